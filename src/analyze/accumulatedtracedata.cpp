@@ -20,10 +20,17 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filter/newline.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -32,14 +39,16 @@
 #include "util/linereader.h"
 #include "util/pointermap.h"
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 #ifdef __GNUC__
 #define POTENTIALLY_UNUSED __attribute__((unused))
 #else
 #define POTENTIALLY_UNUSED
 #endif
 
-AllocationData::DisplayId AllocationData::display = AllocationData::DisplayId::malloc;
-
 bool AccumulatedTraceData::isHideUnmanagedStackParts = false;
 bool AccumulatedTraceData::isShowCoreCLRPartOption = false;
 
@@ -59,11 +68,84 @@ std::ostream& operator<<(std::ostream& out, const Index<Base> index)
     out << index.index;
     return out;
 }
+
+bool readLifetimes(LineReader& reader, AllocationLifetimes& lifetime)
+{
+    if (!(reader >> lifetime.allocationIndex)) {
+        return false;
+    }
+    for (auto& count : lifetime.histogram.byTime) {
+        if (!(reader >> count)) {
+            return false;
+        }
+    }
+    for (auto& count : lifetime.histogram.byEvents) {
+        if (!(reader >> count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Stream buffer for a data file that is still being written.
+ *
+ * At the end of a regular file it waits for the writer to append more data,
+ * instead of reporting the end of the stream. Pipes end when the writer closes
+ * them. Once stop is set, the data that is available is still read, but then
+ * the stream ends.
+ */
+class FollowingFileBuffer : public std::streambuf
+{
+public:
+    explicit FollowingFileBuffer(const std::atomic<bool>& stop)
+        : m_stop(stop)
+    {
+    }
+
+    bool open(const std::string& path)
+    {
+        if (!m_file.open(path, std::ios_base::in | std::ios_base::binary)) {
+            return false;
+        }
+#ifndef _WIN32
+        struct stat info;
+        m_isPipe = stat(path.c_str(), &info) == 0 && S_ISFIFO(info.st_mode);
+#endif
+        return true;
+    }
+
+protected:
+    int_type underflow() override
+    {
+        while (!m_isPipe || !m_stop) {
+            const auto size = m_file.sgetn(m_buffer, sizeof(m_buffer));
+            if (size > 0) {
+                setg(m_buffer, m_buffer, m_buffer + size);
+                return traits_type::to_int_type(*m_buffer);
+            }
+            if (m_isPipe || m_stop) {
+                break;
+            }
+            // seeking clears the end-of-file state, so the next read picks up new data
+            m_file.pubseekoff(0, std::ios_base::cur);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return traits_type::eof();
+    }
+
+private:
+    std::filebuf m_file;
+    const std::atomic<bool>& m_stop;
+    bool m_isPipe = false;
+    char m_buffer[64 * 1024];
+};
 }
 
 AccumulatedTraceData::AccumulatedTraceData()
 {
     instructionPointers.reserve(16384);
+    inlinedFrames.reserve(16384);
     traces.reserve(65536);
     strings.reserve(4096);
     allocations.reserve(16384);
@@ -146,6 +228,13 @@ bool AccumulatedTraceData::read(const std::string& inputFile, const ParsePass pa
         return false;
     }
 
+    // gzip streams can't be entered in the middle, so we still have to decompress
+    // everything before a checkpoint, but at least we don't parse it
+    const uint64_t offset = m_resume ? m_resume->offset : 0;
+    if (offset && !isCompressed) {
+        file.seekg(offset);
+    }
+
     boost::iostreams::filtering_istream in;
     in.push(boost::iostreams::newline_filter(boost::iostreams::newline::posix)); // fix possible newline issues
     if (isCompressed) {
@@ -153,10 +242,36 @@ bool AccumulatedTraceData::read(const std::string& inputFile, const ParsePass pa
     }
     in.push(file);
 
+    if (offset && isCompressed) {
+        in.ignore(offset);
+    }
+
     return read(in, pass);
 }
 
-bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
+bool AccumulatedTraceData::readLive(const std::string& inputFile, const std::atomic<bool>& stop)
+{
+    using namespace std;
+
+    FollowingFileBuffer buffer(stop);
+    if (!buffer.open(inputFile)) {
+        cerr << "Failed to open heaptrack log file: " << inputFile << endl;
+        return false;
+    }
+    istream file(&buffer);
+
+    boost::iostreams::filtering_istream in;
+    in.push(boost::iostreams::newline_filter(boost::iostreams::newline::posix)); // fix possible newline issues
+    if (boost::algorithm::ends_with(inputFile, ".gz")) {
+        in.push(boost::iostreams::gzip_decompressor());
+    }
+    in.push(file);
+
+    return read(in, LivePass);
+}
+
+template <AccumulatedTraceData::ParsePass pass>
+bool AccumulatedTraceData::readPass(std::istream& in)
 {
     using namespace std;
 
@@ -189,8 +304,12 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
     const auto lastSharedPeakCost = pass != FirstPass ? totalCost.shared.peak : 0;
     const auto lastSharedPeakTime = pass != FirstPass ? sharedPeakTime : 0;
 
-    m_maxAllocationTraceIndex.index = 0;
+    m_allocationSlots.clear();
     totalCost = {};
+    for (auto& thread : threads) {
+        thread.cost = {};
+    }
+    m_threadMatches.clear();
     mallocPeakTime = 0;
     managedPeakTime = 0;
     privateCleanPeakTime = 0;
@@ -198,6 +317,9 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
     sharedPeakTime = 0;
     systemInfo = {};
     peakRSS = 0;
+    fragmentation = {};
+    peakFragmentation = {};
+    peakFragmentationTime = 0;
     allocations.clear();
     addressRangeInfos.clear();
     uint fileVersion = 0;
@@ -212,11 +334,109 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
     // allocations, i.e. when a deallocation follows with the same data
     uint64_t lastAllocationPtr = 0;
 
-    while (reader.getLine(in)) {
-        if (reader.mode() == 's') {
-            if (pass != FirstPass) {
+    // the byte offset of the current line, and of the next one
+    uint64_t lineOffset = 0;
+    uint64_t offset = 0;
+
+    if (m_resume) {
+        timeStamp = m_resume->timeStamp;
+        offset = m_resume->offset;
+        lastAllocationPtr = m_resume->lastAllocationPtr;
+        fileVersion = m_resume->fileVersion;
+        fromAttached = m_resume->fromAttached;
+        systemInfo = m_resume->systemInfo;
+        totalCost = m_resume->totalCost;
+        for (size_t thread = 0; thread < m_resume->threadCosts.size(); ++thread) {
+            findThread(thread).cost = m_resume->threadCosts[thread];
+        }
+        fragmentation = m_resume->fragmentation;
+        if (pass != FirstPass) {
+            for (const auto& allocation : m_resume->allocations) {
+                allocations.set(findAllocationSlot(allocation.traceIndex), allocation);
+            }
+        }
+        for (const auto& range : m_resume->addressRanges) {
+            addressRangeInfos.insert(make_pair(range.start, range));
+        }
+        if (pass != FirstPass && !m_resume->debuggee.empty()) {
+            handleDebuggee(m_resume->debuggee.c_str());
+        }
+    }
+    // checkpoints are always taken in front of a time stamp
+    bool isCheckpointLine = m_resume != nullptr;
+
+    // the events before the time window only change the state, see readWindow
+    bool inWindow = timeStamp >= m_windowBegin;
+    // the chart pass clears the allocations as well, so it has to restore the peaks of the second pass
+    const bool takesPeakSnapshots = pass == SecondPass || pass == ThirdPass;
+    // the peaks only cover the time window, so they start out with the state at its begin
+    auto startPeak = [&](AllocationData::DisplayId display, AllocationData::Stats& total, int64_t& peakTime,
+                         int64_t lastPeakCost, int64_t lastPeakTime) {
+        if (total.leaked <= total.peak) {
+            return;
+        }
+        const bool isHeap = display == AllocationData::DisplayId::malloc
+            || display == AllocationData::DisplayId::managed;
+        total.peak = total.leaked;
+        total.peakSlack = total.slack;
+        if (isHeap) {
+            total.peak_instances = total.allocations - total.deallocations;
+        }
+        peakTime = timeStamp;
+
+        if (takesPeakSnapshots && total.peak == lastPeakCost && peakTime == lastPeakTime) {
+            allocations.takePeakSnapshot(display, isHeap);
+            if (pass == SecondPass && !isHeap && isShowCoreCLRPartOption) {
+                calculatePeak(display);
+            }
+        }
+    };
+
+    // a live read can't know the final peaks up front, so the allocations are
+    // snapshotted whenever a time stamp or smaps chunk raised the peak instead
+    bool hasNewPeak[AllocationTable::NumDisplays] = {};
+    auto takeNewPeakSnapshots = [&]() {
+        for (int i = 0; i < AllocationTable::NumDisplays; ++i) {
+            if (!hasNewPeak[i]) {
                 continue;
             }
+            hasNewPeak[i] = false;
+            const auto display = static_cast<AllocationData::DisplayId>(i);
+            const bool isHeap = display == AllocationData::DisplayId::malloc
+                || display == AllocationData::DisplayId::managed;
+            allocations.takePeakSnapshot(display, isHeap);
+            if (!isHeap && isShowCoreCLRPartOption) {
+                calculatePeak(display);
+            }
+        }
+    };
+
+    // records that are irrelevant for this pass are skipped after peeking at their mode
+    LineReader::Modes skipModes;
+    skipModes.set('#');
+    const bool parsesDefinitions = (pass == FirstPass || pass == LivePass) && !m_hasIndexedDefinitions;
+    if (!parsesDefinitions) {
+        for (const char mode : {'s', 't', 'i', 'a', 'e', 'C', 'h'}) {
+            skipModes.set(static_cast<unsigned char>(mode));
+        }
+    }
+    bool isPastWindow = false;
+    int64_t nextCheckpoint = m_checkpointInterval;
+
+    while (!isPastWindow && reader.getLine(in, skipModes)) {
+        lineOffset = offset;
+        offset += reader.size();
+
+        if (isCheckpointLine) {
+            if (reader.mode() != 'c') {
+                cerr << "The index does not match the heaptrack log file." << endl;
+                return false;
+            }
+            isCheckpointLine = false;
+        }
+
+        switch (reader.mode()) {
+        case 's': {
             strings.push_back(reader.line().substr(2));
             StringIndex index;
             index.index = strings.size();
@@ -232,10 +452,9 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                     stopStrings.erase(stopIt);
                 }
             }
-        } else if (reader.mode() == 't') {
-            if (pass != FirstPass) {
-                continue;
-            }
+            break;
+        }
+        case 't': {
             TraceNode node;
             reader >> node.ipIndex;
             reader >> node.parentIndex;
@@ -259,11 +478,10 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             }
 
             traces.push_back(node);
-        } else if (reader.mode() == 'i') {
-            if (pass != FirstPass) {
-                continue;
-            }
-            InstructionPointer ip;
+            break;
+        }
+        case 'i': {
+            InstructionPointerRecord ip;
             reader >> ip.instructionPointer;
             reader >> ip.isManaged;
             reader >> ip.moduleIndex;
@@ -275,12 +493,14 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                     && (reader >> frame->fileIndex)
                     && (reader >> frame->line);
             };
+            ip.inlinedOffset = inlinedFrames.size();
             if (readFrame(&ip.frame)) {
                 Frame inlinedFrame;
                 while (readFrame(&inlinedFrame)) {
-                    ip.inlined.push_back(inlinedFrame);
+                    inlinedFrames.push_back(inlinedFrame);
                 }
             }
+            ip.inlinedCount = inlinedFrames.size() - ip.inlinedOffset;
 
             instructionPointers.push_back(ip);
             if (find(opNewStrIndices.begin(), opNewStrIndices.end(), ip.frame.functionIndex) != opNewStrIndices.end()) {
@@ -288,7 +508,9 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                 index.index = instructionPointers.size();
                 opNewIpIndices.push_back(index);
             }
-        } else if (reader.mode() == '*') {
+            break;
+        }
+        case '*': {
             uint64_t length, ptr;
             int prot, fd, isCoreclr;
             TraceIndex traceIndex;
@@ -316,16 +538,21 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             rangeInfo.setIsCoreCLR(isCoreclr);
             rangeInfo.setTraceIndex(traceIndex.index);
 
-            combineContiguousSimilarRanges();
+            combineContiguousSimilarRanges(ptr, ptr + length);
 
             if (pass != FirstPass) {
-                auto& allocation = findAllocation(traceIndex);
+                const auto slot = findAllocationSlot(traceIndex);
 
-                assert(allocation.traceIndex == traceIndex);
+                assert(allocations.traceIndex(slot) == traceIndex);
+                (void)slot;
 
-                handleTotalCostUpdate();
+                if (inWindow) {
+                    handleTotalCostUpdate();
+                }
             }
-        } else if (reader.mode() == '/') {
+            break;
+        }
+        case '/': {
             uint64_t length, ptr;
 
             if (!(reader >> length)
@@ -335,7 +562,9 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             }
 
             mapRemoveRanges(ptr, length);
-        } else if (reader.mode() == 'K') {
+            break;
+        }
+        case 'K': {
             int isStart;
 
             if (!(reader >> isStart) || !(isStart == 1 || isStart == 0)) {
@@ -377,17 +606,14 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                 totalCost.shared.allocated = 0;
 
                 if (pass != FirstPass) {
-                    for (auto& allocation : allocations)
-                    {
-                        allocation.privateClean.leaked = 0;
-                        allocation.privateClean.allocated = 0;
+                    allocations.fill(AllocationData::DisplayId::privateClean, AllocationTable::Leaked, 0);
+                    allocations.fill(AllocationData::DisplayId::privateClean, AllocationTable::Allocated, 0);
 
-                        allocation.privateDirty.leaked = 0;
-                        allocation.privateDirty.allocated = 0;
+                    allocations.fill(AllocationData::DisplayId::privateDirty, AllocationTable::Leaked, 0);
+                    allocations.fill(AllocationData::DisplayId::privateDirty, AllocationTable::Allocated, 0);
 
-                        allocation.shared.leaked = 0;
-                        allocation.shared.allocated = 0;
-                    }
+                    allocations.fill(AllocationData::DisplayId::shared, AllocationTable::Leaked, 0);
+                    allocations.fill(AllocationData::DisplayId::shared, AllocationTable::Allocated, 0);
                 }
 
                 for (auto i = addressRangeInfos.begin (); i != addressRangeInfos.end(); ++i)
@@ -402,98 +628,92 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                     totalCost.privateClean.allocated += addressRangeInfo.getPrivateClean();
                     totalCost.privateClean.leaked += addressRangeInfo.getPrivateClean();
 
-                    if (totalCost.privateClean.leaked > totalCost.privateClean.peak) {
+                    if (inWindow && totalCost.privateClean.leaked > totalCost.privateClean.peak) {
                         totalCost.privateClean.peak = totalCost.privateClean.leaked;
                         privateCleanPeakTime = timeStamp;
 
-                        if (pass == SecondPass && totalCost.privateClean.peak == lastPrivateCleanPeakCost && privateCleanPeakTime == lastPrivateCleanPeakTime) {
-                            for (auto& allocation : allocations) {
-                                allocation.privateClean.peak = allocation.privateClean.leaked;
-                            }
+                        if (takesPeakSnapshots && totalCost.privateClean.peak == lastPrivateCleanPeakCost && privateCleanPeakTime == lastPrivateCleanPeakTime) {
+                            allocations.takePeakSnapshot(AllocationData::DisplayId::privateClean, false);
+                        } else if (pass == LivePass) {
+                            hasNewPeak[static_cast<int>(AllocationData::DisplayId::privateClean)] = true;
                         }
                     }
 
                     totalCost.privateDirty.allocated += addressRangeInfo.getPrivateDirty();
                     totalCost.privateDirty.leaked += addressRangeInfo.getPrivateDirty();
 
-                    if (totalCost.privateDirty.leaked > totalCost.privateDirty.peak) {
+                    if (inWindow && totalCost.privateDirty.leaked > totalCost.privateDirty.peak) {
                         totalCost.privateDirty.peak = totalCost.privateDirty.leaked;
                         privateDirtyPeakTime = timeStamp;
 
-                        if (pass == SecondPass && totalCost.privateDirty.peak == lastPrivateDirtyPeakCost && privateDirtyPeakTime == lastPrivateDirtyPeakTime) {
-                            for (auto& allocation : allocations) {
-                                allocation.privateDirty.peak = allocation.privateDirty.leaked;
-                            }
+                        if (takesPeakSnapshots && totalCost.privateDirty.peak == lastPrivateDirtyPeakCost && privateDirtyPeakTime == lastPrivateDirtyPeakTime) {
+                            allocations.takePeakSnapshot(AllocationData::DisplayId::privateDirty, false);
+                        } else if (pass == LivePass) {
+                            hasNewPeak[static_cast<int>(AllocationData::DisplayId::privateDirty)] = true;
                         }
                     }
 
                     totalCost.shared.allocated += addressRangeInfo.getShared();
                     totalCost.shared.leaked += addressRangeInfo.getShared();
 
-                    if (totalCost.shared.leaked > totalCost.shared.peak) {
+                    if (inWindow && totalCost.shared.leaked > totalCost.shared.peak) {
                         totalCost.shared.peak = totalCost.shared.leaked;
                         sharedPeakTime = timeStamp;
 
-                        if (pass == SecondPass && totalCost.shared.peak == lastSharedPeakCost && sharedPeakTime == lastSharedPeakTime) {
-                            for (auto& allocation : allocations) {
-                                allocation.shared.peak = allocation.shared.leaked;
-                            }
+                        if (takesPeakSnapshots && totalCost.shared.peak == lastSharedPeakCost && sharedPeakTime == lastSharedPeakTime) {
+                            allocations.takePeakSnapshot(AllocationData::DisplayId::shared, false);
+                        } else if (pass == LivePass) {
+                            hasNewPeak[static_cast<int>(AllocationData::DisplayId::shared)] = true;
                         }
                     }
 
                     if (pass != FirstPass) {
-                        auto& allocation = findAllocation(addressRangeInfo.traceIndex);
+                        const auto slot = findAllocationSlot(addressRangeInfo.traceIndex);
 
-                        allocation.privateClean.leaked += addressRangeInfo.getPrivateClean();
-                        allocation.privateClean.allocated += addressRangeInfo.getPrivateClean();
+                        allocations.at(slot, AllocationData::DisplayId::privateClean, AllocationTable::Leaked) += addressRangeInfo.getPrivateClean();
+                        allocations.at(slot, AllocationData::DisplayId::privateClean, AllocationTable::Allocated) += addressRangeInfo.getPrivateClean();
 
-                        allocation.privateDirty.leaked += addressRangeInfo.getPrivateDirty();
-                        allocation.privateDirty.allocated += addressRangeInfo.getPrivateDirty();
+                        allocations.at(slot, AllocationData::DisplayId::privateDirty, AllocationTable::Leaked) += addressRangeInfo.getPrivateDirty();
+                        allocations.at(slot, AllocationData::DisplayId::privateDirty, AllocationTable::Allocated) += addressRangeInfo.getPrivateDirty();
 
-                        allocation.shared.leaked += addressRangeInfo.getShared();
-                        allocation.shared.allocated += addressRangeInfo.getShared();
+                        allocations.at(slot, AllocationData::DisplayId::shared, AllocationTable::Leaked) += addressRangeInfo.getShared();
+                        allocations.at(slot, AllocationData::DisplayId::shared, AllocationTable::Allocated) += addressRangeInfo.getShared();
                     }
                 }
 
-                if (isShowCoreCLRPartOption)
+                if (pass == LivePass) {
+                    takeNewPeakSnapshots();
+                }
+
+                if (pass != FirstPass && inWindow) {
+                    handleAddressRangesUpdate();
+                }
+
+                if (isShowCoreCLRPartOption && pass == SecondPass && inWindow)
                 {
-                    if (pass == SecondPass && totalCost.privateClean.peak == lastPrivateCleanPeakCost && timeStamp == lastPrivateCleanPeakTime
-                        && AllocationData::display == AllocationData::DisplayId::privateClean)
+                    if (totalCost.privateClean.peak == lastPrivateCleanPeakCost && timeStamp == lastPrivateCleanPeakTime)
                     {
-                        partCoreclrMMAP.peak = 0;
-                        partNonCoreclrMMAP.peak = 0;
-                        partUnknownMMAP.peak = 0;
-                        partUntrackedMMAP.peak = 0;
-
                         calculatePeak(AllocationData::DisplayId::privateClean);
                     }
 
-                    if (pass == SecondPass && totalCost.privateDirty.peak == lastPrivateDirtyPeakCost && timeStamp == lastPrivateDirtyPeakTime
-                        && AllocationData::display == AllocationData::DisplayId::privateDirty)
+                    if (totalCost.privateDirty.peak == lastPrivateDirtyPeakCost && timeStamp == lastPrivateDirtyPeakTime)
                     {
-                        partCoreclrMMAP.peak = 0;
-                        partNonCoreclrMMAP.peak = 0;
-                        partUnknownMMAP.peak = 0;
-                        partUntrackedMMAP.peak = 0;
-
                         calculatePeak(AllocationData::DisplayId::privateDirty);
                     }
 
-                    if (pass == SecondPass && totalCost.shared.peak == lastSharedPeakCost && timeStamp == lastSharedPeakTime
-                        && AllocationData::display == AllocationData::DisplayId::shared)
+                    if (totalCost.shared.peak == lastSharedPeakCost && timeStamp == lastSharedPeakTime)
                     {
-                        partCoreclrMMAP.peak = 0;
-                        partNonCoreclrMMAP.peak = 0;
-                        partUnknownMMAP.peak = 0;
-                        partUntrackedMMAP.peak = 0;
-
                         calculatePeak(AllocationData::DisplayId::shared);
                     }
                 }
             }
 
-            handleTotalCostUpdate();
-        } else if (reader.mode() == 'k') {
+            if (inWindow) {
+                handleTotalCostUpdate();
+            }
+            break;
+        }
+        case 'k': {
             if (!isSmapsChunkInProcess) {
                 cerr << "wrong trace format (smaps data outside of smaps chunk)" << endl;
                 continue;
@@ -533,16 +753,12 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                                                        sharedDirty  * kilobyteSize,
                                                        sharedClean  * kilobyteSize);
             }
-        } else if (reader.mode() == '+') {
+            break;
+        }
+        case '+': {
             AllocationInfo info;
             AllocationIndex allocationIndex;
 
-            if (AllocationData::display != AllocationData::DisplayId::malloc
-                && AllocationData::display != AllocationData::DisplayId::managed) {
-                // we only need the malloc/calloc/realloc/free details information for malloc and managed statistics
-                continue;
-            }
-
             if (fileVersion >= 1) {
                 if (!(reader >> allocationIndex.index)) {
                     cerr << "failed to parse line: " << reader.line() << endl;
@@ -569,46 +785,67 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                 lastAllocationPtr = ptr;
             }
 
+            auto& threadCost = findThread(info.thread).cost;
+            ++threadCost.allocations;
+            threadCost.allocated += info.size;
+            threadCost.leaked += info.size;
+            if (inWindow && threadCost.leaked > threadCost.peak) {
+                threadCost.peak = threadCost.leaked;
+                threadCost.peak_instances = threadCost.allocations - threadCost.deallocations;
+            }
+            if (!isThreadAccounted(info.thread)) {
+                break;
+            }
+
             if (pass != FirstPass) {
-                auto& allocation = findAllocation(info.traceIndex);
-                allocation.malloc.leaked += info.size;
-                allocation.malloc.allocated += info.size;
-                ++allocation.malloc.allocations;
+                const auto slot = findAllocationSlot(info.traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Leaked) += info.size;
+                allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Allocated) += info.size;
+                ++allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Allocations);
+                if (info.slack) {
+                    allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Slack) += info.slack;
+                }
 
-                handleTotalCostUpdate();
-                handleAllocation(info, allocationIndex);
+                if (inWindow) {
+                    handleTotalCostUpdate();
+                    handleAllocation(info, allocationIndex);
+                }
             }
 
             ++totalCost.malloc.allocations;
             totalCost.malloc.allocated += info.size;
             totalCost.malloc.leaked += info.size;
-            if (totalCost.malloc.leaked > totalCost.malloc.peak) {
+            totalCost.malloc.slack += info.slack;
+            if (inWindow && totalCost.malloc.leaked > totalCost.malloc.peak) {
                 totalCost.malloc.peak = totalCost.malloc.leaked;
+                totalCost.malloc.peakSlack = totalCost.malloc.slack;
                 totalCost.malloc.peak_instances = totalCost.malloc.allocations - totalCost.malloc.deallocations;
                 mallocPeakTime = timeStamp;
 
-                if (pass == SecondPass && totalCost.malloc.peak == lastMallocPeakCost && mallocPeakTime == lastMallocPeakTime) {
-                    for (auto& allocation : allocations) {
-                        allocation.malloc.peak = allocation.malloc.leaked;
-                        allocation.malloc.peak_instances = allocation.malloc.allocations - allocation.malloc.deallocations;
-                    }
+                if (takesPeakSnapshots && totalCost.malloc.peak == lastMallocPeakCost && mallocPeakTime == lastMallocPeakTime) {
+                    allocations.takePeakSnapshot(AllocationData::DisplayId::malloc, true);
+                } else if (pass == LivePass) {
+                    hasNewPeak[static_cast<int>(AllocationData::DisplayId::malloc)] = true;
                 }
             }
-        } else if (reader.mode() == '-') {
+            break;
+        }
+        case '-': {
             AllocationIndex allocationInfoIndex;
             bool temporary = false;
 
-            if (AllocationData::display != AllocationData::DisplayId::malloc) {
-                // we don't need the malloc/calloc/realloc/free details information for malloc statistics
-                continue;
-            }
-
             if (fileVersion >= 1) {
                 if (!(reader >> allocationInfoIndex.index)) {
                     cerr << "failed to parse line: " << reader.line() << endl;
                     continue;
                 }
-                temporary = lastAllocationPtr == allocationInfoIndex.index;
+                if (fileVersion >= 3) {
+                    // the interpreter tells the temporary allocations per thread
+                    int flag = 0;
+                    temporary = (reader >> flag) && flag;
+                } else {
+                    temporary = lastAllocationPtr == allocationInfoIndex.index;
+                }
             } else { // backwards compatibility
                 uint64_t ptr = 0;
                 if (!(reader >> ptr)) {
@@ -628,30 +865,44 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             const auto& info = allocationInfos[allocationInfoIndex.index];
             assert(!info.isManaged);
 
+            auto& threadCost = findThread(info.thread).cost;
+            threadCost.leaked -= info.size;
+            ++threadCost.deallocations;
+            if (temporary) {
+                ++threadCost.temporary;
+            }
+            if (!isThreadAccounted(info.thread)) {
+                break;
+            }
+
             totalCost.malloc.leaked -= info.size;
+            totalCost.malloc.slack -= info.slack;
             ++totalCost.malloc.deallocations;
             if (temporary) {
                 ++totalCost.malloc.temporary;
             }
 
             if (pass != FirstPass) {
-                auto& allocation = findAllocation(info.traceIndex);
-                allocation.malloc.leaked -= info.size;
-                ++allocation.malloc.deallocations;
+                const auto slot = findAllocationSlot(info.traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Leaked) -= info.size;
+                ++allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Deallocations);
+                if (info.slack) {
+                    allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Slack) -= info.slack;
+                }
                 if (temporary) {
-                    ++allocation.malloc.temporary;
+                    ++allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Temporary);
+                }
+
+                if (inWindow) {
+                    handleDeallocation(info, allocationInfoIndex);
                 }
             }
-        } else if (reader.mode() == '^') {
+            break;
+        }
+        case '^': {
             AllocationInfo info;
             AllocationIndex allocationIndex;
 
-            if (AllocationData::display != AllocationData::DisplayId::malloc
-                && AllocationData::display != AllocationData::DisplayId::managed) {
-                // we only need the managed allocation details information for malloc and managed allocation statistics
-                continue;
-            }
-
             if (!(reader >> allocationIndex.index)) {
                 cerr << "failed to parse line: " << reader.line() << endl;
                 continue;
@@ -665,38 +916,36 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             assert(info.isManaged);
 
             if (pass != FirstPass) {
-                auto& allocation = findAllocation(info.traceIndex);
-                allocation.managed.leaked += info.size;
-                allocation.managed.allocated += info.size;
-                ++allocation.managed.allocations;
-
-                handleTotalCostUpdate();
-                handleAllocation(info, allocationIndex);
+                const auto slot = findAllocationSlot(info.traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::managed, AllocationTable::Leaked) += info.size;
+                allocations.at(slot, AllocationData::DisplayId::managed, AllocationTable::Allocated) += info.size;
+                ++allocations.at(slot, AllocationData::DisplayId::managed, AllocationTable::Allocations);
+
+                if (inWindow) {
+                    handleTotalCostUpdate();
+                    handleAllocation(info, allocationIndex);
+                }
             }
 
             ++totalCost.managed.allocations;
             totalCost.managed.allocated += info.size;
             totalCost.managed.leaked += info.size;
-            if (totalCost.managed.leaked > totalCost.managed.peak) {
+            if (inWindow && totalCost.managed.leaked > totalCost.managed.peak) {
                 totalCost.managed.peak = totalCost.managed.leaked;
                 totalCost.managed.peak_instances = totalCost.managed.allocations - totalCost.managed.deallocations;
                 managedPeakTime = timeStamp;
 
-                if (pass == SecondPass && totalCost.managed.peak == lastManagedPeakCost && managedPeakTime == lastManagedPeakTime) {
-                    for (auto& allocation : allocations) {
-                        allocation.managed.peak = allocation.managed.leaked;
-                        allocation.managed.peak_instances = allocation.managed.allocations - allocation.managed.deallocations;
-                    }
+                if (takesPeakSnapshots && totalCost.managed.peak == lastManagedPeakCost && managedPeakTime == lastManagedPeakTime) {
+                    allocations.takePeakSnapshot(AllocationData::DisplayId::managed, true);
+                } else if (pass == LivePass) {
+                    hasNewPeak[static_cast<int>(AllocationData::DisplayId::managed)] = true;
                 }
             }
-        } else if (reader.mode() == '~') {
+            break;
+        }
+        case '~': {
             AllocationIndex allocationInfoIndex;
 
-            if (AllocationData::display != AllocationData::DisplayId::managed) {
-                // we don't need the managed deallocation details information for non-managed allocation statistics
-                continue;
-            }
-
             if (!(reader >> allocationInfoIndex.index)) {
                 cerr << "failed to parse line: " << reader.line() << endl;
                 continue;
@@ -709,47 +958,142 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             ++totalCost.managed.deallocations;
 
             if (pass != FirstPass) {
-                auto& allocation = findAllocation(info.traceIndex);
-                allocation.managed.leaked -= info.size;
-                ++allocation.managed.deallocations;
-            }
-        } else if (reader.mode() == 'a') {
-            if (pass != FirstPass) {
-                continue;
+                const auto slot = findAllocationSlot(info.traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::managed, AllocationTable::Leaked) -= info.size;
+                ++allocations.at(slot, AllocationData::DisplayId::managed, AllocationTable::Deallocations);
+
+                if (inWindow) {
+                    handleDeallocation(info, allocationInfoIndex);
+                }
             }
+            break;
+        }
+        case 'a': {
             AllocationInfo info;
             if (!(reader >> info.size) || !(reader >> info.traceIndex) || !(reader >> info.isManaged)) {
                 cerr << "failed to parse line: " << reader.line() << endl;
                 continue;
             }
+            // the thread is only written for the malloc allocations of known threads or with slack
+            if (reader >> info.thread) {
+                reader >> info.slack;
+            }
             allocationInfos.push_back(info);
-        } else if (reader.mode() == '#') {
+            break;
+        }
+        case 'h': { // thread name
+            uint32_t thread = 0;
+            StringIndex name;
+            if (!(reader >> thread) || !(reader >> name)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            findThread(thread).name = name;
+            break;
+        }
+        case '#': {
             // comment or empty line
-            continue;
-        } else if (reader.mode() == 'c') {
+            break;
+        }
+        case 'c': {
             int64_t newStamp = 0;
             if (!(reader >> newStamp)) {
                 cerr << "Failed to read time stamp: " << reader.line() << endl;
                 continue;
             }
-            if (pass != FirstPass) {
+            if (newStamp > m_windowEnd) {
+                isPastWindow = true;
+                break;
+            }
+
+            if (m_indexOut && newStamp >= nextCheckpoint && !isSmapsChunkInProcess && fileVersion >= 1) {
+                // older files need the pointer map, which we don't store
+                Checkpoint checkpoint;
+                checkpoint.timeStamp = timeStamp;
+                checkpoint.offset = lineOffset;
+                checkpoint.lastAllocationPtr = lastAllocationPtr;
+                checkpoint.fileVersion = fileVersion;
+                checkpoint.fromAttached = fromAttached;
+                checkpoint.systemInfo = systemInfo;
+                checkpoint.totalCost = totalCost;
+                for (const auto& thread : threads) {
+                    checkpoint.threadCosts.push_back(thread.cost);
+                }
+                checkpoint.fragmentation = fragmentation;
+                writeCheckpoint(*m_indexOut, checkpoint);
+                nextCheckpoint = newStamp + m_checkpointInterval;
+            }
+
+            if (pass == LivePass) {
+                takeNewPeakSnapshots();
+                totalTime = newStamp + 1;
+            }
+
+            const bool entersWindow = !inWindow && newStamp >= m_windowBegin;
+            if (pass != FirstPass && (inWindow || entersWindow)) {
                 handleTimeStamp(timeStamp, newStamp);
             }
             timeStamp = newStamp;
-        } else if (reader.mode() == 'R') { // RSS timestamp
+
+            if (entersWindow) {
+                inWindow = true;
+                startPeak(AllocationData::DisplayId::malloc, totalCost.malloc, mallocPeakTime,
+                          lastMallocPeakCost, lastMallocPeakTime);
+                startPeak(AllocationData::DisplayId::managed, totalCost.managed, managedPeakTime,
+                          lastManagedPeakCost, lastManagedPeakTime);
+                startPeak(AllocationData::DisplayId::privateClean, totalCost.privateClean, privateCleanPeakTime,
+                          lastPrivateCleanPeakCost, lastPrivateCleanPeakTime);
+                startPeak(AllocationData::DisplayId::privateDirty, totalCost.privateDirty, privateDirtyPeakTime,
+                          lastPrivateDirtyPeakCost, lastPrivateDirtyPeakTime);
+                startPeak(AllocationData::DisplayId::shared, totalCost.shared, sharedPeakTime,
+                          lastSharedPeakCost, lastSharedPeakTime);
+                for (auto& thread : threads) {
+                    thread.cost.peak = thread.cost.leaked;
+                    thread.cost.peak_instances = thread.cost.allocations - thread.cost.deallocations;
+                }
+                if (fragmentation.gap() > peakFragmentation.gap()) {
+                    peakFragmentation = fragmentation;
+                    peakFragmentationTime = timeStamp;
+                }
+            }
+            break;
+        }
+        case 'f': { // heap fragmentation, written in front of the time stamps when it changed
+            Fragmentation next;
+            if (!(reader >> next.live) || !(reader >> next.spanned) || !(reader >> next.sparse)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            fragmentation = next;
+            if (inWindow && fragmentation.gap() > peakFragmentation.gap()) {
+                peakFragmentation = fragmentation;
+                peakFragmentationTime = timeStamp;
+            }
+            break;
+        }
+        case 'R': { // RSS timestamp
             int64_t rss = 0;
             reader >> rss;
-            if (rss > peakRSS) {
+            if (inWindow && rss > peakRSS) {
                 peakRSS = rss;
             }
-        } else if (reader.mode() == 'X') {
+            break;
+        }
+        case 'X': {
             if (pass != FirstPass) {
                 handleDebuggee(reader.line().c_str() + 2);
             }
-        } else if (reader.mode() == 'A') {
+            if (m_indexOut) {
+                *m_indexOut << reader.line() << '\n';
+            }
+            break;
+        }
+        case 'A': {
             totalCost = {};
             fromAttached = true;
-        } else if (reader.mode() == 'v') {
+            break;
+        }
+        case 'v': {
             uint heaptrackVersion = 0;
             reader >> heaptrackVersion;
             if (!(reader >> fileVersion) && heaptrackVersion == 0x010200) {
@@ -767,13 +1111,14 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
                      << endl;
                 return false;
             }
-        } else if (reader.mode() == 'I') { // system information
+            break;
+        }
+        case 'I': { // system information
             reader >> systemInfo.pageSize;
             reader >> systemInfo.pages;
-        } else if (reader.mode() == 'e') { // object dependency
-            if (pass != FirstPass) {
-                continue;
-            }
+            break;
+        }
+        case 'e': { // object dependency
             ObjectTreeNode node;
             reader >> node.gcNum;
             reader >> node.numChildren;
@@ -781,290 +1126,702 @@ bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
             reader >> node.classIndex;
             reader >> node.allocIndex;
             objectTreeNodes.push_back(node);
-        } else if (reader.mode() == 'C') { // class info
-            if (pass != FirstPass) {
-                continue;
-            }
+            break;
+        }
+        case 'C': { // class info
             ClassIndex classIndex;
             reader >> classIndex;
             classIndices.push_back(classIndex);
-        } else {
+            break;
+        }
+        case 'l': { // lifetimes, written after all allocations
+            AllocationLifetimes lifetime;
+            if (!readLifetimes(reader, lifetime)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            if (lifetime.allocationIndex.index >= allocationInfos.size()) {
+                cerr << "allocation index out of bounds: " << lifetime.allocationIndex.index
+                    << ", maximum is: " << allocationInfos.size() << endl;
+                continue;
+            }
+            if (!isThreadAccounted(allocationInfos[lifetime.allocationIndex.index].thread)) {
+                break;
+            }
+            if (parsesDefinitions) {
+                lifetimes.push_back(lifetime);
+            }
+            const auto shortLived = lifetime.histogram.shortLived();
+            totalCost.malloc.shortLived += shortLived;
+            if (pass != FirstPass) {
+                const auto slot = findAllocationSlot(allocationInfos[lifetime.allocationIndex.index].traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::ShortLived) += shortLived;
+            }
+            break;
+        }
+        case 'p': { // pinned pages, written after all allocations
+            AllocationIndex allocationIndex;
+            int64_t pinned = 0;
+            if (!(reader >> allocationIndex.index) || !(reader >> pinned)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            if (allocationIndex.index >= allocationInfos.size()) {
+                cerr << "allocation index out of bounds: " << allocationIndex.index
+                    << ", maximum is: " << allocationInfos.size() << endl;
+                continue;
+            }
+            const auto& info = allocationInfos[allocationIndex.index];
+            if (!isThreadAccounted(info.thread)) {
+                break;
+            }
+            totalCost.malloc.pinned += pinned;
+            if (pass != FirstPass) {
+                const auto slot = findAllocationSlot(info.traceIndex);
+                allocations.at(slot, AllocationData::DisplayId::malloc, AllocationTable::Pinned) += pinned;
+            }
+            break;
+        }
+        default:
             cerr << "failed to parse line: " << reader.line() << endl;
         }
     }
 
-    if (pass == FirstPass) {
+    if (pass == LivePass) {
+        takeNewPeakSnapshots();
+    }
+
+    sortAllocations();
+
+    if (pass == FirstPass || pass == LivePass) {
         totalTime = timeStamp + 1;
-    } else {
+    }
+    if (pass != FirstPass) {
         handleTimeStamp(timeStamp, totalTime);
     }
 
-    if (isShowCoreCLRPartOption)
+    // the chart pass reads the same data again, so the parts and the node types are final after the
+    // second pass already. the GUI reads the node types while the charts are built, so don't touch them
+    if (isShowCoreCLRPartOption && pass != ThirdPass)
     {
         AllocationData::Stats totalCoreclr;
         AllocationData::Stats totalNonCoreclr;
         AllocationData::Stats totalUnknown;
         AllocationData::Stats totalUntracked;
 
-        if (AllocationData::display == AllocationData::DisplayId::malloc)
+        resetCoreCLRClassification();
+
+        for (size_t slot = 0; slot < allocations.size(); ++slot)
         {
-            for (auto it = allocations.begin(); it != allocations.end(); ++it)
+            const auto traceIndex = allocations.traceIndex(slot);
+            const auto malloc = allocations.stats(slot, AllocationData::DisplayId::malloc);
+
+            if (!isValidTrace(traceIndex))
             {
-                if (!isValidTrace(it->traceIndex))
-                {
-                    totalUnknown += *(it->getDisplay ());
-                    continue;
-                }
+                totalUnknown += malloc;
+                continue;
+            }
 
-                // Update type for each trace node
-                TraceIndex index = it->traceIndex;
-                while (isValidTrace(index))
-                {
-                    TraceNode node = findTrace(index);
-                    updateTraceNodeType(index, checkIsNodeCoreCLR(node.ipIndex));
-                    index = node.parentIndex;
-                }
+            // Update type for each trace node
+            updateCallStackNodeTypes(traceIndex, false, false);
 
-                AllocationData::CoreCLRType stackType;
-                if (checkCallStackIsCoreCLR(it->traceIndex))
-                {
-                    stackType = AllocationData::CoreCLRType::CoreCLR;
-                }
-                else if (checkCallStackIsUntracked(it->traceIndex))
-                {
-                    // Untracked shouldn't occur for malloc
-                    assert(0);
-                }
-                else if (!isValidTrace(findTrace(it->traceIndex).parentIndex))
-                {
-                    // Single element in stack, mark it unknown
-                    stackType = AllocationData::CoreCLRType::unknown;
-                }
-                else
-                {
-                    stackType = AllocationData::CoreCLRType::nonCoreCLR;
-                }
+            AllocationData::CoreCLRType stackType = checkCallStackType(traceIndex);
 
-                if (stackType == AllocationData::CoreCLRType::CoreCLR)
-                {
-                    totalCoreclr += *(it->getDisplay ());
-                }
-                else if (stackType == AllocationData::CoreCLRType::nonCoreCLR)
-                {
-                    totalNonCoreclr += *(it->getDisplay ());
-                }
-                else if (stackType == AllocationData::CoreCLRType::untracked)
-                {
-                    totalUntracked += *(it->getDisplay ());
-                }
-                else if (stackType == AllocationData::CoreCLRType::unknown)
-                {
-                    totalUnknown += *(it->getDisplay ());
-                }
+            if (stackType == AllocationData::CoreCLRType::CoreCLR)
+            {
+                totalCoreclr += malloc;
+            }
+            else if (stackType == AllocationData::CoreCLRType::nonCoreCLR)
+            {
+                totalNonCoreclr += malloc;
             }
+            else if (stackType == AllocationData::CoreCLRType::untracked)
+            {
+                // Untracked shouldn't occur for malloc
+                assert(malloc.isEmpty());
+                totalUntracked += malloc;
+            }
+            else if (stackType == AllocationData::CoreCLRType::unknown)
+            {
+                totalUnknown += malloc;
+            }
+        }
+
+        partCoreclr.malloc = totalCoreclr;
+        partNonCoreclr.malloc = totalNonCoreclr;
+        partUnknown.malloc = totalUnknown;
+        partUntracked.malloc = totalUntracked;
 
-            partCoreclr = totalCoreclr;
-            partNonCoreclr = totalNonCoreclr;
-            partUnknown = totalUnknown;
-            partUntracked = totalUntracked;
+        for (auto part : {&partCoreclr, &partNonCoreclr, &partUnknown, &partUntracked})
+        {
+            part->privateClean.leaked = 0;
+            part->privateDirty.leaked = 0;
+            part->shared.leaked = 0;
         }
-        else if (AllocationData::display == AllocationData::DisplayId::privateDirty
-                 || AllocationData::display == AllocationData::DisplayId::privateClean
-                 || AllocationData::display == AllocationData::DisplayId::shared)
+
+        // iterate backwards, so that the node types of the trace nodes shared by
+        // several ranges are set by the last of them, see updateCallStackNodeTypes
+        for (auto it = addressRangeInfos.rbegin(); it != addressRangeInfos.rend(); ++it)
         {
-            for (auto it = addressRangeInfos.begin(); it != addressRangeInfos.end(); ++it)
+            AllocationData* part = &partUnknown;
+
+            if (isValidTrace(it->second.traceIndex))
             {
-                int64_t val = AllocationData::display == AllocationData::DisplayId::privateDirty
-                              ? it->second.getPrivateDirty()
-                              : AllocationData::display == AllocationData::DisplayId::privateClean
-                                ? it->second.getPrivateClean()
-                                : AllocationData::display == AllocationData::DisplayId::shared
-                                  ? it->second.getShared()
-                                  : 0;
-
-                if (!isValidTrace(it->second.traceIndex))
+                switch (checkAddressRangeType(it->second))
                 {
-                    totalUnknown.leaked += val;
-                    continue;
+                    case AllocationData::CoreCLRType::CoreCLR:
+                        part = &partCoreclr;
+                        break;
+                    case AllocationData::CoreCLRType::nonCoreCLR:
+                        part = &partNonCoreclr;
+                        break;
+                    case AllocationData::CoreCLRType::untracked:
+                        part = &partUntracked;
+                        break;
+                    case AllocationData::CoreCLRType::unknown:
+                        break;
                 }
+            }
 
-                TraceIndex index = it->second.traceIndex;
-                while (isValidTrace(index))
-                {
-                    TraceNode node = findTrace(index);
-                    AllocationData::CoreCLRType nodeType;
-                    if (it->second.isCoreCLR == 2)
-                    {
-                        nodeType = AllocationData::CoreCLRType::untracked;
-                    }
-                    else
-                    {
-                        nodeType = checkIsNodeCoreCLR(node.ipIndex);
-                    }
-                    updateTraceNodeType(index, nodeType);
-                    index = node.parentIndex;
-                }
+            part->privateClean.leaked += it->second.getPrivateClean();
+            part->privateDirty.leaked += it->second.getPrivateDirty();
+            part->shared.leaked += it->second.getShared();
+        }
+    }
 
-                AllocationData::CoreCLRType stackType;
-                if (it->second.isCoreCLR == 2)
-                {
-                    stackType = AllocationData::CoreCLRType::untracked;
-                }
-                else if (checkCallStackIsCoreCLR(it->second.traceIndex))
-                {
-                    stackType = AllocationData::CoreCLRType::CoreCLR;
-                }
-                else if (checkCallStackIsUntracked(it->second.traceIndex))
-                {
-                    stackType = AllocationData::CoreCLRType::untracked;
-                }
-                else if (!isValidTrace(findTrace(it->second.traceIndex).parentIndex))
-                {
-                    // single element in stack
-                    stackType = AllocationData::CoreCLRType::unknown;
-                }
-                else
-                {
-                    stackType = AllocationData::CoreCLRType::nonCoreCLR;
-                }
+    return true;
+}
 
-                if (stackType == AllocationData::CoreCLRType::CoreCLR)
-                {
-                    totalCoreclr.leaked += val;
-                }
-                else if (stackType == AllocationData::CoreCLRType::nonCoreCLR)
-                {
-                    totalNonCoreclr.leaked += val;
-                }
-                else if (stackType == AllocationData::CoreCLRType::untracked)
-                {
-                    totalUntracked.leaked += val;
-                }
-                else if (stackType == AllocationData::CoreCLRType::unknown)
-                {
-                    totalUnknown.leaked += val;
-                }
-            }
+bool AccumulatedTraceData::read(std::istream& in, const ParsePass pass)
+{
+    switch (pass) {
+    case FirstPass:
+        return readPass<FirstPass>(in);
+    case SecondPass:
+        return readPass<SecondPass>(in);
+    case ThirdPass:
+        return readPass<ThirdPass>(in);
+    case LivePass:
+        return readPass<LivePass>(in);
+    }
+    return false;
+}
+
+namespace { // helpers for the index
+
+// bump this when the format of the index changes
+const uint32_t indexVersion = 4;
+
+const AllocationData::DisplayId allDisplays[] = {
+    AllocationData::DisplayId::malloc, AllocationData::DisplayId::managed, AllocationData::DisplayId::privateClean,
+    AllocationData::DisplayId::privateDirty, AllocationData::DisplayId::shared};
+
+AllocationData::Stats& statsOf(AllocationData& data, AllocationData::DisplayId display)
+{
+    return const_cast<AllocationData::Stats&>(*data.getDisplay(display));
+}
+
+// the index is written in hex like the data file, negative values and doubles are stored bitwise
+uint64_t toHex(int64_t value)
+{
+    return static_cast<uint64_t>(value);
+}
+
+uint64_t toHex(double value)
+{
+    uint64_t ret;
+    memcpy(&ret, &value, sizeof(ret));
+    return ret;
+}
+
+double doubleFromHex(uint64_t value)
+{
+    double ret;
+    memcpy(&ret, &value, sizeof(ret));
+    return ret;
+}
+
+// the statistics that are accumulated, the peaks are computed per time window
+void writeStats(std::ostream& out, const AllocationData::Stats& stats)
+{
+    out << ' ' << toHex(stats.allocations) << ' ' << toHex(stats.deallocations) << ' ' << toHex(stats.temporary)
+        << ' ' << toHex(stats.allocated) << ' ' << toHex(stats.leaked) << ' ' << toHex(stats.slack);
+}
 
-            partCoreclrMMAP.leaked = totalCoreclr.leaked;
-            partNonCoreclrMMAP.leaked = totalNonCoreclr.leaked;
-            partUnknownMMAP.leaked = totalUnknown.leaked;
-            partUntrackedMMAP.leaked = totalUntracked.leaked;
+bool readStats(LineReader& reader, AllocationData::Stats& stats)
+{
+    return (reader >> stats.allocations) && (reader >> stats.deallocations) && (reader >> stats.temporary)
+        && (reader >> stats.allocated) && (reader >> stats.leaked) && (reader >> stats.slack);
+}
+}
+
+bool AccumulatedTraceData::readAndIndex(const std::string& inputFile, const std::string& indexFile,
+                                        int64_t checkpointInterval)
+{
+    using namespace std;
+
+    if (!read(inputFile, FirstPass)) {
+        return false;
+    }
+
+    ofstream index(indexFile);
+    if (!index.is_open()) {
+        cerr << "Failed to open heaptrack index file for writing: " << indexFile << endl;
+        return false;
+    }
+    index << hex;
+    writeIndexDefinitions(index);
+
+    m_indexOut = &index;
+    m_checkpointInterval = max(checkpointInterval, int64_t(1));
+    const bool ret = read(inputFile, SecondPass);
+    m_indexOut = nullptr;
+
+    if (ret && !index) {
+        cerr << "Failed to write heaptrack index file: " << indexFile << endl;
+        return false;
+    }
+    return ret;
+}
+
+bool AccumulatedTraceData::readWindow(const std::string& inputFile, const std::string& indexFile, int64_t begin,
+                                      int64_t end)
+{
+    using namespace std;
+
+    m_windowBegin = begin;
+    m_windowEnd = end;
+
+    if (!indexFile.empty()) {
+        ifstream index(indexFile);
+        if (!index.is_open()) {
+            cerr << "Failed to open heaptrack index file: " << indexFile << endl;
+            return false;
+        }
+        if (!readIndex(index, begin)) {
+            return false;
         }
     }
 
-    return true;
+    return read(inputFile, FirstPass) && read(inputFile, SecondPass);
 }
 
-void
-AccumulatedTraceData::calculatePeak(AllocationData::DisplayId type)
+void AccumulatedTraceData::writeIndexDefinitions(std::ostream& out) const
 {
-    for (auto i = addressRangeInfos.begin (); i != addressRangeInfos.end(); ++i)
-    {
-        const AddressRangeInfo& addressRangeInfo = i->second;
+    out << "H " << indexVersion << ' ' << int(isHideUnmanagedStackParts) << '\n';
 
-        int64_t peak = 0;
-        switch (type)
-        {
-            case AllocationData::DisplayId::privateDirty:
-            {
-                peak = addressRangeInfo.getPrivateDirty();
-                break;
-            }
-            case AllocationData::DisplayId::privateClean:
-            {
-                peak = addressRangeInfo.getPrivateClean();
-                break;
-            }
-            case AllocationData::DisplayId::shared:
-            {
-                peak = addressRangeInfo.getShared();
-                break;
+    for (const auto& string : strings) {
+        out << "s " << string << '\n';
+    }
+    for (const auto& index : stopIndices) {
+        out << "x " << index << '\n';
+    }
+    for (const auto& ip : instructionPointers) {
+        out << "i " << ip.instructionPointer << ' ' << ip.isManaged << ' ' << ip.moduleIndex << ' '
+            << ip.moduleOffset << ' ' << ip.frame.functionIndex << ' ' << ip.frame.fileIndex << ' ' << ip.frame.line;
+        for (auto i = ip.inlinedOffset; i < ip.inlinedOffset + ip.inlinedCount; ++i) {
+            const auto& frame = inlinedFrames[i];
+            out << ' ' << frame.functionIndex << ' ' << frame.fileIndex << ' ' << frame.line;
+        }
+        out << '\n';
+    }
+    // these are the traces after skipping operator new etc., they are not processed again when reading the index
+    for (const auto& trace : traces) {
+        out << "t " << trace.ipIndex << ' ' << trace.parentIndex << '\n';
+    }
+    for (const auto& info : allocationInfos) {
+        out << "a " << info.size << ' ' << info.traceIndex << ' ' << info.isManaged << ' ' << info.thread << ' '
+            << info.slack << '\n';
+    }
+    for (size_t thread = 0; thread < threads.size(); ++thread) {
+        out << "h " << thread << ' ' << threads[thread].name << '\n';
+    }
+    for (const auto& classIndex : classIndices) {
+        out << "C " << classIndex << '\n';
+    }
+    for (const auto& node : objectTreeNodes) {
+        out << "e " << node.gcNum << ' ' << node.numChildren << ' ' << node.objectPtr << ' ' << node.classIndex
+            << ' ' << node.allocIndex << '\n';
+    }
+    for (const auto& lifetime : lifetimes) {
+        out << "l " << lifetime.allocationIndex;
+        for (const auto count : lifetime.histogram.byTime) {
+            out << ' ' << count;
+        }
+        for (const auto count : lifetime.histogram.byEvents) {
+            out << ' ' << count;
+        }
+        out << '\n';
+    }
+}
+
+void AccumulatedTraceData::writeCheckpoint(std::ostream& out, const Checkpoint& checkpoint) const
+{
+    out << "P " << checkpoint.timeStamp << ' ' << checkpoint.offset << ' ' << checkpoint.lastAllocationPtr << ' '
+        << checkpoint.fileVersion << ' ' << int(checkpoint.fromAttached) << ' ' << checkpoint.systemInfo.pageSize << ' '
+        << checkpoint.systemInfo.pages << '\n';
+
+    for (auto display : allDisplays) {
+        out << "T " << static_cast<int>(display);
+        writeStats(out, *checkpoint.totalCost.getDisplay(display));
+        out << '\n';
+    }
+    for (size_t thread = 0; thread < checkpoint.threadCosts.size(); ++thread) {
+        out << "W " << thread;
+        writeStats(out, checkpoint.threadCosts[thread]);
+        out << '\n';
+    }
+    const auto& fragmentation = checkpoint.fragmentation;
+    if (fragmentation.spanned) {
+        out << "F " << fragmentation.live << ' ' << fragmentation.spanned << ' ' << fragmentation.sparse << '\n';
+    }
+
+    // one line per allocation, with the statistics of the metrics that are not empty
+    for (size_t slot = 0; slot < allocations.size(); ++slot) {
+        AllocationData::Stats stats[AllocationTable::NumDisplays];
+        int displays = 0;
+        for (auto display : allDisplays) {
+            auto& displayStats = stats[static_cast<int>(display)];
+            displayStats = allocations.stats(slot, display);
+            displayStats.peak = 0;
+            displayStats.peakSlack = 0;
+            if (!displayStats.isEmpty()) {
+                displays |= 1 << static_cast<int>(display);
             }
-            default:
-            {
-                assert(0);
+        }
+        out << "S " << allocations.traceIndex(slot) << ' ' << displays;
+        for (auto display : allDisplays) {
+            if (displays & (1 << static_cast<int>(display))) {
+                writeStats(out, stats[static_cast<int>(display)]);
             }
         }
+        out << '\n';
+    }
 
-        if(!addressRangeInfo.isPhysicalMemoryConsumptionSet) {
-            continue;
-        }
+    for (const auto& entry : addressRangeInfos) {
+        const auto& range = entry.second;
+        const int flags = range.isProtSet | (range.isPhysicalMemoryConsumptionSet << 1) | (range.isFdSet << 2)
+            | (range.isCoreCLRSet << 3);
+        out << "M " << range.start << ' ' << range.size << ' ' << range.traceIndex << ' ' << range.prot << ' '
+            << range.fd << ' ' << range.isCoreCLR << ' ' << flags << ' ' << toHex(range.privateDirty) << ' '
+            << toHex(range.privateClean) << ' ' << toHex(range.sharedDirty) << ' ' << toHex(range.sharedClean)
+            << '\n';
+    }
+}
 
-        if (!isValidTrace(addressRangeInfo.traceIndex))
-        {
-            partUnknownMMAP.peak += peak;
-            continue;
-        }
+bool AccumulatedTraceData::readIndex(std::istream& in, int64_t begin)
+{
+    using namespace std;
 
-        TraceIndex index = addressRangeInfo.traceIndex;
-        while (isValidTrace(index))
-        {
-            TraceNode node = findTrace(index);
-            AllocationData::CoreCLRType nodeType;
-            if (addressRangeInfo.isCoreCLR == 2)
-            {
-                nodeType = AllocationData::CoreCLRType::untracked;
+    LineReader reader;
+    string debuggee;
+    unique_ptr<Checkpoint> checkpoint;
+    // position of the data of the checkpoint in the index
+    istream::pos_type checkpointData;
+
+    auto readFrame = [&reader](Frame* frame) {
+        return (reader >> frame->functionIndex) && (reader >> frame->fileIndex) && (reader >> frame->line);
+    };
+
+    while (reader.getLine(in)) {
+        if (reader.mode() == 'H') {
+            uint32_t version = 0;
+            int hideUnmanagedStackParts = 0;
+            if (!(reader >> version) || !(reader >> hideUnmanagedStackParts)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                return false;
             }
-            else
-            {
-                nodeType = checkIsNodeCoreCLR(node.ipIndex);
+            if (version != indexVersion) {
+                cerr << "The index has version " << version << ", but only version " << indexVersion
+                     << " is supported." << endl;
+                return false;
+            }
+            if (static_cast<bool>(hideUnmanagedStackParts) != isHideUnmanagedStackParts) {
+                cerr << "The index was written with a different setting for hiding unmanaged stack parts." << endl;
+                return false;
+            }
+        } else if (reader.mode() == 's') {
+            strings.push_back(reader.line().substr(2));
+        } else if (reader.mode() == 'x') {
+            StringIndex index;
+            reader >> index;
+            stopIndices.push_back(index);
+        } else if (reader.mode() == 'i') {
+            InstructionPointerRecord ip;
+            if (!(reader >> ip.instructionPointer) || !(reader >> ip.isManaged) || !(reader >> ip.moduleIndex)
+                || !(reader >> ip.moduleOffset) || !readFrame(&ip.frame)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            ip.inlinedOffset = inlinedFrames.size();
+            Frame inlinedFrame;
+            while (readFrame(&inlinedFrame)) {
+                inlinedFrames.push_back(inlinedFrame);
+            }
+            ip.inlinedCount = inlinedFrames.size() - ip.inlinedOffset;
+            instructionPointers.push_back(ip);
+        } else if (reader.mode() == 't') {
+            TraceNode node;
+            reader >> node.ipIndex;
+            reader >> node.parentIndex;
+            traces.push_back(node);
+        } else if (reader.mode() == 'a') {
+            AllocationInfo info;
+            if (!(reader >> info.size) || !(reader >> info.traceIndex) || !(reader >> info.isManaged)
+                || !(reader >> info.thread) || !(reader >> info.slack)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            allocationInfos.push_back(info);
+        } else if (reader.mode() == 'h') {
+            uint32_t thread = 0;
+            StringIndex name;
+            if (!(reader >> thread) || !(reader >> name)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            findThread(thread).name = name;
+        } else if (reader.mode() == 'C') {
+            ClassIndex classIndex;
+            reader >> classIndex;
+            classIndices.push_back(classIndex);
+        } else if (reader.mode() == 'e') {
+            ObjectTreeNode node;
+            reader >> node.gcNum;
+            reader >> node.numChildren;
+            reader >> node.objectPtr;
+            reader >> node.classIndex;
+            reader >> node.allocIndex;
+            objectTreeNodes.push_back(node);
+        } else if (reader.mode() == 'l') {
+            AllocationLifetimes lifetime;
+            if (!readLifetimes(reader, lifetime)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                continue;
             }
-            updateTraceNodeType(index, nodeType);
-            index = node.parentIndex;
+            lifetimes.push_back(lifetime);
+        } else if (reader.mode() == 'X') {
+            debuggee = reader.line().substr(2);
+        } else if (reader.mode() == 'P') {
+            unique_ptr<Checkpoint> next(new Checkpoint);
+            int fromAttached = 0;
+            if (!(reader >> next->timeStamp) || !(reader >> next->offset) || !(reader >> next->lastAllocationPtr)
+                || !(reader >> next->fileVersion) || !(reader >> fromAttached)
+                || !(reader >> next->systemInfo.pageSize) || !(reader >> next->systemInfo.pages)) {
+                cerr << "failed to parse line: " << reader.line() << endl;
+                return false;
+            }
+            if (next->timeStamp >= begin) {
+                // the checkpoints are sorted by time, so the previous one is the one we are looking for
+                break;
+            }
+            next->fromAttached = fromAttached;
+            next->debuggee = debuggee;
+            checkpoint = move(next);
+            checkpointData = in.tellg();
+        } else if (reader.mode() == 'T' || reader.mode() == 'W' || reader.mode() == 'F' || reader.mode() == 'S'
+                   || reader.mode() == 'M') {
+            // the data of the checkpoints is only parsed for the one we resume at
+            continue;
+        } else if (reader.mode() != '#') {
+            cerr << "failed to parse line: " << reader.line() << endl;
         }
+    }
 
-        AllocationData::CoreCLRType stackType;
-        if (addressRangeInfo.isCoreCLR == 2)
-        {
-            stackType = AllocationData::CoreCLRType::untracked;
+    if (checkpoint) {
+        in.clear();
+        in.seekg(checkpointData);
+        while (reader.getLine(in) && reader.mode() != 'P') {
+            if (reader.mode() == 'T') {
+                int display = 0;
+                if (!(reader >> display) || display < 0 || display >= AllocationTable::NumDisplays
+                    || !readStats(reader, statsOf(checkpoint->totalCost, allDisplays[display]))) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+            } else if (reader.mode() == 'W') {
+                uint32_t thread = 0;
+                AllocationData::Stats cost;
+                if (!(reader >> thread) || !readStats(reader, cost)) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+                if (checkpoint->threadCosts.size() <= thread) {
+                    checkpoint->threadCosts.resize(thread + 1);
+                }
+                checkpoint->threadCosts[thread] = cost;
+            } else if (reader.mode() == 'F') {
+                auto& fragmentation = checkpoint->fragmentation;
+                if (!(reader >> fragmentation.live) || !(reader >> fragmentation.spanned)
+                    || !(reader >> fragmentation.sparse)) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+            } else if (reader.mode() == 'S') {
+                Allocation allocation;
+                int displays = 0;
+                if (!(reader >> allocation.traceIndex) || !(reader >> displays)) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+                for (auto display : allDisplays) {
+                    if ((displays & (1 << static_cast<int>(display)))
+                        && !readStats(reader, statsOf(allocation, display))) {
+                        cerr << "failed to parse line: " << reader.line() << endl;
+                        return false;
+                    }
+                }
+                checkpoint->allocations.push_back(allocation);
+            } else if (reader.mode() == 'M') {
+                uint64_t start = 0, size = 0;
+                int flags = 0;
+                uint64_t privateDirty = 0, privateClean = 0, sharedDirty = 0, sharedClean = 0;
+                if (!(reader >> start) || !(reader >> size)) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+                AddressRangeInfo range(start, size);
+                if (!(reader >> range.traceIndex) || !(reader >> range.prot) || !(reader >> range.fd)
+                    || !(reader >> range.isCoreCLR) || !(reader >> flags) || !(reader >> privateDirty)
+                    || !(reader >> privateClean) || !(reader >> sharedDirty) || !(reader >> sharedClean)) {
+                    cerr << "failed to parse line: " << reader.line() << endl;
+                    return false;
+                }
+                range.isProtSet = flags & 1;
+                range.isPhysicalMemoryConsumptionSet = flags & 2;
+                range.isFdSet = flags & 4;
+                range.isCoreCLRSet = flags & 8;
+                range.privateDirty = doubleFromHex(privateDirty);
+                range.privateClean = doubleFromHex(privateClean);
+                range.sharedDirty = doubleFromHex(sharedDirty);
+                range.sharedClean = doubleFromHex(sharedClean);
+                checkpoint->addressRanges.push_back(range);
+            }
         }
-        else if (checkCallStackIsCoreCLR(addressRangeInfo.traceIndex))
+    }
+
+    m_hasIndexedDefinitions = true;
+    m_resume = move(checkpoint);
+    return true;
+}
+
+void
+AccumulatedTraceData::calculatePeak(AllocationData::DisplayId type)
+{
+    AllocationData::Stats AllocationData::*stats = nullptr;
+    uint64_t (AddressRangeInfo::*getPeak)() const = nullptr;
+    switch (type)
+    {
+        case AllocationData::DisplayId::privateDirty:
         {
-            stackType = AllocationData::CoreCLRType::CoreCLR;
+            stats = &AllocationData::privateDirty;
+            getPeak = &AddressRangeInfo::getPrivateDirty;
+            break;
         }
-        else if (checkCallStackIsUntracked(addressRangeInfo.traceIndex))
+        case AllocationData::DisplayId::privateClean:
         {
-            stackType = AllocationData::CoreCLRType::untracked;
+            stats = &AllocationData::privateClean;
+            getPeak = &AddressRangeInfo::getPrivateClean;
+            break;
         }
-        else if (!isValidTrace(findTrace(addressRangeInfo.traceIndex).parentIndex))
+        case AllocationData::DisplayId::shared:
         {
-            // single element in stack
-            stackType = AllocationData::CoreCLRType::unknown;
+            stats = &AllocationData::shared;
+            getPeak = &AddressRangeInfo::getShared;
+            break;
         }
-        else
+        default:
         {
-            stackType = AllocationData::CoreCLRType::nonCoreCLR;
+            assert(0);
+            return;
         }
+    }
 
-        if (stackType == AllocationData::CoreCLRType::CoreCLR)
-        {
-            partCoreclrMMAP.peak += peak;
-        }
-        else if (stackType == AllocationData::CoreCLRType::nonCoreCLR)
-        {
-            partNonCoreclrMMAP.peak += peak;
+    for (auto part : {&partCoreclr, &partNonCoreclr, &partUnknown, &partUntracked})
+    {
+        (part->*stats).peak = 0;
+    }
+
+    resetCoreCLRClassification();
+
+    // iterate backwards, see the comment in read()
+    for (auto i = addressRangeInfos.rbegin (); i != addressRangeInfos.rend(); ++i)
+    {
+        const AddressRangeInfo& addressRangeInfo = i->second;
+
+        if(!addressRangeInfo.isPhysicalMemoryConsumptionSet) {
+            continue;
         }
-        else if (stackType == AllocationData::CoreCLRType::untracked)
+
+        const int64_t peak = (addressRangeInfo.*getPeak)();
+
+        if (!isValidTrace(addressRangeInfo.traceIndex))
         {
-            partUntrackedMMAP.peak += peak;
+            (partUnknown.*stats).peak += peak;
+            continue;
         }
-        else if (stackType == AllocationData::CoreCLRType::unknown)
+
+        switch (checkAddressRangeType(addressRangeInfo))
         {
-            partUnknownMMAP.peak += peak;
+            case AllocationData::CoreCLRType::CoreCLR:
+                (partCoreclr.*stats).peak += peak;
+                break;
+            case AllocationData::CoreCLRType::nonCoreCLR:
+                (partNonCoreclr.*stats).peak += peak;
+                break;
+            case AllocationData::CoreCLRType::untracked:
+                (partUntracked.*stats).peak += peak;
+                break;
+            case AllocationData::CoreCLRType::unknown:
+                (partUnknown.*stats).peak += peak;
+                break;
         }
     }
 }
 
+void
+AccumulatedTraceData::resetCoreCLRClassification()
+{
+    m_ipCoreCLRTypes.assign(instructionPointers.size(), IpCoreCLRState());
+    m_traceCoreCLRStates.assign(traces.size(), TraceCoreCLRState());
+}
+
 AllocationData::CoreCLRType
 AccumulatedTraceData::checkIsNodeCoreCLR(IpIndex ipindex)
 {
-    InstructionPointer ip = findIp(ipindex);
+    if (!ipindex || ipindex.index > instructionPointers.size())
+    {
+        return findAddressCoreCLRType(0);
+    }
+
+    if (m_ipCoreCLRTypes.size() < instructionPointers.size())
+    {
+        m_ipCoreCLRTypes.resize(instructionPointers.size());
+    }
+
+    auto& state = m_ipCoreCLRTypes[ipindex.index - 1];
+    if (!state.isClassified)
+    {
+        state.type = findAddressCoreCLRType(instructionPointers[ipindex.index - 1].instructionPointer);
+        state.isClassified = true;
+    }
+
+    return state.type;
+}
+
+AllocationData::CoreCLRType
+AccumulatedTraceData::findAddressCoreCLRType(uint64_t address) const
+{
     AllocationData::CoreCLRType coreclrType = AllocationData::CoreCLRType::unknown;
 
-    for (auto iter = addressRangeInfos.begin(); iter != addressRangeInfos.end(); ++iter)
+    // the ranges don't overlap, so only the last range starting at or before
+    // the address can contain it
+    auto iter = addressRangeInfos.upper_bound(address);
+    if (iter != addressRangeInfos.begin())
     {
-        if (iter->second.start <= ip.instructionPointer && iter->second.start + iter->second.size > ip.instructionPointer)
+        --iter;
+
+        if (iter->second.start <= address && iter->second.start + iter->second.size > address)
         {
             if (iter->second.isCoreCLR == 0)
             {
@@ -1078,7 +1835,6 @@ AccumulatedTraceData::checkIsNodeCoreCLR(IpIndex ipindex)
             {
                 coreclrType = AllocationData::CoreCLRType::untracked;
             }
-            break;
         }
     }
     if (coreclrType == AllocationData::CoreCLRType::unknown)
@@ -1089,53 +1845,132 @@ AccumulatedTraceData::checkIsNodeCoreCLR(IpIndex ipindex)
     return coreclrType;
 }
 
-bool
-AccumulatedTraceData::checkCallStackIsCoreCLR(TraceIndex index)
+AccumulatedTraceData::TraceCoreCLRState&
+AccumulatedTraceData::classifyTrace(TraceIndex traceIndex)
 {
-    while (isValidTrace(index))
+    assert(isValidTrace(traceIndex));
+
+    if (m_traceCoreCLRStates.size() < traces.size())
     {
-        TraceNode node = findTrace(index);
-        index = node.parentIndex;
+        m_traceCoreCLRStates.resize(traces.size());
+    }
 
-        if (node.nodeType == AllocationData::CoreCLRType::CoreCLR)
-        {
-            return true;
-        }
+    // walk up to the first already classified node, then classify the nodes
+    // below it top-down, so that every node is classified only once
+    std::vector<TraceIndex> unclassified;
+    TraceIndex index = traceIndex;
+    while (isValidTrace(index) && !m_traceCoreCLRStates[index.index - 1].isClassified)
+    {
+        unclassified.push_back(index);
+        index = traces[index.index - 1].parentIndex;
     }
 
-    return false;
+    const TraceCoreCLRState* parentState = isValidTrace(index) ? &m_traceCoreCLRStates[index.index - 1] : nullptr;
+
+    for (auto it = unclassified.rbegin(); it != unclassified.rend(); ++it)
+    {
+        auto& state = m_traceCoreCLRStates[it->index - 1];
+        const auto nodeType = checkIsNodeCoreCLR(traces[it->index - 1].ipIndex);
+
+        state.hasCoreCLRFrame = nodeType == AllocationData::CoreCLRType::CoreCLR
+                                || (parentState && parentState->hasCoreCLRFrame);
+        state.isUntracked = nodeType == AllocationData::CoreCLRType::untracked
+                            && (!parentState || parentState->isUntracked);
+        state.isClassified = true;
+
+        parentState = &state;
+    }
+
+    return m_traceCoreCLRStates[traceIndex.index - 1];
 }
 
-bool
-AccumulatedTraceData::checkCallStackIsUntracked(TraceIndex index)
+AllocationData::CoreCLRType
+AccumulatedTraceData::checkCallStackType(TraceIndex traceIndex)
 {
-    while (isValidTrace(index))
+    const auto& state = classifyTrace(traceIndex);
+
+    if (state.hasCoreCLRFrame)
+    {
+        return AllocationData::CoreCLRType::CoreCLR;
+    }
+    else if (state.isUntracked)
+    {
+        return AllocationData::CoreCLRType::untracked;
+    }
+    else if (!isValidTrace(findTrace(traceIndex).parentIndex))
+    {
+        // single element in stack
+        return AllocationData::CoreCLRType::unknown;
+    }
+    else
     {
-        TraceNode node = findTrace(index);
-        index = node.parentIndex;
+        return AllocationData::CoreCLRType::nonCoreCLR;
+    }
+}
 
-        if (node.nodeType != AllocationData::CoreCLRType::untracked)
-        {
-            return false;
-        }
+AllocationData::CoreCLRType
+AccumulatedTraceData::checkAddressRangeType(const AddressRangeInfo& range)
+{
+    updateCallStackNodeTypes(range.traceIndex, range.isCoreCLR == 2, true);
+
+    if (range.isCoreCLR == 2)
+    {
+        return AllocationData::CoreCLRType::untracked;
     }
 
-    return true;
+    return checkCallStackType(range.traceIndex);
+}
+
+void
+AccumulatedTraceData::updateCallStackNodeTypes(TraceIndex traceIndex, bool isUntracked, bool isMMAP)
+{
+    if (m_traceCoreCLRStates.size() < traces.size())
+    {
+        m_traceCoreCLRStates.resize(traces.size());
+    }
+
+    auto isUpdated = isMMAP ? &TraceCoreCLRState::isMMAPNodeTypeUpdated : &TraceCoreCLRState::isNodeTypeUpdated;
+    auto nodeType = isMMAP ? &TraceNode::mmapNodeType : &TraceNode::nodeType;
+
+    // a node that already got its type in this pass also had all of its
+    // parents updated at the same time, so we can stop there
+    while (isValidTrace(traceIndex) && !(m_traceCoreCLRStates[traceIndex.index - 1].*isUpdated))
+    {
+        auto& node = traces[traceIndex.index - 1];
+
+        node.*nodeType = isUntracked ? AllocationData::CoreCLRType::untracked : checkIsNodeCoreCLR(node.ipIndex);
+        m_traceCoreCLRStates[traceIndex.index - 1].*isUpdated = true;
+
+        traceIndex = node.parentIndex;
+    }
 }
 
 namespace { // helpers for diffing
 
-template <typename IndexT, typename SortF>
-std::vector<IndexT> sortedIndices(size_t numIndices, SortF sorter)
+/**
+ * Run @p job on consecutive chunks of the range [0, size), concurrently if the
+ * range is large enough to make that worthwhile.
+ */
+template <typename Job>
+void parallelFor(size_t size, Job job)
 {
-    using namespace std;
-    vector<IndexT> indices;
-    indices.resize(numIndices);
-    for (size_t i = 0; i < numIndices; ++i) {
-        indices[i].index = (i + 1);
+    const size_t minChunkSize = 8192;
+    const size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t numChunks = std::min(numThreads, (size + minChunkSize - 1) / minChunkSize);
+    if (numChunks <= 1) {
+        job(size_t(0), size);
+        return;
+    }
+
+    const size_t chunkSize = (size + numChunks - 1) / numChunks;
+    std::vector<std::future<void>> chunks;
+    for (size_t begin = chunkSize; begin < size; begin += chunkSize) {
+        chunks.push_back(std::async(std::launch::async, job, begin, std::min(size, begin + chunkSize)));
+    }
+    job(size_t(0), chunkSize);
+    for (auto& chunk : chunks) {
+        chunk.get();
     }
-    sort(indices.begin(), indices.end(), sorter);
-    return indices;
 }
 
 std::vector<StringIndex> remapStrings(std::vector<std::string>& lhs, const std::vector<std::string>& rhs)
@@ -1152,61 +1987,113 @@ std::vector<StringIndex> remapStrings(std::vector<std::string>& lhs, const std::
         }
     }
 
-    vector<StringIndex> map;
-    {
-        map.reserve(rhs.size() + 1);
-        map.push_back({});
-        for (const auto& string : rhs) {
-            auto it = stringRemapping.find(string);
-            if (it == stringRemapping.end()) {
-                ++stringIndex.index;
-                lhs.push_back(string);
-                map.push_back(stringIndex);
-            } else {
-                map.push_back(it->second);
+    vector<StringIndex> map(rhs.size() + 1);
+    // the lookups are independent, only new strings must be appended in order
+    parallelFor(rhs.size(), [&stringRemapping, &rhs, &map](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto it = stringRemapping.find(rhs[i]);
+            if (it != stringRemapping.end()) {
+                map[i + 1] = it->second;
             }
         }
+    });
+    for (size_t i = 0; i < rhs.size(); ++i) {
+        if (!map[i + 1]) {
+            ++stringIndex.index;
+            lhs.push_back(rhs[i]);
+            map[i + 1] = stringIndex;
+        }
     }
     return map;
 }
 
-template <typename T>
-inline const T& identity(const T& t)
+/**
+ * Assigns ids to instruction pointers and backtraces such that two of them get
+ * the same id if and only if they are equal while ignoring the actual addresses.
+ *
+ * The id of a trace is derived from the id of its parent and the id of its
+ * instruction pointer, i.e. it identifies the complete backtrace and is
+ * computed bottom-up once per trace node. Comparing two backtraces then is a
+ * single integer comparison instead of a walk over both stacks.
+ */
+class StackClassifier
 {
-    return t;
-}
+public:
+    struct Classes
+    {
+        // indexed by IpIndex::index, the invalid index maps to the id of an empty instruction pointer
+        std::vector<uint32_t> ips;
+        // indexed by TraceIndex::index, the invalid index maps to 0
+        std::vector<uint32_t> traces;
+    };
 
-template <typename IpMapper>
-int compareTraceIndices(const TraceIndex& lhs, const AccumulatedTraceData& lhsData, const TraceIndex& rhs,
-                        const AccumulatedTraceData& rhsData, IpMapper ipMapper)
-{
-    if (!lhs && !rhs) {
-        return 0;
-    } else if (lhs && !rhs) {
-        return 1;
-    } else if (rhs && !lhs) {
-        return -1;
-    } else if (&lhsData == &rhsData && lhs == rhs) {
-        // fast-path if both indices are equal and we compare the same data
-        return 0;
-    }
-
-    const auto& lhsTrace = lhsData.findTrace(lhs);
-    const auto& rhsTrace = rhsData.findTrace(rhs);
-
-    const int parentComparsion =
-        compareTraceIndices(lhsTrace.parentIndex, lhsData, rhsTrace.parentIndex, rhsData, ipMapper);
-    if (parentComparsion != 0) {
-        return parentComparsion;
-    } // else fall-through to below, parents are equal
-
-    const auto& lhsIp = lhsData.findIp(lhsTrace.ipIndex);
-    const auto& rhsIp = ipMapper(rhsData.findIp(rhsTrace.ipIndex));
-    if (lhsIp.equalWithoutAddress(rhsIp)) {
-        return 0;
-    }
-    return lhsIp.compareWithoutAddress(rhsIp) ? -1 : 1;
-}
+    template <typename IpMapper>
+    Classes classify(const AccumulatedTraceData& data, IpMapper ipMapper)
+    {
+        Classes classes;
+
+        std::vector<IpKey> ipKeys(data.instructionPointers.size() + 1);
+        parallelFor(ipKeys.size(), [&data, &ipMapper, &ipKeys](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                IpIndex ipIndex;
+                ipIndex.index = i;
+                const auto ip = ipMapper(data.findIp(ipIndex));
+                ipKeys[i] = {ip.moduleIndex, ip.frame};
+            }
+        });
+        classes.ips.reserve(ipKeys.size());
+        for (const auto& key : ipKeys) {
+            classes.ips.push_back(m_ipClasses.insert(std::make_pair(key, m_ipClasses.size() + 1)).first->second);
+        }
+
+        classes.traces.reserve(data.traces.size() + 1);
+        classes.traces.push_back(0);
+        for (const auto& trace : data.traces) {
+            // parents are always defined before their children
+            assert(trace.parentIndex.index < classes.traces.size());
+            const auto ipClass =
+                trace.ipIndex.index < classes.ips.size() ? classes.ips[trace.ipIndex.index] : classes.ips[0];
+            const auto key = (uint64_t(classes.traces[trace.parentIndex.index]) << 32) | ipClass;
+            classes.traces.push_back(m_traceClasses.insert(std::make_pair(key, m_traceClasses.size() + 1)).first->second);
+        }
+
+        return classes;
+    }
+
+    size_t numIpClasses() const
+    {
+        return m_ipClasses.size();
+    }
+
+private:
+    struct IpKey
+    {
+        ModuleIndex moduleIndex;
+        Frame frame;
+
+        bool operator==(const IpKey& rhs) const
+        {
+            return moduleIndex == rhs.moduleIndex && frame == rhs.frame;
+        }
+    };
+
+    struct IpKeyHash
+    {
+        size_t operator()(const IpKey& key) const
+        {
+            size_t seed = 0;
+            boost::hash_combine(seed, key.moduleIndex.index);
+            boost::hash_combine(seed, key.frame.functionIndex.index);
+            boost::hash_combine(seed, key.frame.fileIndex.index);
+            boost::hash_combine(seed, key.frame.line);
+            return seed;
+        }
+    };
+
+    std::unordered_map<IpKey, uint32_t, IpKeyHash> m_ipClasses;
+    // maps the parent trace class in the upper and the ip class in the lower 32 bits to the trace class
+    std::unordered_map<uint64_t, uint32_t> m_traceClasses;
+};
 
 POTENTIALLY_UNUSED void printTrace(const AccumulatedTraceData& data, TraceIndex index)
 {
@@ -1233,33 +2120,25 @@ void AccumulatedTraceData::diff(const AccumulatedTraceData& base)
     totalCost -= base.totalCost;
     totalTime -= base.totalTime;
     peakRSS -= base.peakRSS;
+    peakFragmentation.live -= base.peakFragmentation.live;
+    peakFragmentation.spanned -= base.peakFragmentation.spanned;
+    peakFragmentation.sparse -= base.peakFragmentation.sparse;
     systemInfo.pages -= base.systemInfo.pages;
     systemInfo.pageSize -= base.systemInfo.pageSize;
+    // the lifetimes are kept per allocation index, which can't be matched between the files,
+    // only the short-lived counts in the statistics get compared
+    lifetimes.clear();
+    // the thread ids are assigned anew in every run
+    threads.clear();
+
+    // step 1: classify our backtraces, concurrently to the string remapping below
+    //         which only touches the strings
+    StackClassifier classifier;
+    auto lhsClassification = std::async(std::launch::async, [this, &classifier]() {
+        return classifier.classify(*this, [](const InstructionPointer& ip) { return ip; });
+    });
 
-    // step 1: sort trace indices of allocations for efficient lookup
-    // step 2: while at it, also merge equal allocations
-    std::vector<TraceIndex> allocationTraceNodes;
-    allocationTraceNodes.reserve(allocations.size());
-    for (auto it = allocations.begin(); it != allocations.end();) {
-        const auto& allocation = *it;
-        auto sortedIt =
-            std::lower_bound(allocationTraceNodes.begin(), allocationTraceNodes.end(), allocation.traceIndex,
-                        [this](const TraceIndex& lhs, const TraceIndex& rhs) -> bool {
-                            return compareTraceIndices(lhs, *this, rhs, *this, identity<InstructionPointer>) < 0;
-                        });
-        if (sortedIt == allocationTraceNodes.end()
-            || compareTraceIndices(allocation.traceIndex, *this, *sortedIt, *this, identity<InstructionPointer>) != 0) {
-            allocationTraceNodes.insert(sortedIt, allocation.traceIndex);
-            ++it;
-        } else if (*sortedIt != allocation.traceIndex) {
-            findAllocation(*sortedIt) += allocation;
-            it = allocations.erase(it);
-        } else {
-            ++it;
-        }
-    }
-
-    // step 3: map string indices from rhs to lhs data
+    // step 2: map string indices from rhs to lhs data
 
     const auto& stringMap = remapStrings(strings, base.strings);
     auto remapString = [&stringMap](StringIndex& index) {
@@ -1272,47 +2151,71 @@ void AccumulatedTraceData::diff(const AccumulatedTraceData& base)
         remapString(frame.fileIndex);
         return frame;
     };
+    // the inlined frames still reference the base data, they are remapped when the ip gets copied
     auto remapIp = [&remapString, &remapFrame](InstructionPointer ip) -> InstructionPointer {
         remapString(ip.moduleIndex);
         remapFrame(ip.frame);
-        for (auto& inlined : ip.inlined) {
-            inlined = remapFrame(inlined);
-        }
         return ip;
     };
 
-    // step 4: iterate over rhs data and find matching traces
+    // step 3: merge allocations with equal backtraces
+    const auto lhsClasses = lhsClassification.get();
+    // maps the trace class to the trace of the allocation representing it
+    std::unordered_map<uint32_t, TraceIndex> allocationTraces;
+    allocationTraces.reserve(allocations.size() + base.allocations.size());
+    // erasing merged allocations right away would invalidate the allocation slots
+    std::vector<bool> isMerged(allocations.size(), false);
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        const auto traceIndex = allocations.traceIndex(i);
+        const auto it = allocationTraces.insert(std::make_pair(lhsClasses.traces[traceIndex.index], traceIndex)).first;
+        if (it->second != traceIndex) {
+            // the allocation for it->second exists already, so this does not add a slot
+            const auto slot = findAllocationSlot(it->second);
+            allocations.set(slot, allocations[slot] + allocations[i]);
+            isMerged[i] = true;
+        }
+    }
+    std::vector<size_t> kept;
+    kept.reserve(allocations.size());
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        if (!isMerged[i]) {
+            kept.push_back(i);
+        }
+    }
+    allocations.reorder(kept);
+    sortAllocations();
+
+    // step 4: classify the rhs backtraces in the same id space, then iterate
+    //         over the rhs allocations and join them with the lhs ones by class
     //         if no match is found, copy the data over
 
-    auto sortedIps = sortedIndices<IpIndex>(instructionPointers.size(), [this](const IpIndex& lhs, const IpIndex& rhs) {
-        return findIp(lhs).compareWithoutAddress(findIp(rhs));
-    });
+    const auto rhsClasses = classifier.classify(base, remapIp);
+
+    // maps the ip class to the first lhs instruction pointer of that class
+    std::vector<IpIndex> classIps(classifier.numIpClasses() + 1);
+    for (size_t i = 1; i < lhsClasses.ips.size(); ++i) {
+        auto& ipIndex = classIps[lhsClasses.ips[i]];
+        if (!ipIndex) {
+            ipIndex.index = i;
+        }
+    }
 
     // map an IpIndex from the rhs data into the lhs data space, or copy the data
     // if it does not exist yet
-    auto remapIpIndex = [&sortedIps, this, &base, &remapIp](IpIndex rhsIndex) -> IpIndex {
+    auto remapIpIndex = [&classIps, &rhsClasses, this, &base, &remapIp, &remapFrame](IpIndex rhsIndex) -> IpIndex {
         if (!rhsIndex) {
             return rhsIndex;
         }
 
-        const auto& rhsIp = base.findIp(rhsIndex);
-        const auto& lhsIp = remapIp(rhsIp);
-
-        auto it = lower_bound(sortedIps.begin(), sortedIps.end(), lhsIp,
-                              [this](const IpIndex& lhs, const InstructionPointer& rhs) {
-                                  return findIp(lhs).compareWithoutAddress(rhs);
-                              });
-        if (it != sortedIps.end() && findIp(*it).equalWithoutAddress(lhsIp)) {
-            return *it;
+        auto& lhsIndex = classIps[rhsClasses.ips[rhsIndex.index]];
+        if (!lhsIndex) {
+            lhsIndex = addIp(remapIp(base.findIp(rhsIndex)));
+            const auto& record = instructionPointers.back();
+            for (auto i = record.inlinedOffset; i < record.inlinedOffset + record.inlinedCount; ++i) {
+                inlinedFrames[i] = remapFrame(inlinedFrames[i]);
+            }
         }
-
-        instructionPointers.push_back(lhsIp);
-
-        IpIndex ret;
-        ret.index = instructionPointers.size();
-        sortedIps.insert(it, ret);
-
-        return ret;
+        return lhsIndex;
     };
 
     // copy the rhs trace index and the data it references into the lhs data,
@@ -1341,75 +2244,126 @@ void AccumulatedTraceData::diff(const AccumulatedTraceData& base)
     // a trace is equivalent if the complete backtrace has equal
     // InstructionPointer
     // data while ignoring the actual pointer address
-    auto remapTrace = [&base, &allocationTraceNodes, this, remapIp, copyTrace](TraceIndex rhsIndex) -> TraceIndex {
+    auto remapTrace = [&allocationTraces, &rhsClasses, copyTrace](TraceIndex rhsIndex) -> TraceIndex {
         if (!rhsIndex) {
             return rhsIndex;
         }
 
-        auto it = lower_bound(allocationTraceNodes.begin(), allocationTraceNodes.end(), rhsIndex,
-                              [&base, this, remapIp](const TraceIndex& lhs, const TraceIndex& rhs) -> bool {
-                                  return compareTraceIndices(lhs, *this, rhs, base, remapIp) < 0;
-                              });
-
-        if (it != allocationTraceNodes.end() && compareTraceIndices(*it, *this, rhsIndex, base, remapIp) == 0) {
-            return *it;
+        const auto traceClass = rhsClasses.traces[rhsIndex.index];
+        auto it = allocationTraces.find(traceClass);
+        if (it != allocationTraces.end()) {
+            return it->second;
         }
 
         TraceIndex ret = copyTrace(rhsIndex);
-        allocationTraceNodes.insert(it, ret);
+        allocationTraces.insert(std::make_pair(traceClass, ret));
         return ret;
     };
 
-    for (const auto& rhsAllocation : base.allocations) {
+    for (size_t i = 0; i < base.allocations.size(); ++i) {
+        const auto rhsAllocation = base.allocations[i];
         const auto lhsTrace = remapTrace(rhsAllocation.traceIndex);
         assert(remapIp(base.findIp(base.findTrace(rhsAllocation.traceIndex).ipIndex))
                    .equalWithoutAddress(findIp(findTrace(lhsTrace).ipIndex)));
-        findAllocation(lhsTrace) -= rhsAllocation;
+        const auto slot = findAllocationSlot(lhsTrace);
+        allocations.set(slot, allocations[slot] - rhsAllocation);
     }
 
     // step 5: remove allocations that don't show any differences
     //         note that when there are differences in the backtraces,
     //         we can still end up with merged backtraces that have a total
     //         of 0, but different "tails" of different origin with non-zero cost
-    allocations.erase(remove_if(allocations.begin(), allocations.end(),
-                                [](const Allocation& allocation) -> bool { return allocation == AllocationData(); }),
-                      allocations.end());
+    std::vector<size_t> changed;
+    changed.reserve(allocations.size());
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        if (allocations[i] != AllocationData()) {
+            changed.push_back(i);
+        }
+    }
+    allocations.reorder(changed);
+    sortAllocations();
 }
 
-Allocation& AccumulatedTraceData::findAllocation(const TraceIndex traceIndex)
+size_t AccumulatedTraceData::findAllocationSlot(const TraceIndex traceIndex)
 {
-    if (traceIndex < m_maxAllocationTraceIndex) {
-        // only need to search when the trace index is previously known
-        auto it = lower_bound(allocations.begin(), allocations.end(), traceIndex,
-                              [](const Allocation& allocation, const TraceIndex traceIndex) -> bool {
-                                  return allocation.traceIndex < traceIndex;
-                              });
-        if (it == allocations.end() || it->traceIndex != traceIndex) {
-            Allocation allocation;
-            allocation.traceIndex = traceIndex;
-            it = allocations.insert(it, allocation);
-        }
-        return *it;
-    } else if (traceIndex == m_maxAllocationTraceIndex && !allocations.empty()) {
-        // reuse the last allocation
-        assert(allocations.back().traceIndex == traceIndex);
-    } else {
+    if (traceIndex.index >= m_allocationSlots.size()) {
+        m_allocationSlots.resize(traceIndex.index + 1, 0);
+    }
+
+    auto& slot = m_allocationSlots[traceIndex.index];
+    if (!slot) {
         // actually a new allocation
-        Allocation allocation;
-        allocation.traceIndex = traceIndex;
-        allocations.push_back(allocation);
-        m_maxAllocationTraceIndex = traceIndex;
+        slot = allocations.add(traceIndex) + 1;
+    }
+    return slot - 1;
+}
+
+void AccumulatedTraceData::sortAllocations()
+{
+    const auto& traceIndices = allocations.traceIndices();
+    if (!is_sorted(traceIndices.begin(), traceIndices.end())) {
+        std::vector<size_t> order(allocations.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(),
+             [&traceIndices](size_t lhs, size_t rhs) { return traceIndices[lhs] < traceIndices[rhs]; });
+        allocations.reorder(order);
+    }
+
+    fill(m_allocationSlots.begin(), m_allocationSlots.end(), 0);
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        const auto traceIndex = allocations.traceIndex(i);
+        if (traceIndex.index >= m_allocationSlots.size()) {
+            m_allocationSlots.resize(traceIndex.index + 1, 0);
+        }
+        m_allocationSlots[traceIndex.index] = i + 1;
     }
-    return allocations.back();
 }
 
 InstructionPointer AccumulatedTraceData::findIp(const IpIndex ipIndex) const
 {
     if (!ipIndex || ipIndex.index > instructionPointers.size()) {
         return {};
+    }
+
+    const auto& record = instructionPointers[ipIndex.index - 1];
+    InstructionPointer ip;
+    ip.instructionPointer = record.instructionPointer;
+    ip.moduleIndex = record.moduleIndex;
+    ip.moduleOffset = record.moduleOffset;
+    ip.frame = record.frame;
+    ip.inlined.first = inlinedFrames.data() + record.inlinedOffset;
+    ip.inlined.last = ip.inlined.first + record.inlinedCount;
+    ip.isManaged = record.isManaged;
+    return ip;
+}
+
+IpIndex AccumulatedTraceData::addIp(const InstructionPointer& ip)
+{
+    InstructionPointerRecord record;
+    record.instructionPointer = ip.instructionPointer;
+    record.moduleIndex = ip.moduleIndex;
+    record.moduleOffset = ip.moduleOffset;
+    record.frame = ip.frame;
+    record.inlinedOffset = inlinedFrames.size();
+    record.inlinedCount = ip.inlined.size();
+    record.isManaged = ip.isManaged;
+
+    // the frames may come from our own pool, so don't keep pointers into it while it grows
+    const auto first = ip.inlined.first;
+    const auto last = ip.inlined.last;
+    if (first >= inlinedFrames.data() && first < inlinedFrames.data() + inlinedFrames.size()) {
+        const size_t offset = first - inlinedFrames.data();
+        for (size_t i = 0; i < record.inlinedCount; ++i) {
+            inlinedFrames.push_back(inlinedFrames[offset + i]);
+        }
     } else {
-        return instructionPointers[ipIndex.index - 1];
+        inlinedFrames.insert(inlinedFrames.end(), first, last);
     }
+
+    instructionPointers.push_back(record);
+    IpIndex index;
+    index.index = instructionPointers.size();
+    return index;
 }
 
 TraceNode AccumulatedTraceData::findTrace(const TraceIndex traceIndex) const
@@ -1421,14 +2375,6 @@ TraceNode AccumulatedTraceData::findTrace(const TraceIndex traceIndex) const
     }
 }
 
-void AccumulatedTraceData::updateTraceNodeType(const TraceIndex traceIndex, AllocationData::CoreCLRType type)
-{
-    if (isValidTrace(traceIndex))
-    {
-        traces[traceIndex.index - 1].nodeType = type;
-    }
-}
-
 bool AccumulatedTraceData::isValidTrace(const TraceIndex traceIndex) const
 {
     return !(!traceIndex || traceIndex.index > traces.size());
@@ -1446,34 +2392,50 @@ bool AccumulatedTraceData::isStopIndex(const StringIndex index) const
     return find(stopIndices.begin(), stopIndices.end(), index) != stopIndices.end();
 }
 
+ThreadData& AccumulatedTraceData::findThread(uint32_t thread)
+{
+    if (thread >= threads.size()) {
+        threads.resize(thread + 1);
+    }
+    return threads[thread];
+}
+
+bool AccumulatedTraceData::isThreadAccounted(uint32_t thread)
+{
+    if (threadFilter.empty()) {
+        return true;
+    }
+    if (thread >= m_threadMatches.size()) {
+        m_threadMatches.resize(thread + 1, UnknownThreadMatch);
+    }
+    auto& match = m_threadMatches[thread];
+    if (match == UnknownThreadMatch) {
+        // the name of a thread is written before its first allocation
+        const auto& name = stringify(findThread(thread).name);
+        const auto id = std::to_string(thread);
+        const bool matches = std::any_of(threadFilter.begin(), threadFilter.end(), [&](const std::string& filter) {
+            return filter == id || (!name.empty() && filter == name);
+        });
+        match = matches ? ThreadMatched : ThreadNotMatched;
+    }
+    return match == ThreadMatched;
+}
+
 AddressRangesMapIteratorPair AccumulatedTraceData::mapUpdateRange(const uint64_t start,
                                                                   const uint64_t size)
 {
     uint64_t ptr = start;
     uint64_t endPtr = start + size;
 
-    auto rangesIter = addressRangeInfos.lower_bound(ptr);
-    auto rangesEnd = addressRangeInfos.lower_bound(endPtr);
-
-    if (rangesIter != addressRangeInfos.begin())
-    {
-        auto prev = std::prev(rangesIter);
-
-        if (prev->first + prev->second.size > start)
-        {
-            AddressRangeInfo newRange = prev->second.split(start - prev->first);
-
-            addressRangeInfos.insert(std::make_pair(start, newRange));
-
-            rangesIter = std::next(prev);
+    mapSplitRangeAt(start);
+    mapSplitRangeAt(endPtr);
 
-            assert (rangesIter->first == ptr);
-        }
-    }
+    // fill the gaps between the already known ranges
+    auto rangesIter = addressRangeInfos.lower_bound(ptr);
 
     while (ptr != endPtr)
     {
-        if (rangesIter == rangesEnd)
+        if (rangesIter == addressRangeInfos.end() || rangesIter->first >= endPtr)
         {
             addressRangeInfos.insert(std::make_pair(ptr,
                                                     AddressRangeInfo(ptr,
@@ -1481,42 +2443,21 @@ AddressRangesMapIteratorPair AccumulatedTraceData::mapUpdateRange(const uint64_t
 
             ptr = endPtr;
         }
-        else
+        else if (ptr != rangesIter->first)
         {
-            if (ptr != rangesIter->first)
-            {
-                assert(ptr < rangesIter->first);
-
-                uint64_t newSubrangeStart = ptr;
-                uint64_t newSubrangeEnd = std::min(endPtr, rangesIter->first);
-                uint64_t newSubrangeSize = newSubrangeEnd - newSubrangeStart;
+            assert(ptr < rangesIter->first);
 
-                addressRangeInfos.insert(std::make_pair(ptr,
-                                                        AddressRangeInfo(newSubrangeStart,
-                                                                         newSubrangeSize)));
-
-                ptr = newSubrangeEnd;
-            }
-            else
-            {
-                uint64_t subrangeStart = rangesIter->first;
-                uint64_t subrangeEnd = subrangeStart + rangesIter->second.size;
-
-                if (subrangeEnd <= endPtr)
-                {
-                    ptr = subrangeEnd;
-
-                    ++rangesIter;
-                }
-                else
-                {
-                    assert (std::next(rangesIter) == rangesEnd);
+            rangesIter = addressRangeInfos.insert(std::make_pair(ptr,
+                                                                 AddressRangeInfo(ptr,
+                                                                                  rangesIter->first - ptr))).first;
+        }
+        else
+        {
+            ptr += rangesIter->second.size;
 
-                    AddressRangeInfo newRange = rangesIter->second.split(endPtr - ptr);
+            assert(ptr <= endPtr);
 
-                    addressRangeInfos.insert(std::make_pair(endPtr, newRange));
-                }
-            }
+            ++rangesIter;
         }
     }
 
@@ -1524,52 +2465,53 @@ AddressRangesMapIteratorPair AccumulatedTraceData::mapUpdateRange(const uint64_t
                           addressRangeInfos.lower_bound(endPtr));
 }
 
-void AccumulatedTraceData::mapRemoveRanges(const uint64_t start,
-                                           const uint64_t size)
+void AccumulatedTraceData::mapSplitRangeAt(const uint64_t address)
 {
-    auto i = addressRangeInfos.lower_bound(start);
-    auto e = addressRangeInfos.lower_bound(start + size);
+    auto next = addressRangeInfos.lower_bound(address);
 
-    if (i != addressRangeInfos.begin())
+    if (next == addressRangeInfos.begin())
     {
-        auto prev = std::prev(i);
-
-        if (prev->first + prev->second.size > start)
-        {
-            AddressRangeInfo newRange = prev->second.split(start - prev->first);
+        return;
+    }
 
-            addressRangeInfos.insert(std::make_pair(start, newRange));
+    auto prev = std::prev(next);
 
-            i = std::next(prev);
+    if (prev->first + prev->second.size > address)
+    {
+        AddressRangeInfo newRange = prev->second.split(address - prev->first);
 
-            assert(i->first == start);
-        }
+        addressRangeInfos.insert(std::make_pair(address, newRange));
     }
+}
 
-    if (i != e)
-    {
-        auto last = std::prev(e);
-
-        assert (last->first < start + size);
+void AccumulatedTraceData::mapRemoveRanges(const uint64_t start,
+                                           const uint64_t size)
+{
+    mapSplitRangeAt(start);
+    mapSplitRangeAt(start + size);
 
-        if (last->first + last->second.size > start + size)
-        {
-            AddressRangeInfo newRange = last->second.split(start + size - last->first);
+    addressRangeInfos.erase(addressRangeInfos.lower_bound(start),
+                            addressRangeInfos.lower_bound(start + size));
+}
 
-            addressRangeInfos.insert(std::make_pair(start + size, newRange));
+void AccumulatedTraceData::combineContiguousSimilarRanges(const uint64_t start,
+                                                          const uint64_t end)
+{
+    auto i = addressRangeInfos.lower_bound(start);
 
-            e = std::next(last);
+    if (i != addressRangeInfos.begin())
+    {
+        auto prev = std::prev(i);
 
-            assert(last->first + last->second.size == start + size);
+        if (prev->first + prev->second.size == start)
+        {
+            i = prev;
         }
     }
 
-    addressRangeInfos.erase(i, e);
-}
-
-void AccumulatedTraceData::combineContiguousSimilarRanges()
-{
-    for (auto i = addressRangeInfos.begin (); i != addressRangeInfos.end(); ++i)
+    // outside of the window the ranges are already combined, so only the ranges
+    // of the window and its contiguous neighbours need to be checked
+    while (i != addressRangeInfos.end() && i->first < end)
     {
         assert(i->first == i->second.start);
 
@@ -1579,18 +2521,13 @@ void AccumulatedTraceData::combineContiguousSimilarRanges()
                 || i->second.start + i->second.size <= j->first);
 
         while (j != addressRangeInfos.end()
-               && i->first + i->second.size == j->first)
+               && i->first + i->second.size == j->first
+               && i->second.combineIfSimilar(j->second))
         {
-            if (i->second.combineIfSimilar(j->second))
-            {
-                addressRangeInfos.erase(j);
-
-                j = std::next (i);
-            }
-            else
-            {
-                break;
-            }
+            // erasing keeps the iterators before the erased range valid
+            j = addressRangeInfos.erase(j);
         }
+
+        i = j;
     }
 }
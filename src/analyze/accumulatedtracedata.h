@@ -19,11 +19,14 @@
 #ifndef ACCUMULATEDTRACEDATA_H
 #define ACCUMULATEDTRACEDATA_H
 
+#include <atomic>
 #include <iosfwd>
+#include <memory>
 #include <tuple>
 #include <vector>
 
 #include <fstream>
+#include <limits>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
@@ -31,7 +34,10 @@
 #include <boost/functional/hash.hpp>
 
 #include "allocationdata.h"
+#include "allocationtable.h"
+#include "util/blockmap.h"
 #include "util/indices.h"
+#include "util/lifetimehistogram.h"
 
 struct Frame
 {
@@ -52,14 +58,49 @@ struct Frame
     }
 };
 
+/**
+ * View of the inlined frames of an instruction pointer. The frames of all
+ * instruction pointers are stored in one pool, see AccumulatedTraceData::inlinedFrames.
+ */
+struct InlinedFrames
+{
+    const Frame* first = nullptr;
+    const Frame* last = nullptr;
+
+    const Frame* begin() const
+    {
+        return first;
+    }
+
+    const Frame* end() const
+    {
+        return last;
+    }
+
+    std::size_t size() const
+    {
+        return last - first;
+    }
+
+    bool empty() const
+    {
+        return first == last;
+    }
+};
+
+/**
+ * Lightweight view of an instruction pointer as returned by AccumulatedTraceData::findIp.
+ *
+ * NOTE: the inlined frames are invalidated when new instruction pointers are added
+ */
 struct InstructionPointer
 {
     uint64_t instructionPointer = 0;
     ModuleIndex moduleIndex;
     uint64_t moduleOffset = 0;
     Frame frame;
-    std::vector<Frame> inlined;
-    int isManaged;
+    InlinedFrames inlined;
+    int isManaged = 0;
 
     bool compareWithoutAddress(const InstructionPointer& other) const
     {
@@ -74,17 +115,35 @@ struct InstructionPointer
     }
 };
 
+/**
+ * Storage of an instruction pointer, the inlined frames are referenced by
+ * their offset and count in AccumulatedTraceData::inlinedFrames.
+ */
+struct InstructionPointerRecord
+{
+    uint64_t instructionPointer = 0;
+    ModuleIndex moduleIndex;
+    uint64_t moduleOffset = 0;
+    Frame frame;
+    uint32_t inlinedOffset = 0;
+    uint32_t inlinedCount = 0;
+    int isManaged = 0;
+};
+
 struct TraceNode
 {
     IpIndex ipIndex;
     TraceIndex parentIndex;
+    // CoreCLR classification of the node for the malloc and managed allocations
     AllocationData::CoreCLRType nodeType;
-};
+    // CoreCLR classification of the node for the mmapped ranges
+    AllocationData::CoreCLRType mmapNodeType;
 
-struct Allocation : public AllocationData
-{
-    // backtrace entry point
-    TraceIndex traceIndex;
+    AllocationData::CoreCLRType getNodeType(AllocationData::DisplayId display) const
+    {
+        return (display == AllocationData::DisplayId::malloc
+                || display == AllocationData::DisplayId::managed) ? nodeType : mmapNodeType;
+    }
 };
 
 struct ObjectTreeNode
@@ -96,6 +155,44 @@ struct ObjectTreeNode
     AllocationIndex allocIndex;
 };
 
+/**
+ * Lifetimes of the freed allocations of one allocation index, computed by heaptrack_interpret.
+ */
+struct AllocationLifetimes
+{
+    AllocationIndex allocationIndex;
+    LifetimeHistogram histogram;
+};
+
+/**
+ * A thread of the debuggee, with the malloc cost of the allocations it made. The cost of
+ * an allocation stays with the thread that made it, regardless of the thread that frees it.
+ */
+struct ThreadData
+{
+    // empty for threads whose name is not known
+    StringIndex name;
+    AllocationData::Stats cost;
+};
+
+/**
+ * Occupancy of the pages of the malloc'd address space, as tracked by heaptrack_interpret.
+ */
+struct Fragmentation
+{
+    // bytes of the live malloc allocations
+    int64_t live = 0;
+    // bytes of the pages that hold at least one byte of a live allocation
+    int64_t spanned = 0;
+    // bytes of the spanned pages that are less than a quarter used
+    int64_t sparse = 0;
+
+    int64_t gap() const
+    {
+        return spanned - live;
+    }
+};
+
 /**
  * Information for a single call to an allocation function.
  */
@@ -104,9 +201,14 @@ struct AllocationInfo
     uint64_t size = 0;
     TraceIndex traceIndex;
     int isManaged;
+    // the compact id of the thread that made the allocation, 0 when unknown
+    uint32_t thread = 0;
+    // the bytes that the allocator reserved beyond the requested size
+    uint64_t slack = 0;
     bool operator==(const AllocationInfo& rhs) const
     {
-        return rhs.traceIndex == traceIndex && rhs.size == size && rhs.isManaged == isManaged;
+        return rhs.traceIndex == traceIndex && rhs.size == size && rhs.isManaged == isManaged
+            && rhs.thread == thread && rhs.slack == slack;
     }
 };
 
@@ -116,7 +218,9 @@ struct AllocationInfo
 struct AddressRangeInfo
 {
     AddressRangeInfo(uint64_t vStart, uint64_t vSize)
-        : start(vStart), size(vSize), isProtSet(false), isPhysicalMemoryConsumptionSet(false), isFdSet(false), isCoreCLRSet (false)
+        : start(vStart), size(vSize), privateDirty(0), privateClean(0), sharedDirty(0), sharedClean(0),
+          prot(0), fd(0), isCoreCLR(0),
+          isProtSet(false), isPhysicalMemoryConsumptionSet(false), isFdSet(false), isCoreCLRSet (false)
     {
         assert(!traceIndex);
     }
@@ -263,7 +367,7 @@ struct AddressRangeInfo
     }
 };
 
-typedef std::map<uint64_t, AddressRangeInfo> AddressRangesMap;
+typedef BlockMap<uint64_t, AddressRangeInfo> AddressRangesMap;
 typedef std::pair<AddressRangesMap::iterator, AddressRangesMap::iterator> AddressRangesMapIteratorPair;
 
 struct AccumulatedTraceData
@@ -275,6 +379,14 @@ struct AccumulatedTraceData
     virtual void handleTotalCostUpdate() = 0;
     virtual void handleAllocation(const AllocationInfo& info, const AllocationIndex index) = 0;
     virtual void handleDebuggee(const char* command) = 0;
+    // called like handleAllocation when a malloc or managed allocation is freed
+    virtual void handleDeallocation(const AllocationInfo& /*info*/, const AllocationIndex /*index*/)
+    {
+    }
+    // called when a smaps chunk updated the costs of the address ranges
+    virtual void handleAddressRangesUpdate()
+    {
+    }
 
     const std::string& stringify(const StringIndex stringId) const;
 
@@ -284,17 +396,55 @@ struct AccumulatedTraceData
     enum ParsePass {
         FirstPass,
         SecondPass,
-        ThirdPass
+        ThirdPass,
+        // definitions and allocations in one go, for data that can only be read once
+        LivePass
     };
     bool read(const std::string& inputFile, const ParsePass pass);
     bool read(std::istream& in, const ParsePass pass);
 
+    /**
+     * Read the data file like read() and write a sidecar index for it at the same time.
+     *
+     * The index holds the definitions of the trace, i.e. the strings, backtraces and
+     * so on, as well as checkpoints of the accumulated state that are taken every
+     * @p checkpointInterval ms. It allows readWindow() to start reading the data
+     * file at the last checkpoint before the time window.
+     */
+    bool readAndIndex(const std::string& inputFile, const std::string& indexFile, int64_t checkpointInterval);
+
+    /**
+     * Read the data of the time window [@p begin, @p end] of the data file, in ms.
+     *
+     * Everything that happened up to the end of the window is accounted for, but
+     * the peaks only cover the window and the handle* callbacks are only invoked
+     * for the events in the window. When an @p indexFile is given, the definitions
+     * are taken from it and reading starts at the last checkpoint before the window.
+     */
+    bool readWindow(const std::string& inputFile, const std::string& indexFile, int64_t begin, int64_t end);
+
+    /**
+     * Read a data file while it is still being written, e.g. by following a growing
+     * file or reading from a FIFO that heaptrack_interpret writes to.
+     *
+     * The data is read in a single pass, the handle* callbacks are invoked as usual
+     * and handleTimeStamp() sees the accumulated state of everything read so far,
+     * so it can be used to publish intermediate results. The per-allocation peaks
+     * are those of the latest time stamp that raised the total peak. Reading ends
+     * when a FIFO is closed by the writer, or once @p stop is set and the data that
+     * is available at that point was read.
+     */
+    bool readLive(const std::string& inputFile, const std::atomic<bool>& stop);
+
     void diff(const AccumulatedTraceData& base);
 
     bool shortenTemplates = false;
     bool fromAttached = false;
+    // when not empty, only the malloc allocations of the threads with these names or decimal ids are accounted for
+    std::vector<std::string> threadFilter;
 
-    std::vector<Allocation> allocations;
+    // while parsing, new allocations are appended. after read() and diff() they are sorted by trace index
+    AllocationTable allocations;
     AllocationData totalCost;
     int64_t totalTime = 0;
     int64_t managedPeakTime = 0;
@@ -303,6 +453,11 @@ struct AccumulatedTraceData
     int64_t privateDirtyPeakTime = 0;
     int64_t sharedPeakTime = 0;
     int64_t peakRSS = 0;
+    // only known for traces that were interpreted with DUMP_HEAPTRACK_FRAGMENTATION
+    Fragmentation fragmentation;
+    // the fragmentation at the largest gap between the spanned and the live bytes
+    Fragmentation peakFragmentation;
+    int64_t peakFragmentationTime = 0;
 
     struct SystemInfo
     {
@@ -311,14 +466,9 @@ struct AccumulatedTraceData
     };
     SystemInfo systemInfo;
 
-    // our indices are sequentially increasing thus a new allocation can only ever
-    // occur with an index larger than any other we encountered so far
-    // this can be used to our advantage in speeding up the findAllocation calls.
-    TraceIndex m_maxAllocationTraceIndex;
-
-    int64_t getPeakTime()
+    int64_t getPeakTime(AllocationData::DisplayId display) const
     {
-        switch (AllocationData::display)
+        switch (display)
         {
             case AllocationData::DisplayId::malloc:
                 return mallocPeakTime;
@@ -329,57 +479,158 @@ struct AccumulatedTraceData
             case AllocationData::DisplayId::privateDirty:
                 return privateDirtyPeakTime;
             default:
-                assert(AllocationData::display == AllocationData::DisplayId::shared);
+                assert(display == AllocationData::DisplayId::shared);
                 return sharedPeakTime;
         }
     }
 
-    Allocation& findAllocation(const TraceIndex traceIndex);
+    // returns the slot of the allocation for the trace in the allocations table,
+    // a new empty allocation is appended when there is none yet
+    std::size_t findAllocationSlot(const TraceIndex traceIndex);
 
+    // returns a view of the instruction pointer without copying its inlined frames
     InstructionPointer findIp(const IpIndex ipIndex) const;
+    // appends a copy of the instruction pointer and its inlined frames
+    IpIndex addIp(const InstructionPointer& ip);
 
     TraceNode findTrace(const TraceIndex traceIndex) const;
     TraceNode findPrevTrace(const TraceIndex traceIndex) const;
-    void updateTraceNodeType(const TraceIndex traceIndex, AllocationData::CoreCLRType type);
 
     bool isStopIndex(const StringIndex index) const;
 
     AddressRangesMapIteratorPair mapUpdateRange(const uint64_t start, const uint64_t size);
 
+    void mapSplitRangeAt(const uint64_t address);
     void mapRemoveRanges(const uint64_t start, const uint64_t size);
-    void combineContiguousSimilarRanges();
 
-    bool checkCallStackIsCoreCLR(TraceIndex traceIndex);
-    bool checkCallStackIsUntracked(TraceIndex traceIndex);
+    // combines similar ranges that lie inside of [start, end) or are contiguous to it
+    void combineContiguousSimilarRanges(const uint64_t start = 0,
+                                        const uint64_t end = std::numeric_limits<uint64_t>::max());
+
     bool isValidTrace(const TraceIndex traceIndex) const;
     AllocationData::CoreCLRType checkIsNodeCoreCLR(IpIndex ipindex);
+    AllocationData::CoreCLRType checkCallStackType(TraceIndex traceIndex);
+    AllocationData::CoreCLRType checkAddressRangeType(const AddressRangeInfo& range);
+    void updateCallStackNodeTypes(TraceIndex traceIndex, bool isUntracked, bool isMMAP);
     void calculatePeak(AllocationData::DisplayId type);
 
     // indices of functions that should stop the backtrace, e.g. main or static
     // initialization
     std::vector<StringIndex> stopIndices;
-    std::vector<InstructionPointer> instructionPointers;
+    std::vector<InstructionPointerRecord> instructionPointers;
+    // the inlined frames of all instruction pointers
+    std::vector<Frame> inlinedFrames;
     std::vector<TraceNode> traces;
     std::vector<std::string> strings;
     std::vector<IpIndex> opNewIpIndices;
     std::vector<AllocationInfo> allocationInfos;
     std::vector<ClassIndex> classIndices;
     std::vector<ObjectTreeNode> objectTreeNodes;
+    // only for the whole trace, the time window is not taken into account, and only known for traces that
+    // were interpreted with DUMP_HEAPTRACK_LIFETIMES
+    std::vector<AllocationLifetimes> lifetimes;
+    // the threads by their compact id, the first one holds the allocations of unknown threads
+    std::vector<ThreadData> threads;
 
     AddressRangesMap addressRangeInfos;
 
     static bool isHideUnmanagedStackParts;
     static bool isShowCoreCLRPartOption;
 
-    AllocationData::Stats partCoreclr;
-    AllocationData::Stats partNonCoreclr;
-    AllocationData::Stats partUnknown;
-    AllocationData::Stats partUntracked;
+    // the malloc parts are calculated from the allocations, the private and shared
+    // parts from the mmapped ranges. the managed parts are not calculated
+    AllocationData partCoreclr;
+    AllocationData partNonCoreclr;
+    AllocationData partUnknown;
+    AllocationData partUntracked;
+
+private:
+    // The accumulated state of the parser before a line of the data file, as
+    // written to the index by readAndIndex. The peaks are not part of it.
+    struct Checkpoint
+    {
+        int64_t timeStamp = 0;
+        // offset of the line in the uncompressed data file
+        uint64_t offset = 0;
+        uint64_t lastAllocationPtr = 0;
+        uint32_t fileVersion = 0;
+        bool fromAttached = false;
+        SystemInfo systemInfo;
+        std::string debuggee;
+        AllocationData totalCost;
+        std::vector<AllocationData::Stats> threadCosts;
+        Fragmentation fragmentation;
+        std::vector<Allocation> allocations;
+        std::vector<AddressRangeInfo> addressRanges;
+    };
+
+    // the implementation of read(std::istream&, ParsePass), specialized for each pass
+    template <ParsePass pass>
+    bool readPass(std::istream& in);
+
+    void writeIndexDefinitions(std::ostream& out) const;
+    // writes the header of the checkpoint, followed by the current allocations and address ranges
+    void writeCheckpoint(std::ostream& out, const Checkpoint& checkpoint) const;
+    bool readIndex(std::istream& in, int64_t begin);
+
+    ThreadData& findThread(uint32_t thread);
+    // whether the malloc allocations of @p thread pass the thread filter
+    bool isThreadAccounted(uint32_t thread);
+
+    // the time window that is read, see readWindow
+    int64_t m_windowBegin = 0;
+    int64_t m_windowEnd = std::numeric_limits<int64_t>::max();
+    // where reading starts, when set
+    std::unique_ptr<Checkpoint> m_resume;
+    // the definitions were loaded from an index, so they are skipped in the data file
+    bool m_hasIndexedDefinitions = false;
+    // checkpoints are written to this index while reading, see readAndIndex
+    std::ostream* m_indexOut = nullptr;
+    int64_t m_checkpointInterval = 0;
+    // whether the threads pass the thread filter, by thread id, evaluated on their first allocation in a pass
+    enum ThreadMatch : char
+    {
+        UnknownThreadMatch,
+        ThreadMatched,
+        ThreadNotMatched
+    };
+    std::vector<ThreadMatch> m_threadMatches;
+
+    // The CoreCLR classification depends on the current address ranges, so it is
+    // memoized only for a single pass over the allocations or ranges, see
+    // resetCoreCLRClassification.
+    struct IpCoreCLRState
+    {
+        AllocationData::CoreCLRType type = AllocationData::CoreCLRType::unknown;
+        bool isClassified = false;
+    };
+
+    struct TraceCoreCLRState
+    {
+        // some frame of the call stack up to this node lies in CoreCLR
+        bool hasCoreCLRFrame = false;
+        // all frames of the call stack up to this node lie in untracked ranges
+        bool isUntracked = false;
+        bool isClassified = false;
+        bool isNodeTypeUpdated = false;
+        bool isMMAPNodeTypeUpdated = false;
+    };
+
+    void resetCoreCLRClassification();
+    AllocationData::CoreCLRType findAddressCoreCLRType(uint64_t address) const;
+    TraceCoreCLRState& classifyTrace(TraceIndex traceIndex);
+
+    std::vector<IpCoreCLRState> m_ipCoreCLRTypes;
+    std::vector<TraceCoreCLRState> m_traceCoreCLRStates;
+
+    // sorts the allocations by their trace index, which is the order they are
+    // exposed in after reading or diffing the data, and updates m_allocationSlots
+    void sortAllocations();
 
-    AllocationData::Stats partCoreclrMMAP;
-    AllocationData::Stats partNonCoreclrMMAP;
-    AllocationData::Stats partUnknownMMAP;
-    AllocationData::Stats partUntrackedMMAP;
+    // our trace indices are small sequential integers, so we can map them to the
+    // allocations directly. the table holds the allocation index + 1, or 0 when
+    // there is no allocation for the trace index yet
+    std::vector<uint32_t> m_allocationSlots;
 };
 
 #endif // ACCUMULATEDTRACEDATA_H
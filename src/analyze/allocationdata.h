@@ -60,29 +60,41 @@ struct AllocationData
         int64_t peak_instances = 0;
         // number of temporary allocations
         int64_t temporary = 0;
+        // number of allocations that were freed before 100 other allocation events happened,
+        // see LifetimeHistogram
+        int64_t shortLived = 0;
         // bytes allocated in total
         int64_t allocated = 0;
         // amount of bytes leaked
         int64_t leaked = 0;
         // largest amount of bytes allocated
         int64_t peak = 0;
+        // bytes that the allocator reserved beyond the requested sizes of the live allocations
+        int64_t slack = 0;
+        // slack of the allocations that were alive at the peak
+        int64_t peakSlack = 0;
+        // free bytes of the sparse pages that the allocations kept resident at the largest
+        // heap fragmentation, see Fragmentation
+        int64_t pinned = 0;
 
         bool isEmpty() const
         {
             return (allocations == 0
                     && deallocations == 0
                     && temporary == 0
+                    && shortLived == 0
                     && allocated == 0
                     && leaked == 0
-                    && peak == 0);
+                    && peak == 0
+                    && slack == 0
+                    && peakSlack == 0
+                    && pinned == 0);
         }
     };
 
     Stats malloc, managed, privateClean, privateDirty, shared;
 
-    static DisplayId display;
-
-    const Stats *getDisplay() const
+    const Stats *getDisplay(DisplayId display) const
     {
         switch (display)
         {
@@ -106,9 +118,13 @@ inline bool operator==(const AllocationData::Stats &lhs, const AllocationData::S
     return (lhs.allocations == rhs.allocations
             && lhs.deallocations == rhs.deallocations
             && lhs.temporary == rhs.temporary
+            && lhs.shortLived == rhs.shortLived
             && lhs.allocated == rhs.allocated
             && lhs.leaked == rhs.leaked
-            && lhs.peak == rhs.peak);
+            && lhs.peak == rhs.peak
+            && lhs.slack == rhs.slack
+            && lhs.peakSlack == rhs.peakSlack
+            && lhs.pinned == rhs.pinned);
 }
 
 inline bool operator!=(const AllocationData::Stats &lhs, const AllocationData::Stats &rhs)
@@ -122,9 +138,13 @@ inline AllocationData::Stats& operator+=(AllocationData::Stats& lhs, const Alloc
     lhs.deallocations += rhs.deallocations;
     lhs.peak_instances += rhs.peak_instances;
     lhs.temporary += rhs.temporary;
+    lhs.shortLived += rhs.shortLived;
     lhs.allocated += rhs.allocated;
     lhs.leaked += rhs.leaked;
     lhs.peak += rhs.peak;
+    lhs.slack += rhs.slack;
+    lhs.peakSlack += rhs.peakSlack;
+    lhs.pinned += rhs.pinned;
 
     return lhs;
 }
@@ -135,9 +155,13 @@ inline AllocationData::Stats& operator-=(AllocationData::Stats& lhs, const Alloc
     lhs.deallocations -= rhs.deallocations;
     lhs.peak_instances -= rhs.peak_instances;
     lhs.temporary -= rhs.temporary;
+    lhs.shortLived -= rhs.shortLived;
     lhs.allocated -= rhs.allocated;
     lhs.leaked -= rhs.leaked;
     lhs.peak -= rhs.peak;
+    lhs.slack -= rhs.slack;
+    lhs.peakSlack -= rhs.peakSlack;
+    lhs.pinned -= rhs.pinned;
 
     return lhs;
 }
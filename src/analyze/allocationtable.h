@@ -0,0 +1,311 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ALLOCATIONTABLE_H
+#define ALLOCATIONTABLE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "allocationdata.h"
+#include "util/indices.h"
+
+struct Allocation : public AllocationData
+{
+    // backtrace entry point
+    TraceIndex traceIndex;
+};
+
+/**
+ * Column-oriented storage of the allocation statistics of all backtraces.
+ *
+ * Each field of each metric is stored in a separate contiguous array that is
+ * indexed by the allocation slot. Loops which only need a few fields of one
+ * metric, like the peak snapshots while parsing or the chart updates, thus
+ * only touch the memory they actually use.
+ *
+ * The columns of a metric are allocated when it is written to for the first
+ * time, i.e. metrics that are not present in a trace do not take any memory.
+ */
+class AllocationTable
+{
+public:
+    // the order matches the members of AllocationData::Stats
+    enum Field
+    {
+        Allocations,
+        Deallocations,
+        PeakInstances,
+        Temporary,
+        ShortLived,
+        Allocated,
+        Leaked,
+        Peak,
+        Slack,
+        PeakSlack,
+        Pinned,
+        NumFields
+    };
+
+    static const int NumDisplays = static_cast<int>(AllocationData::DisplayId::shared) + 1;
+
+    std::size_t size() const
+    {
+        return m_traceIndices.size();
+    }
+
+    bool empty() const
+    {
+        return m_traceIndices.empty();
+    }
+
+    void clear()
+    {
+        m_traceIndices.clear();
+        for (int display = 0; display < NumDisplays; ++display) {
+            for (auto& column : m_columns[display]) {
+                column.clear();
+            }
+            m_hasData[display] = false;
+        }
+    }
+
+    void reserve(std::size_t size)
+    {
+        m_traceIndices.reserve(size);
+    }
+
+    /**
+     * Append an empty allocation for the given trace and return its slot.
+     */
+    std::size_t add(TraceIndex traceIndex)
+    {
+        m_traceIndices.push_back(traceIndex);
+        for (int display = 0; display < NumDisplays; ++display) {
+            if (m_hasData[display]) {
+                for (auto& column : m_columns[display]) {
+                    column.push_back(0);
+                }
+            }
+        }
+        return m_traceIndices.size() - 1;
+    }
+
+    TraceIndex traceIndex(std::size_t slot) const
+    {
+        return m_traceIndices[slot];
+    }
+
+    const std::vector<TraceIndex>& traceIndices() const
+    {
+        return m_traceIndices;
+    }
+
+    bool hasData(AllocationData::DisplayId display) const
+    {
+        return m_hasData[static_cast<int>(display)];
+    }
+
+    /**
+     * @return the column of the given field, allocating the columns of the metric if needed
+     */
+    int64_t* column(AllocationData::DisplayId display, Field field)
+    {
+        allocate(display);
+        return m_columns[static_cast<int>(display)][field].data();
+    }
+
+    /**
+     * @return the column of the given field, or nullptr when the metric has no data
+     */
+    const int64_t* column(AllocationData::DisplayId display, Field field) const
+    {
+        return hasData(display) ? m_columns[static_cast<int>(display)][field].data() : nullptr;
+    }
+
+    int64_t& at(std::size_t slot, AllocationData::DisplayId display, Field field)
+    {
+        assert(slot < size());
+        return column(display, field)[slot];
+    }
+
+    int64_t value(std::size_t slot, AllocationData::DisplayId display, Field field) const
+    {
+        assert(slot < size());
+        return hasData(display) ? m_columns[static_cast<int>(display)][field][slot] : 0;
+    }
+
+    AllocationData::Stats stats(std::size_t slot, AllocationData::DisplayId display) const
+    {
+        AllocationData::Stats stats;
+        if (hasData(display)) {
+            const auto& columns = m_columns[static_cast<int>(display)];
+            stats.allocations = columns[Allocations][slot];
+            stats.deallocations = columns[Deallocations][slot];
+            stats.peak_instances = columns[PeakInstances][slot];
+            stats.temporary = columns[Temporary][slot];
+            stats.shortLived = columns[ShortLived][slot];
+            stats.allocated = columns[Allocated][slot];
+            stats.leaked = columns[Leaked][slot];
+            stats.peak = columns[Peak][slot];
+            stats.slack = columns[Slack][slot];
+            stats.peakSlack = columns[PeakSlack][slot];
+            stats.pinned = columns[Pinned][slot];
+        }
+        return stats;
+    }
+
+    void setStats(std::size_t slot, AllocationData::DisplayId display, const AllocationData::Stats& stats)
+    {
+        if (!hasData(display) && stats == AllocationData::Stats() && stats.peak_instances == 0) {
+            // don't allocate the columns just to store zeros
+            return;
+        }
+        allocate(display);
+        auto& columns = m_columns[static_cast<int>(display)];
+        columns[Allocations][slot] = stats.allocations;
+        columns[Deallocations][slot] = stats.deallocations;
+        columns[PeakInstances][slot] = stats.peak_instances;
+        columns[Temporary][slot] = stats.temporary;
+        columns[ShortLived][slot] = stats.shortLived;
+        columns[Allocated][slot] = stats.allocated;
+        columns[Leaked][slot] = stats.leaked;
+        columns[Peak][slot] = stats.peak;
+        columns[Slack][slot] = stats.slack;
+        columns[PeakSlack][slot] = stats.peakSlack;
+        columns[Pinned][slot] = stats.pinned;
+    }
+
+    /**
+     * @return a copy of all statistics of the allocation in the given slot
+     */
+    Allocation operator[](std::size_t slot) const
+    {
+        Allocation allocation;
+        allocation.traceIndex = m_traceIndices[slot];
+        allocation.malloc = stats(slot, AllocationData::DisplayId::malloc);
+        allocation.managed = stats(slot, AllocationData::DisplayId::managed);
+        allocation.privateClean = stats(slot, AllocationData::DisplayId::privateClean);
+        allocation.privateDirty = stats(slot, AllocationData::DisplayId::privateDirty);
+        allocation.shared = stats(slot, AllocationData::DisplayId::shared);
+        return allocation;
+    }
+
+    void set(std::size_t slot, const AllocationData& data)
+    {
+        setStats(slot, AllocationData::DisplayId::malloc, data.malloc);
+        setStats(slot, AllocationData::DisplayId::managed, data.managed);
+        setStats(slot, AllocationData::DisplayId::privateClean, data.privateClean);
+        setStats(slot, AllocationData::DisplayId::privateDirty, data.privateDirty);
+        setStats(slot, AllocationData::DisplayId::shared, data.shared);
+    }
+
+    /**
+     * @return copies of all allocations, for code that wants to sort or filter complete rows
+     */
+    std::vector<Allocation> rows() const
+    {
+        std::vector<Allocation> ret;
+        ret.reserve(size());
+        for (std::size_t slot = 0; slot < size(); ++slot) {
+            ret.push_back((*this)[slot]);
+        }
+        return ret;
+    }
+
+    void fill(AllocationData::DisplayId display, Field field, int64_t value)
+    {
+        if (hasData(display)) {
+            auto& column = m_columns[static_cast<int>(display)][field];
+            std::fill(column.begin(), column.end(), value);
+        }
+    }
+
+    /**
+     * Remember the current memory consumption of all allocations as their peak.
+     */
+    void takePeakSnapshot(AllocationData::DisplayId display, bool withInstances)
+    {
+        if (!hasData(display)) {
+            return;
+        }
+        auto& columns = m_columns[static_cast<int>(display)];
+        std::copy(columns[Leaked].begin(), columns[Leaked].end(), columns[Peak].begin());
+        std::copy(columns[Slack].begin(), columns[Slack].end(), columns[PeakSlack].begin());
+        if (withInstances) {
+            const int64_t* allocations = columns[Allocations].data();
+            const int64_t* deallocations = columns[Deallocations].data();
+            int64_t* peakInstances = columns[PeakInstances].data();
+            const std::size_t count = size();
+            for (std::size_t i = 0; i < count; ++i) {
+                peakInstances[i] = allocations[i] - deallocations[i];
+            }
+        }
+    }
+
+    /**
+     * Rearrange the allocations, slot i afterwards holds the allocation
+     * that was stored in slot order[i] before. Allocations whose slots are
+     * not part of the order are removed.
+     */
+    void reorder(const std::vector<std::size_t>& order)
+    {
+        std::vector<TraceIndex> traceIndices;
+        traceIndices.reserve(order.size());
+        for (auto slot : order) {
+            traceIndices.push_back(m_traceIndices[slot]);
+        }
+        m_traceIndices.swap(traceIndices);
+
+        std::vector<int64_t> values;
+        for (int display = 0; display < NumDisplays; ++display) {
+            if (!m_hasData[display]) {
+                continue;
+            }
+            for (auto& column : m_columns[display]) {
+                values.clear();
+                values.reserve(order.size());
+                for (auto slot : order) {
+                    values.push_back(column[slot]);
+                }
+                column.swap(values);
+            }
+        }
+    }
+
+private:
+    void allocate(AllocationData::DisplayId display)
+    {
+        const auto index = static_cast<int>(display);
+        if (!m_hasData[index]) {
+            for (auto& column : m_columns[index]) {
+                column.assign(size(), 0);
+            }
+            m_hasData[index] = true;
+        }
+    }
+
+    std::vector<TraceIndex> m_traceIndices;
+    std::vector<int64_t> m_columns[NumDisplays][NumFields];
+    bool m_hasData[NumDisplays] = {};
+};
+
+#endif // ALLOCATIONTABLE_H
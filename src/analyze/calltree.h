@@ -0,0 +1,554 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef CALLTREE_H
+#define CALLTREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "accumulatedtracedata.h"
+
+/**
+ * Building of bottom-up and top-down call trees from the backtraces of the allocations,
+ * shared by heaptrack_print and the GUI.
+ *
+ * The trees are containers of rows that can be aggregate initialized from
+ * {cost, location, parent, children, stackType}, where the children are a container of
+ * the same type. The rows of the bottom-up tree are sorted by location, so rows must be
+ * comparable with a location through operator< and locations through operator==.
+ */
+namespace CallTree {
+
+/**
+ * Add @p cost to the row for @p location in @p rows, creating it if needed.
+ *
+ * @return the children of that row
+ */
+template <typename Rows, typename Location>
+Rows* addRow(Rows* rows, const Location& location, const AllocationData::Stats& cost,
+             AllocationData::CoreCLRType stackType)
+{
+    auto it = std::lower_bound(rows->begin(), rows->end(), location);
+    for (; it != rows->end() && it->location == location; ++it) {
+        if (it->stackType == stackType) {
+            it->cost += cost;
+            return &it->children;
+        }
+    }
+    it = rows->insert(it, {cost, location, nullptr, {}, stackType});
+    return &it->children;
+}
+
+/**
+ * Call @p visitor for the trace nodes of the backtrace of @p traceIndex whose frames are part of the
+ * call trees, from the allocation site up to the first stop frame. The visitor gets the TraceIndex,
+ * the TraceNode and its InstructionPointer. It returns false to stop the walk.
+ */
+template <typename Visitor>
+void forEachNode(const AccumulatedTraceData& data, TraceIndex traceIndex, Visitor visitor)
+{
+    do {
+        const auto trace = data.findTrace(traceIndex);
+        const auto ip = data.findIp(trace.ipIndex);
+        if (!(AccumulatedTraceData::isHideUnmanagedStackParts && !ip.isManaged)) {
+            if (!visitor(traceIndex, trace, ip)) {
+                return;
+            }
+        }
+        if (data.isStopIndex(ip.frame.functionIndex)) {
+            break;
+        }
+        traceIndex = trace.parentIndex;
+    } while (traceIndex);
+}
+
+/**
+ * Call @p visitor for the frames of the backtrace of @p traceIndex that are part of the call trees,
+ * from the allocation site up to the first stop frame. The visitor gets the TraceNode, its
+ * InstructionPointer, the inlined Frame or nullptr for the frame of the instruction pointer itself
+ * and whether the location is untracked. It returns false to stop the walk.
+ */
+template <typename Visitor>
+void forEachFrame(const AccumulatedTraceData& data, TraceIndex traceIndex, Visitor visitor)
+{
+    forEachNode(data, traceIndex, [&visitor](TraceIndex index, const TraceNode& trace, const InstructionPointer& ip) {
+        const bool isUntrackedLocation = !index;
+        if (!visitor(trace, ip, nullptr, isUntrackedLocation)) {
+            return false;
+        }
+        for (const auto& inlined : ip.inlined) {
+            if (!visitor(trace, ip, &inlined, isUntrackedLocation)) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+/**
+ * Add the backtrace of an allocation to the bottom-up tree @p topRows, i.e. the top rows
+ * are the allocation sites and the children of each row are its callers.
+ *
+ * @p ipLocation maps an IpIndex, its InstructionPointer and whether the location is untracked
+ * to a location, @p frameLocation does the same for an inlined Frame of an InstructionPointer.
+ *
+ * NOTE: the parent pointers are invalid until setParents is called
+ */
+template <typename Rows, typename IpLocation, typename FrameLocation>
+void addBacktrace(Rows* topRows, const AccumulatedTraceData& data, TraceIndex traceIndex,
+                  const AllocationData::Stats& cost, AllocationData::DisplayId display, IpLocation ipLocation,
+                  FrameLocation frameLocation)
+{
+    auto rows = topRows;
+    forEachFrame(data, traceIndex, [&](const TraceNode& trace, const InstructionPointer& ip, const Frame* inlined,
+                                       bool isUntrackedLocation) {
+        const auto stackType = AccumulatedTraceData::isShowCoreCLRPartOption ? trace.getNodeType(display)
+                                                                             : AllocationData::CoreCLRType::nonCoreCLR;
+        if (inlined) {
+            rows = addRow(rows, frameLocation(*inlined, ip, isUntrackedLocation), cost, stackType);
+        } else {
+            rows = addRow(rows, ipLocation(trace.ipIndex, ip, isUntrackedLocation), cost, stackType);
+        }
+        return true;
+    });
+}
+
+template <typename Rows>
+void setParents(Rows& children, const typename Rows::value_type* parent)
+{
+    for (auto& row : children) {
+        row.parent = parent;
+        setParents(row.children, &row);
+    }
+}
+
+/**
+ * Builds a top-down tree from the leaves of a bottom-up tree. The rows are created in a flat
+ * list. The children of a row are found by scanning them, and once a row has many children
+ * through a hash map keyed on the parent and the location, so Location must be hashable with
+ * std::hash.
+ *
+ * Independent parts of a bottom-up tree can be added to different builders that are merged
+ * afterwards. Merging them in the order of the parts gives the same tree as adding all parts
+ * to a single builder.
+ */
+template <typename Rows>
+class TopDownBuilder
+{
+public:
+    using Row = typename Rows::value_type;
+    using Location = decltype(Row::location);
+
+    TopDownBuilder()
+        // the root has no location, its children are the top rows
+        : m_nodes(1)
+    {
+    }
+
+    /**
+     * Add the cost of the leaves in the bottom-up rows [@p begin, @p end), starting at the
+     * outermost caller. The parents of the rows must be set.
+     *
+     * @return the total cost of the rows
+     */
+    template <typename Iterator>
+    AllocationData::Stats addLeaves(Iterator begin, Iterator end)
+    {
+        AllocationData::Stats totalCost;
+        for (auto it = begin; it != end; ++it) {
+            const auto& row = *it;
+            // recurse and find the cost attributed to children
+            const auto childCost = addLeaves(row.children.begin(), row.children.end());
+            if (childCost != row.cost) {
+                // this row is (partially) a leaf
+                const auto cost = row.cost - childCost;
+
+                // bubble up the parent chain to build a top-down tree, always use the leaf node's
+                // cost and propagate that one up the chain, otherwise we'd count the cost of some
+                // nodes multiple times
+                uint32_t node = 0;
+                for (auto bottomUp = &row; bottomUp; bottomUp = bottomUp->parent) {
+                    node = addNode(node, bottomUp->location, bottomUp->stackType);
+                    m_nodes[node].cost += cost;
+                }
+            }
+            totalCost += row.cost;
+        }
+        return totalCost;
+    }
+
+    /**
+     * Add the rows of @p other, which was built from bottom-up rows that follow the ones
+     * of this builder.
+     */
+    void merge(const TopDownBuilder& other)
+    {
+        // the parents are created before their children, so they are always mapped already
+        std::vector<uint32_t> mapped(other.m_nodes.size(), 0);
+        for (uint32_t i = 1; i < other.m_nodes.size(); ++i) {
+            const auto& node = other.m_nodes[i];
+            mapped[i] = addNode(mapped[node.parent], node.location, node.stackType);
+            m_nodes[mapped[i]].cost += node.cost;
+        }
+    }
+
+    /**
+     * @return the top-down tree with its parents set, the children of a row are in the order
+     *         in which they were created
+     */
+    Rows rows() const
+    {
+        Rows topRows;
+        addRows(&topRows, 0);
+        // now set the parents, the data is constant from here on
+        setParents(topRows, nullptr);
+        return topRows;
+    }
+
+private:
+    // rows with more children are looked up in the hash map
+    static const uint32_t MAX_SCANNED_CHILDREN = 8;
+
+    struct Node
+    {
+        Location location;
+        AllocationData::CoreCLRType stackType;
+        AllocationData::Stats cost;
+        uint32_t parent;
+        // the children form a list in the order of their creation, zero ends it
+        uint32_t firstChild;
+        uint32_t lastChild;
+        uint32_t nextSibling;
+        uint32_t numChildren;
+    };
+
+    struct Key
+    {
+        uint32_t parent;
+        Location location;
+
+        bool operator==(const Key& rhs) const
+        {
+            return parent == rhs.parent && location == rhs.location;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            return std::hash<Location>()(key.location) * 31 + key.parent;
+        }
+    };
+
+    /**
+     * @return the child of @p parent for @p location, created with @p stackType if needed
+     */
+    uint32_t addNode(uint32_t parent, const Location& location, AllocationData::CoreCLRType stackType)
+    {
+        if (m_nodes[parent].numChildren <= MAX_SCANNED_CHILDREN) {
+            for (auto child = m_nodes[parent].firstChild; child; child = m_nodes[child].nextSibling) {
+                if (m_nodes[child].location == location) {
+                    return child;
+                }
+            }
+        } else {
+            auto it = m_index.find({parent, location});
+            if (it != m_index.end()) {
+                return it->second;
+            }
+        }
+
+        const auto node = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back({location, stackType, {}, parent, 0, 0, 0, 0});
+        auto& parentNode = m_nodes[parent];
+        if (parentNode.lastChild) {
+            m_nodes[parentNode.lastChild].nextSibling = node;
+        } else {
+            parentNode.firstChild = node;
+        }
+        parentNode.lastChild = node;
+        ++parentNode.numChildren;
+
+        if (parentNode.numChildren == MAX_SCANNED_CHILDREN + 1) {
+            // the parent just became too wide to scan, so index all of its children
+            for (auto child = parentNode.firstChild; child; child = m_nodes[child].nextSibling) {
+                m_index.insert({{parent, m_nodes[child].location}, child});
+            }
+        } else if (parentNode.numChildren > MAX_SCANNED_CHILDREN) {
+            m_index.insert({{parent, location}, node});
+        }
+        return node;
+    }
+
+    void addRows(Rows* rows, uint32_t node) const
+    {
+        rows->reserve(m_nodes[node].numChildren);
+        for (auto child = m_nodes[node].firstChild; child; child = m_nodes[child].nextSibling) {
+            const auto& childNode = m_nodes[child];
+            rows->push_back({childNode.cost, childNode.location, nullptr, {}, childNode.stackType});
+            addRows(&rows->back().children, child);
+        }
+    }
+
+    std::vector<Node> m_nodes;
+    std::unordered_map<Key, uint32_t, KeyHash> m_index;
+};
+
+/**
+ * @return the top-down tree for the bottom-up tree @p bottomUpData, whose parents must be set
+ */
+template <typename Rows>
+Rows toTopDown(const Rows& bottomUpData)
+{
+    TopDownBuilder<Rows> builder;
+    builder.addLeaves(bottomUpData.begin(), bottomUpData.end());
+    return builder.rows();
+}
+
+/**
+ * An allocation whose backtrace passes through a row of a LazyTree and the position of the
+ * row's frame in the backtrace: the trace node, or for a top-down tree its position in the
+ * path of the allocation, and the frame of that node, where 0 is the frame of its instruction
+ * pointer and the inlined frames follow like in forEachFrame.
+ */
+struct Member
+{
+    uint32_t allocation;
+    uint32_t node;
+    uint32_t inlined;
+};
+
+/**
+ * A bottom-up or top-down call tree whose rows are only created when they are needed,
+ * e.g. when they are expanded in a view or printed. Instead of their children, the rows
+ * that were not expanded yet hold the allocations whose backtraces continue below them,
+ * so in addition rows need a container of Member called members.
+ *
+ * The costs of the allocations are copied, but the backtraces are looked up in the data
+ * when a row is expanded. Thus the data must outlive the tree and its traces must not
+ * change anymore. The members continue from their frame, so a bottom-up tree follows the
+ * parents of the trace nodes. A top-down tree can't, so it keeps the path of trace nodes
+ * of each allocation from the allocation site to the outermost caller.
+ */
+template <typename Location>
+class LazyTree
+{
+public:
+    enum Direction
+    {
+        BottomUp,
+        TopDown
+    };
+
+    using IpLocation = std::function<Location(IpIndex, const InstructionPointer&, bool)>;
+    using FrameLocation = std::function<Location(const Frame&, const InstructionPointer&, bool)>;
+
+    LazyTree(const AccumulatedTraceData& data, AllocationData::DisplayId display, Direction direction,
+             IpLocation ipLocation, FrameLocation frameLocation)
+        : m_data(data)
+        , m_display(display)
+        , m_direction(direction)
+        , m_ipLocation(std::move(ipLocation))
+        , m_frameLocation(std::move(frameLocation))
+    {
+    }
+
+    void addAllocation(TraceIndex traceIndex, const AllocationData::Stats& cost)
+    {
+        const auto pathBegin = static_cast<uint32_t>(m_paths.size());
+        if (m_direction == TopDown) {
+            forEachNode(m_data, traceIndex, [this](TraceIndex index, const TraceNode&, const InstructionPointer&) {
+                m_paths.push_back(index.index);
+                return true;
+            });
+        }
+        m_allocations.push_back({traceIndex, cost, pathBegin});
+    }
+
+    /**
+     * @return the top rows of the tree, i.e. the allocation sites for a bottom-up tree
+     *         and the outermost callers for a top-down tree
+     */
+    template <typename Rows>
+    Rows topRows() const
+    {
+        std::vector<Member> members;
+        members.reserve(m_allocations.size());
+        for (uint32_t i = 0; i < m_allocations.size(); ++i) {
+            Member member = {i, 0, 0};
+            if (m_direction == BottomUp) {
+                if (firstFrame(m_allocations[i].traceIndex, &member)) {
+                    members.push_back(member);
+                }
+                continue;
+            }
+            const auto pathEnd = i + 1 < m_allocations.size() ? m_allocations[i + 1].pathBegin
+                                                              : static_cast<uint32_t>(m_paths.size());
+            if (pathEnd != m_allocations[i].pathBegin) {
+                member.node = pathEnd - 1;
+                member.inlined = numInlined(member);
+                members.push_back(member);
+            }
+        }
+        Rows rows;
+        addRows(&rows, members, nullptr);
+        return rows;
+    }
+
+    /**
+     * Create the children of @p row, unless that was done before. The address of @p row
+     * is used as parent of the children, so it must not change afterwards.
+     */
+    template <typename Row>
+    void expand(Row* row) const
+    {
+        if (row->members.empty()) {
+            return;
+        }
+        std::vector<Member> members(row->members.begin(), row->members.end());
+        addRows(&row->children, members, row);
+        row->members = {};
+    }
+
+private:
+    struct Allocation
+    {
+        TraceIndex traceIndex;
+        AllocationData::Stats cost;
+        // the start of the path of the allocation in m_paths, it ends where the path of the next one begins
+        uint32_t pathBegin;
+    };
+
+    TraceIndex traceIndex(const Member& member) const
+    {
+        TraceIndex index;
+        index.index = m_direction == BottomUp ? member.node : m_paths[member.node];
+        return index;
+    }
+
+    uint32_t numInlined(const Member& member) const
+    {
+        const auto ip = m_data.findIp(m_data.findTrace(traceIndex(member)).ipIndex);
+        return static_cast<uint32_t>(ip.inlined.size());
+    }
+
+    /**
+     * Move @p member to the first frame of the trace node @p index or of its callers that
+     * forEachFrame visits.
+     *
+     * @return false when there is no such frame
+     */
+    bool firstFrame(TraceIndex index, Member* member) const
+    {
+        bool found = false;
+        forEachNode(m_data, index, [member, &found](TraceIndex node, const TraceNode&, const InstructionPointer&) {
+            member->node = node.index;
+            member->inlined = 0;
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    /**
+     * Move @p member to the frame that follows its frame in the direction of the tree.
+     *
+     * @return false when the backtrace ends at the frame of @p member
+     */
+    bool nextFrame(Member* member) const
+    {
+        if (m_direction == TopDown) {
+            if (member->inlined) {
+                --member->inlined;
+                return true;
+            }
+            if (member->node == m_allocations[member->allocation].pathBegin) {
+                return false;
+            }
+            --member->node;
+            member->inlined = numInlined(*member);
+            return true;
+        }
+        const auto trace = m_data.findTrace(traceIndex(*member));
+        const auto ip = m_data.findIp(trace.ipIndex);
+        if (member->inlined < ip.inlined.size()) {
+            ++member->inlined;
+            return true;
+        }
+        if (m_data.isStopIndex(ip.frame.functionIndex) || !trace.parentIndex) {
+            return false;
+        }
+        return firstFrame(trace.parentIndex, member);
+    }
+
+    /**
+     * Add the cost of @p members to the rows of their frames in @p rows, members that
+     * continue below these frames are kept in the rows for their expansion.
+     */
+    template <typename Rows>
+    void addRows(Rows* rows, const std::vector<Member>& members, const typename Rows::value_type* parent) const
+    {
+        for (const auto& member : members) {
+            const auto& allocation = m_allocations[member.allocation];
+            const auto index = traceIndex(member);
+            const auto trace = m_data.findTrace(index);
+            const auto ip = m_data.findIp(trace.ipIndex);
+            const bool isUntrackedLocation = !index;
+            const auto location = member.inlined
+                ? m_frameLocation(ip.inlined.begin()[member.inlined - 1], ip, isUntrackedLocation)
+                : m_ipLocation(trace.ipIndex, ip, isUntrackedLocation);
+            const auto stackType = AccumulatedTraceData::isShowCoreCLRPartOption
+                ? trace.getNodeType(m_display)
+                : AllocationData::CoreCLRType::nonCoreCLR;
+
+            // like addRow, but the top-down tree merges rows of a location regardless of their stack type,
+            // as buildTopDown does
+            auto it = std::lower_bound(rows->begin(), rows->end(), location);
+            for (; it != rows->end() && it->location == location; ++it) {
+                if (m_direction == TopDown || it->stackType == stackType) {
+                    break;
+                }
+            }
+            if (it == rows->end() || !(it->location == location)) {
+                it = rows->insert(it, {{}, location, parent, {}, stackType});
+            }
+            it->cost += allocation.cost;
+            auto next = member;
+            if (nextFrame(&next)) {
+                it->members.push_back(next);
+            }
+        }
+    }
+
+    const AccumulatedTraceData& m_data;
+    AllocationData::DisplayId m_display;
+    Direction m_direction;
+    IpLocation m_ipLocation;
+    FrameLocation m_frameLocation;
+    std::vector<Allocation> m_allocations;
+    // the trace nodes of the backtraces of a top-down tree that forEachFrame visits, from the allocation site on
+    std::vector<uint32_t> m_paths;
+};
+}
+
+#endif // CALLTREE_H
@@ -0,0 +1,325 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file heaptrack_check.cpp
+ *
+ * @brief Compare heaptrack data against a baseline and fail on memory regressions.
+ */
+
+#include <boost/program_options.hpp>
+
+#include "analyze/traceanalysis.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+#include "util/config.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+namespace {
+
+const char BASELINE_HEADER[] = "# heaptrack_check baseline";
+
+// exit codes, a regression has its own so that CI can tell it apart from broken input
+const int EXIT_REGRESSION = 1;
+const int EXIT_ERROR = 2;
+
+const int NUM_DISPLAYS = static_cast<int>(AllocationData::DisplayId::shared) + 1;
+
+const char* displayName(AllocationData::DisplayId display)
+{
+    switch (display) {
+    case AllocationData::DisplayId::malloc:
+        return "malloc";
+    case AllocationData::DisplayId::managed:
+        return "managed";
+    case AllocationData::DisplayId::privateClean:
+        return "private_clean";
+    case AllocationData::DisplayId::privateDirty:
+        return "private_dirty";
+    default:
+        return "shared";
+    }
+}
+
+bool parseDisplay(const string& name, AllocationData::DisplayId* display)
+{
+    for (int i = 0; i < NUM_DISPLAYS; ++i) {
+        const auto id = static_cast<AllocationData::DisplayId>(i);
+        if (name == displayName(id)) {
+            *display = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasAllocationCounts(AllocationData::DisplayId display)
+{
+    return display == AllocationData::DisplayId::malloc || display == AllocationData::DisplayId::managed;
+}
+
+/**
+ * The numbers that are compared against the baseline: the totals of each metric
+ * and the top allocation sites by peak, which point at the cause of a regression.
+ */
+struct Summary
+{
+    struct Site
+    {
+        int64_t peak = 0;
+        int64_t allocations = 0;
+    };
+
+    map<AllocationData::DisplayId, AllocationData::Stats> totals;
+    map<AllocationData::DisplayId, map<pair<string, string>, Site>> sites;
+
+    void collect(const TraceAnalysis& data, size_t siteCount)
+    {
+        for (int i = 0; i < NUM_DISPLAYS; ++i) {
+            const auto display = static_cast<AllocationData::DisplayId>(i);
+            const auto& total = *data.totalCost.getDisplay(display);
+            if (total.isEmpty()) {
+                continue;
+            }
+            totals[display] = total;
+            for (const auto& site : data.top(display, &AllocationData::Stats::peak, siteCount)) {
+                auto& entry = sites[display][{site.location.function, site.location.module}];
+                entry.peak += site.cost.peak;
+                entry.allocations += site.cost.allocations;
+            }
+        }
+    }
+
+    void write(ostream& out) const
+    {
+        out << BASELINE_HEADER << '\n';
+        for (const auto& total : totals) {
+            const auto& stats = total.second;
+            out << "total " << displayName(total.first) << ' ' << stats.peak << ' ' << stats.allocations << ' '
+                << stats.leaked << ' ' << stats.temporary << '\n';
+        }
+        for (const auto& displaySites : sites) {
+            for (const auto& site : displaySites.second) {
+                out << "site " << displayName(displaySites.first) << ' ' << site.second.peak << ' '
+                    << site.second.allocations << '\t' << site.first.first << '\t' << site.first.second << '\n';
+            }
+        }
+    }
+
+    bool read(istream& in)
+    {
+        string line;
+        while (getline(in, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            istringstream stream(line);
+            string type;
+            string name;
+            AllocationData::DisplayId display;
+            if (!(stream >> type >> name) || !parseDisplay(name, &display)) {
+                cerr << "failed to parse line: " << line << endl;
+                return false;
+            }
+            if (type == "total") {
+                auto& stats = totals[display];
+                if (!(stream >> stats.peak >> stats.allocations >> stats.leaked >> stats.temporary)) {
+                    cerr << "failed to parse line: " << line << endl;
+                    return false;
+                }
+            } else if (type == "site") {
+                Site site;
+                string function;
+                string module;
+                if (!(stream >> site.peak >> site.allocations) || stream.get() != '\t'
+                    || !getline(stream, function, '\t')) {
+                    cerr << "failed to parse line: " << line << endl;
+                    return false;
+                }
+                getline(stream, module);
+                sites[display][{function, module}] = site;
+            } else {
+                cerr << "failed to parse line: " << line << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+bool isBaselineFile(const string& path)
+{
+    ifstream in(path);
+    string line;
+    return getline(in, line) && line == BASELINE_HEADER;
+}
+
+/**
+ * @return the increase from @p base to @p value in percent
+ */
+double increase(int64_t base, int64_t value)
+{
+    if (base == 0) {
+        return value > 0 ? numeric_limits<double>::infinity() : 0.;
+    }
+    return 100. * (value - base) / base;
+}
+}
+
+int main(int argc, char** argv)
+{
+    po::options_description desc("Options", 120, 60);
+    desc.add_options()("file,f", po::value<string>(), "The heaptrack data file to check.")(
+        "baseline,b", po::value<string>()->default_value(string()),
+        "The baseline to compare to, either a file written with --write-baseline or a heaptrack data file.")(
+        "write-baseline,w", po::value<string>()->default_value(string()),
+        "Write the numbers of the data file to the given baseline file instead of checking it.")(
+        "max-peak-increase", po::value<double>()->default_value(5.),
+        "Largest accepted increase of the peak memory consumption in percent.")(
+        "max-allocations-increase", po::value<double>()->default_value(5.),
+        "Largest accepted increase of the number of calls to allocation functions in percent.")(
+        "top-sites,n", po::value<size_t>()->default_value(10),
+        "Number of allocation sites with the highest peak that are reported and stored in baselines.")(
+        "begin", po::value<int64_t>()->default_value(0), "Only check the peaks from the given time in ms on.")(
+        "end", po::value<int64_t>()->default_value(numeric_limits<int64_t>::max()),
+        "Only check the data up to the given time in ms.")("help,h", "Show this help message.")(
+        "version,v", "Displays version information.");
+    po::positional_options_description p;
+    p.add("file", -1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+        if (vm.count("help")) {
+            cout << "heaptrack_check - check heaptrack data files for memory regressions.\n"
+                 << "\n"
+                 << "Compares the peak memory consumption and the number of calls to allocation\n"
+                 << "functions to a baseline. The exit code is " << EXIT_REGRESSION
+                 << " when a metric grew beyond its threshold,\n"
+                 << EXIT_ERROR << " when the data could not be read and 0 otherwise.\n\n"
+                 << desc << endl;
+            return 0;
+        } else if (vm.count("version")) {
+            cout << "heaptrack_check " << HEAPTRACK_VERSION_STRING << endl;
+            return 0;
+        }
+        po::notify(vm);
+    } catch (const po::error& error) {
+        cerr << "ERROR: " << error.what() << endl << endl << desc << endl;
+        return EXIT_ERROR;
+    }
+
+    const auto baselineFile = vm["baseline"].as<string>();
+    const auto writeBaseline = vm["write-baseline"].as<string>();
+    if (!vm.count("file") || baselineFile.empty() == writeBaseline.empty()) {
+        cerr << "ERROR: a data file and either --baseline or --write-baseline are required\n\n" << desc << endl;
+        return EXIT_ERROR;
+    }
+
+    const auto siteCount = vm["top-sites"].as<size_t>();
+    const auto windowBegin = vm["begin"].as<int64_t>();
+    const auto windowEnd = vm["end"].as<int64_t>();
+    auto summarize = [&](const string& file, Summary* summary) {
+        TraceAnalysis data;
+        const bool isWindow = windowBegin != 0 || windowEnd != numeric_limits<int64_t>::max();
+        if (!(isWindow ? data.readWindow(file, {}, windowBegin, windowEnd) : data.load(file))) {
+            cerr << "Failed to read heaptrack data file: " << file << endl;
+            return false;
+        }
+        summary->collect(data, siteCount);
+        return true;
+    };
+
+    Summary run;
+    if (!summarize(vm["file"].as<string>(), &run)) {
+        return EXIT_ERROR;
+    }
+
+    if (!writeBaseline.empty()) {
+        ofstream out(writeBaseline);
+        if (!out.is_open()) {
+            cerr << "Failed to open baseline output file \"" << writeBaseline << "\"." << endl;
+            return EXIT_ERROR;
+        }
+        run.write(out);
+        return 0;
+    }
+
+    Summary baseline;
+    if (isBaselineFile(baselineFile)) {
+        ifstream in(baselineFile);
+        if (!baseline.read(in)) {
+            return EXIT_ERROR;
+        }
+    } else if (!summarize(baselineFile, &baseline)) {
+        return EXIT_ERROR;
+    }
+
+    const auto maxPeakIncrease = vm["max-peak-increase"].as<double>();
+    const auto maxAllocationsIncrease = vm["max-allocations-increase"].as<double>();
+    bool regression = false;
+    auto check = [&](AllocationData::DisplayId display, const char* metric, int64_t base, int64_t value,
+                     double maxIncrease) {
+        const auto percent = increase(base, value);
+        const bool failed = percent > maxIncrease;
+        cout << (failed ? "FAIL " : "ok   ") << displayName(display) << ' ' << metric << ": " << base << " -> "
+             << value << " (" << showpos << fixed << setprecision(2) << percent << noshowpos << "%, limit "
+             << maxIncrease << "%)\n";
+        regression |= failed;
+        return failed;
+    };
+
+    for (const auto& total : baseline.totals) {
+        const auto display = total.first;
+        const auto& base = total.second;
+        const auto& value = run.totals[display];
+        bool failed = check(display, "peak", base.peak, value.peak, maxPeakIncrease);
+        if (hasAllocationCounts(display)) {
+            failed |= check(display, "allocations", base.allocations, value.allocations, maxAllocationsIncrease);
+        }
+        if (!failed) {
+            continue;
+        }
+
+        // point at the allocation sites that grew
+        const auto& baseSites = baseline.sites[display];
+        for (const auto& site : run.sites[display]) {
+            const auto& function = site.first.first.empty() ? string("??") : site.first.first;
+            auto it = baseSites.find(site.first);
+            if (it == baseSites.end()) {
+                cout << "     " << function << " in " << site.first.second << ": " << site.second.peak << " peak, "
+                     << site.second.allocations << " allocations, not among the top sites of the baseline\n";
+            } else if (site.second.peak > it->second.peak || site.second.allocations > it->second.allocations) {
+                cout << "     " << function << " in " << site.first.second << ": " << it->second.peak << " -> "
+                     << site.second.peak << " peak, " << it->second.allocations << " -> " << site.second.allocations
+                     << " allocations\n";
+            }
+        }
+    }
+
+    cout << flush;
+    return regression ? EXIT_REGRESSION : 0;
+}
@@ -28,6 +28,7 @@
 
 #include <QTextStream>
 
+#include <algorithm>
 #include <cmath>
 
 namespace {
@@ -309,12 +310,50 @@ void CallerCalleeModel::resetData(const QVector<CallerCalleeData>& rows)
     endResetModel();
 }
 
+void CallerCalleeModel::updateData(const QVector<CallerCalleeData>& rows)
+{
+    const auto oldIndices = persistentIndexList();
+    if (oldIndices.isEmpty() || m_rows.isEmpty()) {
+        resetData(rows);
+        return;
+    }
+
+    emit layoutAboutToBeChanged();
+
+    QVector<LocationData::Ptr> locations;
+    locations.reserve(oldIndices.size());
+    for (const auto& index : oldIndices) {
+        locations.append(m_rows.at(index.row()).location);
+    }
+
+    m_rows = rows;
+
+    // the rows are sorted by location, see toCallerCalleeData
+    QModelIndexList newIndices;
+    newIndices.reserve(oldIndices.size());
+    for (int i = 0; i < oldIndices.size(); ++i) {
+        const auto& location = locations[i];
+        auto it = std::lower_bound(m_rows.begin(), m_rows.end(), location,
+                                   [](const CallerCalleeData& lhs, const LocationData::Ptr& rhs) { return lhs.location < rhs; });
+        if (it != m_rows.end() && it->location == location) {
+            newIndices.append(index(it - m_rows.begin(), oldIndices[i].column()));
+        } else {
+            newIndices.append(QModelIndex());
+        }
+    }
+    changePersistentIndexList(oldIndices, newIndices);
+
+    emit layoutChanged();
+}
+
 void CallerCalleeModel::setSummary(const SummaryData& data)
 {
-    beginResetModel();
+    // only the maximum cost changes, which is used to paint the cost bars
     m_maxCost.inclusiveCost = data.cost;
     m_maxCost.selfCost = data.cost;
-    endResetModel();
+    if (!m_rows.isEmpty()) {
+        emit dataChanged(index(0, 0), index(m_rows.size() - 1, NUM_COLUMNS - 1));
+    }
 }
 
 void CallerCalleeModel::clearData()
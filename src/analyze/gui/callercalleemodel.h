@@ -87,6 +87,8 @@ public:
     int rowCount(const QModelIndex& parent = {}) const override;
 
     void resetData(const QVector<CallerCalleeData>& rows);
+    // like resetData, but keeps the persistent indices on the rows of the same locations
+    void updateData(const QVector<CallerCalleeData>& rows);
     void setSummary(const SummaryData& data);
     void clearData();
 
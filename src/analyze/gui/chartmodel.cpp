@@ -91,6 +91,10 @@ QVariant ChartModel::headerData(int section, Qt::Orientation orientation, int ro
                 return i18n("Memory Consumed");
             case Temporary:
                 return i18n("Temporary Allocations");
+            case Threads:
+                return i18n("Memory Consumed per Thread");
+            case Fragmentation:
+                return i18n("Heap Fragmentation");
             }
         }
     }
@@ -129,7 +133,7 @@ QVariant ChartModel::data(const QModelIndex& index, int role) const
         return {};
     }
 
-    const auto& data = m_data.rows.at(index.row());
+    const auto& data = m_rows.at(index.row());
 
     int column = index.column();
     if (role != Qt::ToolTipRole && column % 2 == 0) {
@@ -165,6 +169,12 @@ QVariant ChartModel::data(const QModelIndex& index, int role) const
             case Allocated:
                 return i18n("<qt>%1 allocated in total after <b>%2</b></qt>",
                             byteCost(), time);
+            case Threads:
+                return i18n("<qt>%1 consumed by all threads after <b>%2</b></qt>",
+                            byteCost(), time);
+            case Fragmentation:
+                return i18n("<qt>%1 of pages spanned by the heap after <b>%2</b></qt>",
+                            byteCost(), time);
             }
         } else {
             auto label = m_data.labels.value(column);
@@ -190,6 +200,12 @@ QVariant ChartModel::data(const QModelIndex& index, int role) const
                 return i18n("<qt>%2 consumed after <b>%3</b> from: "
                             "<p style='margin-left:10px'>%1</p></qt>",
                             label, byteCost(), time);
+            case Threads:
+                return i18n("<qt>%2 consumed after <b>%3</b> by thread: "
+                            "<p style='margin-left:10px'>%1</p></qt>",
+                            label, byteCost(), time);
+            case Fragmentation:
+                return i18n("<qt>%2 of %1 after <b>%3</b></qt>", label, byteCost(), time);
             case Allocated:
                 return i18n("<qt>%2 allocated after <b>%3</b> from: "
                             "<p style='margin-left:10px'>%1</p></qt>",
@@ -212,7 +228,7 @@ int ChartModel::rowCount(const QModelIndex& parent) const
     if (parent.isValid()) {
         return 0;
     } else {
-        return m_data.rows.size();
+        return m_rows.size();
     }
 }
 
@@ -221,13 +237,8 @@ void ChartModel::resetData(const ChartData& data)
     Q_ASSERT(m_data.labels.size() < ChartRows::MAX_NUM_COST);
     beginResetModel();
     m_data = data;
-    m_timestamps.clear();
-    const int rows = rowCount();
-    m_timestamps.reserve(rows);
-    for (int row = 0; row < rows; ++row)
-    {
-        m_timestamps.append(m_data.rows[row].timeStamp);
-    }
+    m_hasTimeRange = false;
+    setRows(m_data.rows);
     m_columnDataSetBrushes.clear();
     m_columnDataSetPens.clear();
     const int columns = columnCount();
@@ -242,10 +253,57 @@ void ChartModel::resetData(const ChartData& data)
     endResetModel();
 }
 
+void ChartModel::updateData(const ChartData& data)
+{
+    if (m_hasTimeRange && data.labels == m_data.labels) {
+        // keep showing the time range that is zoomed into
+        beginResetModel();
+        m_data = data;
+        setRows(rowsInRange(m_begin, m_end));
+        endResetModel();
+        return;
+    }
+
+    const int oldRows = rowCount();
+    const int newRows = data.rows.size();
+    auto extendsData = [&]() {
+        if (oldRows == 0 || newRows < oldRows || data.labels != m_data.labels) {
+            return false;
+        }
+        for (int row = 0; row < oldRows; ++row) {
+            const auto& oldRow = m_data.rows[row];
+            const auto& newRow = data.rows[row];
+            if (oldRow.timeStamp != newRow.timeStamp || oldRow.cost != newRow.cost) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!extendsData()) {
+        // e.g. the labels changed, or rows got dropped to thin out the data
+        resetData(data);
+        return;
+    }
+    if (newRows == oldRows) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), oldRows, newRows - 1);
+    m_data = data;
+    m_rows = m_data.rows;
+    m_timestamps.reserve(newRows);
+    for (int row = oldRows; row < newRows; ++row) {
+        m_timestamps.append(m_rows[row].timeStamp);
+    }
+    endInsertRows();
+}
+
 void ChartModel::clearData()
 {
     beginResetModel();
     m_data = {};
+    m_rows = {};
+    m_hasTimeRange = false;
     m_timestamps = {};
     m_columnDataSetBrushes = {};
     m_columnDataSetPens = {};
@@ -259,7 +317,7 @@ qint64 ChartModel::getTimestamp(int row) const
 
 qint64 ChartModel::getCost(int row, int column) const
 {
-    return m_data.rows[row].cost[column / 2];
+    return m_rows[row].cost[column / 2];
 }
 
 QString ChartModel::getColumnLabel(int column) const
@@ -298,3 +356,71 @@ int ChartModel::getRowForTimestamp(qreal timestamp) const
     }
     return result;
 }
+
+qint64 ChartModel::getMaxCost(int column) const
+{
+    qint64 maxCost = 0;
+    for (const auto& row : m_data.rows) {
+        maxCost = std::max(maxCost, row.cost[column / 2]);
+    }
+    return maxCost;
+}
+
+bool ChartModel::setTimeRange(qint64 begin, qint64 end)
+{
+    const auto& allRows = m_data.rows;
+    if (m_data.levels.isEmpty() || allRows.isEmpty()) {
+        return false;
+    }
+    const bool hasTimeRange = begin > allRows.first().timeStamp || end < allRows.last().timeStamp;
+    const auto rows = hasTimeRange ? rowsInRange(begin, end) : allRows;
+    if (hasTimeRange == m_hasTimeRange && rows.size() == m_rows.size() && !rows.isEmpty()
+        && rows.first().timeStamp == m_rows.first().timeStamp && rows.last().timeStamp == m_rows.last().timeStamp) {
+        return false;
+    }
+
+    beginResetModel();
+    m_hasTimeRange = hasTimeRange;
+    m_begin = begin;
+    m_end = end;
+    setRows(rows);
+    endResetModel();
+    return true;
+}
+
+bool ChartModel::hasTimeRange() const
+{
+    return m_hasTimeRange;
+}
+
+QVector<ChartRows> ChartModel::rowsInRange(qint64 begin, qint64 end) const
+{
+    const int maxRows = std::max(m_data.rows.size(), 2);
+    for (const auto& level : m_data.levels) {
+        const auto& rows = level.rows;
+        auto byTimeStamp = [](const ChartRows& row, qint64 timeStamp) { return row.timeStamp < timeStamp; };
+        // include the rows right before and after the range so that the curves reach its edges
+        auto first = std::lower_bound(rows.begin(), rows.end(), begin, byTimeStamp);
+        if (first != rows.begin()) {
+            --first;
+        }
+        auto last = std::lower_bound(first, rows.end(), end, byTimeStamp);
+        if (last != rows.end()) {
+            ++last;
+        }
+        if (last - first <= maxRows || &level == &m_data.levels.last()) {
+            return rows.mid(first - rows.begin(), last - first);
+        }
+    }
+    return m_data.rows;
+}
+
+void ChartModel::setRows(const QVector<ChartRows>& rows)
+{
+    m_rows = rows;
+    m_timestamps.clear();
+    m_timestamps.reserve(m_rows.size());
+    for (const auto& row : m_rows) {
+        m_timestamps.append(row.timeStamp);
+    }
+}
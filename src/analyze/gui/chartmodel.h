@@ -40,10 +40,25 @@ struct ChartRows
 };
 Q_DECLARE_TYPEINFO(ChartRows, Q_MOVABLE_TYPE);
 
+/**
+ * The rows of a chart at one time resolution. A row merges the rows of a bucket of
+ * @c bucketWidth ms: it has the time stamp of the last one and the maximum of each cost,
+ * which also is the last cost for the accumulated metrics.
+ */
+struct ChartLevel
+{
+    qint64 bucketWidth = 1;
+    QVector<ChartRows> rows;
+};
+Q_DECLARE_TYPEINFO(ChartLevel, Q_MOVABLE_TYPE);
+
 struct ChartData
 {
     QVector<ChartRows> rows;
     QHash<int, QString> labels;
+    // the finest level first, the bucket width doubles from one level to the next and
+    // the last level holds the rows above. empty when the rows can't be zoomed into
+    QVector<ChartLevel> levels;
 };
 Q_DECLARE_METATYPE(ChartData)
 Q_DECLARE_TYPEINFO(ChartData, Q_MOVABLE_TYPE);
@@ -59,6 +74,10 @@ public:
         Allocations,
         Allocated,
         Temporary,
+        // the memory consumed by the allocations of the threads, the labels are thread names
+        Threads,
+        // the pages spanned by the malloc heap, with its live bytes and its sparse pages
+        Fragmentation,
     };
     explicit ChartModel(Type type, QObject* parent = nullptr);
     virtual ~ChartModel();
@@ -84,12 +103,36 @@ public:
     // of all rows, otherwise return -1
     int getRowForTimestamp(qreal timestamp) const;
 
+    // the largest cost of the column over the whole time, also when zoomed in
+    qint64 getMaxCost(int column) const;
+
+    /**
+     * Show the rows of the finest level that has no more rows within [@p begin, @p end] in ms
+     * than the whole data has, plus one row on either side. This resets the model.
+     *
+     * @return false when the rows didn't change
+     */
+    bool setTimeRange(qint64 begin, qint64 end);
+
+    // whether the rows are those of a time range instead of the whole data
+    bool hasTimeRange() const;
+
 public slots:
     void resetData(const ChartData& data);
+    // like resetData, but only inserts the new rows when @p data extends the current data
+    void updateData(const ChartData& data);
     void clearData();
 
 private:
+    QVector<ChartRows> rowsInRange(qint64 begin, qint64 end) const;
+    void setRows(const QVector<ChartRows>& rows);
+
     ChartData m_data;
+    // the rows that are shown, those of a time range or m_data.rows
+    QVector<ChartRows> m_rows;
+    bool m_hasTimeRange = false;
+    qint64 m_begin = 0;
+    qint64 m_end = 0;
     Type m_type;
     QVector<qint64> m_timestamps;
     // we cache the pens and brushes as constructing them requires allocations
@@ -200,6 +200,16 @@ void ChartWidget::setModel(ChartModel* model, bool minimalMode)
                         "corresponding deallocation, without other allocations happening "
                         "in-between.</qt>"));
         break;
+    case ChartModel::Threads:
+        setToolTip(i18n("<qt>Shows the heap memory consumed by the allocations of the threads over time, "
+                        "regardless of the threads that free them.</qt>"));
+        break;
+    case ChartModel::Fragmentation:
+        setToolTip(i18n("<qt>Shows the pages spanned by the malloc heap over time, next to its live bytes "
+                        "and its sparse pages, i.e. the pages that are less than a quarter used. "
+                        "A large gap between the spanned pages and the live bytes keeps the RSS up "
+                        "after the heap shrank.</qt>"));
+        break;
     }
 
 #if defined(KChart_FOUND) || defined(SHOW_TABLES)
@@ -266,6 +276,7 @@ void ChartWidget::setModel(ChartModel* model, bool minimalMode)
     }
 #elif defined(QWT_FOUND)
     connect(model, SIGNAL(modelReset()), this, SLOT(modelReset()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(modelRowsInserted()));
     m_plot->setModel(model);
 #ifdef SHOW_TABLES
     totalProxy = new ChartProxy(true, this);
@@ -289,7 +300,14 @@ QSize ChartWidget::sizeHint() const
 #ifdef QWT_FOUND
 void ChartWidget::modelReset()
 {
-    m_plot->rebuild(true);
+    // keep the zoom when the model shows the rows of the zoomed time range
+    m_plot->rebuild(!m_plot->model()->hasTimeRange());
+}
+
+void ChartWidget::modelRowsInserted()
+{
+    // keep the zoom while live data is appended
+    m_plot->rebuild(false);
 }
 
 #ifndef QT_NO_CONTEXTMENU
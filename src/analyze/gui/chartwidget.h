@@ -64,6 +64,7 @@ public:
 
 public slots:
     void modelReset();
+    void modelRowsInserted();
 protected:
 #ifndef QT_NO_CONTEXTMENU
     virtual void contextMenuEvent(QContextMenuEvent *event) override;
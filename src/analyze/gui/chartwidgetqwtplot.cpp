@@ -205,8 +205,7 @@ void ChartWidgetQwtPlot::rebuild(bool resetZoomAndPan)
 
         auto adapter = new ChartModel2QwtSeriesData(m_model, column);
 
-        QRectF bounds = adapter->boundingRect();
-        qint64 maxCost = bounds.bottom();
+        qint64 maxCost = m_model->getMaxCost(column);
 
         QString titleEnd = QString(" (max=<b>%1</b>)").arg(m_isSizeModel
             ? Util::formatByteSize(maxCost) : QString::number(maxCost));
@@ -268,6 +267,7 @@ void ChartWidgetQwtPlot::rebuild(bool resetZoomAndPan)
             // Ctrl+LeftButton: zoom out to full size
             m_zoomer->setMousePattern(QwtEventPattern::MouseSelect2, Qt::LeftButton, Qt::ControlModifier);
             m_zoomer->setMousePattern(QwtEventPattern::MouseSelect3, Qt::LeftButton, Qt::ShiftModifier);
+            QObject::connect(m_zoomer, &QwtPlotZoomer::zoomed, this, [this]() { updateTimeRange(); });
         }
 
         if (!m_panner)
@@ -275,6 +275,8 @@ void ChartWidgetQwtPlot::rebuild(bool resetZoomAndPan)
             m_panner = new QwtPlotPanner(canvas());
             // Alt+LeftButton for panning
             m_panner->setMouseButton(Qt::LeftButton, Qt::AltModifier);
+            // QwtPlotPanner moves the axes in its own slot, which is connected first
+            QObject::connect(m_panner, &QwtPanner::panned, this, [this]() { updateTimeRange(); });
         }
     }
     else
@@ -347,6 +349,18 @@ void ChartWidgetQwtPlot::resetZoom()
     {
         replot();
     }
+    updateTimeRange();
+}
+
+void ChartWidgetQwtPlot::updateTimeRange()
+{
+    if (!m_model)
+    {
+        return;
+    }
+    // when the rows change, the model is reset and ChartWidget rebuilds the curves
+    const QwtScaleDiv& timeScale = axisScaleDiv(QwtPlot::xBottom);
+    m_model->setTimeRange(timeScale.lowerBound(), timeScale.upperBound());
 }
 
 bool ChartWidgetQwtPlot::getCurveTooltip(const QPointF &position, QString &tooltip) const
@@ -69,6 +69,9 @@ public:
 
     void resetZoom();
 
+    // let the model show the rows of the visible time range in as much detail as it has
+    void updateTimeRange();
+
     bool getCurveTooltip(const QPointF &position, QString &tooltip) const;
 
 private:
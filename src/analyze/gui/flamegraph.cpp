@@ -18,8 +18,11 @@
 
 #include "flamegraph.h"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
+#include <QAbstractScrollArea>
 #include <QAction>
 #include <QApplication>
 #include <QCheckBox>
@@ -28,15 +31,16 @@
 #include <QDebug>
 #include <QDoubleSpinBox>
 #include <QEvent>
-#include <QGraphicsRectItem>
-#include <QGraphicsScene>
-#include <QGraphicsView>
+#include <QHash>
 #include <QLabel>
-#include <QStyleOption>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScrollBar>
 #include <QToolTip>
 #include <QVBoxLayout>
 #include <QWheelEvent>
 #include <QLineEdit>
+#include <QSignalBlocker>
 
 #ifdef NO_K_LIB
 #include "noklib.h"
@@ -44,7 +48,6 @@
 #include <threadweaver.h>
 #endif // THREAD_WEAVER
 #else
-#include <KColorScheme>
 #include <KLocalizedString>
 #include <KStandardAction>
 #include <ThreadWeaver/ThreadWeaver>
@@ -52,8 +55,6 @@
 
 #include "util.h"
 
-//#define DEBUG_MAX_DEPTH // to investigate which flame graph depth is safe (i.e. doesn't cause stack overflow)
-
 enum CostType
 {
     Allocations,
@@ -78,582 +79,637 @@ enum SearchMatchType
     DirectMatch,
     ChildMatch
 };
-}
-
-class FrameGraphicsItem : public QGraphicsRectItem
-{
-public:
-    FrameGraphicsItem(const qint64 cost, CostType costType, const QString& function, AllocationData::CoreCLRType type,
-                      FrameGraphicsItem* parent = nullptr);
-    FrameGraphicsItem(const qint64 cost, const QString& function, AllocationData::CoreCLRType type, FrameGraphicsItem* parent);
-
-    qint64 cost() const;
-    void setCost(qint64 cost);
-    QString function() const;
-
-    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
-
-    QString description() const;
-    void setSearchMatchType(SearchMatchType matchType);
-
-protected:
-    void hoverEnterEvent(QGraphicsSceneHoverEvent* event) override;
-    void hoverLeaveEvent(QGraphicsSceneHoverEvent* event) override;
-
-private:
-    qint64 m_cost;
-    QString m_function;
-    CostType m_costType;
-    bool m_isHovered;
-    SearchMatchType m_searchMatch = NoSearch;
-    AllocationData::CoreCLRType stackType;
-};
-
-Q_DECLARE_METATYPE(FrameGraphicsItem*)
 
-FrameGraphicsItem::FrameGraphicsItem(const qint64 cost, CostType costType, const QString& function,
-                                     AllocationData::CoreCLRType type, FrameGraphicsItem* parent)
-    : QGraphicsRectItem(parent)
-    , m_cost(cost)
-    , m_function(function)
-    , m_costType(costType)
-    , m_isHovered(false)
-    , stackType (type)
-{
-    setFlag(QGraphicsItem::ItemIsSelectable);
-    setAcceptHoverEvents(true);
-}
+const int NUM_BRUSHES = 100;
 
-FrameGraphicsItem::FrameGraphicsItem(const qint64 cost, const QString& function, AllocationData::CoreCLRType type,
-                                     FrameGraphicsItem* parent)
-    : FrameGraphicsItem(cost, parent->m_costType, function, type, parent)
+/**
+ * @return the brushes for frames of the given stack type, the CoreCLR ones use the
+ * "mem" color space of upstream FlameGraph.pl
+ */
+const QVector<QBrush>& brushes(AllocationData::CoreCLRType type)
 {
-}
+    // intern the brushes, to reuse them across frames which can be thousands
+    // otherwise we'd end up with dozens of allocations and higher memory
+    // consumption
+    auto generate = [](QColor (*color)()) {
+        QVector<QBrush> brushes;
+        std::generate_n(std::back_inserter(brushes), NUM_BRUSHES, color);
+        return brushes;
+    };
+    static const QVector<QBrush> coreclr = generate([]() {
+        return QColor(220, 100 + 50 * qreal(rand()) / RAND_MAX, 200 + 50 * qreal(rand()) / RAND_MAX, 125);
+    });
+    static const QVector<QBrush> noncoreclr = generate([]() {
+        return QColor(0, 190 + 50 * qreal(rand()) / RAND_MAX, 210 * qreal(rand()) / RAND_MAX, 125);
+    });
+    static const QVector<QBrush> untracked =
+        generate([]() { return QColor(50, 50, 50 + 50 * qreal(rand()) / RAND_MAX, 125); });
+    static const QVector<QBrush> unknown =
+        generate([]() { return QColor(50 + 50 * qreal(rand()) / RAND_MAX, 50, 50, 125); });
 
-qint64 FrameGraphicsItem::cost() const
-{
-    return m_cost;
+    switch (type) {
+    case AllocationData::CoreCLRType::CoreCLR:
+        return coreclr;
+    case AllocationData::CoreCLRType::nonCoreCLR:
+        return noncoreclr;
+    case AllocationData::CoreCLRType::untracked:
+        return untracked;
+    case AllocationData::CoreCLRType::unknown:
+        break;
+    }
+    return unknown;
 }
-
-void FrameGraphicsItem::setCost(qint64 cost)
-{
-    m_cost = cost;
 }
 
-QString FrameGraphicsItem::function() const
+/**
+ * The frames of a flame graph in breadth-first order, i.e. the frames of a depth are
+ * next to each other and so are the children of a frame. The first frame is the root.
+ */
+struct FlameGraphData
 {
-    return m_function;
-}
+    struct Frame
+    {
+        QString function;
+        // one of the locations of the function, none for the root
+        LocationData::Ptr location;
+        qint64 cost = 0;
+        int parent = -1;
+        int depth = 0;
+        int firstChild = 0;
+        int numChildren = 0;
+        AllocationData::CoreCLRType stackType = AllocationData::CoreCLRType::nonCoreCLR;
+        // index into the brushes of the stack type
+        int brush = 0;
+    };
+
+    QVector<Frame> frames;
+    CostType costType = Peak;
+};
+Q_DECLARE_METATYPE(FlameGraphData*)
 
-void FrameGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* /*widget*/)
+/**
+ * The items that are visible when a frame is shown at a given width. The frame and its
+ * parents span the whole width, the frames below it are as wide as their share of the
+ * cost. Consecutive siblings narrower than a pixel are merged into one item, which is
+ * left out as well when it is still too narrow.
+ */
+struct FlameGraphLayout
 {
-    if (isSelected() || m_isHovered || m_searchMatch == DirectMatch) {
-        auto selectedColor = brush().color();
-        selectedColor.setAlpha(255);
-        painter->fillRect(rect(), selectedColor);
-    } else if (m_searchMatch == NoMatch) {
-        auto noMatchColor = brush().color();
-        noMatchColor.setAlpha(50);
-        painter->fillRect(rect(), noMatchColor);
-    } else { // default, when no search is running, or a sub-item is matched
-        painter->fillRect(rect(), brush());
-    }
-
-    const QPen oldPen = painter->pen();
-    auto pen = oldPen;
-    if (m_searchMatch != NoMatch) {
-        pen.setColor(brush().color());
-        if (isSelected()) {
-            pen.setWidth(2);
-        }
-        painter->setPen(pen);
-        painter->drawRect(rect());
-        painter->setPen(oldPen);
-    }
-
-    const int margin = 4;
-    const int width = rect().width() - 2 * margin;
-    if (width < option->fontMetrics.averageCharWidth() * 6) {
-        // text is too wide for the current LOD, don't paint it
-        return;
-    }
-
-    if (m_searchMatch == NoMatch) {
-        auto color = oldPen.color();
-        color.setAlpha(125);
-        pen.setColor(color);
-        painter->setPen(pen);
-    }
+    struct Item
+    {
+        // the frame, or the first of the merged frames
+        int frame;
+        int depth;
+        qreal x;
+        qreal width;
+        // number of merged frames, zero for an item that shows a single frame
+        int numMerged;
+        qint64 mergedCost;
+    };
+
+    // ordered by depth and then by x
+    QVector<Item> items;
+    // the index of the first item of each depth, and the end of the items
+    QVector<int> depthBegins;
+    int frame = 0;
+    int generation = 0;
+};
+Q_DECLARE_METATYPE(FlameGraphLayout*)
 
-    const int height = rect().height();
-    painter->drawText(margin + rect().x(), rect().y(), width, height, Qt::AlignVCenter | Qt::AlignLeft | Qt::TextSingleLine,
-                      option->fontMetrics.elidedText(m_function, Qt::ElideRight, width));
+namespace {
 
-    if (m_searchMatch == NoMatch) {
-        painter->setPen(oldPen);
+int64_t AllocationData::Stats::*memberForType(CostType type)
+{
+    switch (type) {
+    case Allocations:
+        return &AllocationData::Stats::allocations;
+    case Temporary:
+        return &AllocationData::Stats::temporary;
+    case Peak:
+        return &AllocationData::Stats::peak;
+    case PeakInstances:
+        return &AllocationData::Stats::peak_instances;
+    case Leaked:
+        return &AllocationData::Stats::leaked;
+    case Allocated:
+        return &AllocationData::Stats::allocated;
     }
+    Q_UNREACHABLE();
 }
 
-void FrameGraphicsItem::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
+QString formatCost(qint64 cost, CostType type)
 {
-    QGraphicsRectItem::hoverEnterEvent(event);
-    m_isHovered = true;
-    update();
+    switch (type) {
+    case Peak:
+    case Leaked:
+    case Allocated:
+        return Util::formatByteSize(cost, 1);
+    case Allocations:
+    case Temporary:
+    case PeakInstances:
+        break;
+    }
+    return QString::number(cost);
 }
 
-void FrameGraphicsItem::hoverLeaveEvent(QGraphicsSceneHoverEvent* event)
+/**
+ * Convert the top-down graph into the frames of a flame graph. The rows of a function below
+ * the same frame are merged, and the children of a frame are only added when its cost is
+ * above @p costThreshold in percent of the total cost.
+ *
+ * This works breadth-first on the frames, so deep graphs don't overflow the stack.
+ */
+FlameGraphData* parseData(const TreeData& topDownData, CostType type, double costThreshold, bool collapseRecursion)
 {
-    QGraphicsRectItem::hoverLeaveEvent(event);
-    m_isHovered = false;
-    update();
-}
+    auto member = memberForType(type);
 
-QString FrameGraphicsItem::description() const
-{
-    // we build the tooltip text on demand, which is much faster than doing that
-    // for potentially thousands of items when we load the data
-    QString tooltip;
-    qint64 totalCost = 0;
-    {
-        auto item = this;
-        while (item->parentItem()) {
-            item = static_cast<const FrameGraphicsItem*>(item->parentItem());
-        }
-        totalCost = item->cost();
-    }
-    const auto fraction = QString::number(double(m_cost) * 100. / totalCost, 'g', 3);
-    const auto function = m_function;
-    if (!parentItem()) {
-        return function;
+    double totalCost = 0;
+    foreach (const auto& frame, topDownData) {
+        totalCost += frame.cost.*member;
     }
 
-    switch (m_costType) {
+    QString label;
+    switch (type) {
     case Allocations:
-        tooltip = i18nc("%1: number of allocations, %2: relative number, %3: function label",
-                        "%1 (%2%) allocations in %3 and below.", m_cost, fraction, function);
+        label = i18n("%1 allocations in total", totalCost);
         break;
     case Temporary:
-        tooltip = i18nc("%1: number of temporary allocations, %2: relative number, "
-                        "%3 function label",
-                        "%1 (%2%) temporary allocations in %3 and below.", m_cost, fraction, function);
+        label = i18n("%1 temporary allocations in total", totalCost);
         break;
     case Peak:
-        tooltip =
-            i18nc("%1: peak consumption in bytes, %2: relative number, %3: "
-                  "function label",
-                  "%1 (%2%) contribution to peak consumption in %3 and below.",
-                  Util::formatByteSize(m_cost, 1), fraction, function);
+        label = i18n("%1 contribution to peak consumption", Util::formatByteSize(totalCost, 1));
         break;
     case PeakInstances:
-        tooltip =
-            i18nc("%1: peak number of instances, %2: relative number, %3: "
-                  "function label",
-                  "%1 (%2%) contribution to peak number of instances in %3 and below.",
-                  m_cost, fraction, function);
+        label = i18n("%1 contribution to peak number of instances", totalCost);
         break;
     case Leaked:
-        tooltip = i18nc("%1: leaked bytes, %2: relative number, %3: function label", "%1 (%2%) leaked in %3 and below.",
-                        Util::formatByteSize(m_cost, 1), fraction, function);
+        label = i18n("%1 leaked in total", Util::formatByteSize(totalCost, 1));
         break;
     case Allocated:
-        tooltip = i18nc("%1: allocated bytes, %2: relative number, %3: function label",
-                        "%1 (%2%) allocated in %3 and below.",
-                        Util::formatByteSize(m_cost, 1), fraction, function);
+        label = i18n("%1 allocated in total", Util::formatByteSize(totalCost, 1));
         break;
     }
 
-    return tooltip;
-}
-
-void FrameGraphicsItem::setSearchMatchType(SearchMatchType matchType)
-{
-    if (m_searchMatch != matchType) {
-        m_searchMatch = matchType;
-        update();
+    auto data = new FlameGraphData;
+    data->costType = type;
+    auto& frames = data->frames;
+    FlameGraphData::Frame root;
+    root.function = label;
+    root.cost = totalCost;
+    frames.push_back(root);
+
+    const auto minCost = totalCost * costThreshold / 100;
+    // the rows whose children are merged into the children of a frame
+    std::vector<std::vector<const TreeData*>> frameRows = {{&topDownData}};
+    QHash<QString, int> children;
+    for (int i = 0; i < frames.size(); ++i) {
+        if (i > 0 && frames[i].cost <= minCost) {
+            continue;
+        }
+        const auto function = frames[i].function;
+        const auto depth = frames[i].depth + 1;
+        const int firstChild = frames.size();
+        children.clear();
+        // frameRows grows below
+        const auto rowsOfFrame = std::move(frameRows[i]);
+        for (const auto rows : rowsOfFrame) {
+            for (const auto& row : *rows) {
+                const auto& rowFunction = row.location->function;
+                if (collapseRecursion && rowFunction != unresolvedFunctionName()
+                    && rowFunction != untrackedFunctionName() && rowFunction == function) {
+                    continue;
+                }
+                auto it = children.constFind(rowFunction);
+                int child;
+                if (it == children.constEnd()) {
+                    child = frames.size();
+                    children.insert(rowFunction, child);
+                    FlameGraphData::Frame frame;
+                    frame.function = rowFunction;
+                    frame.location = row.location;
+                    frame.parent = i;
+                    frame.depth = depth;
+                    frame.stackType = row.stackType;
+                    frame.brush = rand() % NUM_BRUSHES;
+                    frames.push_back(frame);
+                    frameRows.emplace_back();
+                } else {
+                    child = *it;
+                }
+                frames[child].cost += row.cost.*member;
+                if (!row.children.isEmpty()) {
+                    frameRows[child].push_back(&row.children);
+                }
+            }
+        }
+        frames[i].firstChild = firstChild;
+        frames[i].numChildren = frames.size() - firstChild;
     }
+    return data;
 }
 
-namespace {
-
 /**
- * Generate a brush from the "mem" color space used in upstream FlameGraph.pl
+ * Lay out the frames that are visible when @p frame is shown at the given @p width.
  */
-QBrush brush_coreclr()
+FlameGraphLayout* layoutFrames(const FlameGraphData& data, int frame, qreal width, int generation)
 {
-    // intern the brushes, to reuse them across items which can be thousands
-    // otherwise we'd end up with dozens of allocations and higher memory
-    // consumption
-    static const QVector<QBrush> brushes = []() -> QVector<QBrush> {
-        QVector<QBrush> brushes;
-        std::generate_n(std::back_inserter(brushes), 100, []() {
-            return QColor(220, 100 + 50 * qreal(rand()) / RAND_MAX, 200 + 50 * qreal(rand()) / RAND_MAX, 125);
-        });
-        return brushes;
-    }();
-    return brushes.at(rand() % brushes.size());
+    auto layout = new FlameGraphLayout;
+    layout->frame = frame;
+    layout->generation = generation;
+    auto& items = layout->items;
+    const auto& frames = data.frames;
+
+    for (int parent = frames[frame].parent; parent != -1; parent = frames[parent].parent) {
+        items.push_back({parent, frames[parent].depth, 0, width, 0, 0});
+    }
+    std::reverse(items.begin(), items.end());
+    items.push_back({frame, frames[frame].depth, 0, width, 0, 0});
+
+    // the children are appended breadth-first, which keeps the items ordered
+    for (int i = items.size() - 1; i < items.size(); ++i) {
+        const auto item = items[i];
+        const auto& parent = frames[item.frame];
+        if (item.numMerged || !parent.cost) {
+            continue;
+        }
+        FlameGraphLayout::Item merged = {0, item.depth + 1, 0, 0, 0, 0};
+        auto addMerged = [&]() {
+            if (merged.width > 1) {
+                items.push_back(merged);
+            }
+            merged.numMerged = 0;
+            merged.mergedCost = 0;
+            merged.width = 0;
+        };
+        qreal x = item.x;
+        for (int child = parent.firstChild; child < parent.firstChild + parent.numChildren; ++child) {
+            const qreal w = item.width * double(frames[child].cost) / parent.cost;
+            if (w > 1) {
+                addMerged();
+                items.push_back({child, item.depth + 1, x, w, 0, 0});
+            } else {
+                if (!merged.numMerged) {
+                    merged.frame = child;
+                    merged.x = x;
+                }
+                ++merged.numMerged;
+                merged.mergedCost += frames[child].cost;
+                merged.width += w;
+            }
+            x += w;
+        }
+        addMerged();
+    }
+
+    for (int i = 0; i < items.size(); ++i) {
+        while (layout->depthBegins.size() <= items[i].depth) {
+            layout->depthBegins.push_back(i);
+        }
+    }
+    layout->depthBegins.push_back(items.size());
+    return layout;
 }
 
-QBrush brush_noncoreclr()
+QString description(const FlameGraphData& data, int frame)
 {
-    // intern the brushes, to reuse them across items which can be thousands
-    // otherwise we'd end up with dozens of allocations and higher memory
-    // consumption
-    static const QVector<QBrush> brushes = []() -> QVector<QBrush> {
-        QVector<QBrush> brushes;
-        std::generate_n(std::back_inserter(brushes), 100, []() {
-            return QColor(0, 190 + 50 * qreal(rand()) / RAND_MAX, 210 * qreal(rand()) / RAND_MAX, 125);
-        });
-        return brushes;
-    }();
-    return brushes.at(rand() % brushes.size());
+    // we build the tooltip text on demand, which is much faster than doing that
+    // for potentially thousands of frames when we load the data
+    const auto& frames = data.frames;
+    const auto cost = frames[frame].cost;
+    const auto function = frames[frame].function;
+    if (!frame) {
+        return function;
+    }
+    const auto fraction = QString::number(double(cost) * 100. / frames.first().cost, 'g', 3);
+
+    switch (data.costType) {
+    case Allocations:
+        return i18nc("%1: number of allocations, %2: relative number, %3: function label",
+                     "%1 (%2%) allocations in %3 and below.", cost, fraction, function);
+    case Temporary:
+        return i18nc("%1: number of temporary allocations, %2: relative number, "
+                     "%3 function label",
+                     "%1 (%2%) temporary allocations in %3 and below.", cost, fraction, function);
+    case Peak:
+        return i18nc("%1: peak consumption in bytes, %2: relative number, %3: "
+                     "function label",
+                     "%1 (%2%) contribution to peak consumption in %3 and below.",
+                     Util::formatByteSize(cost, 1), fraction, function);
+    case PeakInstances:
+        return i18nc("%1: peak number of instances, %2: relative number, %3: "
+                     "function label",
+                     "%1 (%2%) contribution to peak number of instances in %3 and below.", cost, fraction,
+                     function);
+    case Leaked:
+        return i18nc("%1: leaked bytes, %2: relative number, %3: function label", "%1 (%2%) leaked in %3 and below.",
+                     Util::formatByteSize(cost, 1), fraction, function);
+    case Allocated:
+        return i18nc("%1: allocated bytes, %2: relative number, %3: function label",
+                     "%1 (%2%) allocated in %3 and below.", Util::formatByteSize(cost, 1), fraction, function);
+    }
+    return {};
 }
 
-QBrush brush_untracked()
+QString description(const FlameGraphData& data, const FlameGraphLayout::Item& item)
 {
-    // intern the brushes, to reuse them across items which can be thousands
-    // otherwise we'd end up with dozens of allocations and higher memory
-    // consumption
-    static const QVector<QBrush> brushes = []() -> QVector<QBrush> {
-        QVector<QBrush> brushes;
-        std::generate_n(std::back_inserter(brushes), 100, []() {
-            return QColor(50, 50, 50 + 50 * qreal(rand()) / RAND_MAX, 125);
-        });
-        return brushes;
-    }();
-    return brushes.at(rand() % brushes.size());
+    if (!item.numMerged) {
+        return description(data, item.frame);
+    }
+    return i18nc("%1: cost, %2: relative number, %3: number of functions",
+                 "%1 (%2%) in %3 functions that are too small to show.", formatCost(item.mergedCost, data.costType),
+                 fraction(item.mergedCost, data.frames.first().cost), item.numMerged);
 }
 
-QBrush brush_unknown()
+struct SearchResults
 {
-    // intern the brushes, to reuse them across items which can be thousands
-    // otherwise we'd end up with dozens of allocations and higher memory
-    // consumption
-    static const QVector<QBrush> brushes = []() -> QVector<QBrush> {
-        QVector<QBrush> brushes;
-        std::generate_n(std::back_inserter(brushes), 100, []() {
-            return QColor(50 + 50 * qreal(rand()) / RAND_MAX, 50, 50, 125);
-        });
-        return brushes;
-    }();
-    return brushes.at(rand() % brushes.size());
-}
+    SearchMatchType matchType = NoMatch;
+    qint64 directCost = 0;
+};
 
 /**
- * Layout the flame graph and hide tiny items.
+ * Match all frames against @p searchValue, which is the function filter of @p filter. A frame
+ * whose function doesn't match is a child match when a frame below it matches.
  */
-void layoutItems(FrameGraphicsItem* parent)
+SearchResults applySearch(const FlameGraphData& data, const LocationFilter& filter, const QString& searchValue,
+                          QVector<SearchMatchType>* matches)
 {
-    const auto& parentRect = parent->rect();
-    const auto pos = parentRect.topLeft();
-    const qreal maxWidth = parentRect.width();
-    const qreal h = parentRect.height();
-    const qreal y_margin = 2.;
-    const qreal y = pos.y() - h - y_margin;
-    qreal x = pos.x();
-
-    foreach (auto child, parent->childItems()) {
-        auto frameChild = static_cast<FrameGraphicsItem*>(child);
-        const qreal w = maxWidth * double(frameChild->cost()) / parent->cost();
-        frameChild->setVisible(w > 1);
-        if (frameChild->isVisible()) {
-            frameChild->setRect(QRectF(x, y, w, h));
-            layoutItems(frameChild);
-            x += w;
-        }
+    const auto& frames = data.frames;
+    if (searchValue.isEmpty()) {
+        matches->fill(NoSearch, frames.size());
+        return {NoSearch, 0};
     }
-}
 
-FrameGraphicsItem* findItemByFunction(const QList<QGraphicsItem*>& items, const QString& function)
-{
-    foreach (auto item_, items) {
-        auto item = static_cast<FrameGraphicsItem*>(item_);
-        if (item->function() == function) {
-            return item;
+    matches->fill(NoMatch, frames.size());
+    QVector<qint64> directCosts(frames.size(), 0);
+    // the children come after their parent, so walking backwards visits them first
+    for (int i = frames.size() - 1; i >= 0; --i) {
+        const auto& frame = frames[i];
+        const bool isMatch = frame.location ? filter.matches(*frame.location)
+                                            : frame.function.contains(searchValue, Qt::CaseInsensitive);
+        if (isMatch) {
+            (*matches)[i] = DirectMatch;
+            directCosts[i] = frame.cost;
+            continue;
+        }
+        for (int child = frame.firstChild; child < frame.firstChild + frame.numChildren; ++child) {
+            if (matches->at(child) != NoMatch) {
+                (*matches)[i] = ChildMatch;
+                directCosts[i] += directCosts[child];
+            }
         }
     }
-    return nullptr;
+    return {matches->first(), directCosts.first()};
+}
+
 }
 
 /**
- * Convert the top-down graph into a tree of FrameGraphicsItem.
+ * Paints a FlameGraphLayout with the root at the bottom.
  */
-struct ToGraphicsItemsContext
+class FlameGraphView : public QAbstractScrollArea
 {
-    int64_t AllocationData::Stats::*member;
-    double costThreshold;
-    bool collapseRecursion;
-    int depth = 0;
-};
+public:
+    explicit FlameGraphView(QWidget* parent)
+        : QAbstractScrollArea(parent)
+    {
+        setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    }
 
-static const int MaxRecursionDepth = 600; // 800: crashes
-#ifdef DEBUG_MAX_DEPTH
-static int maxDepthReached;
-static int lastMaxDepthReached;
-#endif
+    void setData(const std::shared_ptr<const FlameGraphData>& data, const QString& message)
+    {
+        m_data = data;
+        m_message = message;
+        m_layout.reset();
+        m_searchMatches.clear();
+        m_hoveredItem = -1;
+        updateScrollBar();
+        viewport()->update();
+    }
 
-// returns 'true' if flame graph was created completely, returns 'false' if its depth was limited by
-bool toGraphicsItems(const QVector<RowData>& data, ToGraphicsItemsContext& context, FrameGraphicsItem* parent);
+    void setFrameLayout(std::unique_ptr<FlameGraphLayout> layout)
+    {
+        m_layout = std::move(layout);
+        m_hoveredItem = -1;
+        updateScrollBar();
+
+        // center on the shown frame
+        const int depth = m_data->frames[m_layout->frame].depth;
+        const int top = contentBottom() - (depth + 1) * rowDistance();
+        verticalScrollBar()->setValue(top - (viewport()->height() - rowHeight()) / 2);
+        viewport()->update();
+    }
 
-bool toGraphicsItems(const QVector<RowData>& data, FrameGraphicsItem* parent, int64_t AllocationData::Stats::*member,
-                     const double costThreshold, bool collapseRecursion)
-{
-    // pack parameters to a structure to remove stack usage during recursion
-    ToGraphicsItemsContext ctx;
-    ctx.member = member;
-    ctx.costThreshold = costThreshold;
-    ctx.collapseRecursion = collapseRecursion;
-#ifdef DEBUG_MAX_DEPTH
-    maxDepthReached = 0;
-    lastMaxDepthReached = 0;
-#endif
-    bool result = toGraphicsItems(data, ctx, parent);
-#ifdef DEBUG_MAX_DEPTH
-    qDebug() << "Max flame graph depth: " << maxDepthReached;
-    if (!result)
+    const FlameGraphLayout* frameLayout() const
     {
-        qDebug() << ". Flame graph depth limited to " << MaxRecursionDepth;
+        return m_layout.get();
     }
-#endif
-    return result;
-}
 
-bool toGraphicsItems(const QVector<RowData>& data, ToGraphicsItemsContext& context, FrameGraphicsItem* parent)
-{
-    bool result = true;
-    foreach (const auto& row, data) {
-        if (context.collapseRecursion
-            && row.location->function != unresolvedFunctionName()
-            && row.location->function != untrackedFunctionName()
-            && row.location->function == parent->function())
-        {
-            continue;
+    void setSearchMatches(const QVector<SearchMatchType>& matches)
+    {
+        m_searchMatches = matches;
+        viewport()->update();
+    }
+
+    void setHoveredItem(int item)
+    {
+        if (m_hoveredItem != item) {
+            m_hoveredItem = item;
+            viewport()->update();
         }
-        auto item = findItemByFunction(parent->childItems(), row.location->function);
-        if (!item) {
-            AllocationData::CoreCLRType clrType = row.stackType;
-            item = new FrameGraphicsItem(row.cost.*context.member, row.location->function, clrType, parent);
-            item->setPen(parent->pen());
+    }
 
-            switch (clrType)
-            {
-                case AllocationData::CoreCLRType::CoreCLR:
-                {
-                    item->setBrush(brush_coreclr());
-                    break;
-                }
-                case AllocationData::CoreCLRType::nonCoreCLR:
-                {
-                    item->setBrush(brush_noncoreclr());
-                    break;
-                }
-                case AllocationData::CoreCLRType::untracked:
-                {
-                    item->setBrush(brush_untracked());
-                    break;
-                }
-                case AllocationData::CoreCLRType::unknown:
-                {
-                    item->setBrush(brush_unknown());
-                    break;
-                }
-                default:
-                {
-                    assert(0);
-                }
-            }
-        } else {
-            item->setCost(item->cost() + row.cost.*context.member);
+    // the width of the root frame
+    qreal layoutWidth() const
+    {
+        return std::max(1, viewport()->width() - 2 * MARGIN);
+    }
+
+    /// @return the index of the layout item at @p pos in viewport coordinates, or -1
+    int itemAt(const QPoint& pos) const
+    {
+        if (!m_layout) {
+            return -1;
+        }
+        const int bottom = contentBottom() - verticalScrollBar()->value();
+        if (pos.y() >= bottom) {
+            return -1;
+        }
+        const int depth = (bottom - pos.y() - 1) / rowDistance();
+        if (depth + 1 >= m_layout->depthBegins.size() || pos.y() >= rowY(depth) + rowHeight()) {
+            return -1;
         }
-        if (item->cost() > context.costThreshold) {
-            ++context.depth;
+        const auto& items = m_layout->items;
+        const auto begin = items.begin() + m_layout->depthBegins[depth];
+        const auto end = items.begin() + m_layout->depthBegins[depth + 1];
+        const qreal x = pos.x() - MARGIN;
+        auto it = std::upper_bound(begin, end, x,
+                                   [](qreal lhs, const FlameGraphLayout::Item& rhs) { return lhs < rhs.x; });
+        if (it == begin || x >= (it - 1)->x + (it - 1)->width) {
+            return -1;
+        }
+        return it - 1 - items.begin();
+    }
 
-            if (!row.children.isEmpty())
-            {
-                if (context.depth <= MaxRecursionDepth)
-                {
-#ifdef DEBUG_MAX_DEPTH
-                    if (context.depth > maxDepthReached)
-                    {
-                        maxDepthReached = context.depth;
-                        if (maxDepthReached - lastMaxDepthReached >= 100)
-                        {
-                            lastMaxDepthReached = maxDepthReached;
-                            qDebug() << "Depth: " << maxDepthReached;
-                        }
-                    }
-#endif
-                    if (!toGraphicsItems(row.children, context, item))
-                    {
-                        result = false;
-                    }
-                }
-                else
-                {
-                    result = false;
+protected:
+    void paintEvent(QPaintEvent* event) override
+    {
+        QPainter painter(viewport());
+        if (!m_layout) {
+            painter.drawText(viewport()->rect(), Qt::AlignCenter, m_message);
+            return;
+        }
+
+        const auto exposed = event->rect();
+        const auto& depthBegins = m_layout->depthBegins;
+        for (int depth = 0; depth + 1 < depthBegins.size(); ++depth) {
+            const int y = rowY(depth);
+            if (y > exposed.bottom() || y + rowHeight() <= exposed.top()) {
+                continue;
+            }
+            for (int i = depthBegins[depth]; i < depthBegins[depth + 1]; ++i) {
+                const auto& item = m_layout->items[i];
+                const QRectF rect(MARGIN + item.x, y, item.width, rowHeight());
+                if (rect.right() >= exposed.left() && rect.left() <= exposed.right()) {
+                    paintItem(&painter, item, rect, i == m_hoveredItem);
                 }
             }
-            --context.depth;
         }
     }
-    return result;
-}
 
-int64_t AllocationData::Stats::*memberForType(CostType type)
-{
-    switch (type) {
-    case Allocations:
-        return &AllocationData::Stats::allocations;
-    case Temporary:
-        return &AllocationData::Stats::temporary;
-    case Peak:
-        return &AllocationData::Stats::peak;
-    case PeakInstances:
-        return &AllocationData::Stats::peak_instances;
-    case Leaked:
-        return &AllocationData::Stats::leaked;
-    case Allocated:
-        return &AllocationData::Stats::allocated;
+    void resizeEvent(QResizeEvent* event) override
+    {
+        QAbstractScrollArea::resizeEvent(event);
+        updateScrollBar();
     }
-    Q_UNREACHABLE();
-}
 
-FrameGraphicsItem* parseData(const QVector<RowData>& topDownData, CostType type, double costThreshold,
-                             bool collapseRecursion, bool& depthLimited)
-{
-    depthLimited = false;
+private:
+    enum
+    {
+        MARGIN = 20
+    };
 
-    auto member = memberForType(type);
+    void paintItem(QPainter* painter, const FlameGraphLayout::Item& item, const QRectF& rect, bool isHovered) const
+    {
+        const auto& frame = m_data->frames[item.frame];
+        const bool isSelected = !item.numMerged && item.frame == m_layout->frame;
+
+        QColor color;
+        if (item.numMerged) {
+            color = palette().color(QPalette::Mid);
+            color.setAlpha(125);
+        } else if (!item.frame) {
+            color = palette().color(QPalette::Window);
+        } else {
+            color = brushes(frame.stackType).at(frame.brush).color();
+        }
 
-    double totalCost = 0;
-    foreach (const auto& frame, topDownData) {
-        totalCost += frame.cost.*member;
+        auto match = NoSearch;
+        if (!m_searchMatches.isEmpty() && !item.numMerged) {
+            match = m_searchMatches.at(item.frame);
+        } else if (!m_searchMatches.isEmpty()) {
+            // merged frames are highlighted like a parent when one of them matches
+            match = NoMatch;
+            for (int i = item.frame; i < item.frame + item.numMerged && match == NoMatch; ++i) {
+                match = m_searchMatches.at(i) == NoMatch ? NoMatch : ChildMatch;
+            }
+        }
+
+        if (isSelected || isHovered || match == DirectMatch) {
+            auto selectedColor = color;
+            selectedColor.setAlpha(255);
+            painter->fillRect(rect, selectedColor);
+        } else if (match == NoMatch) {
+            auto noMatchColor = color;
+            noMatchColor.setAlpha(50);
+            painter->fillRect(rect, noMatchColor);
+        } else { // default, when no search is running, or a sub-item is matched
+            painter->fillRect(rect, color);
+        }
+
+        QPen pen(palette().color(QPalette::WindowText));
+        if (match != NoMatch) {
+            QPen borderPen(color);
+            if (isSelected) {
+                borderPen.setWidth(2);
+            }
+            painter->setPen(borderPen);
+            painter->drawRect(rect);
+        }
+
+        const int margin = 4;
+        const int width = rect.width() - 2 * margin;
+        if (item.numMerged || width < fontMetrics().averageCharWidth() * 6) {
+            // text is too wide for the current LOD, don't paint it
+            return;
+        }
+
+        if (match == NoMatch) {
+            auto textColor = pen.color();
+            textColor.setAlpha(125);
+            pen.setColor(textColor);
+        }
+        painter->setPen(pen);
+        painter->drawText(QRectF(rect.x() + margin, rect.y(), width, rect.height()),
+                          Qt::AlignVCenter | Qt::AlignLeft | Qt::TextSingleLine,
+                          fontMetrics().elidedText(frame.function, Qt::ElideRight, width));
     }
 
-#ifdef NO_K_LIB
-    QPalette pal;
-    const QPen pen(pal.color(QPalette::Active, QPalette::Foreground));
-#else
-    KColorScheme scheme(QPalette::Active);
-    const QPen pen(scheme.foreground().color());
-#endif
+    int rowHeight() const
+    {
+        return fontMetrics().height() + 4;
+    }
 
-    QString label;
-    switch (type) {
-    case Allocations:
-        label = i18n("%1 allocations in total", totalCost);
-        break;
-    case Temporary:
-        label = i18n("%1 temporary allocations in total", totalCost);
-        break;
-    case Peak:
-        label = i18n("%1 contribution to peak consumption", Util::formatByteSize(totalCost, 1));
-        break;
-    case PeakInstances:
-        label = i18n("%1 contribution to peak number of instances", totalCost);
-        break;
-    case Leaked:
-        label = i18n("%1 leaked in total", Util::formatByteSize(totalCost, 1));
-        break;
-    case Allocated:
-        label = i18n("%1 allocated in total", Util::formatByteSize(totalCost, 1));
-        break;
+    int rowDistance() const
+    {
+        return rowHeight() + 2;
     }
-    auto rootItem = new FrameGraphicsItem(totalCost, type, label, AllocationData::CoreCLRType::nonCoreCLR);
-#ifdef NO_K_LIB
-    rootItem->setBrush(pal.color(QPalette::Active, QPalette::Background));
-#else
-    rootItem->setBrush(scheme.background());
-#endif
-    rootItem->setPen(pen);
-    depthLimited = !toGraphicsItems(topDownData, rootItem, member, totalCost * costThreshold / 100, collapseRecursion);
-    return rootItem;
-}
 
-struct SearchResults
-{
-    SearchMatchType matchType = NoMatch;
-    qint64 directCost = 0;
-};
+    int contentHeight() const
+    {
+        return m_layout ? (m_layout->depthBegins.size() - 1) * rowDistance() : 0;
+    }
 
-SearchResults applySearch(FrameGraphicsItem* item, const QString& searchValue)
-{
-    SearchResults result;
-    if (searchValue.isEmpty()) {
-        result.matchType = NoSearch;
-    } else if (item->function().contains(searchValue, Qt::CaseInsensitive)) {
-        result.directCost += item->cost();
-        result.matchType = DirectMatch;
+    // the root is at the bottom of the viewport when the graph is not as high
+    int contentBottom() const
+    {
+        return std::max(contentHeight(), viewport()->height());
     }
 
-    // recurse into the child items, we always need to update all items
-    for (auto* child : item->childItems()) {
-        auto* childFrame = static_cast<FrameGraphicsItem*>(child);
-        auto childMatch = applySearch(childFrame, searchValue);
-        if (result.matchType != DirectMatch &&
-            (childMatch.matchType == DirectMatch || childMatch.matchType == ChildMatch))
-        {
-            result.matchType = ChildMatch;
-            result.directCost += childMatch.directCost;
-        }
+    // the top of the items of @p depth in viewport coordinates
+    int rowY(int depth) const
+    {
+        return contentBottom() - verticalScrollBar()->value() - (depth + 1) * rowDistance();
     }
 
-    item->setSearchMatchType(result.matchType);
-    return result;
-}
+    void updateScrollBar()
+    {
+        verticalScrollBar()->setRange(0, std::max(0, contentHeight() - viewport()->height()));
+        verticalScrollBar()->setPageStep(viewport()->height());
+        verticalScrollBar()->setSingleStep(rowDistance());
+    }
 
-}
+    std::shared_ptr<const FlameGraphData> m_data;
+    std::unique_ptr<FlameGraphLayout> m_layout;
+    QVector<SearchMatchType> m_searchMatches;
+    QString m_message;
+    int m_hoveredItem = -1;
+};
 
 FlameGraph::FlameGraph(QWidget* parent, Qt::WindowFlags flags)
     : QWidget(parent, flags)
     , m_costSource(new QComboBox(this))
-    , m_scene(new QGraphicsScene(this))
-    , m_view(new QGraphicsView(this))
+    , m_view(new FlameGraphView(this))
     , m_displayLabel(new QLabel)
     , m_searchResultsLabel(new QLabel)
 {
-    qRegisterMetaType<FrameGraphicsItem*>();
-
-    m_costSource->addItem(i18n("Memory Peak"), QVariant::fromValue(Peak));
-    m_costSource->setItemData(0, i18n("Show a flame graph over the contributions to the peak heap "
-                                      "memory consumption of your application."),
-                              Qt::ToolTipRole);
-    m_costSource->addItem(i18n("Leaked"), QVariant::fromValue(Leaked));
-    m_costSource->setItemData(1, i18n("Show a flame graph over the leaked heap memory of your application. "
-                                      "Memory is considered to be leaked when it never got deallocated. "),
-                              Qt::ToolTipRole);
-    if(AllocationData::display == AllocationData::DisplayId::malloc
-       || AllocationData::display == AllocationData::DisplayId::managed)
-    {
-        m_costSource->addItem(i18n("Allocations"), QVariant::fromValue(Allocations));
-        m_costSource->setItemData(2, i18n("Show a flame graph over the number of allocations triggered by "
-                                          "functions in your code."),
-                                  Qt::ToolTipRole);
-        m_costSource->addItem(i18n("Allocated"), QVariant::fromValue(Allocated));
-        m_costSource->setItemData(4, i18n("Show a flame graph over the total memory allocated by functions in "
-                                          "your code. "
-                                          "This aggregates all memory allocations and ignores deallocations."),
-                                  Qt::ToolTipRole);
-        m_costSource->addItem(i18n("Peak number of instances"), QVariant::fromValue(PeakInstances));
-        m_costSource->setItemData(0, i18n("Show a flame graph over the contributions to number of instances "
-                                          "allocated from specific functions of your application."),
-                                  Qt::ToolTipRole);
-
-        if(AllocationData::display == AllocationData::DisplayId::malloc)
-        {
-            m_costSource->addItem(i18n("Temporary Allocations"), QVariant::fromValue(Temporary));
-            m_costSource->setItemData(3, i18n("Show a flame graph over the number of temporary allocations "
-                                              "triggered by functions in your code. "
-                                              "Allocations are marked as temporary when they are immediately "
-                                              "followed by their deallocation."),
-                                      Qt::ToolTipRole);
-        }
-    }
+    qRegisterMetaType<FlameGraphData*>();
+    qRegisterMetaType<FlameGraphLayout*>();
+
+    setDisplay(AllocationData::DisplayId::malloc);
     connect(m_costSource, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this,
             &FlameGraph::showData);
     m_costSource->setToolTip(i18n("Select the data source that should be visualized in the flame graph."));
 
-    m_scene->setItemIndexMethod(QGraphicsScene::NoIndex);
-    m_view->setScene(m_scene);
     m_view->viewport()->installEventFilter(this);
     m_view->viewport()->setMouseTracking(true);
     m_view->setFont(QFont(QStringLiteral("monospace")));
@@ -748,31 +804,35 @@ bool FlameGraph::eventFilter(QObject* object, QEvent* event)
 
     if (event->type() == QEvent::MouseButtonRelease) {
         QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
-        if (mouseEvent->button() == Qt::LeftButton) {
-            auto item = static_cast<FrameGraphicsItem*>(m_view->itemAt(mouseEvent->pos()));
-            if (item && item != m_selectionHistory.at(m_selectedItem)) {
-                selectItem(item);
+        const auto layout = m_view->frameLayout();
+        const auto item = m_view->itemAt(mouseEvent->pos());
+        if (mouseEvent->button() == Qt::LeftButton && item != -1 && !layout->items[item].numMerged) {
+            const auto frame = layout->items[item].frame;
+            if (frame != m_selectionHistory.at(m_selectedItem)) {
                 if (m_selectedItem != m_selectionHistory.size() - 1) {
                     m_selectionHistory.remove(m_selectedItem + 1, m_selectionHistory.size() - m_selectedItem - 1);
                 }
                 m_selectedItem = m_selectionHistory.size();
-                m_selectionHistory.push_back(item);
+                m_selectionHistory.push_back(frame);
                 updateNavigationActions();
+                showFrame(frame);
             }
         }
     } else if (event->type() == QEvent::MouseMove) {
         QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
-        auto item = static_cast<FrameGraphicsItem*>(m_view->itemAt(mouseEvent->pos()));
+        const auto item = m_view->itemAt(mouseEvent->pos());
+        m_view->setHoveredItem(item);
         setTooltipItem(item);
     } else if (event->type() == QEvent::Leave) {
-        setTooltipItem(nullptr);
+        m_view->setHoveredItem(-1);
+        setTooltipItem(-1);
     } else if (event->type() == QEvent::Resize || event->type() == QEvent::Show) {
-        if (!m_rootItem) {
-            if (!m_buildingScene) {
+        if (!m_data) {
+            if (!m_buildingData) {
                 showData();
             }
         } else {
-            selectItem(m_selectionHistory.at(m_selectedItem));
+            showFrame(m_selectionHistory.at(m_selectedItem));
         }
         updateTooltip();
     } else if (event->type() == QEvent::ToolTip) {
@@ -835,97 +895,131 @@ void FlameGraph::setBottomUpData(const TreeData& bottomUpData)
     m_bottomUpData = bottomUpData;
 }
 
+void FlameGraph::setDisplay(AllocationData::DisplayId display)
+{
+    const auto oldSource = m_costSource->currentData();
+    // only the data update triggered by the metric switch should rebuild the scene
+    QSignalBlocker blocker(m_costSource);
+    m_costSource->clear();
+
+    auto addCostSource = [this](const QString& text, CostType type, const QString& toolTip) {
+        m_costSource->addItem(text, QVariant::fromValue(type));
+        m_costSource->setItemData(m_costSource->count() - 1, toolTip, Qt::ToolTipRole);
+    };
+    addCostSource(i18n("Memory Peak"), Peak,
+                  i18n("Show a flame graph over the contributions to the peak heap "
+                       "memory consumption of your application."));
+    addCostSource(i18n("Leaked"), Leaked,
+                  i18n("Show a flame graph over the leaked heap memory of your application. "
+                       "Memory is considered to be leaked when it never got deallocated. "));
+    if (display == AllocationData::DisplayId::malloc || display == AllocationData::DisplayId::managed) {
+        addCostSource(i18n("Allocations"), Allocations,
+                      i18n("Show a flame graph over the number of allocations triggered by "
+                           "functions in your code."));
+        addCostSource(i18n("Allocated"), Allocated,
+                      i18n("Show a flame graph over the total memory allocated by functions in "
+                           "your code. "
+                           "This aggregates all memory allocations and ignores deallocations."));
+        addCostSource(i18n("Peak number of instances"), PeakInstances,
+                      i18n("Show a flame graph over the contributions to number of instances "
+                           "allocated from specific functions of your application."));
+
+        if (display == AllocationData::DisplayId::malloc) {
+            addCostSource(i18n("Temporary Allocations"), Temporary,
+                          i18n("Show a flame graph over the number of temporary allocations "
+                               "triggered by functions in your code. "
+                               "Allocations are marked as temporary when they are immediately "
+                               "followed by their deallocation."));
+        }
+    }
+
+    // keep the selected cost source if the new metric provides it
+    int index = 0;
+    for (int i = 0; i < m_costSource->count(); ++i) {
+        if (oldSource.isValid() && m_costSource->itemData(i).value<CostType>() == oldSource.value<CostType>()) {
+            index = i;
+            break;
+        }
+    }
+    m_costSource->setCurrentIndex(index);
+}
+
 void FlameGraph::clearData()
 {
     m_topDownData = {};
     m_bottomUpData = {};
 
-    setData(nullptr, false);
+    setData(nullptr);
 }
 
 void FlameGraph::showData()
 {
-    setData(nullptr, false);
+    setData(nullptr);
 
-    m_buildingScene = true;
+    m_buildingData = true;
     auto data = m_showBottomUpData ? m_bottomUpData : m_topDownData;
     bool collapseRecursion = m_collapseRecursion;
     auto source = m_costSource->currentData().value<CostType>();
     auto threshold = m_costThreshold;
 #ifndef THREAD_WEAVER
-    bool depthLimited;
-    auto parsedData = parseData(data, source, threshold, collapseRecursion, depthLimited);
-    setData(parsedData, depthLimited);
+    setData(parseData(data, source, threshold, collapseRecursion));
 #else
     using namespace ThreadWeaver;
     stream() << make_job([data, source, threshold, collapseRecursion, this]() {
-        bool depthLimited;
-        auto parsedData = parseData(data, source, threshold, collapseRecursion, depthLimited);
-        QMetaObject::invokeMethod(this, "setData", Qt::QueuedConnection, Q_ARG(FrameGraphicsItem*, parsedData),
-                                  Q_ARG(bool, depthLimited));
+        auto parsedData = parseData(data, source, threshold, collapseRecursion);
+        QMetaObject::invokeMethod(this, "setData", Qt::QueuedConnection, Q_ARG(FlameGraphData*, parsedData));
     });
 #endif
 }
 
-void FlameGraph::setTooltipItem(const FrameGraphicsItem* item)
+void FlameGraph::setTooltipItem(int item)
 {
-    if (!item && m_selectedItem != -1 && m_selectionHistory.at(m_selectedItem)) {
-        item = m_selectionHistory.at(m_selectedItem);
-        m_view->setCursor(Qt::ArrowCursor);
-    } else {
-        m_view->setCursor(Qt::PointingHandCursor);
-    }
+    m_view->setCursor(item == -1 ? Qt::ArrowCursor : Qt::PointingHandCursor);
     m_tooltipItem = item;
     updateTooltip();
 }
 
 void FlameGraph::updateTooltip()
 {
-    auto text = m_tooltipItem ? m_tooltipItem->description() : QString();
+    QString text;
+    const auto layout = m_view->frameLayout();
+    if (m_data && layout && m_tooltipItem != -1) {
+        text = description(*m_data, layout->items.at(m_tooltipItem));
+    } else if (m_data) {
+        // without a hovered item, describe the selected one
+        text = description(*m_data, m_selectionHistory.at(m_selectedItem));
+    }
     m_displayLabel->setToolTip(text);
     const auto metrics = m_displayLabel->fontMetrics();
-    if (m_depthLimited)
-    {
-        if (text.endsWith('.'))
-        {
-            text.resize(text.length() - 1);
-        }
-        text = text.toHtmlEscaped() + QString(
-            i18n(" <b>(graph maximum depth limited to %1)</b>")).arg(MaxRecursionDepth);
-    }
     m_displayLabel->setText(metrics.elidedText(text, Qt::ElideRight, m_displayLabel->width()));
 }
 
-void FlameGraph::setData(FrameGraphicsItem* rootItem, bool depthLimited)
+void FlameGraph::setData(FlameGraphData* data)
 {
-    m_scene->clear();
-    m_buildingScene = false;
-    m_depthLimited = depthLimited;
-    m_tooltipItem = nullptr;
-    m_rootItem = rootItem;
+    m_data.reset(data);
+    m_buildingData = false;
+    m_tooltipItem = -1;
     m_selectionHistory.clear();
-    m_selectionHistory.push_back(rootItem);
+    m_selectionHistory.push_back(0);
     m_selectedItem = 0;
+    // drop the layouts of the previous data that are still being computed
+    ++m_layoutGeneration;
     updateNavigationActions();
-    if (!rootItem) {
-        auto text = m_scene->addText(i18n("generating flame graph..."));
-        m_view->centerOn(text);
+    if (!data) {
+        m_view->setData(nullptr, i18n("generating flame graph..."));
         m_view->setCursor(Qt::BusyCursor);
         return;
     }
 
+    m_view->setData(m_data, {});
     m_view->setCursor(Qt::ArrowCursor);
-    // layouting needs a root item with a given height, the rest will be
-    // overwritten later
-    rootItem->setRect(0, 0, 800, m_view->fontMetrics().height() + 4);
-    m_scene->addItem(rootItem);
 
     if (!m_searchInput->text().isEmpty()) {
         setSearchValue(m_searchInput->text());
     }
 
     if (isVisible()) {
-        selectItem(m_rootItem);
+        showFrame(0);
     }
 }
 
@@ -933,74 +1027,77 @@ void FlameGraph::selectItem(int item)
 {
     m_selectedItem = item;
     updateNavigationActions();
-    selectItem(m_selectionHistory.at(m_selectedItem));
+    showFrame(m_selectionHistory.at(m_selectedItem));
 }
 
-void FlameGraph::selectItem(FrameGraphicsItem* item)
+void FlameGraph::showFrame(int frame)
 {
-    if (!item) {
+    if (!m_data) {
         return;
     }
 
-    // scale item and its parents to the maximum available width
-    // also hide all siblings of the parent items
-    const auto rootWidth = m_view->viewport()->width() - 40;
-    auto parent = item;
-    while (parent) {
-        auto rect = parent->rect();
-        rect.setLeft(0);
-        rect.setWidth(rootWidth);
-        parent->setRect(rect);
-        if (parent->parentItem()) {
-            foreach (auto sibling, parent->parentItem()->childItems()) {
-                sibling->setVisible(sibling == parent);
-            }
-        }
-        parent = static_cast<FrameGraphicsItem*>(parent->parentItem());
-    }
-
-    // then layout all items below the selected on
-    layoutItems(item);
-
-    // 1) trying to fix a bug (?): sometimes the flamegraph is displayed at a wrong position initially
-    // (observed after switching to the flamegraph tab soon after the application starts with
-    // a data file specified in the command line);
-    // 2) QGraphicsScene::sceneRect never shrinks automatically so we need to update it manually
-    // if we want to update the ranges and visibility of the scrollbars
-    m_scene->setSceneRect(m_scene->itemsBoundingRect());
+    // only the frames that are visible at the current width are laid out, so this
+    // is repeated when the frame or the width changes
+    const auto data = m_data;
+    const auto width = m_view->layoutWidth();
+    const auto generation = ++m_layoutGeneration;
+#ifndef THREAD_WEAVER
+    setFrameLayout(layoutFrames(*data, frame, width, generation));
+#else
+    using namespace ThreadWeaver;
+    stream() << make_job([data, frame, width, generation, this]() {
+        auto layout = layoutFrames(*data, frame, width, generation);
+        QMetaObject::invokeMethod(this, "setFrameLayout", Qt::QueuedConnection, Q_ARG(FlameGraphLayout*, layout));
+    });
+#endif
+}
 
-    // and make sure it's visible
-    m_view->centerOn(item);
+void FlameGraph::setFrameLayout(FlameGraphLayout* layout)
+{
+    std::unique_ptr<FlameGraphLayout> newLayout(layout);
+    if (layout->generation != m_layoutGeneration) {
+        // the data, the frame or the width changed in the meantime
+        return;
+    }
+    m_view->setFrameLayout(std::move(newLayout));
+    setTooltipItem(-1);
+}
 
-    setTooltipItem(item);
+void FlameGraph::setSearchIndex(const SearchIndexPtr& index)
+{
+    m_searchFilter.setIndex(index);
 }
 
 void FlameGraph::setSearchValue(const QString& value)
 {
-    if (!m_rootItem) {
+    if (!m_data) {
         return;
     }
 
-    auto match = applySearch(m_rootItem, value);
+    m_searchFilter.setFilter(SearchIndex::Function, value);
+    QVector<SearchMatchType> matches;
+    auto match = applySearch(*m_data, m_searchFilter, value, &matches);
+    m_view->setSearchMatches(matches);
 
     if (value.isEmpty()) {
         m_searchResultsLabel->hide();
     } else {
         QString label;
-        const auto costFraction = fraction(match.directCost, m_rootItem->cost());
-        switch (m_costSource->currentData().value<CostType>()) {
+        const auto totalCost = m_data->frames.first().cost;
+        const auto costFraction = fraction(match.directCost, totalCost);
+        switch (m_data->costType) {
         case Allocations:
         case Temporary:
         case PeakInstances:
             label = i18n("%1 (%2% of total of %3) allocations matched by search.",
-                         match.directCost, costFraction, m_rootItem->cost());
+                         match.directCost, costFraction, totalCost);
             break;
         case Peak:
         case Leaked:
         case Allocated:
             label = i18n("%1 (%2% of total of %3) matched by search.",
                          Util::formatByteSize(match.directCost, 1), costFraction,
-                         Util::formatByteSize(m_rootItem->cost(), 1));
+                         Util::formatByteSize(totalCost, 1));
             break;
         }
         m_searchResultsLabel->setText(label);
@@ -22,15 +22,18 @@
 #include <QVector>
 #include <QWidget>
 
+#include <memory>
+
+#include "searchindex.h"
 #include "treemodel.h"
 
-class QGraphicsScene;
-class QGraphicsView;
 class QComboBox;
 class QLabel;
 class QLineEdit;
 
-class FrameGraphicsItem;
+struct FlameGraphData;
+struct FlameGraphLayout;
+class FlameGraphView;
 
 class FlameGraph : public QWidget
 {
@@ -41,6 +44,10 @@ public:
 
     void setTopDownData(const TreeData& topDownData);
     void setBottomUpData(const TreeData& bottomUpData);
+    // updates the available cost sources for the given metric
+    void setDisplay(AllocationData::DisplayId display);
+    // speeds up the search, the frames of locations that are not in the index are compared directly
+    void setSearchIndex(const SearchIndexPtr& index);
 
     void clearData();
 #if NO_K_LIB
@@ -52,42 +59,46 @@ public:
 protected:
     bool eventFilter(QObject* object, QEvent* event) override;
 private slots:
-    void setData(FrameGraphicsItem* rootItem, bool depthLimited);
+    void setData(FlameGraphData* data);
+    void setFrameLayout(FlameGraphLayout* layout);
     void setSearchValue(const QString& value);
     void navigateBack();
     void navigateForward();
 
 private:
-    void setTooltipItem(const FrameGraphicsItem* item);
+    void setTooltipItem(int item);
     void updateTooltip();
     void showData();
     void selectItem(int item);
-    void selectItem(FrameGraphicsItem* item);
+    // lay out the graph below @p frame on the thread pool, see setFrameLayout()
+    void showFrame(int frame);
     void updateNavigationActions();
 
     TreeData m_topDownData;
     TreeData m_bottomUpData;
 
     QComboBox* m_costSource;
-    QGraphicsScene* m_scene;
-    QGraphicsView* m_view;
+    FlameGraphView* m_view;
     QLabel* m_displayLabel;
     QLabel* m_searchResultsLabel;
     QLineEdit* m_searchInput = nullptr;
     QAction* m_forwardAction = nullptr;
     QAction* m_backAction = nullptr;
     QAction* m_resetAction = nullptr;
-    const FrameGraphicsItem* m_tooltipItem = nullptr;
-    FrameGraphicsItem* m_rootItem = nullptr;
-    QVector<FrameGraphicsItem*> m_selectionHistory;
+    std::shared_ptr<const FlameGraphData> m_data;
+    LocationFilter m_searchFilter;
+    // index of the layout item the tooltip is shown for
+    int m_tooltipItem = -1;
+    // the frames that were selected, the first one is the root
+    QVector<int> m_selectionHistory;
     int m_selectedItem = -1;
-    int m_minRootWidth = 0;
+    // layouts that are computed for an older request are dropped
+    int m_layoutGeneration = 0;
     bool m_showBottomUpData = false;
     bool m_collapseRecursion = true;
-    bool m_buildingScene = false;
+    bool m_buildingData = false;
     // cost threshold in percent, items below that value will not be shown
     double m_costThreshold = 0.1;
-    bool m_depthLimited = false;
 };
 
 #endif // FLAMEGRAPH_H
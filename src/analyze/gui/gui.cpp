@@ -67,13 +67,17 @@ int main(int argc, char** argv)
                                   i18n("Base profile data to compare other files to."),
                                   QStringLiteral("<file>")};
     parser.addOption(diffOption);
+    QCommandLineOption liveOption{{QStringLiteral("l"), QStringLiteral("live")},
+                                  i18n("Follow the files while they are being written, e.g. growing files or FIFOs "
+                                       "heaptrack_interpret writes to, and update the results periodically.")};
+    parser.addOption(liveOption);
     parser.addPositionalArgument(QStringLiteral("files"), i18n("Files to load"), i18n("[FILE...]"));
 
-    QCommandLineOption showMallocOption(QStringLiteral("malloc"), QStringLiteral("Show malloc-allocated memory consumption"));
-    QCommandLineOption showManagedOption(QStringLiteral("managed"), QStringLiteral("Show managed memory consumption"));
-    QCommandLineOption showPrivateDirtyOption(QStringLiteral("private_dirty"), QStringLiteral("Show Private_Dirty part of memory consumption"));
-    QCommandLineOption showPrivateCleanOption(QStringLiteral("private_clean"), QStringLiteral("Show Private_Clean part of memory consumption"));
-    QCommandLineOption showSharedOption(QStringLiteral("shared"), QStringLiteral("Show Shared_Clean + Shared_Dirty part of memory consumption"));
+    QCommandLineOption showMallocOption(QStringLiteral("malloc"), QStringLiteral("Initially show malloc-allocated memory consumption"));
+    QCommandLineOption showManagedOption(QStringLiteral("managed"), QStringLiteral("Initially show managed memory consumption"));
+    QCommandLineOption showPrivateDirtyOption(QStringLiteral("private_dirty"), QStringLiteral("Initially show Private_Dirty part of memory consumption"));
+    QCommandLineOption showPrivateCleanOption(QStringLiteral("private_clean"), QStringLiteral("Initially show Private_Clean part of memory consumption"));
+    QCommandLineOption showSharedOption(QStringLiteral("shared"), QStringLiteral("Initially show Shared_Clean + Shared_Dirty part of memory consumption"));
 
     parser.addOption(showMallocOption);
     parser.addOption(showManagedOption);
@@ -87,6 +91,12 @@ int main(int argc, char** argv)
     QCommandLineOption showCoreCLRPartOption(QStringLiteral("show-coreclr"), QStringLiteral("Show CoreCLR/non-CoreCLR memory distribution"));
     parser.addOption(showCoreCLRPartOption);
 
+    QCommandLineOption threadOption(QStringLiteral("thread"),
+                                    QStringLiteral("Only account for the malloc allocations of the threads with the "
+                                                   "given name or id, can be given several times"),
+                                    QStringLiteral("thread"));
+    parser.addOption(threadOption);
+
     parser.process(app);
 #ifndef NO_K_LIB
     aboutData.processCommandLine(&parser);
@@ -104,30 +114,27 @@ int main(int argc, char** argv)
         + (isShowManaged ? 1 : 0)
         + (isShowPrivateDirty ? 1 : 0)
         + (isShowPrivateClean ? 1 : 0)
-        + (isShowShared ? 1 : 0) != 1) {
+        + (isShowShared ? 1 : 0) > 1) {
 
-        const auto msg = "One of --malloc, --managed, --private_dirty, --private_clean or --shared options is necessary. " \
-                         "Please, use exactly only one of the options for each start of GUI.";
+        const auto msg = "Only one of --malloc, --managed, --private_dirty, --private_clean or --shared options can be used. " \
+                         "The option selects the initially shown metric, all metrics are available in the GUI.";
 
         QMessageBox::critical(nullptr, AboutData::DisplayName + " Error", msg, QMessageBox::Ok);
 
         qFatal(msg);
 
         return 1;
-    } else if (isShowMalloc)
-    {
-        AllocationData::display = AllocationData::DisplayId::malloc;
-    } else if (isShowManaged)
-    {
-        AllocationData::display = AllocationData::DisplayId::managed;
+    }
+
+    AllocationData::DisplayId display = AllocationData::DisplayId::malloc;
+    if (isShowManaged) {
+        display = AllocationData::DisplayId::managed;
     } else if (isShowPrivateDirty) {
-        AllocationData::display = AllocationData::DisplayId::privateDirty;
+        display = AllocationData::DisplayId::privateDirty;
     } else if (isShowPrivateClean) {
-        AllocationData::display = AllocationData::DisplayId::privateClean;
-    } else {
-        assert (isShowShared);
-
-        AllocationData::display = AllocationData::DisplayId::shared;
+        display = AllocationData::DisplayId::privateClean;
+    } else if (isShowShared) {
+        display = AllocationData::DisplayId::shared;
     }
 
     if (isHideUnmanagedStackParts) {
@@ -138,15 +145,23 @@ int main(int argc, char** argv)
         AccumulatedTraceData::isShowCoreCLRPartOption = true;
     }
 
-    auto createWindow = []() -> MainWindow* {
-        auto window = new MainWindow;
+    const auto threads = parser.values(threadOption);
+
+    auto createWindow = [display, threads]() -> MainWindow* {
+        auto window = new MainWindow(display);
+        window->setThreadFilter(threads);
         window->setAttribute(Qt::WA_DeleteOnClose);
         window->show();
         return window;
     };
 
+    const bool isLive = parser.isSet(liveOption);
     foreach (const QString& file, parser.positionalArguments()) {
-        createWindow()->loadFile(file, parser.value(diffOption));
+        if (isLive) {
+            createWindow()->loadLiveFile(file);
+        } else {
+            createWindow()->loadFile(file, parser.value(diffOption));
+        }
     }
 
     if (parser.positionalArguments().isEmpty()) {
@@ -39,6 +39,8 @@ struct LocationData
     QString file;
     QString module;
     int line;
+    // position in the order the locations got interned, see SearchIndex
+    int id;
 
     bool operator==(const LocationData& rhs) const
     {
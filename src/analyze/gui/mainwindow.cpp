@@ -18,6 +18,7 @@
 
 #include "mainwindow.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -40,6 +41,7 @@
 #include "util.h"
 
 #include <QAction>
+#include <QComboBox>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QFileDialog>
@@ -119,7 +121,26 @@ void setupTopView(TreeModel* source, QTreeView* view, TopProxy::Type type)
     addContextMenu(view, TreeModel::LocationRole);
 }
 
+bool hasAllocationCounts(AllocationData::DisplayId display)
+{
+    return display == AllocationData::DisplayId::malloc || display == AllocationData::DisplayId::managed;
+}
+
 #if USE_CHART
+bool isChartAvailable(ChartModel::Type type, AllocationData::DisplayId display)
+{
+    switch (type) {
+    case ChartModel::Consumed:
+        return true;
+    case ChartModel::Temporary:
+    case ChartModel::Threads:
+    case ChartModel::Fragmentation:
+        return display == AllocationData::DisplayId::malloc;
+    default:
+        return hasAllocationCounts(display);
+    }
+}
+
 void addChartTab(QTabWidget* tabWidget, const QString& title, ChartModel::Type type, const Parser* parser,
                  void (Parser::*dataReady)(const ChartData&), MainWindow* window)
 {
@@ -129,17 +150,19 @@ void addChartTab(QTabWidget* tabWidget, const QString& title, ChartModel::Type t
     auto model = new ChartModel(type, tab);
     tab->setModel(model);
     QObject::connect(parser, dataReady, tab, [=](const ChartData& data) {
-        model->resetData(data);
-        tabWidget->setTabEnabled(tabWidget->indexOf(tab), true);
+        model->updateData(data);
+        // only traces that were interpreted with fragmentation tracking have the fragmentation chart
+        const bool hasData = type != ChartModel::Fragmentation || !data.rows.isEmpty();
+        tabWidget->setTabEnabled(tabWidget->indexOf(tab), hasData && isChartAvailable(type, window->display()));
     });
     QObject::connect(window, &MainWindow::clearData, model, &ChartModel::clearData);
 }
 #endif
 
 void setupTreeModel(TreeModel* model, QTreeView* view, CostDelegate* costDelegate, QLineEdit* filterFunction,
-                    QLineEdit* filterFile, QLineEdit* filterModule)
+                    QLineEdit* filterFile, QLineEdit* filterModule, Parser* parser)
 {
-    auto proxy = new TreeProxy(TreeModel::FunctionColumn, TreeModel::FileColumn, TreeModel::ModuleColumn, model);
+    auto proxy = new TreeProxy(TreeModel::LocationRole, model);
     proxy->setSourceModel(model);
     proxy->setSortRole(TreeModel::SortRole);
 
@@ -150,24 +173,26 @@ void setupTreeModel(TreeModel* model, QTreeView* view, CostDelegate* costDelegat
     view->setItemDelegateForColumn(TreeModel::LeakedColumn, costDelegate);
     view->setItemDelegateForColumn(TreeModel::AllocationsColumn, costDelegate);
     view->setItemDelegateForColumn(TreeModel::TemporaryColumn, costDelegate);
-    if(AllocationData::display != AllocationData::DisplayId::malloc)
-    {
-        view->hideColumn(TreeModel::TemporaryColumn);
-
-        if(AllocationData::display != AllocationData::DisplayId::managed)
-        {
-            view->hideColumn(TreeModel::AllocationsColumn);
-            view->hideColumn(TreeModel::PeakInstancesColumn);
-        }
-    }
+    view->setItemDelegateForColumn(TreeModel::ShortLivedColumn, costDelegate);
+    view->setItemDelegateForColumn(TreeModel::SlackColumn, costDelegate);
     view->hideColumn(TreeModel::FunctionColumn);
     view->hideColumn(TreeModel::FileColumn);
     view->hideColumn(TreeModel::LineColumn);
     view->hideColumn(TreeModel::ModuleColumn);
 
+    // the filters search the whole tree, so merge the rows that weren't expanded yet first
+    auto expandAll = [model](const QString& filter) {
+        if (!filter.isEmpty()) {
+            model->expandAll();
+        }
+    };
+    for (auto filter : {filterFunction, filterFile, filterModule}) {
+        QObject::connect(filter, &QLineEdit::textChanged, model, expandAll);
+    }
     QObject::connect(filterFunction, &QLineEdit::textChanged, proxy, &TreeProxy::setFunctionFilter);
     QObject::connect(filterFile, &QLineEdit::textChanged, proxy, &TreeProxy::setFileFilter);
     QObject::connect(filterModule, &QLineEdit::textChanged, proxy, &TreeProxy::setModuleFilter);
+    QObject::connect(parser, &Parser::searchIndexAvailable, proxy, &TreeProxy::setSearchIndex);
     addContextMenu(view, TreeModel::LocationRole);
 }
 
@@ -184,10 +209,9 @@ void setupObjectTreeModel(ObjectTreeModel* model, QTreeView* view, QLineEdit* fi
 }
 
 void setupCallerCalle(CallerCalleeModel* model, QTreeView* view, CostDelegate* costDelegate, QLineEdit* filterFunction,
-                      QLineEdit* filterFile, QLineEdit* filterModule)
+                      QLineEdit* filterFile, QLineEdit* filterModule, Parser* parser)
 {
-    auto callerCalleeProxy = new TreeProxy(CallerCalleeModel::FunctionColumn, CallerCalleeModel::FileColumn,
-                                           CallerCalleeModel::ModuleColumn, model);
+    auto callerCalleeProxy = new TreeProxy(CallerCalleeModel::LocationRole, model);
     callerCalleeProxy->setSourceModel(model);
     callerCalleeProxy->setSortRole(CallerCalleeModel::SortRole);
     view->setModel(callerCalleeProxy);
@@ -208,25 +232,34 @@ void setupCallerCalle(CallerCalleeModel* model, QTreeView* view, CostDelegate* c
     view->hideColumn(CallerCalleeModel::FileColumn);
     view->hideColumn(CallerCalleeModel::LineColumn);
     view->hideColumn(CallerCalleeModel::ModuleColumn);
-    if(AllocationData::display != AllocationData::DisplayId::malloc)
-    {
-        view->hideColumn(CallerCalleeModel::SelfTemporaryColumn);
-        view->hideColumn(CallerCalleeModel::InclusiveTemporaryColumn);
-
-        if(AllocationData::display != AllocationData::DisplayId::managed)
-        {
-            view->hideColumn(CallerCalleeModel::SelfAllocationsColumn);
-            view->hideColumn(CallerCalleeModel::InclusiveAllocationsColumn);
-            view->hideColumn(CallerCalleeModel::SelfPeakInstancesColumn);
-            view->hideColumn(CallerCalleeModel::InclusivePeakInstancesColumn);
-        }
-    }
     QObject::connect(filterFunction, &QLineEdit::textChanged, callerCalleeProxy, &TreeProxy::setFunctionFilter);
     QObject::connect(filterFile, &QLineEdit::textChanged, callerCalleeProxy, &TreeProxy::setFileFilter);
     QObject::connect(filterModule, &QLineEdit::textChanged, callerCalleeProxy, &TreeProxy::setModuleFilter);
+    QObject::connect(parser, &Parser::searchIndexAvailable, callerCalleeProxy, &TreeProxy::setSearchIndex);
     addContextMenu(view, CallerCalleeModel::LocationRole);
 }
 
+void updateTreeColumns(QTreeView* view, AllocationData::DisplayId display)
+{
+    const bool isMalloc = display == AllocationData::DisplayId::malloc;
+    view->setColumnHidden(TreeModel::TemporaryColumn, !isMalloc);
+    view->setColumnHidden(TreeModel::ShortLivedColumn, !isMalloc);
+    view->setColumnHidden(TreeModel::SlackColumn, !isMalloc);
+    view->setColumnHidden(TreeModel::AllocationsColumn, !hasAllocationCounts(display));
+    view->setColumnHidden(TreeModel::PeakInstancesColumn, !hasAllocationCounts(display));
+}
+
+void updateCallerCalleeColumns(QTreeView* view, AllocationData::DisplayId display)
+{
+    const bool isMalloc = display == AllocationData::DisplayId::malloc;
+    view->setColumnHidden(CallerCalleeModel::SelfTemporaryColumn, !isMalloc);
+    view->setColumnHidden(CallerCalleeModel::InclusiveTemporaryColumn, !isMalloc);
+    view->setColumnHidden(CallerCalleeModel::SelfAllocationsColumn, !hasAllocationCounts(display));
+    view->setColumnHidden(CallerCalleeModel::InclusiveAllocationsColumn, !hasAllocationCounts(display));
+    view->setColumnHidden(CallerCalleeModel::SelfPeakInstancesColumn, !hasAllocationCounts(display));
+    view->setColumnHidden(CallerCalleeModel::InclusivePeakInstancesColumn, !hasAllocationCounts(display));
+}
+
 QString insertWordWrapMarkers(QString text)
 {
     // insert zero-width spaces after every 50 word characters to enable word wrap in the middle of words
@@ -235,13 +268,15 @@ QString insertWordWrapMarkers(QString text)
 }
 }
 
-MainWindow::MainWindow(QWidget* parent)
+MainWindow::MainWindow(AllocationData::DisplayId display, QWidget* parent)
     : QMainWindow(parent)
     , m_ui(new Ui::MainWindow)
     , m_parser(new Parser(this))
+    , m_displaySelector(new QComboBox(this))
 #ifndef NO_K_LIB
     , m_config(KSharedConfig::openConfig(QStringLiteral("heaptrack_gui")))
 #endif
+    , m_display(display)
 {
     m_ui->setupUi(this);
 
@@ -294,11 +329,36 @@ MainWindow::MainWindow(QWidget* parent)
         if (!m_diffMode) {
             m_ui->flameGraphTab->setBottomUpData(data);
         }
+    });
+    // the flame graph and the caller/callee data are built when their tabs are shown
+    auto requestTabData = [=](int tabIndex) {
+        const auto widget = m_ui->tabWidget->widget(tabIndex);
+        if (widget == m_ui->flameGraphTab && m_flameGraphOutdated) {
+            m_flameGraphOutdated = false;
+            m_parser->requestFlameGraphData();
+        } else if (widget == m_ui->callerCalleeTab && m_callerCalleeOutdated) {
+            m_callerCalleeOutdated = false;
+            m_parser->requestCallerCalleeData();
+        }
+    };
+    connect(m_ui->tabWidget, &QTabWidget::currentChanged, this, requestTabData);
+    connect(m_parser, &Parser::bottomUpFilterOutLeavesDataAvailable, this, [=](const LazyTreeData& data) {
+        bottomUpModelFilterOutLeaves->updateData(data);
         m_ui->progressLabel->setAlignment(Qt::AlignVCenter | Qt::AlignRight);
         statusBar()->addWidget(m_ui->progressLabel, 1);
         statusBar()->addWidget(m_ui->loadingProgress);
         m_ui->pages->setCurrentWidget(m_ui->resultsPage);
         m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->bottomUpTab), true);
+        m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->callerCalleeTab), true);
+        m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->flameGraphTab), !m_diffMode);
+        if (m_live) {
+            // the live updates use the currently selected metric
+            m_displaySelector->setEnabled(true);
+        }
+        // new data or another metric, so the trees of the other views are rebuilt when they are shown
+        m_flameGraphOutdated = true;
+        m_callerCalleeOutdated = true;
+        requestTabData(m_ui->tabWidget->currentIndex());
     });
     connect(m_parser, &Parser::objectTreeBottomUpDataAvailable, this, [=](const ObjectTreeData& data) {
         quint32 maxGC = 0;
@@ -312,23 +372,18 @@ MainWindow::MainWindow(QWidget* parent)
         objectTreeModel->resetData(data);
         m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->heapTab), true);
     });
-    connect(m_parser,
-            (AccumulatedTraceData::isHideUnmanagedStackParts ?
-             &Parser::bottomUpDataAvailable : &Parser::bottomUpFilterOutLeavesDataAvailable),
-            this, [=](const TreeData& data) {
-        bottomUpModelFilterOutLeaves->resetData(data);
-    });
     connect(m_parser, &Parser::callerCalleeDataAvailable, this, [=](const CallerCalleeRows& data) {
-        callerCalleeModel->resetData(data);
-        m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->callerCalleeTab), true);
+        callerCalleeModel->updateData(data);
     });
-    connect(m_parser, &Parser::topDownDataAvailable, this, [=](const TreeData& data) {
-        topDownModel->resetData(data);
+    connect(m_parser, &Parser::lazyTopDownDataAvailable, this, [=](const LazyTreeData& data) {
+        topDownModel->updateData(data);
         m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->topDownTab), true);
+    });
+    connect(m_parser, &Parser::searchIndexAvailable, m_ui->flameGraphTab, &FlameGraph::setSearchIndex);
+    connect(m_parser, &Parser::topDownDataAvailable, this, [=](const TreeData& data) {
         if (!m_diffMode) {
             m_ui->flameGraphTab->setTopDownData(data);
         }
-        m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_ui->flameGraphTab), !m_diffMode);
     });
     connect(m_parser, &Parser::summaryAvailable, this, [=](const SummaryData& data) {
         bottomUpModelFilterOutLeaves->setSummary(data);
@@ -362,8 +417,7 @@ MainWindow::MainWindow(QWidget* parent)
                    << "</dl></qt>";
         }
 
-        if(AllocationData::display == AllocationData::DisplayId::malloc
-           || AllocationData::display == AllocationData::DisplayId::managed)
+        if (hasAllocationCounts(m_display))
         {
             QTextStream stream(&textCenter);
             stream << "<qt><dl>" << i18n("<dt><b>calls to allocation functions</b>:</dt><dd>%1 "
@@ -377,14 +431,30 @@ MainWindow::MainWindow(QWidget* parent)
                    << i18n("<dt><b>bytes allocated in total</b> (ignoring "
                            "deallocations):</dt><dd>%1 (%2/s)</dd>",
                            Util::formatByteSize(data.cost.allocated, 2),
-                           Util::formatByteSize(data.cost.allocated / totalTimeS, 1))
-                   << "</dl></qt>";
+                           Util::formatByteSize(data.cost.allocated / totalTimeS, 1));
+            if (data.cost.peakSlack) {
+                stream << i18n("<dt><b>allocator slack at peak</b>:</dt><dd>%1 (%2% of the peak)</dd>",
+                               Util::formatByteSize(data.cost.peakSlack, 1),
+                               std::round(float(data.cost.peakSlack) * 100.f * 100.f / data.cost.peak) / 100.f);
+            }
+            if (!data.threads.isEmpty()) {
+                auto threads = data.threads;
+                std::sort(threads.begin(), threads.end(), [](const ThreadSummary& l, const ThreadSummary& r) {
+                    return l.cost.peak > r.cost.peak;
+                });
+                stream << i18n("<dt><b>peak heap memory consumption per thread</b>:</dt>");
+                for (int i = 0; i < std::min(threads.size(), 5); ++i) {
+                    stream << i18n("<dd>%1: %2 (%3 calls)</dd>", threads[i].name.toHtmlEscaped(),
+                                   Util::formatByteSize(threads[i].cost.peak, 1), threads[i].cost.allocations);
+                }
+            }
+            stream << "</dl></qt>";
         }
         if (AccumulatedTraceData::isShowCoreCLRPartOption)
         {
             QTextStream stream(&textRight);
 
-            if (AllocationData::display == AllocationData::DisplayId::malloc)
+            if (m_display == AllocationData::DisplayId::malloc)
             {
                 stream << "<qt><dl>" << i18n("<dt><b>peak heap memory consumption</b>:</dt><dd>%1 "
                                              "after %2s</dd>"
@@ -461,8 +531,13 @@ MainWindow::MainWindow(QWidget* parent)
         layout->insertWidget(idx + 1, m_ui->progressLabel);
         m_ui->progressLabel->setAlignment(Qt::AlignVCenter | Qt::AlignHCenter);
         m_openAction->setEnabled(true);
+        m_stopLiveAction->setEnabled(false);
+        m_live = false;
     };
     connect(m_parser, &Parser::finished, this, removeProgress);
+    connect(m_parser, &Parser::finished, m_displaySelector, [this] { m_displaySelector->setEnabled(true); });
+    connect(m_parser, &Parser::displayUpdated, this, removeProgress);
+    connect(m_parser, &Parser::displayUpdated, m_displaySelector, [this] { m_displaySelector->setEnabled(true); });
     connect(m_parser, &Parser::failedToOpen, this, [this, removeProgress](const QString& failedFile) {
         removeProgress();
         m_ui->pages->setCurrentWidget(m_ui->openPage);
@@ -471,39 +546,42 @@ MainWindow::MainWindow(QWidget* parent)
     m_ui->messages->hide();
 
 #if USE_CHART
+    // all chart tabs are created up front, the ones that make no sense for the
+    // selected metric are disabled
     addChartTab(m_ui->tabWidget, i18n("Consumed"), ChartModel::Consumed, m_parser, &Parser::consumedChartDataAvailable,
                 this);
 
-    if(AllocationData::display == AllocationData::DisplayId::malloc
-       || AllocationData::display == AllocationData::DisplayId::managed)
-    {
-        addChartTab(m_ui->tabWidget, i18n("Instances"), ChartModel::Instances, m_parser,
-                    &Parser::instancesChartDataAvailable, this);
+    addChartTab(m_ui->tabWidget, i18n("Instances"), ChartModel::Instances, m_parser,
+                &Parser::instancesChartDataAvailable, this);
 
-        addChartTab(m_ui->tabWidget, i18n("Allocations"), ChartModel::Allocations, m_parser,
-                    &Parser::allocationsChartDataAvailable, this);
+    addChartTab(m_ui->tabWidget, i18n("Allocations"), ChartModel::Allocations, m_parser,
+                &Parser::allocationsChartDataAvailable, this);
 
-        addChartTab(m_ui->tabWidget, i18n("Allocated"), ChartModel::Allocated, m_parser, &Parser::allocatedChartDataAvailable,
-                    this);
+    addChartTab(m_ui->tabWidget, i18n("Allocated"), ChartModel::Allocated, m_parser, &Parser::allocatedChartDataAvailable,
+                this);
 
-        if (AllocationData::display == AllocationData::DisplayId::malloc)
-        {
-            addChartTab(m_ui->tabWidget, i18n("Temporary Allocations"), ChartModel::Temporary, m_parser,
-                        &Parser::temporaryChartDataAvailable, this);
-        }
+    addChartTab(m_ui->tabWidget, i18n("Temporary Allocations"), ChartModel::Temporary, m_parser,
+                &Parser::temporaryChartDataAvailable, this);
 
-        auto sizesTab = new HistogramWidget(this);
-        m_ui->tabWidget->addTab(sizesTab, i18n("Sizes"));
-        m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(sizesTab), false);
-        auto sizeHistogramModel = new HistogramModel(this);
-        sizesTab->setModel(sizeHistogramModel);
-        connect(this, &MainWindow::clearData, sizeHistogramModel, &HistogramModel::clearData);
+    addChartTab(m_ui->tabWidget, i18n("Threads"), ChartModel::Threads, m_parser,
+                &Parser::threadsChartDataAvailable, this);
 
-        connect(m_parser, &Parser::sizeHistogramDataAvailable, this, [=](const HistogramData& data) {
-                sizeHistogramModel->resetData(data);
-                m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(sizesTab), true);
-                });
-    }
+    addChartTab(m_ui->tabWidget, i18n("Fragmentation"), ChartModel::Fragmentation, m_parser,
+                &Parser::fragmentationChartDataAvailable, this);
+
+    m_sizesTab = new HistogramWidget(this);
+    m_ui->tabWidget->addTab(m_sizesTab, i18n("Sizes"));
+    m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_sizesTab), false);
+    auto sizeHistogramModel = new HistogramModel(this);
+    m_sizesTab->setModel(sizeHistogramModel);
+    connect(this, &MainWindow::clearData, sizeHistogramModel, &HistogramModel::clearData);
+    connect(this, &MainWindow::clearData, this, [this]() { m_sizesAvailable = false; });
+
+    connect(m_parser, &Parser::sizeHistogramDataAvailable, this, [=](const HistogramData& data) {
+            sizeHistogramModel->resetData(data);
+            m_sizesAvailable = true;
+            m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_sizesTab), hasAllocationCounts(m_display));
+            });
 #endif // USE_CHART
 
     connect(m_ui->aboutAction, &QAction::triggered, this, &MainWindow::about);
@@ -511,13 +589,13 @@ MainWindow::MainWindow(QWidget* parent)
     auto costDelegate = new CostDelegate(this);
 
     setupTreeModel(bottomUpModelFilterOutLeaves, m_ui->bottomUpResults, costDelegate, m_ui->bottomUpFilterFunction,
-                   m_ui->bottomUpFilterFile, m_ui->bottomUpFilterModule);
+                   m_ui->bottomUpFilterFile, m_ui->bottomUpFilterModule, m_parser);
 
     setupTreeModel(topDownModel, m_ui->topDownResults, costDelegate, m_ui->topDownFilterFunction,
-                   m_ui->topDownFilterFile, m_ui->topDownFilterModule);
+                   m_ui->topDownFilterFile, m_ui->topDownFilterModule, m_parser);
 
     setupCallerCalle(callerCalleeModel, m_ui->callerCalleeResults, costDelegate, m_ui->callerCalleeFilterFunction,
-                     m_ui->callerCalleeFilterFile, m_ui->callerCalleeFilterModule);
+                     m_ui->callerCalleeFilterFile, m_ui->callerCalleeFilterModule, m_parser);
 
     setupObjectTreeModel(objectTreeModel, m_ui->objectTreeResults, m_ui->filterClass, m_ui->filterGC);
 
@@ -587,31 +665,31 @@ MainWindow::MainWindow(QWidget* parent)
     setupTopView(bottomUpModelFilterOutLeaves, m_ui->topLeaked, TopProxy::Leaked);
     m_ui->topLeaked->setItemDelegate(costDelegate);
 
-    if(AllocationData::display == AllocationData::DisplayId::malloc
-       || AllocationData::display == AllocationData::DisplayId::managed)
-    {
-        setupTopView(bottomUpModelFilterOutLeaves, m_ui->topAllocations, TopProxy::Allocations);
-        m_ui->topAllocations->setItemDelegate(costDelegate);
-        setupTopView(bottomUpModelFilterOutLeaves, m_ui->topAllocated, TopProxy::Allocated);
-        m_ui->topAllocated->setItemDelegate(costDelegate);
-
-        if (AllocationData::display == AllocationData::DisplayId::malloc)
-        {
-            setupTopView(bottomUpModelFilterOutLeaves, m_ui->topTemporary, TopProxy::Temporary);
-            m_ui->topTemporary->setItemDelegate(costDelegate);
-        }
-        else
-        {
-            m_ui->widget_8->hide();
-        }
-    }
-    else
-    {
-        m_ui->widget_7->hide();
-        m_ui->widget_8->hide();
-        m_ui->widget_9->hide();
-        m_ui->widget_12->hide();
-    }
+    setupTopView(bottomUpModelFilterOutLeaves, m_ui->topAllocations, TopProxy::Allocations);
+    m_ui->topAllocations->setItemDelegate(costDelegate);
+    setupTopView(bottomUpModelFilterOutLeaves, m_ui->topAllocated, TopProxy::Allocated);
+    m_ui->topAllocated->setItemDelegate(costDelegate);
+    setupTopView(bottomUpModelFilterOutLeaves, m_ui->topTemporary, TopProxy::Temporary);
+    m_ui->topTemporary->setItemDelegate(costDelegate);
+
+    m_displaySelector->addItem(i18n("malloc"), static_cast<int>(AllocationData::DisplayId::malloc));
+    m_displaySelector->addItem(i18n("Managed"), static_cast<int>(AllocationData::DisplayId::managed));
+    m_displaySelector->addItem(i18n("Private Dirty"), static_cast<int>(AllocationData::DisplayId::privateDirty));
+    m_displaySelector->addItem(i18n("Private Clean"), static_cast<int>(AllocationData::DisplayId::privateClean));
+    m_displaySelector->addItem(i18n("Shared"), static_cast<int>(AllocationData::DisplayId::shared));
+    m_displaySelector->setToolTip(i18n("Select the memory consumption metric to show."));
+    m_displaySelector->setCurrentIndex(m_displaySelector->findData(static_cast<int>(m_display)));
+    // switching is possible once a file is loaded
+    m_displaySelector->setEnabled(false);
+    m_ui->tabWidget->setCornerWidget(m_displaySelector);
+    connect(m_displaySelector, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this,
+            [this](int index) {
+                setDisplay(static_cast<AllocationData::DisplayId>(m_displaySelector->itemData(index).toInt()));
+            });
+
+    m_parser->setDisplay(m_display);
+    m_ui->flameGraphTab->setDisplay(m_display);
+    updateDisplay();
 
     setWindowTitle(AboutData::ShortName);
     // closing the current file shows the stack page to open a new one
@@ -633,8 +711,12 @@ MainWindow::MainWindow(QWidget* parent)
     m_openNewAction = KStandardAction::openNew(this, SLOT(openNewFile()), this);
     m_quitAction = KStandardAction::quit(qApp, SLOT(quit()), this);
 #endif
+    m_stopLiveAction = new QAction(i18n("Stop &Live Update"), this);
+    m_stopLiveAction->setEnabled(false);
+    connect(m_stopLiveAction, &QAction::triggered, m_parser, &Parser::stopLive);
     m_ui->menu_File->addAction(m_openAction);
     m_ui->menu_File->addAction(m_openNewAction);
+    m_ui->menu_File->addAction(m_stopLiveAction);
     m_ui->menu_File->addAction(m_quitAction);
 }
 
@@ -662,9 +744,31 @@ void MainWindow::loadFile(const QString& file, const QString& diffBase)
     m_parser->parse(file, diffBase);
 }
 
+void MainWindow::loadLiveFile(const QString& file)
+{
+    m_ui->loadingLabel->setText(i18n("Waiting for data of %1...", file));
+    setWindowTitle(i18nc("%1: application name; %2: file name that is followed", "%1 - %2 (live)",
+                         AboutData::ShortName, QFileInfo(file).fileName()));
+    m_diffMode = false;
+    m_live = true;
+    m_stopLiveAction->setEnabled(true);
+    m_ui->pages->setCurrentWidget(m_ui->loadingPage);
+    m_parser->parseLive(file);
+}
+
+void MainWindow::setThreadFilter(const QStringList& threads)
+{
+    std::vector<std::string> filter;
+    for (const auto& thread : threads) {
+        filter.push_back(thread.toStdString());
+    }
+    m_parser->setThreadFilter(filter);
+}
+
 void MainWindow::openNewFile()
 {
-    auto window = new MainWindow;
+    auto window = new MainWindow(m_display);
+    window->m_parser->setThreadFilter(m_parser->threadFilter());
     window->setAttribute(Qt::WA_DeleteOnClose, true);
     window->show();
 }
@@ -679,9 +783,48 @@ void MainWindow::closeFile()
     }
 
     m_openAction->setEnabled(false);
+    m_displaySelector->setEnabled(false);
     emit clearData();
 }
 
+AllocationData::DisplayId MainWindow::display() const
+{
+    return m_display;
+}
+
+void MainWindow::setDisplay(AllocationData::DisplayId display)
+{
+    if (display == m_display) {
+        return;
+    }
+    m_display = display;
+
+    // the parser re-emits the data for the new metric, which updates the models.
+    // while following live data, the next update already uses the new metric
+    m_displaySelector->setEnabled(m_live);
+    m_ui->flameGraphTab->setDisplay(display);
+    updateDisplay();
+    m_parser->setDisplay(display);
+}
+
+void MainWindow::updateDisplay()
+{
+    updateTreeColumns(m_ui->bottomUpResults, m_display);
+    updateTreeColumns(m_ui->topDownResults, m_display);
+    updateCallerCalleeColumns(m_ui->callerCalleeResults, m_display);
+
+    m_ui->widget_7->setVisible(hasAllocationCounts(m_display));
+    m_ui->widget_8->setVisible(m_display == AllocationData::DisplayId::malloc);
+    m_ui->widget_9->setVisible(hasAllocationCounts(m_display));
+    m_ui->widget_12->setVisible(hasAllocationCounts(m_display));
+
+#if USE_CHART
+    // the charts are re-emitted by the parser, only the metric independent sizes need an update here
+    m_ui->tabWidget->setTabEnabled(m_ui->tabWidget->indexOf(m_sizesTab),
+                                   m_sizesAvailable && hasAllocationCounts(m_display));
+#endif
+}
+
 void MainWindow::about()
 {
     AboutDialog dlg(this);
@@ -750,7 +893,7 @@ void MainWindow::setupStacks()
 #endif
     };
     connect(m_ui->tabWidget, &QTabWidget::currentChanged, this, tabChanged);
-    connect(m_parser, &Parser::bottomUpDataAvailable, this, [tabChanged]() { tabChanged(0); });
+    connect(m_parser, &Parser::bottomUpFilterOutLeavesDataAvailable, this, [tabChanged]() { tabChanged(0); });
 
     m_ui->stacksDock->setVisible(false);
 }
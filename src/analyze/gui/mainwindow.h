@@ -23,6 +23,8 @@
 
 #include <QMainWindow>
 
+#include "../allocationdata.h"
+
 #ifndef NO_K_LIB
 #include <KSharedConfig>
 #endif
@@ -34,19 +36,31 @@ class MainWindow;
 class TreeModel;
 class ChartModel;
 class Parser;
+class QComboBox;
+#if USE_CHART
+class HistogramWidget;
+#endif
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 public:
-    MainWindow(QWidget* parent = nullptr);
+    explicit MainWindow(AllocationData::DisplayId display = AllocationData::DisplayId::malloc,
+                        QWidget* parent = nullptr);
     virtual ~MainWindow();
 
+    AllocationData::DisplayId display() const;
+    // only account for the malloc allocations of these threads, by name or id
+    void setThreadFilter(const QStringList& threads);
+
 public slots:
     void loadFile(const QString& path, const QString& diffBase = {});
+    // follow a data file while it is being written, the results are updated periodically
+    void loadLiveFile(const QString& path);
     void openNewFile();
     void closeFile();
     void about();
+    void setDisplay(AllocationData::DisplayId display);
 
 signals:
     void clearData();
@@ -66,16 +80,28 @@ protected:
 private:
     void showError(const QString& message);
     void setupStacks();
+    void updateDisplay();
 
     QScopedPointer<Ui::MainWindow> m_ui;
     Parser* m_parser;
+    QComboBox* m_displaySelector;
+#if USE_CHART
+    HistogramWidget* m_sizesTab = nullptr;
+    bool m_sizesAvailable = false;
+#endif
 #ifndef NO_K_LIB
     KSharedConfig::Ptr m_config;
 #endif
     bool m_diffMode = false;
+    bool m_live = false;
+    // the data of these tabs is requested from the parser when they are shown
+    bool m_flameGraphOutdated = false;
+    bool m_callerCalleeOutdated = false;
+    AllocationData::DisplayId m_display;
 
     QAction* m_openAction = nullptr;
     QAction* m_openNewAction = nullptr;
+    QAction* m_stopLiveAction = nullptr;
     QAction* m_quitAction = nullptr;
 };
 
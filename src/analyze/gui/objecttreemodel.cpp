@@ -82,8 +82,8 @@ QVariant ObjectTreeModel::headerData(int section, Qt::Orientation orientation, i
             return i18n("Instances");
         case ShallowSizeColumn:
             return i18n("Shallow Size");
-        case ReferencedSizeColumn:
-            return i18n("Referenced Size");
+        case RetainedSizeColumn:
+            return i18n("Retained Size");
         case GCNumColumn:
             return i18n("GC #");
         case NUM_COLUMNS:
@@ -94,13 +94,15 @@ QVariant ObjectTreeModel::headerData(int section, Qt::Orientation orientation, i
         case ClassNameColumn:
             return i18n("<qt>The name of the class.</qt>");
         case InstanceCountColumn:
-            return i18n("<qt>Total number of instances in this reference chain.</qt>");
+            return i18n("<qt>Number of instances of this type that are dominated by the instances of the parent "
+                        "row, i.e. only reachable through them.</qt>");
         case GCNumColumn:
             return i18n("<qt>GC number after which the snapshot has been taken.</qt>");
         case ShallowSizeColumn:
-            return i18n("<qt>Total size of objects of this type in a given reference chain.</qt>");
-        case ReferencedSizeColumn:
-            return i18n("<qt>Total size of objects of this type referenced by other objects in a given reference chain.</qt>");
+            return i18n("<qt>Total size of the instances of this type.</qt>");
+        case RetainedSizeColumn:
+            return i18n("<qt>Total size of the instances of this type and of all objects that are only "
+                        "reachable through them, i.e. the memory freed when they become unreachable.</qt>");
         case NUM_COLUMNS:
             break;
         }
@@ -129,11 +131,11 @@ QVariant ObjectTreeModel::data(const QModelIndex& index, int role) const
                 return static_cast<qint64>(row->allocated);
             }
             return Util::formatByteSize(row->allocated, 1);
-        case ReferencedSizeColumn:
+        case RetainedSizeColumn:
             if (role == SortRole) {
-                return static_cast<qint64>(row->referenced);
+                return static_cast<qint64>(row->retained);
             }
-            return Util::formatByteSize(row->referenced, 1);
+            return Util::formatByteSize(row->retained, 1);
         case GCNumColumn:
             return static_cast<quint64>(row->gcNum);
         case NUM_COLUMNS:
@@ -148,16 +150,18 @@ QVariant ObjectTreeModel::data(const QModelIndex& index, int role) const
                 stream << i18n("The name of the class.");
                 break;
             case InstanceCountColumn:
-                stream << i18n("Total number of instances in this reference chain.");
+                stream << i18n("Number of instances of this type that are dominated by the instances of the "
+                               "parent row.");
                 break;
             case GCNumColumn:
                 stream << i18n("GC number after which the snapshot has been taken.");
                 break;
             case ShallowSizeColumn:
-                stream << i18n("Total size of objects of this type in a given reference chain.");
+                stream << i18n("Total size of the instances of this type.");
                 break;
-            case ReferencedSizeColumn:
-                stream << i18n("Total size of objects of this type referenced by other objects in a given reference chain.");
+            case RetainedSizeColumn:
+                stream << i18n("Total size of the instances of this type and of all objects that are only "
+                               "reachable through them.");
                 break;
             case NUM_COLUMNS:
                 break;
@@ -36,7 +36,7 @@ struct ObjectRowData
      gcNum(0),
      allocations(0),
      allocated(0),
-     referenced(0),
+     retained(0),
      parent(nullptr),
      children()
     {}
@@ -45,7 +45,7 @@ struct ObjectRowData
     quint32 gcNum;
     uint64_t allocations;
     uint64_t allocated;
-    uint64_t referenced;
+    uint64_t retained;
     const ObjectRowData* parent;
     QVector<ObjectRowData> children;
     bool operator<(const ObjectRowData& rhs) const
@@ -68,7 +68,7 @@ public:
     {
         InstanceCountColumn,
         ShallowSizeColumn,
-        ReferencedSizeColumn,
+        RetainedSizeColumn,
         GCNumColumn,
         ClassNameColumn,
         NUM_COLUMNS
@@ -29,13 +29,24 @@
 #endif // NO_K_LIB
 
 #include <QDebug>
+#include <QSemaphore>
+#include <QThread>
 
 #include "analyze/accumulatedtracedata.h"
+#include "analyze/calltree.h"
+#include "analyze/heapsnapshots.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <limits>
+#include <numeric>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <functional>
+#include <mutex>
 
 using namespace std;
 
@@ -92,15 +103,22 @@ struct StringCache
 
     LocationData::Ptr location(const IpIndex& index, const InstructionPointer& ip, bool isUntrackedLocation) const
     {
+        lock_guard<mutex> lock(m_locationsMutex);
         // first try a fast index-based lookup
         auto& location = m_locationsMap[index];
         if (!location) {
-            location = frameLocation(ip.frame, ip, isUntrackedLocation);
+            location = internLocation(ip.frame, ip, isUntrackedLocation);
         }
         return location;
     }
 
     LocationData::Ptr frameLocation(const Frame& frame, const InstructionPointer& ip, bool isUntrackedLocation) const
+    {
+        lock_guard<mutex> lock(m_locationsMutex);
+        return internLocation(frame, ip, isUntrackedLocation);
+    }
+
+    LocationData::Ptr internLocation(const Frame& frame, const InstructionPointer& ip, bool isUntrackedLocation) const
     {
         LocationData::Ptr location;
         // slow-path, look for interned location
@@ -113,12 +131,27 @@ struct StringCache
         } else {
             // completely new location, cache it in both containers
             auto interned = make_shared<LocationData>(data);
+            interned->id = m_locationsById.size();
             m_locations.insert(it, interned);
+            m_locationsById.push_back(interned);
             location = interned;
         }
         return location;
     }
 
+    /**
+     * Index the locations that were interned since the last call.
+     *
+     * @return a copy of the index for the views, which use it while the parser adds new locations
+     */
+    SearchIndexPtr searchIndex()
+    {
+        lock_guard<mutex> lock(m_locationsMutex);
+        vector<LocationData::Ptr> locations(m_locationsById.begin() + m_searchIndex.size(), m_locationsById.end());
+        m_searchIndex.addLocations(locations);
+        return make_shared<const SearchIndex>(m_searchIndex);
+    }
+
     void update(const vector<string>& strings)
     {
         transform(strings.begin() + m_strings.size(), strings.end(), back_inserter(m_strings),
@@ -126,8 +159,13 @@ struct StringCache
     }
 
     vector<QString> m_strings;
+    // the views of lazy trees look up locations in the GUI thread while the parser builds other trees
+    mutable mutex m_locationsMutex;
     mutable vector<LocationData::Ptr> m_locations;
+    mutable vector<LocationData::Ptr> m_locationsById;
     mutable QHash<IpIndex, LocationData::Ptr> m_locationsMap;
+    // also guarded by m_locationsMutex, the trees that the views request are built in parallel jobs
+    SearchIndex m_searchIndex;
 
     bool diffMode = false;
 };
@@ -148,6 +186,87 @@ struct ChartMergeData
 };
 
 const uint64_t MAX_CHART_DATAPOINTS = 500; // TODO: make this configurable via the GUI
+// number of buckets of the finest level of the charts, which is shown when zooming in
+const uint64_t MAX_CHART_BUCKETS = 16 * MAX_CHART_DATAPOINTS;
+
+// time between the updates of the results while parsing live data
+const auto LIVE_UPDATE_INTERVAL = chrono::seconds(1);
+
+const int NUM_DISPLAY_IDS = static_cast<int>(AllocationData::DisplayId::shared) + 1;
+
+AllocationData::DisplayId displayId(int index)
+{
+    return static_cast<AllocationData::DisplayId>(index);
+}
+
+// here we store the indices into ChartRows::cost for those IpIndices that
+// are within the top hotspots. This way, we can do one hash lookup in the
+// handleTimeStamp function instead of three when we'd store this data
+// in a per-ChartData hash.
+struct LabelIds
+{
+    int consumed = -1;
+    int instances = -1;
+    int allocations = -1;
+    int allocated = -1;
+    int temporary = -1;
+};
+
+// the chart data of a single metric, all metrics are built in one pass.
+// the rows are those of the finest level, see ChartLevel
+struct MetricChartData
+{
+    ChartData consumedChartData;
+    ChartData instancesChartData;
+    ChartData allocationsChartData;
+    ChartData allocatedChartData;
+    ChartData temporaryChartData;
+    QHash<IpIndex, LabelIds> labelIds;
+    // the allocation slots of the hotspots, only those are read for a new row
+    vector<pair<size_t, LabelIds>> labelSlots;
+    int64_t maxConsumedSinceLastTimeStamp = 0;
+    int64_t maxInstancesSinceLastTimeStamp = 0;
+};
+
+/**
+ * @return the @p rows merged into buckets of @p bucketWidth ms, see ChartLevel.
+ * The first row is kept as it is, so that the charts start at the origin.
+ */
+QVector<ChartRows> mergeBuckets(const QVector<ChartRows>& rows, int64_t bucketWidth)
+{
+    QVector<ChartRows> merged;
+    merged.reserve(rows.size() / 2 + 2);
+    for (const auto& row : rows) {
+        if (merged.size() < 2 || merged.last().timeStamp / bucketWidth != row.timeStamp / bucketWidth) {
+            merged.push_back(row);
+            continue;
+        }
+        auto& bucket = merged.last();
+        bucket.timeStamp = row.timeStamp;
+        for (size_t cost = 0; cost < row.cost.size(); ++cost) {
+            bucket.cost[cost] = max(bucket.cost[cost], row.cost[cost]);
+        }
+    }
+    return merged;
+}
+
+/**
+ * @return the chart with the levels that are needed to show @p finest, whose buckets are
+ * @p bucketWidth ms wide, with at most MAX_CHART_DATAPOINTS rows
+ */
+ChartData toChartLevels(const ChartData& finest, int64_t bucketWidth)
+{
+    auto data = finest;
+    data.levels.push_back({bucketWidth, finest.rows});
+    while (uint64_t(data.levels.last().rows.size()) > MAX_CHART_DATAPOINTS) {
+        bucketWidth *= 2;
+        data.levels.push_back({bucketWidth, mergeBuckets(data.levels.last().rows, bucketWidth)});
+    }
+    data.rows = data.levels.last().rows;
+    return data;
+}
+
+}
 
 struct ParserData final : public AccumulatedTraceData
 {
@@ -165,45 +284,59 @@ struct ParserData final : public AccumulatedTraceData
         if (stringCache.diffMode) {
             return;
         }
-        consumedChartData.rows.reserve(MAX_CHART_DATAPOINTS);
-        instancesChartData.rows.reserve(MAX_CHART_DATAPOINTS);
-        allocatedChartData.rows.reserve(MAX_CHART_DATAPOINTS);
-        allocationsChartData.rows.reserve(MAX_CHART_DATAPOINTS);
-        temporaryChartData.rows.reserve(MAX_CHART_DATAPOINTS);
+        for (int i = 0; i < NUM_DISPLAY_IDS; ++i) {
+            prepareBuildCharts(displayId(i), &charts[i]);
+        }
+        prepareBuildThreadsChart();
+        // for live data the total time is not known yet, the buckets grow while reading instead
+        chartBucketWidth = 1;
+        while (totalTime / chartBucketWidth > int64_t(MAX_CHART_BUCKETS)) {
+            chartBucketWidth *= 2;
+        }
+        chartSlots = 0;
+        buildCharts = true;
+    }
+
+    void prepareBuildCharts(AllocationData::DisplayId display, MetricChartData* chart)
+    {
         // start off with null data at the origin
-        consumedChartData.rows.push_back({});
-        instancesChartData.rows.push_back({});
-        allocatedChartData.rows.push_back({});
-        allocationsChartData.rows.push_back({});
-        temporaryChartData.rows.push_back({});
+        chart->consumedChartData.rows.push_back({});
+        chart->instancesChartData.rows.push_back({});
+        chart->allocatedChartData.rows.push_back({});
+        chart->allocationsChartData.rows.push_back({});
+        chart->temporaryChartData.rows.push_back({});
         // index 0 indicates the total row
-        consumedChartData.labels[0] = i18n("total");
-        instancesChartData.labels[0] = i18n("total");
-        allocatedChartData.labels[0] = i18n("total");
-        allocationsChartData.labels[0] = i18n("total");
-        temporaryChartData.labels[0] = i18n("total");
-
-        buildCharts = true;
-        maxConsumedSinceLastTimeStamp = 0;
-        maxInstancesSinceLastTimeStamp = 0;
+        chart->consumedChartData.labels[0] = i18n("total");
+        chart->instancesChartData.labels[0] = i18n("total");
+        chart->allocatedChartData.labels[0] = i18n("total");
+        chart->allocationsChartData.labels[0] = i18n("total");
+        chart->temporaryChartData.labels[0] = i18n("total");
+
+        chart->maxConsumedSinceLastTimeStamp = 0;
+        chart->maxInstancesSinceLastTimeStamp = 0;
         vector<ChartMergeData> merged;
         merged.reserve(instructionPointers.size());
         // merge the allocation cost by instruction pointer
         // TODO: aggregate by function instead?
         // TODO: traverse the merged call stack up until the first fork
-        for (const auto& alloc : allocations) {
-            const auto &trace = findPrevTrace(alloc.traceIndex);
+        for (size_t slot = 0; allocations.hasData(display) && slot < allocations.size(); ++slot) {
+            const auto stats = allocations.stats(slot, display);
+            if (stats.isEmpty()) {
+                continue;
+            }
+            const auto traceIndex = allocations.traceIndex(slot);
+            const auto &trace = findPrevTrace(traceIndex);
             const auto ip = trace.ipIndex;
-            bool isUntrackedLocation = (!alloc.traceIndex);
+            bool isUntrackedLocation = (!traceIndex);
             auto it = lower_bound(merged.begin(), merged.end(), ip);
             if (it == merged.end() || it->ip != ip) {
                 it = merged.insert(it, {ip, isUntrackedLocation, 0, 0, 0, 0, 0});
             }
-            it->consumed += alloc.getDisplay()->peak; // we want to track the top peaks in the chart
-            it->instances += alloc.getDisplay()->allocations - alloc.getDisplay()->deallocations;
-            it->allocated += alloc.getDisplay()->allocated;
-            it->allocations += alloc.getDisplay()->allocations;
-            it->temporary += alloc.getDisplay()->temporary;
+            it->consumed += stats.peak; // we want to track the top peaks in the chart
+            it->instances += stats.allocations - stats.deallocations;
+            it->allocated += stats.allocated;
+            it->allocations += stats.allocations;
+            it->temporary += stats.temporary;
         }
         // find the top hot spots for the individual data members and remember their
         // IP and store the label
@@ -216,37 +349,126 @@ struct ParserData final : public AccumulatedTraceData
                     break;
                 }
                 const auto ip = alloc.ip;
-                (labelIds[ip].*label) = i + 1;
+                (chart->labelIds[ip].*label) = i + 1;
                 const auto function = stringCache.func(findIp(ip).frame, alloc.isUntrackedLocation);
                 const auto module = stringCache.module(findIp(ip));
                 data->labels[i + 1] = i18nc("Function and module, if known", "%1 (%2)", function, module);
             }
         };
-        findTopChartEntries(&ChartMergeData::consumed, &LabelIds::consumed, &consumedChartData);
-        findTopChartEntries(&ChartMergeData::instances, &LabelIds::instances, &instancesChartData);
-        findTopChartEntries(&ChartMergeData::allocated, &LabelIds::allocated, &allocatedChartData);
-        findTopChartEntries(&ChartMergeData::allocations, &LabelIds::allocations, &allocationsChartData);
-        findTopChartEntries(&ChartMergeData::temporary, &LabelIds::temporary, &temporaryChartData);
+        findTopChartEntries(&ChartMergeData::consumed, &LabelIds::consumed, &chart->consumedChartData);
+        findTopChartEntries(&ChartMergeData::instances, &LabelIds::instances, &chart->instancesChartData);
+        findTopChartEntries(&ChartMergeData::allocated, &LabelIds::allocated, &chart->allocatedChartData);
+        findTopChartEntries(&ChartMergeData::allocations, &LabelIds::allocations, &chart->allocationsChartData);
+        findTopChartEntries(&ChartMergeData::temporary, &LabelIds::temporary, &chart->temporaryChartData);
+    }
+
+    // the threads with the highest peaks get a column, the others only count for the total
+    void prepareBuildThreadsChart()
+    {
+        threadsChartData.rows.push_back({});
+        threadsChartData.labels[0] = i18n("total");
+        chartThreads.clear();
+        if (threads.size() < 2) {
+            // the allocations aren't attributed to threads
+            return;
+        }
+        for (uint32_t thread = 0; thread < threads.size(); ++thread) {
+            if (threads[thread].cost.peak) {
+                chartThreads.push_back(thread);
+            }
+        }
+        sort(chartThreads.begin(), chartThreads.end(),
+             [this](uint32_t l, uint32_t r) { return threads[l].cost.peak > threads[r].cost.peak; });
+        chartThreads.resize(min(chartThreads.size(), size_t(ChartRows::MAX_NUM_COST - 1)));
+        for (size_t i = 0; i < chartThreads.size(); ++i) {
+            threadsChartData.labels[i + 1] = threadLabel(chartThreads[i]);
+        }
+    }
+
+    QString threadLabel(uint32_t thread) const
+    {
+        if (!thread) {
+            return i18n("unknown threads");
+        }
+        const auto& name = stringify(threads[thread].name);
+        return name.empty() ? i18n("thread %1", thread)
+                            : i18nc("%1: thread name, %2: thread id", "%1 (thread %2)",
+                                    QString::fromStdString(name), thread);
     }
 
     void handleTimeStamp(int64_t /*oldStamp*/, int64_t newStamp)
+    {
+        updateCharts(newStamp);
+
+        if (publishLive) {
+            const auto now = chrono::steady_clock::now();
+            if (now - lastLivePublish >= LIVE_UPDATE_INTERVAL) {
+                lastLivePublish = now;
+                publishLive();
+            }
+        }
+    }
+
+    void updateCharts(int64_t newStamp)
     {
         if (!buildCharts || stringCache.diffMode) {
             return;
         }
-        maxConsumedSinceLastTimeStamp = max(maxConsumedSinceLastTimeStamp, totalCost.getDisplay()->leaked);
-        maxInstancesSinceLastTimeStamp = max(maxInstancesSinceLastTimeStamp, totalCost.getDisplay()->allocations - totalCost.getDisplay()->deallocations);
-        const int64_t diffBetweenTimeStamps = totalTime / MAX_CHART_DATAPOINTS;
-        if (newStamp != totalTime && newStamp - lastTimeStamp < diffBetweenTimeStamps) {
+        handleTotalCostUpdate();
+        // add one row per bucket, the totals keep their maximum until the next row
+        const auto& rows = charts[0].consumedChartData.rows;
+        if (newStamp != totalTime && rows.last().timeStamp / chartBucketWidth == newStamp / chartBucketWidth) {
             return;
         }
-        const auto nowConsumed = maxConsumedSinceLastTimeStamp;
-        maxConsumedSinceLastTimeStamp = 0;
 
-        const auto nowInstances = maxInstancesSinceLastTimeStamp;
-        maxInstancesSinceLastTimeStamp = 0;
+        updateChartSlots();
+        for (int i = 0; i < NUM_DISPLAY_IDS; ++i) {
+            addChartRows(displayId(i), newStamp, &charts[i]);
+        }
+        addThreadsChartRow(newStamp);
+        addFragmentationChartRow(newStamp);
+
+        if (uint64_t(rows.size()) > MAX_CHART_BUCKETS) {
+            // for live data the total time grows as we go
+            chartBucketWidth *= 2;
+            for (auto& chart : charts) {
+                for (auto data : {&chart.consumedChartData, &chart.instancesChartData, &chart.allocatedChartData,
+                                  &chart.allocationsChartData, &chart.temporaryChartData}) {
+                    data->rows = mergeBuckets(data->rows, chartBucketWidth);
+                }
+            }
+            threadsChartData.rows = mergeBuckets(threadsChartData.rows, chartBucketWidth);
+            fragmentationChartData.rows = mergeBuckets(fragmentationChartData.rows, chartBucketWidth);
+        }
+    }
 
-        lastTimeStamp = newStamp;
+    // assign the allocation slots that were added since the last row to the hotspots
+    void updateChartSlots()
+    {
+        const bool hasLabels =
+            any_of(begin(charts), end(charts), [](const MetricChartData& chart) { return !chart.labelIds.isEmpty(); });
+        if (!hasLabels) {
+            chartSlots = allocations.size();
+            return;
+        }
+        for (; chartSlots < allocations.size(); ++chartSlots) {
+            const auto ip = findPrevTrace(allocations.traceIndex(chartSlots)).ipIndex;
+            for (auto& chart : charts) {
+                auto it = chart.labelIds.constFind(ip);
+                if (it != chart.labelIds.constEnd()) {
+                    chart.labelSlots.push_back({chartSlots, *it});
+                }
+            }
+        }
+    }
+
+    void addChartRows(AllocationData::DisplayId display, int64_t newStamp, MetricChartData* chart)
+    {
+        const auto nowConsumed = chart->maxConsumedSinceLastTimeStamp;
+        chart->maxConsumedSinceLastTimeStamp = 0;
+
+        const auto nowInstances = chart->maxInstancesSinceLastTimeStamp;
+        chart->maxInstancesSinceLastTimeStamp = 0;
 
         // create the rows
         auto createRow = [](int64_t timeStamp, int64_t totalCost) {
@@ -255,11 +477,12 @@ struct ParserData final : public AccumulatedTraceData
             row.cost[0] = totalCost;
             return row;
         };
+        const auto total = totalCost.getDisplay(display);
         auto consumed = createRow(newStamp, nowConsumed);
         auto instances = createRow(newStamp, nowInstances);
-        auto allocated = createRow(newStamp, totalCost.getDisplay()->allocated);
-        auto allocs = createRow(newStamp, totalCost.getDisplay()->allocations);
-        auto temporary = createRow(newStamp, totalCost.getDisplay()->temporary);
+        auto allocated = createRow(newStamp, total->allocated);
+        auto allocs = createRow(newStamp, total->allocations);
+        auto temporary = createRow(newStamp, total->temporary);
 
         // if the cost is non-zero and the ip corresponds to a hotspot function
         // selected in the labels,
@@ -270,31 +493,73 @@ struct ParserData final : public AccumulatedTraceData
             }
             rows->cost[labelId] += cost;
         };
-        for (const auto& alloc : allocations) {
-            const auto ip = findPrevTrace(alloc.traceIndex).ipIndex;
-            auto it = labelIds.constFind(ip);
-            if (it == labelIds.constEnd()) {
-                continue;
+        if (!chart->labelIds.isEmpty() && allocations.hasData(display)) {
+            // only read the columns that are shown in the charts
+            const auto leaked = allocations.column(display, AllocationTable::Leaked);
+            const auto allocationCount = allocations.column(display, AllocationTable::Allocations);
+            const auto deallocationCount = allocations.column(display, AllocationTable::Deallocations);
+            const auto allocatedBytes = allocations.column(display, AllocationTable::Allocated);
+            const auto temporaryCount = allocations.column(display, AllocationTable::Temporary);
+            for (const auto& labelSlot : chart->labelSlots) {
+                const auto slot = labelSlot.first;
+                const auto& labelIds = labelSlot.second;
+                addDataToRow(leaked[slot], labelIds.consumed, &consumed);
+                addDataToRow(allocationCount[slot] - deallocationCount[slot], labelIds.instances, &instances);
+                addDataToRow(allocatedBytes[slot], labelIds.allocated, &allocated);
+                addDataToRow(allocationCount[slot], labelIds.allocations, &allocs);
+                addDataToRow(temporaryCount[slot], labelIds.temporary, &temporary);
             }
-            const auto& labelIds = *it;
-            addDataToRow(alloc.getDisplay()->leaked, labelIds.consumed, &consumed);
-            addDataToRow(alloc.getDisplay()->allocations - alloc.getDisplay()->deallocations, labelIds.instances, &instances);
-            addDataToRow(alloc.getDisplay()->allocated, labelIds.allocated, &allocated);
-            addDataToRow(alloc.getDisplay()->allocations, labelIds.allocations, &allocs);
-            addDataToRow(alloc.getDisplay()->temporary, labelIds.temporary, &temporary);
         }
         // add the rows for this time stamp
-        consumedChartData.rows << consumed;
-        instancesChartData.rows << instances;
-        allocatedChartData.rows << allocated;
-        allocationsChartData.rows << allocs;
-        temporaryChartData.rows << temporary;
+        chart->consumedChartData.rows << consumed;
+        chart->instancesChartData.rows << instances;
+        chart->allocatedChartData.rows << allocated;
+        chart->allocationsChartData.rows << allocs;
+        chart->temporaryChartData.rows << temporary;
+    }
+
+    void addThreadsChartRow(int64_t newStamp)
+    {
+        ChartRows row;
+        row.timeStamp = newStamp;
+        row.cost[0] = totalCost.malloc.leaked;
+        for (size_t i = 0; i < chartThreads.size(); ++i) {
+            row.cost[i + 1] = threads[chartThreads[i]].cost.leaked;
+        }
+        threadsChartData.rows << row;
+    }
+
+    // the chart starts with the first fragmentation record, so traces without them have no rows
+    void addFragmentationChartRow(int64_t newStamp)
+    {
+        if (fragmentationChartData.rows.isEmpty()) {
+            if (!fragmentation.spanned) {
+                return;
+            }
+            fragmentationChartData.labels[0] = i18n("pages spanned");
+            fragmentationChartData.labels[1] = i18n("live bytes");
+            fragmentationChartData.labels[2] = i18n("sparse pages");
+        }
+        ChartRows row;
+        row.timeStamp = newStamp;
+        row.cost[0] = fragmentation.spanned;
+        row.cost[1] = fragmentation.live;
+        row.cost[2] = fragmentation.sparse;
+        fragmentationChartData.rows << row;
     }
 
     void handleTotalCostUpdate()
     {
-        maxConsumedSinceLastTimeStamp = max(maxConsumedSinceLastTimeStamp, totalCost.getDisplay()->leaked);
-        maxInstancesSinceLastTimeStamp = max(maxInstancesSinceLastTimeStamp, totalCost.getDisplay()->allocations - totalCost.getDisplay()->deallocations);
+        if (!buildCharts) {
+            return;
+        }
+        for (int i = 0; i < NUM_DISPLAY_IDS; ++i) {
+            const auto total = totalCost.getDisplay(displayId(i));
+            auto& chart = charts[i];
+            chart.maxConsumedSinceLastTimeStamp = max(chart.maxConsumedSinceLastTimeStamp, total->leaked);
+            chart.maxInstancesSinceLastTimeStamp =
+                max(chart.maxInstancesSinceLastTimeStamp, total->allocations - total->deallocations);
+        }
     }
 
     void handleAllocation(const AllocationInfo& info, const AllocationIndex index)
@@ -324,361 +589,271 @@ struct ParserData final : public AccumulatedTraceData
     };
     vector<CountedAllocationInfo> allocationInfoCounter;
 
-    ChartData consumedChartData;
-    ChartData instancesChartData;
-    ChartData allocationsChartData;
-    ChartData allocatedChartData;
-    ChartData temporaryChartData;
-    // here we store the indices into ChartRows::cost for those IpIndices that
-    // are within the top hotspots. This way, we can do one hash lookup in the
-    // handleTimeStamp function instead of three when we'd store this data
-    // in a per-ChartData hash.
-    struct LabelIds
-    {
-        int consumed = -1;
-        int instances = -1;
-        int allocations = -1;
-        int allocated = -1;
-        int temporary = -1;
-    };
-    QHash<IpIndex, LabelIds> labelIds;
-    int64_t maxConsumedSinceLastTimeStamp = 0;
-    int64_t maxInstancesSinceLastTimeStamp = 0;
-    int64_t lastTimeStamp = 0;
+    MetricChartData charts[NUM_DISPLAY_IDS];
+    // only for the malloc allocations, whose cost is attributed to threads
+    ChartData threadsChartData;
+    // the threads of the columns of threadsChartData after the total
+    vector<uint32_t> chartThreads;
+    // the pages spanned by the malloc heap, followed by its live bytes and sparse pages
+    ChartData fragmentationChartData;
+    // width of the buckets of the finest chart level in ms
+    int64_t chartBucketWidth = 1;
+    // number of allocation slots that updateChartSlots() looked at
+    size_t chartSlots = 0;
+
+    // set while parsing live data, called periodically to publish the intermediate results
+    function<void()> publishLive;
+    chrono::steady_clock::time_point lastLivePublish;
 
     StringCache stringCache;
 
     bool buildCharts = false;
 };
 
-struct ObjectNode {
-    ObjectNode()
-    : m_children(), index(0), visited(false)
-    {
-    }
-
-    std::vector<ObjectNode*> m_children;
-    size_t index;
-    bool visited;
-
-    static std::unordered_map<uint64_t, std::unique_ptr<ObjectNode>> nodes;
-};
-
-std::unordered_map<uint64_t, std::unique_ptr<ObjectNode>> ObjectNode::nodes;
-
-struct TypeTree {
-    TypeTree()
-    : m_classIndex(),
-      m_parents(),
-      m_uniqueObjects(),
-      m_referencedSize(0),
-      m_gcNum(0)
-    {
-    }
+namespace {
 
-    TypeTree(const TypeTree& rhs)
-    : m_classIndex(rhs.m_classIndex),
-      m_parents(),
-      m_uniqueObjects(rhs.m_uniqueObjects),
-      m_referencedSize(rhs.m_referencedSize),
-      m_gcNum(rhs.m_gcNum)
-    {
-        for (auto& rParent: rhs.m_parents) {
-            m_parents.push_back(std::unique_ptr<TypeTree>(new TypeTree(*rParent)));
+/**
+ * Append the groups of @p snapshot as rows to @p rows, with the groups that are dominated
+ * by the objects of a group as the children of its row.
+ */
+void appendSnapshotRows(const ParserData& data, const HeapSnapshot& snapshot, ObjectTreeData* rows)
+{
+    const auto& groups = snapshot.groups;
+    // the children of a group come after it, so they are complete when it is moved to its parent
+    vector<ObjectRowData> groupRows(groups.size());
+    for (size_t i = groups.size() - 1; i > 0; --i) {
+        const auto& group = groups[i];
+        auto& row = groupRows[i];
+        row.gcNum = snapshot.gcNum;
+        row.classIndex = group.classIndex.index;
+        row.className = data.stringify(group.classIndex);
+        row.allocations = group.instances;
+        row.allocated = group.shallowSize;
+        row.retained = group.retainedSize;
+        if (group.parent) {
+            groupRows[group.parent].children.append(std::move(row));
+        } else {
+            rows->append(std::move(row));
         }
     }
+}
 
-    ~TypeTree() {
-        m_parents.clear();
-        m_uniqueObjects.clear();
-    }
-
-    static std::unique_ptr<TypeTree> create(ParserData& data, ObjectNode* node) {
-        auto TT = std::unique_ptr<TypeTree>(new TypeTree());
-        TT->m_classIndex = data.objectTreeNodes[node->index].classIndex;
-        TT->m_gcNum = data.objectTreeNodes[node->index].gcNum;
-        TT->m_uniqueObjects[node->index] = 1;
-        return TT;
-    }
+TreeData mergeAllocations(const ParserData& data, AllocationData::DisplayId display, bool bIncludeLeaves)
+{
+    TreeData topRows;
+    auto ipLocation = [&data](IpIndex ipIndex, const InstructionPointer& ip, bool isUntrackedLocation) {
+        return data.stringCache.location(ipIndex, ip, isUntrackedLocation);
+    };
+    auto frameLocation = [&data](const Frame& frame, const InstructionPointer& ip, bool isUntrackedLocation) {
+        return data.stringCache.frameLocation(frame, ip, isUntrackedLocation);
+    };
+    // merge allocations, leave parent pointers invalid (their location may change)
+    for (size_t slot = 0; data.allocations.hasData(display) && slot < data.allocations.size(); ++slot) {
+        const AllocationData::Stats stats = data.allocations.stats(slot, display);
 
-    static std::vector<std::unique_ptr<TypeTree>> createBottomUp(ParserData& data, ObjectNode* node) {
-        node->visited = true;
-        std::vector<std::unique_ptr<TypeTree>> result;
-        if (data.objectTreeNodes[node->index].classIndex.index == 0 && node->m_children.size() == 0) {
-            node->visited = false;
-            return result;
+        if (stats.isEmpty()) {
+            continue;
         }
 
-        if (node->m_children.size() == 0) {
-            result.push_back(create(data, node));
-            node->visited = false;
-            return result;
-        }
+        auto traceIndex = data.allocations.traceIndex(slot);
 
-        for (ObjectNode* child: node->m_children) {
-            if (child->visited)
-                continue;
-            auto leaves = TypeTree::createBottomUp(data, child);
-            for (auto& leaf: leaves) {
-                auto parent = create(data, node);
-                TypeTree* childIt = leaf.get();
-                while (childIt->m_parents.size() > 0) {
-                    assert(childIt->m_parents.size() == 1 && "Invalid number of m_parents");
-                    childIt = childIt->m_parents[0].get();
-                }
-                childIt->m_parents.push_back(std::move(parent));
-                result.push_back(std::move(leaf));
-            }
+        if (!bIncludeLeaves) {
+            traceIndex = data.findTrace(traceIndex).parentIndex;
         }
-        node->visited = false;
-        return result;
-    }
 
-    void merge(TypeTree *other) {
-        for (auto &grandparent: other->m_parents)
-            m_parents.push_back(std::move(grandparent));
-        for (auto& uo: other->m_uniqueObjects) {
-            m_uniqueObjects[uo.first]++;
-        }
+        CallTree::addBacktrace(&topRows, data, traceIndex, stats, display, ipLocation, frameLocation);
     }
+    // now set the parents, the data is constant from here on
+    CallTree::setParents(topRows, nullptr);
 
-    void mergeSubtrees() {
-        std::unordered_map<uint64_t,
-                std::vector<std::unique_ptr<TypeTree>>> classCounters;
-
-        for (auto& parent: m_parents) {
-            classCounters[parent->m_classIndex.index].push_back(std::move(parent));
-        }
-        m_parents.erase(m_parents.begin(), m_parents.end());
+    return topRows;
+}
 
-        std::vector<std::unique_ptr<TypeTree>> newParents;
+using LazyTree = CallTree::LazyTree<LocationData::Ptr>;
 
-        for (auto it = classCounters.begin(),
-             end = classCounters.end(); it != end; ++it) {
-            auto combinedParent = std::unique_ptr<TypeTree>(new TypeTree());
-            combinedParent->m_classIndex.index = it->first;
-            auto& subtrees = it->second;
-            combinedParent->m_gcNum = m_gcNum;
-            for (auto& parent: subtrees) {
-                combinedParent->merge(parent.get());
-            }
-            combinedParent->mergeSubtrees();
+/**
+ * Collect the allocations of @p display for a tree whose rows are merged on demand, like
+ * mergeAllocations does for the complete bottom-up tree.
+ */
+shared_ptr<LazyTree> lazyAllocations(const ParserData& data, AllocationData::DisplayId display,
+                                     LazyTree::Direction direction, bool bIncludeLeaves)
+{
+    const auto stringCache = &data.stringCache;
+    auto ipLocation = [stringCache](IpIndex ipIndex, const InstructionPointer& ip, bool isUntrackedLocation) {
+        return stringCache->location(ipIndex, ip, isUntrackedLocation);
+    };
+    auto frameLocation = [stringCache](const Frame& frame, const InstructionPointer& ip, bool isUntrackedLocation) {
+        return stringCache->frameLocation(frame, ip, isUntrackedLocation);
+    };
+    auto tree = make_shared<LazyTree>(data, display, direction, ipLocation, frameLocation);
+    for (size_t slot = 0; data.allocations.hasData(display) && slot < data.allocations.size(); ++slot) {
+        const AllocationData::Stats stats = data.allocations.stats(slot, display);
 
-            newParents.push_back(std::move(combinedParent));
+        if (stats.isEmpty()) {
+            continue;
         }
 
-        m_parents = std::move(newParents);
-    }
-
-    void unroll() {
-        std::function<std::vector<unique_ptr<TypeTree>>(TypeTree *tt)> gp;
-        gp = [&gp](TypeTree *tt) -> std::vector<unique_ptr<TypeTree>> {
-            std::vector<std::unique_ptr<TypeTree>> parents;
-            for (auto& parent: tt->m_parents) {
-                parents.push_back(std::unique_ptr<TypeTree>(new TypeTree(*parent)));
-            }
+        auto traceIndex = data.allocations.traceIndex(slot);
 
-            std::vector<std::unique_ptr<TypeTree>> grandparents;
-            for (auto& parent: parents) {
-                auto gps = gp(parent.get());
-                for (auto& p: gps) {
-                    grandparents.push_back(std::move(p));
-                }
-            }
-            for (auto& p: grandparents) {
-                parents.push_back(std::move(p));
-            }
-
-            return parents;
-        };
-
-        m_parents = gp(this);
-        mergeSubtrees();
-    }
-
-    size_t addRefSize(ParserData& data, size_t objectIndex, size_t leafSize) {
-        int result = 0;
-        for (auto& uo: m_uniqueObjects) {
-            size_t uoIndex = uo.first;
-            auto& uoChildren = ObjectNode::nodes[data.objectTreeNodes[uoIndex].objectPtr]->m_children;
-            for (auto &uoChild: uoChildren) {
-                if (uoChild->index == objectIndex) {
-                    if (m_parents.size() == 0) {
-                        result += 1;
-                    }
-                    for (auto& parent: m_parents)
-                        result += parent->addRefSize(data, uoIndex, leafSize);
-                }
-            }
+        if (!bIncludeLeaves) {
+            traceIndex = data.findTrace(traceIndex).parentIndex;
         }
-        m_referencedSize += result * leafSize;
-        return result;
-    }
 
-    ClassIndex m_classIndex;
-    std::vector<std::unique_ptr<TypeTree>> m_parents;
-    std::unordered_map<size_t, uint64_t> m_uniqueObjects;
-    uint64_t m_referencedSize;
-    int m_gcNum;
-};
+        tree->addAllocation(traceIndex, stats);
+    }
+    return tree;
+}
 
-void setParents(QVector<RowData>& children, const RowData* parent)
+/**
+ * @return the top rows of @p tree, the views merge the other rows when they get expanded
+ */
+LazyTreeData toLazyTreeData(const shared_ptr<ParserData>& data, const shared_ptr<LazyTree>& tree)
 {
-    for (auto& row : children) {
-        row.parent = parent;
-        setParents(row.children, &row);
-    }
+    // the rows are expanded after the parser is done, so keep the traces alive
+    return {tree->topRows<TreeData>(), [data, tree](RowData* row) { tree->expand(row); }};
 }
 
-TreeData mergeAllocations(const ParserData& data, bool bIncludeLeaves)
+/**
+ * Build the result of @p Builder from the top rows of @p bottomUpData, which are independent of each
+ * other. The rows are split into parts that are built in parallel and then merged in their order,
+ * so the result doesn't depend on the scheduling. The calling thread builds parts as well, thus
+ * this makes progress even when all threads of the pool are busy.
+ */
+template <typename Builder>
+Builder buildInParts(const TreeData& bottomUpData)
 {
-    TreeData topRows;
-    auto addRow = [](TreeData* rows, const LocationData::Ptr& location, const Allocation::Stats& cost, AllocationData::CoreCLRType type) -> TreeData* {
-        auto it = lower_bound(rows->begin(), rows->end(), location);
-        if (it != rows->end() && it->location == location && it->stackType == type)
-        {
-            it->cost += cost;
-        } else
+    struct Parts
+    {
+        Parts(const TreeData& rows, int count)
+            : rows(rows)
+            , builders(count)
         {
-            it = rows->insert(it, {cost, location, nullptr, {}, type});
         }
-        return &it->children;
-    };
-    // merge allocations, leave parent pointers invalid (their location may change)
-    for (const auto& allocation : data.allocations) {
-        const AllocationData::Stats *stats = allocation.getDisplay();
 
-        if (stats->isEmpty()) {
-            continue;
-        }
-
-        auto traceIndex = allocation.traceIndex;
-
-        if (!bIncludeLeaves) {
-            traceIndex = data.findTrace(traceIndex).parentIndex;
+        // build the next part that no thread started yet, @return false when there is none
+        bool buildNext()
+        {
+            const int part = next++;
+            const int count = builders.size();
+            if (part >= count) {
+                return false;
+            }
+            builders[part].addLeaves(rows.constBegin() + rows.size() * part / count,
+                                     rows.constBegin() + rows.size() * (part + 1) / count);
+            finished.release();
+            return true;
         }
 
-        auto rows = &topRows;
-        do {
-            bool isUntrackedLocation = (!traceIndex);
+        const TreeData rows;
+        vector<Builder> builders;
+        atomic<int> next{0};
+        QSemaphore finished;
+    };
 
-            const auto& trace = data.findTrace(traceIndex);
-            const auto& ip = data.findIp(trace.ipIndex);
-            if (!(AccumulatedTraceData::isHideUnmanagedStackParts && !ip.isManaged)) {
-                auto location = data.stringCache.location(trace.ipIndex, ip, isUntrackedLocation);
-                AllocationData::CoreCLRType clrType = AccumulatedTraceData::isShowCoreCLRPartOption ? trace.nodeType : AllocationData::CoreCLRType::nonCoreCLR;
-                rows = addRow(rows, location, *stats, clrType);
-                for (const auto& inlined : ip.inlined) {
-                    auto inlinedLocation = data.stringCache.frameLocation(inlined, ip, isUntrackedLocation);
-                    rows = addRow(rows, inlinedLocation, *stats, clrType);
-                }
-            }
-            if (data.isStopIndex(ip.frame.functionIndex)) {
-                break;
-            }
-            traceIndex = trace.parentIndex;
-        } while (traceIndex);
+#ifdef THREAD_WEAVER
+    const int numParts = max(1, min(QThread::idealThreadCount(), bottomUpData.size()));
+#else
+    const int numParts = 1;
+#endif
+    // jobs that start after all parts are built just return, so they share the parts
+    auto parts = make_shared<Parts>(bottomUpData, numParts);
+#ifdef THREAD_WEAVER
+    for (int i = 1; i < numParts; ++i) {
+        ThreadWeaver::stream() << ThreadWeaver::make_job([parts]() { parts->buildNext(); });
     }
-    // now set the parents, the data is constant from here on
-    setParents(topRows, nullptr);
-
-    return topRows;
-}
+#endif
+    while (parts->buildNext()) {
+    }
+    parts->finished.acquire(numParts);
 
-RowData* findByLocation(const RowData& row, QVector<RowData>* data)
-{
-    for (int i = 0; i < data->size(); ++i) {
-        if (data->at(i).location == row.location) {
-            return data->data() + i;
-        }
+    auto& result = parts->builders.front();
+    for (int i = 1; i < numParts; ++i) {
+        result.merge(parts->builders[i]);
     }
-    return nullptr;
+    return std::move(result);
 }
 
-AllocationData::Stats buildTopDown(const TreeData& bottomUpData, TreeData* topDownData)
+/**
+ * Builds the caller/callee data from the leaves of a bottom-up tree, in parts like
+ * CallTree::TopDownBuilder.
+ */
+class CallerCalleeBuilder
 {
-    AllocationData::Stats totalCost;
-    for (const auto& row : bottomUpData) {
-        // recurse and find the cost attributed to children
-        const auto childCost = buildTopDown(row.children, topDownData);
-        if (childCost != row.cost) {
-            // this row is (partially) a leaf
-            const auto cost = row.cost - childCost;
-
-            // bubble up the parent chain to build a top-down tree
-            auto node = &row;
-            auto stack = topDownData;
-            while (node) {
-                auto data = findByLocation(*node, stack);
-                if (!data) {
-                    // create an empty top-down item for this bottom-up node
-                    *stack << RowData{{}, node->location, nullptr, {}, node->stackType};
-                    data = &stack->back();
+public:
+    template <typename Iterator>
+    AllocationData::Stats addLeaves(Iterator begin, Iterator end)
+    {
+        AllocationData::Stats totalCost;
+        for (auto it = begin; it != end; ++it) {
+            const auto& row = *it;
+            // recurse to find a leaf
+            const auto childCost = addLeaves(row.children.begin(), row.children.end());
+            if (childCost != row.cost) {
+                // this row is (partially) a leaf
+                const auto cost = row.cost - childCost;
+
+                // leaf node found, bubble up the parent chain to add cost for all frames
+                // to the caller/callee data. we must not count symbols more than once per
+                // leaf, so the entries remember the leaf they were counted for last
+                ++m_leaf;
+                for (auto node = &row; node; node = node->parent) {
+                    auto& entry = m_entries[node->location];
+                    if (entry.leaf != m_leaf) {
+                        entry.leaf = m_leaf;
+                        entry.inclusiveCost += cost;
+                        if (!node->parent) {
+                            entry.selfCost += cost;
+                        }
+                    }
                 }
-                // always use the leaf node's cost and propagate that one up the chain
-                // otherwise we'd count the cost of some nodes multiple times
-                data->cost += cost;
-                stack = &data->children;
-                node = node->parent;
             }
+            totalCost += row.cost;
         }
-        totalCost += row.cost;
+        return totalCost;
     }
-    return totalCost;
-}
 
-QVector<RowData> toTopDownData(const QVector<RowData>& bottomUpData)
-{
-    QVector<RowData> topRows;
-    buildTopDown(bottomUpData, &topRows);
-    // now set the parents, the data is constant from here on
-    setParents(topRows, nullptr);
-    return topRows;
-}
+    void merge(const CallerCalleeBuilder& other)
+    {
+        for (const auto& entry : other.m_entries) {
+            auto& merged = m_entries[entry.first];
+            merged.inclusiveCost += entry.second.inclusiveCost;
+            merged.selfCost += entry.second.selfCost;
+        }
+    }
 
-AllocationData::Stats buildCallerCallee(const TreeData& bottomUpData, CallerCalleeRows* callerCalleeData)
-{
-    AllocationData::Stats totalCost;
-    for (const auto& row : bottomUpData) {
-        // recurse to find a leaf
-        const auto childCost = buildCallerCallee(row.children, callerCalleeData);
-        if (childCost != row.cost) {
-            // this row is (partially) a leaf
-            const auto cost = row.cost - childCost;
-
-            // leaf node found, bubble up the parent chain to add cost for all frames
-            // to the caller/callee data. this is done top-down since we must not count
-            // symbols more than once in the caller-callee data
-            QSet<LocationData::Ptr> recursionGuard;
-
-            auto node = &row;
-            while (node) {
-                const auto& location = node->location;
-                if (!recursionGuard.contains(location)) { // aggregate caller-callee data
-                    auto it = lower_bound(callerCalleeData->begin(), callerCalleeData->end(), location,
-                        [](const CallerCalleeData& lhs, const LocationData::Ptr& rhs) { return lhs.location < rhs; });
-                    if (it == callerCalleeData->end() || it->location != location) {
-                        it = callerCalleeData->insert(it, {{}, {}, location});
-                    }
-                    it->inclusiveCost += cost;
-                    if (!node->parent) {
-                        it->selfCost += cost;
-                    }
-                    recursionGuard.insert(location);
-                }
-                node = node->parent;
-            }
+    /// @return the caller/callee data, sorted by location as CallerCalleeModel expects it
+    CallerCalleeRows rows() const
+    {
+        CallerCalleeRows rows;
+        rows.reserve(m_entries.size());
+        for (const auto& entry : m_entries) {
+            rows.push_back({entry.second.inclusiveCost, entry.second.selfCost, entry.first});
         }
-        totalCost += row.cost;
+        sort(rows.begin(), rows.end(),
+             [](const CallerCalleeData& lhs, const CallerCalleeData& rhs) { return lhs.location < rhs.location; });
+        return rows;
     }
-    return totalCost;
+
+private:
+    struct Entry
+    {
+        AllocationData::Stats inclusiveCost;
+        AllocationData::Stats selfCost;
+        uint64_t leaf = 0;
+    };
+
+    unordered_map<LocationData::Ptr, Entry> m_entries;
+    uint64_t m_leaf = 0;
+};
+
+TreeData toTopDownData(const TreeData& bottomUpData)
+{
+    return buildInParts<CallTree::TopDownBuilder<TreeData>>(bottomUpData).rows();
 }
 
 CallerCalleeRows toCallerCalleeData(const QVector<RowData>& bottomUpData, bool diffMode)
 {
-    CallerCalleeRows callerCalleeRows;
-
-    buildCallerCallee(bottomUpData, &callerCalleeRows);
+    auto callerCalleeRows = buildInParts<CallerCalleeBuilder>(bottomUpData).rows();
 
     if (diffMode) {
         // remove rows without cost
@@ -775,72 +950,16 @@ void setObjectParents(QVector<ObjectRowData>& children, const ObjectRowData* par
     }
 }
 
-ObjectRowData objectRowDataFromTypeTree(ParserData& data, TypeTree* tree) {
-    ObjectRowData rowData;
-    rowData.gcNum = tree->m_gcNum;
-    rowData.classIndex = tree->m_classIndex.index;
-    rowData.className = data.stringify(tree->m_classIndex);
-    rowData.allocations = tree->m_uniqueObjects.size();
-    rowData.referenced = tree->m_referencedSize;
-    for (auto &uo: tree->m_uniqueObjects) {
-        rowData.allocated += data.allocationInfos[data.objectTreeNodes[uo.first].allocIndex.index].size;
-    }
-    for (auto& parent: tree->m_parents)
-        rowData.children.push_back(objectRowDataFromTypeTree(data, parent.get()));
-    return rowData;
-}
-
-std::unique_ptr<ObjectNode> buildObjectGraph(ParserData& data, size_t &nodeIndex) {
-    auto node = std::unique_ptr<ObjectNode>(new ObjectNode());
-    Q_ASSERT(nodeIndex < data.objectTreeNodes.size() && "Heap snapshot data is incomplete");
-    ObjectTreeNode &dataNode = data.objectTreeNodes[nodeIndex];
-    node->index = nodeIndex;
-    nodeIndex++;
-    for (size_t i = 0; i < dataNode.numChildren; ++i) {
-        // FIXME: this check will not be needed once we can ensure the
-        // integrity of the trace.
-        // https://github.sec.samsung.net/dotnet/profiler/issues/24
-        Q_ASSERT(dataNode.gcNum == data.objectTreeNodes[nodeIndex].gcNum && "Heap snapshot data is incomplete");
-
-        uint64_t childPtr = data.objectTreeNodes[nodeIndex].objectPtr;
-        if (ObjectNode::nodes.find(childPtr) == ObjectNode::nodes.end()) {
-            ObjectNode::nodes.insert(std::pair<uint64_t, std::unique_ptr<ObjectNode>>(childPtr, std::move(buildObjectGraph(data, nodeIndex))));
-        } else {
-            Q_ASSERT(data.objectTreeNodes[nodeIndex].numChildren == 0 && "Incorrect number of children");
-            ++nodeIndex;
-        }
-        ObjectNode *child = ObjectNode::nodes[childPtr].get();
-        node->m_children.push_back(child);
-    }
-    return node;
-}
-
-ObjectTreeData buildObjectTree(ParserData& data)
+ObjectTreeData buildObjectTree(const ParserData& data)
 {
     ObjectTreeData ret;
     size_t nodeIndex = 0;
     while (nodeIndex < data.objectTreeNodes.size()) {
-        std::unique_ptr<ObjectNode> node = std::move(buildObjectGraph(data, nodeIndex));
-        auto nodePtr = node.get();
-        ObjectNode::nodes.insert(std::pair<uint64_t, std::unique_ptr<ObjectNode>>(
-                                     0, std::move(node)));
-        TypeTree root;
-        root.m_gcNum = data.objectTreeNodes[nodePtr->index].gcNum;
-        root.m_parents = std::move(TypeTree::createBottomUp(data, nodePtr));
-        root.mergeSubtrees();
-        root.unroll();
-        for (auto& parent: root.m_parents) {
-            for (auto &uo: parent->m_uniqueObjects) {
-                for (auto &grandparent: parent->m_parents) {
-                    size_t leafSize = data.allocationInfos[data.objectTreeNodes[uo.first].allocIndex.index].size;
-                    size_t chains = grandparent->addRefSize(data, uo.first, leafSize);
-                    parent->m_referencedSize += chains * leafSize;
-                }
-            }
-            ret.push_back(objectRowDataFromTypeTree(data, parent.get()));
+        HeapSnapshot snapshot;
+        if (!snapshot.read(data, nodeIndex)) {
+            qWarning() << "Heap snapshot data is incomplete";
         }
-
-        ObjectNode::nodes.clear();
+        appendSnapshotRows(data, snapshot, &ret);
     }
 
     setObjectParents(ret, nullptr);
@@ -852,12 +971,38 @@ Parser::Parser(QObject* parent)
     : QObject(parent)
 {
     qRegisterMetaType<SummaryData>();
+    qRegisterMetaType<SearchIndexPtr>();
 }
 
-Parser::~Parser() = default;
+Parser::~Parser()
+{
+    // otherwise a live parse job would follow the data file forever
+    stopLive();
+    if (m_liveJob.valid()) {
+        m_liveJob.wait();
+    }
+}
+
+AllocationData::DisplayId Parser::display() const
+{
+    return m_display;
+}
+
+void Parser::setThreadFilter(const vector<string>& threads)
+{
+    m_threadFilter = threads;
+}
+
+vector<string> Parser::threadFilter() const
+{
+    return m_threadFilter;
+}
 
 void Parser::parse(const QString& path, const QString& diffBase)
 {
+    m_data.reset();
+    m_flameGraphRequested = false;
+    m_callerCalleeRequested = false;
 #ifndef THREAD_WEAVER
     parseJob(path, diffBase);
 #else
@@ -867,14 +1012,69 @@ void Parser::parse(const QString& path, const QString& diffBase)
 #endif
 }
 
+void Parser::parseLive(const QString& path)
+{
+    stopLive();
+    if (m_liveJob.valid()) {
+        m_liveJob.wait();
+    }
+    m_data.reset();
+    m_flameGraphRequested = false;
+    m_callerCalleeRequested = false;
+    m_stopLive = false;
+    // the job runs as long as the data comes in, so don't block a thread of the shared pool with it
+    m_liveJob = async(launch::async, [this, path]() { parseLiveJob(path); });
+}
+
+void Parser::stopLive()
+{
+    // the job publishes the final results once it read the data that is available
+    m_stopLive = true;
+}
+
+void Parser::parseLiveJob(const QString& path)
+{
+    auto data = make_shared<ParserData>();
+    data->threadFilter = m_threadFilter;
+    emit progressMessageAvailable(i18n("reading live data..."));
+
+    // the hotspots are not known up front, so the charts only show the totals
+    data->prepareBuildCharts();
+    data->publishLive = [this, &data]() {
+        data->updateStringCache();
+        emitDisplayData(data, m_display, false);
+    };
+
+    if (!data->readLive(path.toStdString(), m_stopLive)) {
+        emit failedToOpen(path);
+        return;
+    }
+    data->publishLive = nullptr;
+    data->updateStringCache();
+
+    const auto display = m_display.load();
+    emitDisplayData(data, display, true);
+
+    if (!data->objectTreeNodes.empty()) {
+        emit objectTreeBottomUpDataAvailable(buildObjectTree(*data));
+    }
+    emit sizeHistogramDataAvailable(buildSizeHistogram(*data));
+
+    m_data = data;
+    emitRequestedData(data);
+    emit finished();
+}
+
 void Parser::parseJob(const QString& path, const QString& diffBase)
 {
     const auto stdPath = path.toStdString();
     auto data = make_shared<ParserData>();
+    data->threadFilter = m_threadFilter;
     emit progressMessageAvailable(i18n("parsing data..."));
 
     if (!diffBase.isEmpty()) {
         ParserData diffData;
+        diffData.threadFilter = m_threadFilter;
         auto readBase =
             async(launch::async, [&diffData, diffBase]() { return diffData.read(diffBase.toStdString()); });
         if (!data->read(stdPath)) {
@@ -894,43 +1094,18 @@ void Parser::parseJob(const QString& path, const QString& diffBase)
 
     data->updateStringCache();
 
-    AllocationData::Stats *partCoreclr;
-    AllocationData::Stats *partNonCoreclr;
-    AllocationData::Stats *partUntracked;
-    AllocationData::Stats *partUnknown;
-
-    if (AllocationData::display == AllocationData::DisplayId::malloc)
-    {
-        partCoreclr = &data->partCoreclr;
-        partNonCoreclr = &data->partNonCoreclr;
-        partUntracked = &data->partUntracked;
-        partUnknown = &data->partUnknown;
-    }
-    else
-    {
-        partCoreclr = &data->partCoreclrMMAP;
-        partNonCoreclr = &data->partNonCoreclrMMAP;
-        partUntracked = &data->partUntrackedMMAP;
-        partUnknown = &data->partUnknownMMAP;
-    }
-
-    emit summaryAvailable({QString::fromStdString(data->debuggee), *data->totalCost.getDisplay(), data->totalTime, data->getPeakTime(),
-                           data->peakRSS * 1024,
-                           data->systemInfo.pages * data->systemInfo.pageSize, data->fromAttached,
-                           *partCoreclr, *partNonCoreclr, *partUntracked, *partUnknown});
+    const auto display = m_display.load();
+    emitSummary(*data, display);
 
     emit progressMessageAvailable(i18n("merging allocations..."));
-    // merge allocations before modifying the data again
-    const auto mergedAllocations = mergeAllocations(*data, true);
-    emit bottomUpDataAvailable(mergedAllocations);
-
-    if (!AccumulatedTraceData::isHideUnmanagedStackParts) {
-        emit bottomUpFilterOutLeavesDataAvailable(mergeAllocations(*data, false));
-    } else {
-        emit bottomUpFilterOutLeavesDataAvailable(mergedAllocations);
-    }
-
-    if (AllocationData::display == AllocationData::DisplayId::managed) {
+    // collect the allocations before modifying the data again
+    emit bottomUpFilterOutLeavesDataAvailable(toLazyTreeData(
+        data, lazyAllocations(*data, display, LazyTree::BottomUp, AccumulatedTraceData::isHideUnmanagedStackParts)));
+    const auto topDownTree = lazyAllocations(*data, display, LazyTree::TopDown, true);
+    // the filters match the locations that the expanded rows intern later on when they see them
+    emit searchIndexAvailable(data->stringCache.searchIndex());
+
+    if (!data->objectTreeNodes.empty()) {
         const auto objectTreeBottomUpData = buildObjectTree(*data);
         emit objectTreeBottomUpDataAvailable(objectTreeBottomUpData);
     }
@@ -941,23 +1116,15 @@ void Parser::parseJob(const QString& path, const QString& diffBase)
     emit sizeHistogramDataAvailable(sizeHistogram);
     // now data can be modified again for the chart data evaluation
 
-    const auto diffMode = data->stringCache.diffMode;
     emit progressMessageAvailable(i18n("building charts..."));
 #ifdef THREAD_WEAVER
     using namespace ThreadWeaver;
     auto parallel = new Collection;
-    *parallel << make_job([this, mergedAllocations]()
+    *parallel << make_job([this, data, topDownTree]()
 #endif
     {
-        const auto topDownData = toTopDownData(mergedAllocations);
-        emit topDownDataAvailable(topDownData);
-    }
-#ifdef THREAD_WEAVER
-    ) << make_job([this, mergedAllocations, diffMode]()
-#endif
-    {
-        const auto callerCalleeData = toCallerCalleeData(mergedAllocations, diffMode);
-        emit callerCalleeDataAvailable(callerCalleeData);
+        // finding the outermost callers walks all backtraces, which the chart pass doesn't change
+        emit lazyTopDownDataAvailable(toLazyTreeData(data, topDownTree));
     }
 #ifdef THREAD_WEAVER
     );
@@ -965,30 +1132,176 @@ void Parser::parseJob(const QString& path, const QString& diffBase)
     if (!data->stringCache.diffMode) {
         // only build charts when we are not diffing
 #ifdef THREAD_WEAVER
-        *parallel << make_job([this, data, stdPath]()
+        *parallel << make_job([this, data, stdPath, display]()
 #endif
         {
-            // this mutates data, and thus anything running in parallel must
-            // not access data
+            // this rebuilds the allocations and the address ranges of data, so anything
+            // running in parallel must not access them. the traces, the instruction pointers
+            // and the node types stay the same, which the lazy trees read when they expand rows
             data->prepareBuildCharts();
             data->read(stdPath);
-            emit consumedChartDataAvailable(data->consumedChartData);
-            emit instancesChartDataAvailable(data->instancesChartData);
-            emit allocationsChartDataAvailable(data->allocationsChartData);
-            emit allocatedChartDataAvailable(data->allocatedChartData);
-            emit temporaryChartDataAvailable(data->temporaryChartData);
+            emitCharts(*data, display);
         }
 #ifdef THREAD_WEAVER
         );
 #endif
     }
 
+    // the chart pass restores the peaks of the initial read and leaves the parts and
+    // the node types alone, so keep the data around to switch between the metrics
+    // without parsing again
 #ifndef THREAD_WEAVER
+    m_data = data;
+    emitRequestedData(data);
     emit finished();
 #else
     auto sequential = new Sequence;
-    *sequential << parallel << make_job([this]() { emit finished(); });
+    *sequential << parallel << make_job([this, data]() {
+        m_data = data;
+        emitRequestedData(data);
+        emit finished();
+    });
 
     stream() << sequential;
 #endif
 }
+
+void Parser::setDisplay(AllocationData::DisplayId display)
+{
+    m_display = display;
+    if (!m_data) {
+        // nothing parsed yet, the display is used for the next parse job
+        return;
+    }
+
+    auto data = m_data;
+#ifndef THREAD_WEAVER
+    displayJob(data, display);
+#else
+    ThreadWeaver::stream() << ThreadWeaver::make_job([this, data, display]() {
+        displayJob(data, display);
+    });
+#endif
+}
+
+void Parser::requestFlameGraphData()
+{
+    m_flameGraphRequested = true;
+    requestData();
+}
+
+void Parser::requestCallerCalleeData()
+{
+    m_callerCalleeRequested = true;
+    requestData();
+}
+
+void Parser::requestData()
+{
+    auto data = m_data;
+    if (!data) {
+        // the data is still being parsed, the parse job builds the requested data at its end
+        return;
+    }
+#ifndef THREAD_WEAVER
+    emitRequestedData(data);
+#else
+    ThreadWeaver::stream() << ThreadWeaver::make_job([this, data]() {
+        emitRequestedData(data);
+    });
+#endif
+}
+
+void Parser::emitRequestedData(const shared_ptr<ParserData>& data)
+{
+    const bool flameGraph = m_flameGraphRequested.exchange(false);
+    const bool callerCallee = m_callerCalleeRequested.exchange(false);
+    if (!flameGraph && !callerCallee) {
+        return;
+    }
+
+    const auto mergedAllocations = mergeAllocations(*data, m_display.load(), true);
+    // the complete bottom-up tree interned the locations of all backtraces
+    emit searchIndexAvailable(data->stringCache.searchIndex());
+    if (flameGraph) {
+        emit bottomUpDataAvailable(mergedAllocations);
+        emit topDownDataAvailable(toTopDownData(mergedAllocations));
+    }
+    if (callerCallee) {
+        emit callerCalleeDataAvailable(toCallerCalleeData(mergedAllocations, data->stringCache.diffMode));
+    }
+}
+
+void Parser::displayJob(const shared_ptr<ParserData>& data, AllocationData::DisplayId display)
+{
+    emit progressMessageAvailable(i18n("merging allocations..."));
+    emitDisplayData(data, display, true);
+    emit displayUpdated();
+}
+
+void Parser::emitDisplayData(const shared_ptr<ParserData>& data, AllocationData::DisplayId display, bool isComplete)
+{
+    emitSummary(*data, display);
+
+    if (isComplete) {
+        emit bottomUpFilterOutLeavesDataAvailable(
+            toLazyTreeData(data, lazyAllocations(*data, display, LazyTree::BottomUp,
+                                                 AccumulatedTraceData::isHideUnmanagedStackParts)));
+        emit lazyTopDownDataAvailable(
+            toLazyTreeData(data, lazyAllocations(*data, display, LazyTree::TopDown, true)));
+        emit searchIndexAvailable(data->stringCache.searchIndex());
+    } else {
+        // the traces are still being read, so the trees are built completely, the ones that the views
+        // requested in the meantime as well
+        const auto mergedAllocations = mergeAllocations(*data, display, true);
+        if (!AccumulatedTraceData::isHideUnmanagedStackParts) {
+            emit bottomUpFilterOutLeavesDataAvailable({mergeAllocations(*data, display, false), {}});
+        } else {
+            emit bottomUpFilterOutLeavesDataAvailable({mergedAllocations, {}});
+        }
+        const auto topDownData = toTopDownData(mergedAllocations);
+        emit lazyTopDownDataAvailable({topDownData, {}});
+        emit searchIndexAvailable(data->stringCache.searchIndex());
+        if (m_flameGraphRequested.exchange(false)) {
+            emit bottomUpDataAvailable(mergedAllocations);
+            emit topDownDataAvailable(topDownData);
+        }
+        if (m_callerCalleeRequested.exchange(false)) {
+            emit callerCalleeDataAvailable(toCallerCalleeData(mergedAllocations, data->stringCache.diffMode));
+        }
+    }
+
+    if (!data->stringCache.diffMode) {
+        emitCharts(*data, display);
+    }
+}
+
+void Parser::emitSummary(const ParserData& data, AllocationData::DisplayId display)
+{
+    SummaryData summary{QString::fromStdString(data.debuggee), *data.totalCost.getDisplay(display), data.totalTime,
+                        data.getPeakTime(display), data.peakRSS * 1024,
+                        data.systemInfo.pages * data.systemInfo.pageSize, data.fromAttached,
+                        *data.partCoreclr.getDisplay(display), *data.partNonCoreclr.getDisplay(display),
+                        *data.partUntracked.getDisplay(display), *data.partUnknown.getDisplay(display), {}};
+    if (display == AllocationData::DisplayId::malloc && data.threads.size() > 1) {
+        for (uint32_t thread = 0; thread < data.threads.size(); ++thread) {
+            if (data.threads[thread].cost.allocations) {
+                summary.threads.push_back({data.threadLabel(thread), data.threads[thread].cost});
+            }
+        }
+    }
+    emit summaryAvailable(summary);
+}
+
+void Parser::emitCharts(const ParserData& data, AllocationData::DisplayId display)
+{
+    const auto& charts = data.charts[static_cast<int>(display)];
+    const auto bucketWidth = data.chartBucketWidth;
+    emit consumedChartDataAvailable(toChartLevels(charts.consumedChartData, bucketWidth));
+    emit instancesChartDataAvailable(toChartLevels(charts.instancesChartData, bucketWidth));
+    emit allocationsChartDataAvailable(toChartLevels(charts.allocationsChartData, bucketWidth));
+    emit allocatedChartDataAvailable(toChartLevels(charts.allocatedChartData, bucketWidth));
+    emit temporaryChartDataAvailable(toChartLevels(charts.temporaryChartData, bucketWidth));
+    emit threadsChartDataAvailable(toChartLevels(data.threadsChartData, bucketWidth));
+    emit fragmentationChartDataAvailable(toChartLevels(data.fragmentationChartData, bucketWidth));
+}
@@ -21,11 +21,20 @@
 
 #include <QObject>
 
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "callercalleemodel.h"
 #include "chartmodel.h"
 #include "histogrammodel.h"
 #include "treemodel.h"
 #include "objecttreemodel.h"
+#include "searchindex.h"
+
+struct ParserData;
 
 class Parser : public QObject
 {
@@ -34,29 +43,80 @@ public:
     explicit Parser(QObject* parent = nullptr);
     virtual ~Parser();
 
+    AllocationData::DisplayId display() const;
+
+    // only account for the malloc allocations of these threads in the files parsed afterwards,
+    // see AccumulatedTraceData::threadFilter
+    void setThreadFilter(const std::vector<std::string>& threads);
+    std::vector<std::string> threadFilter() const;
+
 public slots:
     void parse(const QString& path, const QString& diffBase);
+    /**
+     * Parse a data file that is still being written, see AccumulatedTraceData::readLive.
+     *
+     * The summary, trees and charts are published periodically while the data comes in,
+     * the remaining results once the data ends, i.e. when the FIFO gets closed or after
+     * stopLive() was called.
+     */
+    void parseLive(const QString& path);
+    void stopLive();
+    // rebuilds the metric dependent data from the last parsed file without parsing it again
+    void setDisplay(AllocationData::DisplayId display);
+    /**
+     * Build the complete trees of the flame graph or the caller/callee data of the current display,
+     * which are only needed when their views are shown. While a file is parsed, they are built
+     * once the data is available.
+     */
+    void requestFlameGraphData();
+    void requestCallerCalleeData();
 
 signals:
     void progressMessageAvailable(const QString& progress);
     void summaryAvailable(const SummaryData& summary);
+    // the complete bottom-up and top-down trees of the flame graph, see requestFlameGraphData
     void bottomUpDataAvailable(const TreeData& data);
-    void bottomUpFilterOutLeavesDataAvailable(const TreeData& data);
+    void bottomUpFilterOutLeavesDataAvailable(const LazyTreeData& data);
     void topDownDataAvailable(const TreeData& data);
+    void lazyTopDownDataAvailable(const LazyTreeData& data);
     void callerCalleeDataAvailable(const CallerCalleeRows& data);
+    void searchIndexAvailable(const SearchIndexPtr& index);
     void consumedChartDataAvailable(const ChartData& data);
     void instancesChartDataAvailable(const ChartData& data);
     void allocationsChartDataAvailable(const ChartData& data);
     void allocatedChartDataAvailable(const ChartData& data);
     void temporaryChartDataAvailable(const ChartData& data);
+    void threadsChartDataAvailable(const ChartData& data);
+    void fragmentationChartDataAvailable(const ChartData& data);
     void sizeHistogramDataAvailable(const HistogramData& data);
     void objectTreeTopDownDataAvailable(const ObjectTreeData& data);
     void objectTreeBottomUpDataAvailable(const ObjectTreeData& data);
     void finished();
+    void displayUpdated();
     void failedToOpen(const QString& path);
 
 private:
     void parseJob(const QString& path, const QString& diffBase);
+    void parseLiveJob(const QString& path);
+    void displayJob(const std::shared_ptr<ParserData>& data, AllocationData::DisplayId display);
+    void requestData();
+    // builds the data that the views requested from @p data, which must not change anymore
+    void emitRequestedData(const std::shared_ptr<ParserData>& data);
+    // the trees of the views are only built lazily when @p data is complete and doesn't change anymore
+    void emitDisplayData(const std::shared_ptr<ParserData>& data, AllocationData::DisplayId display,
+                         bool isComplete);
+    void emitSummary(const ParserData& data, AllocationData::DisplayId display);
+    void emitCharts(const ParserData& data, AllocationData::DisplayId display);
+
+    std::shared_ptr<ParserData> m_data;
+    std::vector<std::string> m_threadFilter;
+    // also read by the live parse job, which publishes the currently selected metric
+    std::atomic<AllocationData::DisplayId> m_display{AllocationData::DisplayId::malloc};
+    std::future<void> m_liveJob;
+    std::atomic<bool> m_stopLive{false};
+    // set by the views, the data is built by the next job that can access the parsed data
+    std::atomic<bool> m_flameGraphRequested{false};
+    std::atomic<bool> m_callerCalleeRequested{false};
 };
 
 #endif // PARSER_H
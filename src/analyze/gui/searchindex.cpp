@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "searchindex.h"
+
+namespace {
+const int TRIGRAM_LENGTH = 3;
+
+quint64 trigram(const QChar* chars)
+{
+    return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | chars[2].unicode();
+}
+
+QString locationField(const LocationData& location, SearchIndex::Field field)
+{
+    switch (field) {
+    case SearchIndex::Function:
+        return location.function;
+    case SearchIndex::File:
+        return location.file;
+    case SearchIndex::Module:
+        return location.module;
+    case SearchIndex::NUM_FIELDS:
+        break;
+    }
+    Q_UNREACHABLE();
+}
+}
+
+void SearchIndex::addLocations(const std::vector<LocationData::Ptr>& locations)
+{
+    for (const auto& location : locations) {
+        Q_ASSERT(location->id == size());
+        for (int field = 0; field < NUM_FIELDS; ++field) {
+            m_fields[field].add(locationField(*location, static_cast<Field>(field)));
+        }
+    }
+}
+
+int SearchIndex::size() const
+{
+    return m_fields[Function].locations.size();
+}
+
+QBitArray SearchIndex::find(Field field, const QString& needle) const
+{
+    const auto& strings = m_fields[field];
+    const auto matches = strings.find(needle.toCaseFolded());
+    QBitArray ret(strings.locations.size());
+    for (int i = 0; i < strings.locations.size(); ++i) {
+        if (matches.testBit(strings.locations[i])) {
+            ret.setBit(i);
+        }
+    }
+    return ret;
+}
+
+void SearchIndex::Strings::add(const QString& string)
+{
+    const auto folded = string.toCaseFolded();
+    auto it = ids.constFind(folded);
+    if (it != ids.constEnd()) {
+        locations.append(*it);
+        return;
+    }
+
+    const int id = strings.size();
+    strings.append(folded);
+    ids.insert(folded, id);
+    locations.append(id);
+    for (int i = 0; i + TRIGRAM_LENGTH <= folded.size(); ++i) {
+        auto& ofTrigram = trigrams[trigram(folded.constData() + i)];
+        // the same trigram can occur several times in a string
+        if (ofTrigram.isEmpty() || ofTrigram.last() != id) {
+            ofTrigram.append(id);
+        }
+    }
+}
+
+QBitArray SearchIndex::Strings::find(const QString& needle) const
+{
+    QBitArray ret(strings.size());
+    if (needle.size() < TRIGRAM_LENGTH) {
+        // short needles match too many strings for the index to help
+        for (int id = 0; id < strings.size(); ++id) {
+            if (strings[id].contains(needle)) {
+                ret.setBit(id);
+            }
+        }
+        return ret;
+    }
+
+    // every trigram of the needle has to occur in a match, so only the strings with the
+    // rarest one are candidates
+    const QVector<int>* candidates = nullptr;
+    for (int i = 0; i + TRIGRAM_LENGTH <= needle.size(); ++i) {
+        auto it = trigrams.constFind(trigram(needle.constData() + i));
+        if (it == trigrams.constEnd()) {
+            return ret;
+        }
+        if (!candidates || it->size() < candidates->size()) {
+            candidates = &*it;
+        }
+    }
+    for (const auto id : *candidates) {
+        if (strings[id].contains(needle)) {
+            ret.setBit(id);
+        }
+    }
+    return ret;
+}
+
+void LocationFilter::setIndex(const SearchIndexPtr& index)
+{
+    m_index = index;
+    update();
+}
+
+bool LocationFilter::setFilter(SearchIndex::Field field, const QString& filter)
+{
+    if (m_filters[field] == filter) {
+        return false;
+    }
+    m_filters[field] = filter;
+    update();
+    return true;
+}
+
+bool LocationFilter::isEmpty() const
+{
+    for (const auto& filter : m_filters) {
+        if (!filter.isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LocationFilter::matches(const LocationData& location) const
+{
+    if (location.id >= static_cast<int>(m_matches.size())) {
+        m_matches.resize(location.id + 1, Unknown);
+    }
+    auto& match = m_matches[location.id];
+    if (match == Unknown) {
+        match = Matched;
+        for (int field = 0; field < SearchIndex::NUM_FIELDS; ++field) {
+            const auto& filter = m_filters[field];
+            const auto value = locationField(location, static_cast<SearchIndex::Field>(field));
+            if (!filter.isEmpty() && !value.contains(filter, Qt::CaseInsensitive)) {
+                match = NotMatched;
+                break;
+            }
+        }
+    }
+    return match == Matched;
+}
+
+void LocationFilter::update()
+{
+    m_matches.clear();
+    if (!m_index || isEmpty()) {
+        return;
+    }
+
+    QBitArray matches(m_index->size(), true);
+    for (int field = 0; field < SearchIndex::NUM_FIELDS; ++field) {
+        if (!m_filters[field].isEmpty()) {
+            matches &= m_index->find(static_cast<SearchIndex::Field>(field), m_filters[field]);
+        }
+    }
+    m_matches.resize(matches.size());
+    for (int id = 0; id < matches.size(); ++id) {
+        m_matches[id] = matches.testBit(id) ? Matched : NotMatched;
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+#include "locationdata.h"
+
+/**
+ * Trigram index over the distinct function, file and module names of the interned
+ * locations, to find the locations that contain a filter string without comparing
+ * it to the names of every row of a tree.
+ */
+class SearchIndex
+{
+public:
+    enum Field
+    {
+        Function,
+        File,
+        Module,
+        NUM_FIELDS
+    };
+
+    /**
+     * Index @p locations, which have to be the locations with the ids from size() on,
+     * in the order of their ids.
+     */
+    void addLocations(const std::vector<LocationData::Ptr>& locations);
+
+    /// @return the number of indexed locations, i.e. the id of the first location that isn't indexed
+    int size() const;
+
+    /// @return a bit per indexed location that is set when its @p field contains @p needle, ignoring the case
+    QBitArray find(Field field, const QString& needle) const;
+
+private:
+    struct Strings
+    {
+        void add(const QString& string);
+        /// @return a bit per distinct string that is set when it contains the case folded @p needle
+        QBitArray find(const QString& needle) const;
+
+        // the distinct strings, case folded
+        QVector<QString> strings;
+        QHash<QString, int> ids;
+        // the ids of the strings that contain a trigram, in ascending order
+        QHash<quint64, QVector<int>> trigrams;
+        // the string id of each location
+        QVector<int> locations;
+    };
+
+    Strings m_fields[NUM_FIELDS];
+};
+
+using SearchIndexPtr = std::shared_ptr<const SearchIndex>;
+Q_DECLARE_METATYPE(SearchIndexPtr)
+
+/**
+ * Matches locations against a filter string per field. The locations are looked up in the
+ * search index once per filter change, the ones that got interned after the index was
+ * built are compared directly and the result is cached as well.
+ */
+class LocationFilter
+{
+public:
+    void setIndex(const SearchIndexPtr& index);
+    /// @return true when the filter changed
+    bool setFilter(SearchIndex::Field field, const QString& filter);
+    bool isEmpty() const;
+    bool matches(const LocationData& location) const;
+
+private:
+    enum Match : char
+    {
+        Unknown,
+        Matched,
+        NotMatched
+    };
+
+    void update();
+
+    SearchIndexPtr m_index;
+    QString m_filters[SearchIndex::NUM_FIELDS];
+    // indexed by the location ids
+    mutable std::vector<Match> m_matches;
+};
+
+#endif // SEARCHINDEX_H
@@ -43,7 +43,12 @@ void StacksModel::setStackIndex(int index)
 
 static void findLeafs(const QModelIndex& index, QVector<QModelIndex>* leafs)
 {
-    int rows = index.model()->rowCount(index);
+    // rows of lazy trees only get their children when they are fetched
+    auto model = const_cast<QAbstractItemModel*>(index.model());
+    if (model->canFetchMore(index)) {
+        model->fetchMore(index);
+    }
+    int rows = model->rowCount(index);
     if (!rows) {
         leafs->append(index);
         return;
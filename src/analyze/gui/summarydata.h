@@ -22,6 +22,13 @@
 #include "../allocationdata.h"
 #include <QMetaType>
 #include <QString>
+#include <QVector>
+
+struct ThreadSummary
+{
+    QString name;
+    AllocationData::Stats cost;
+};
 
 struct SummaryData
 {
@@ -37,6 +44,9 @@ struct SummaryData
     AllocationData::Stats nonCoreCLRPart;
     AllocationData::Stats untrackedPart;
     AllocationData::Stats unknownPart;
+
+    // the malloc cost per thread, empty when the allocations aren't attributed to threads
+    QVector<ThreadSummary> threads;
 };
 Q_DECLARE_METATYPE(SummaryData)
 
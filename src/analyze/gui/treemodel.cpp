@@ -30,6 +30,7 @@
 
 #include "util.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace {
@@ -64,6 +65,7 @@ TreeModel::TreeModel(QObject* parent)
     : QAbstractItemModel(parent)
 {
     qRegisterMetaType<TreeData>();
+    qRegisterMetaType<LazyTreeData>();
 }
 
 TreeModel::~TreeModel()
@@ -77,7 +79,8 @@ QVariant TreeModel::headerData(int section, Qt::Orientation orientation, int rol
     }
     if (role == Qt::InitialSortOrderRole) {
         if (section == AllocatedColumn || section == AllocationsColumn || section == PeakColumn
-            || section == PeakInstancesColumn || section == LeakedColumn || section == TemporaryColumn) {
+            || section == PeakInstancesColumn || section == LeakedColumn || section == TemporaryColumn
+            || section == ShortLivedColumn || section == SlackColumn) {
             return Qt::DescendingOrder;
         }
     }
@@ -95,6 +98,10 @@ QVariant TreeModel::headerData(int section, Qt::Orientation orientation, int rol
             return i18n("Allocations");
         case TemporaryColumn:
             return i18n("Temporary");
+        case ShortLivedColumn:
+            return i18n("Short-lived");
+        case SlackColumn:
+            return i18n("Slack");
         case PeakColumn:
             return i18n("Peak");
         case PeakInstancesColumn:
@@ -130,6 +137,15 @@ QVariant TreeModel::headerData(int section, Qt::Orientation orientation, int rol
             return i18n("<qt>The number of temporary allocations. These allocations "
                         "are directly followed by a free "
                         "without any other allocations in-between.</qt>");
+        case ShortLivedColumn:
+            return i18n("<qt>The number of short-lived allocations. These allocations "
+                        "are freed before 100 other allocations or deallocations happened, "
+                        "which makes them candidates for a pool or an arena allocator.</qt>");
+        case SlackColumn:
+            return i18n("<qt>The contributions from a given location to the allocator slack at the "
+                        "maximum heap memory consumption, i.e. the bytes that malloc reserved beyond "
+                        "the requested sizes. Only known when the usable sizes were recorded or the "
+                        "allocator was modeled while interpreting the trace.</qt>");
         case PeakColumn:
             return i18n("<qt>The contributions from a given location to the maximum heap "
                         "memory consumption in bytes. This takes deallocations "
@@ -182,6 +198,16 @@ QVariant TreeModel::data(const QModelIndex& index, int role) const
                 return static_cast<qint64>(abs(row->cost.temporary));
             }
             return static_cast<qint64>(row->cost.temporary);
+        case ShortLivedColumn:
+            if (role == SortRole || role == MaxCostRole) {
+                return static_cast<qint64>(abs(row->cost.shortLived));
+            }
+            return static_cast<qint64>(row->cost.shortLived);
+        case SlackColumn:
+            if (role == SortRole || role == MaxCostRole) {
+                return static_cast<qint64>(abs(row->cost.peakSlack));
+            }
+            return Util::formatByteSize(row->cost.peakSlack, 1);
         case PeakColumn:
             if (role == SortRole || role == MaxCostRole) {
                 return static_cast<qint64>(abs(row->cost.peak));
@@ -250,6 +276,17 @@ QVariant TreeModel::data(const QModelIndex& index, int role) const
         stream << i18n("allocations: %1 (%2% of total)\n", row->cost.allocations, allocationsFraction);
         stream << i18n("temporary: %1 (%2% of allocations, %3% of total)\n", row->cost.temporary, temporaryFraction,
                        temporaryFractionTotal);
+        if (m_maxCost.cost.shortLived) {
+            const auto shortLivedFraction =
+                QString::number(double(row->cost.shortLived) * 100. / row->cost.allocations, 'g', 3);
+            stream << i18n("short-lived: %1 (%2% of allocations)\n", row->cost.shortLived, shortLivedFraction);
+        }
+        if (m_maxCost.cost.peakSlack) {
+            const auto slackFraction =
+                QString::number(double(row->cost.peakSlack) * 100. / m_maxCost.cost.peakSlack, 'g', 3);
+            stream << i18n("allocator slack at peak: %1 (%2% of total)\n",
+                           Util::formatByteSize(row->cost.peakSlack, 1), slackFraction);
+        }
         if (!row->children.isEmpty()) {
             auto child = row;
             int max = 5;
@@ -318,28 +355,150 @@ int TreeModel::columnCount(const QModelIndex& /*parent*/) const
     return NUM_COLUMNS;
 }
 
-void TreeModel::resetData(const TreeData& data)
+bool TreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (!parent.isValid()) {
+        return !m_data.isEmpty();
+    } else if (parent.column() != 0) {
+        return false;
+    }
+    auto row = toRow(parent);
+    Q_ASSERT(row);
+    return !row->children.isEmpty() || !row->members.isEmpty();
+}
+
+bool TreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (!parent.isValid() || parent.column() != 0) {
+        return false;
+    }
+    auto row = toRow(parent);
+    Q_ASSERT(row);
+    return !row->members.isEmpty();
+}
+
+void TreeModel::fetchMore(const QModelIndex& parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    // the rows are owned by this model, see resetData
+    auto row = const_cast<RowData*>(toRow(parent));
+
+    // merge into a copy first, the views must be told how many rows get inserted
+    RowData expanded = *row;
+    m_expand(&expanded);
+    beginInsertRows(parent, 0, expanded.children.size() - 1);
+    row->children = std::move(expanded.children);
+    row->members = {};
+    CallTree::setParents(row->children, row);
+    endInsertRows();
+}
+
+void TreeModel::resetData(const LazyTreeData& data)
 {
     beginResetModel();
-    m_data = data;
+    m_data = data.rows;
+    // fetchMore modifies the rows in place, so they must not be shared with anyone
+    m_data.detach();
+    m_expand = data.expand;
     endResetModel();
 }
 
+void TreeModel::updateData(const LazyTreeData& data)
+{
+    const auto oldIndices = persistentIndexList();
+    if (oldIndices.isEmpty() || m_data.isEmpty()) {
+        resetData(data);
+        return;
+    }
+
+    emit layoutAboutToBeChanged();
+
+    // the persistent indices point into the old data, so remember their location paths
+    QVector<QVector<const RowData*>> paths;
+    paths.reserve(oldIndices.size());
+    for (const auto& index : oldIndices) {
+        QVector<const RowData*> path;
+        for (auto row = toRow(index); row; row = row->parent) {
+            path.prepend(row);
+        }
+        paths.append(path);
+    }
+
+    // keep the old rows alive until the paths are resolved in the new data
+    const auto oldData = m_data;
+    m_data = data.rows;
+    m_data.detach();
+    m_expand = data.expand;
+
+    QModelIndexList newIndices;
+    newIndices.reserve(oldIndices.size());
+    for (int i = 0; i < oldIndices.size(); ++i) {
+        RowData* row = nullptr;
+        TreeData* siblings = &m_data;
+        for (const auto oldRow : paths[i]) {
+            auto it = std::find_if(siblings->begin(), siblings->end(), [oldRow](const RowData& newRow) {
+                return newRow.location == oldRow->location && newRow.stackType == oldRow->stackType;
+            });
+            if (it == siblings->end()) {
+                row = nullptr;
+                break;
+            }
+            row = &*it;
+            // the rows of the path were expanded in the old data, so the views expect their children
+            expand(row);
+            siblings = &row->children;
+        }
+        if (row) {
+            newIndices.append(createIndex(rowOf(row), oldIndices[i].column(),
+                                          const_cast<void*>(reinterpret_cast<const void*>(row->parent))));
+        } else {
+            newIndices.append(QModelIndex());
+        }
+    }
+    changePersistentIndexList(oldIndices, newIndices);
+
+    emit layoutChanged();
+}
+
 void TreeModel::setSummary(const SummaryData& data)
 {
-    beginResetModel();
+    // only the maximum cost changes, which is used to paint the cost bars
     m_maxCost.cost = data.cost;
-    endResetModel();
+    if (!m_data.isEmpty()) {
+        emit dataChanged(index(0, 0), index(m_data.size() - 1, NUM_COLUMNS - 1));
+    }
 }
 
 void TreeModel::clearData()
 {
     beginResetModel();
     m_data = {};
+    m_expand = {};
     m_maxCost = {};
     endResetModel();
 }
 
+void TreeModel::expandAll()
+{
+    if (!m_expand) {
+        return;
+    }
+    // the existing rows keep their addresses, so the persistent indices stay valid
+    emit layoutAboutToBeChanged();
+    expandAll(&m_data);
+    emit layoutChanged();
+}
+
+void TreeModel::expandAll(TreeData* rows)
+{
+    for (auto& row : *rows) {
+        expand(&row);
+        expandAll(&row.children);
+    }
+}
+
 const RowData* TreeModel::toRow(const QModelIndex& index) const
 {
     if (!index.isValid()) {
@@ -352,6 +511,15 @@ const RowData* TreeModel::toRow(const QModelIndex& index) const
     }
 }
 
+void TreeModel::expand(RowData* row)
+{
+    if (row->members.isEmpty()) {
+        return;
+    }
+    m_expand(row);
+    CallTree::setParents(row->children, row);
+}
+
 int TreeModel::rowOf(const RowData* row) const
 {
     if (auto parent = row->parent) {
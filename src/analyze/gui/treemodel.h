@@ -22,11 +22,14 @@
 #include <QAbstractItemModel>
 #include <QVector>
 
+#include <functional>
+
 #ifndef NO_K_LIB
 #include <KFormat>
 #endif
 
 #include "../allocationdata.h"
+#include "../calltree.h"
 #include "locationdata.h"
 #include "summarydata.h"
 
@@ -37,6 +40,8 @@ struct RowData
     const RowData* parent;
     QVector<RowData> children;
     AllocationData::CoreCLRType stackType;
+    // the allocations below this row until its children are merged, see CallTree::LazyTree
+    QVector<CallTree::Member> members;
     bool operator<(const LocationData::Ptr& rhs) const
     {
         return *location < *rhs;
@@ -47,6 +52,18 @@ Q_DECLARE_TYPEINFO(RowData, Q_MOVABLE_TYPE);
 using TreeData = QVector<RowData>;
 Q_DECLARE_METATYPE(TreeData)
 
+/**
+ * Tree data whose rows get their children on demand: rows that still have members
+ * are passed to expand when a view needs their children. Fully built trees have no
+ * members and don't need to set expand.
+ */
+struct LazyTreeData
+{
+    TreeData rows;
+    std::function<void(RowData* row)> expand;
+};
+Q_DECLARE_METATYPE(LazyTreeData)
+
 class TreeModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -62,6 +79,8 @@ public:
         AllocationsColumn,
         AllocatedColumn,
         TemporaryColumn,
+        ShortLivedColumn,
+        SlackColumn,
         FunctionColumn,
         FileColumn,
         LineColumn,
@@ -83,19 +102,34 @@ public:
     QModelIndex parent(const QModelIndex& child) const override;
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
 
 public slots:
-    void resetData(const TreeData& data);
+    void resetData(const LazyTreeData& data);
+    /**
+     * Replace the data like resetData, but keep the persistent indices, i.e. the
+     * expanded and selected rows of the views, pointing to the rows with the same
+     * location path in the new data. Used for the periodic updates of live data.
+     */
+    void updateData(const LazyTreeData& data);
     void setSummary(const SummaryData& data);
     void clearData();
+    /// merge all rows of a lazy tree, e.g. for filters that search the whole tree
+    void expandAll();
 
 private:
     /// @return the row resembled by @p index
     const RowData* toRow(const QModelIndex& index) const;
     /// @return the row number of @p row in its parent
     int rowOf(const RowData* row) const;
+    /// merge the children of @p row if that wasn't done yet, without notifying the views
+    void expand(RowData* row);
+    void expandAll(TreeData* rows);
 
     TreeData m_data;
+    std::function<void(RowData* row)> m_expand;
     RowData m_maxCost;
     // TODO: update via global event filter when the locale changes (changeEvent)
 #ifndef NO_K_LIB
@@ -18,15 +18,13 @@
 
 #include "treeproxy.h"
 
-TreeProxy::TreeProxy(int functionColumn, int fileColumn, int moduleColumn, QObject* parent)
+TreeProxy::TreeProxy(int locationRole, QObject* parent)
 #ifdef NO_K_LIB
     : QSortFilterProxyModel(parent)
 #else
     : KRecursiveFilterProxyModel(parent)
 #endif
-    , m_functionColumn(functionColumn)
-    , m_fileColumn(fileColumn)
-    , m_moduleColumn(moduleColumn)
+    , m_locationRole(locationRole)
 {
 #if QT_VERSION >= 0x050A00
     setRecursiveFilteringEnabled(true);
@@ -39,47 +37,42 @@ TreeProxy::~TreeProxy() = default;
 
 void TreeProxy::setFunctionFilter(const QString& functionFilter)
 {
-    m_functionFilter = functionFilter;
-    invalidate();
+    setFilter(SearchIndex::Function, functionFilter);
 }
 
 void TreeProxy::setFileFilter(const QString& fileFilter)
 {
-    m_fileFilter = fileFilter;
-    invalidate();
+    setFilter(SearchIndex::File, fileFilter);
 }
 
 void TreeProxy::setModuleFilter(const QString& moduleFilter)
 {
-    m_moduleFilter = moduleFilter;
-    invalidate();
+    setFilter(SearchIndex::Module, moduleFilter);
+}
+
+void TreeProxy::setSearchIndex(const SearchIndexPtr& index)
+{
+    m_filter.setIndex(index);
+}
+
+void TreeProxy::setFilter(SearchIndex::Field field, const QString& filter)
+{
+    if (m_filter.setFilter(field, filter)) {
+        invalidate();
+    }
 }
 
 bool TreeProxy::acceptRow(int sourceRow, const QModelIndex& sourceParent) const
 {
+    if (m_filter.isEmpty()) {
+        return true;
+    }
     auto source = sourceModel();
     if (!source) {
         return false;
     }
-    if (!m_functionFilter.isEmpty()) {
-        const auto& function = source->index(sourceRow, m_functionColumn, sourceParent).data().toString();
-        if (!function.contains(m_functionFilter, Qt::CaseInsensitive)) {
-            return false;
-        }
-    }
-    if (!m_fileFilter.isEmpty()) {
-        const auto& file = source->index(sourceRow, m_fileColumn, sourceParent).data().toString();
-        if (!file.contains(m_fileFilter, Qt::CaseInsensitive)) {
-            return false;
-        }
-    }
-    if (!m_moduleFilter.isEmpty()) {
-        const auto& module = source->index(sourceRow, m_moduleColumn, sourceParent).data().toString();
-        if (!module.contains(m_moduleFilter, Qt::CaseInsensitive)) {
-            return false;
-        }
-    }
-    return true;
+    const auto location = source->index(sourceRow, 0, sourceParent).data(m_locationRole).value<LocationData::Ptr>();
+    return location && m_filter.matches(*location);
 }
 
 #ifdef NO_K_LIB
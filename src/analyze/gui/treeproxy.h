@@ -25,6 +25,8 @@
 #include <KRecursiveFilterProxyModel>
 #endif
 
+#include "searchindex.h"
+
 class TreeProxy final : public
 #ifdef NO_K_LIB
     QSortFilterProxyModel
@@ -34,13 +36,15 @@ class TreeProxy final : public
 {
     Q_OBJECT
 public:
-    explicit TreeProxy(int functionColumn, int fileColumn, int moduleColumn, QObject* parent = nullptr);
+    /// @p locationRole is the role of the source model that returns the LocationData::Ptr of a row
+    explicit TreeProxy(int locationRole, QObject* parent = nullptr);
     virtual ~TreeProxy();
 
 public slots:
     void setFunctionFilter(const QString& functionFilter);
     void setFileFilter(const QString& fileFilter);
     void setModuleFilter(const QString& moduleFilter);
+    void setSearchIndex(const SearchIndexPtr& index);
 
 private:
 #ifdef NO_K_LIB
@@ -50,13 +54,10 @@ private:
     bool acceptRow(int source_row, const QModelIndex& source_parent) const override;
 #endif
 
-    int m_functionColumn;
-    int m_fileColumn;
-    int m_moduleColumn;
+    void setFilter(SearchIndex::Field field, const QString& filter);
 
-    QString m_functionFilter;
-    QString m_fileFilter;
-    QString m_moduleFilter;
+    int m_locationRole;
+    LocationFilter m_filter;
 };
 
 #endif // TREEPROXY_H
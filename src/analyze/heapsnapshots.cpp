@@ -0,0 +1,418 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "heapsnapshots.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+#include "accumulatedtracedata.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * The object graph of one heap snapshot in compressed sparse row form. Node 0 is the
+ * root of the snapshot, the other nodes are the objects in the order of their first record.
+ */
+struct ObjectGraph
+{
+    uint32_t size() const
+    {
+        return records.size();
+    }
+
+    // index of the first record of each node in AccumulatedTraceData::objectTreeNodes
+    vector<size_t> records;
+    // the nodes referenced by node i are targets[firstTarget[i]] to targets[firstTarget[i + 1] - 1]
+    vector<uint32_t> firstTarget;
+    vector<uint32_t> targets;
+};
+
+/**
+ * Convert @p edges, pairs of source and target nodes, to the compressed sparse rows of @p numNodes nodes,
+ * with the targets of a node in the order of the edges.
+ */
+void toSparseRows(const vector<pair<uint32_t, uint32_t>>& edges, uint32_t numNodes, vector<uint32_t>* firstTarget,
+                  vector<uint32_t>* targets)
+{
+    firstTarget->assign(numNodes + 1, 0);
+    for (const auto& edge : edges) {
+        ++(*firstTarget)[edge.first + 1];
+    }
+    partial_sum(firstTarget->begin(), firstTarget->end(), firstTarget->begin());
+    targets->resize(edges.size());
+    auto next = *firstTarget;
+    for (const auto& edge : edges) {
+        (*targets)[next[edge.first]++] = edge.second;
+    }
+}
+
+/**
+ * Read the snapshot that starts with the record @p recordIndex, whose records list the
+ * references of an object right after it in depth-first order. An object that was listed
+ * before is repeated without references.
+ *
+ * @return false when the records end before the snapshot is complete, @p graph then holds
+ *         the objects that were read until then
+ */
+bool readObjectGraph(const AccumulatedTraceData& data, size_t& recordIndex, ObjectGraph* graph)
+{
+    const auto& records = data.objectTreeNodes;
+    const auto gcNum = records[recordIndex].gcNum;
+    unordered_map<uint64_t, uint32_t> nodes;
+    vector<pair<uint32_t, uint32_t>> edges;
+    // the nodes whose references are still being read, with the number of remaining references
+    vector<pair<uint32_t, uint64_t>> stack;
+
+    bool isComplete = true;
+    graph->records.push_back(recordIndex);
+    stack.push_back({0, records[recordIndex].numChildren});
+    ++recordIndex;
+    while (!stack.empty()) {
+        if (!stack.back().second) {
+            stack.pop_back();
+            continue;
+        }
+        --stack.back().second;
+        if (recordIndex >= records.size() || records[recordIndex].gcNum != gcNum) {
+            // FIXME: this check will not be needed once we can ensure the
+            // integrity of the trace.
+            // https://github.sec.samsung.net/dotnet/profiler/issues/24
+            isComplete = false;
+            break;
+        }
+        const auto& record = records[recordIndex];
+        auto it = nodes.find(record.objectPtr);
+        if (it == nodes.end()) {
+            it = nodes.insert({record.objectPtr, graph->size()}).first;
+            graph->records.push_back(recordIndex);
+            edges.push_back({stack.back().first, it->second});
+            stack.push_back({it->second, record.numChildren});
+        } else {
+            assert(record.numChildren == 0 && "Incorrect number of children");
+            edges.push_back({stack.back().first, it->second});
+        }
+        ++recordIndex;
+    }
+
+    toSparseRows(edges, graph->size(), &graph->firstTarget, &graph->targets);
+    return isComplete;
+}
+
+/**
+ * @return the immediate dominator of each node of @p graph, the root dominates itself.
+ *
+ * This is the iterative algorithm of Cooper, Harvey and Kennedy, "A Simple, Fast Dominance
+ * Algorithm", on the nodes in reverse postorder. It needs a few passes for the reference
+ * graphs of heaps, which are mostly trees.
+ */
+vector<uint32_t> immediateDominators(const ObjectGraph& graph)
+{
+    const auto numNodes = graph.size();
+
+    // number the nodes in postorder, all nodes are reachable from the root
+    vector<uint32_t> postorder(numNodes);
+    vector<uint32_t> byPostorder;
+    byPostorder.reserve(numNodes);
+    {
+        vector<bool> visited(numNodes, false);
+        // the nodes on the current path, with the next reference to look at
+        vector<pair<uint32_t, uint32_t>> stack = {{0, graph.firstTarget[0]}};
+        visited[0] = true;
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second == graph.firstTarget[top.first + 1]) {
+                postorder[top.first] = byPostorder.size();
+                byPostorder.push_back(top.first);
+                stack.pop_back();
+                continue;
+            }
+            const auto target = graph.targets[top.second++];
+            if (!visited[target]) {
+                visited[target] = true;
+                stack.push_back({target, graph.firstTarget[target]});
+            }
+        }
+    }
+
+    vector<pair<uint32_t, uint32_t>> reverseEdges;
+    reverseEdges.reserve(graph.targets.size());
+    for (uint32_t node = 0; node < numNodes; ++node) {
+        for (auto i = graph.firstTarget[node]; i < graph.firstTarget[node + 1]; ++i) {
+            reverseEdges.push_back({postorder[graph.targets[i]], postorder[node]});
+        }
+    }
+    vector<uint32_t> firstPredecessor;
+    vector<uint32_t> predecessors;
+    toSparseRows(reverseEdges, numNodes, &firstPredecessor, &predecessors);
+
+    // the dominators by postorder number, the root has the highest one
+    const uint32_t undefined = numeric_limits<uint32_t>::max();
+    const auto root = numNodes - 1;
+    vector<uint32_t> dominators(numNodes, undefined);
+    dominators[root] = root;
+    auto intersect = [&dominators](uint32_t lhs, uint32_t rhs) {
+        while (lhs != rhs) {
+            while (lhs < rhs) {
+                lhs = dominators[lhs];
+            }
+            while (rhs < lhs) {
+                rhs = dominators[rhs];
+            }
+        }
+        return lhs;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t node = root; node-- > 0;) {
+            auto dominator = undefined;
+            for (auto i = firstPredecessor[node]; i < firstPredecessor[node + 1]; ++i) {
+                const auto predecessor = predecessors[i];
+                if (dominators[predecessor] == undefined) {
+                    continue;
+                }
+                dominator = dominator == undefined ? predecessor : intersect(predecessor, dominator);
+            }
+            if (dominators[node] != dominator) {
+                dominators[node] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    vector<uint32_t> ret(numNodes);
+    for (uint32_t node = 0; node < numNodes; ++node) {
+        ret[node] = byPostorder[dominators[postorder[node]]];
+    }
+    return ret;
+}
+
+HeapGrowth::Stats& operator+=(HeapGrowth::Stats& lhs, const HeapGrowth::Stats& rhs)
+{
+    lhs.instances += rhs.instances;
+    lhs.shallowSize += rhs.shallowSize;
+    lhs.retainedSize += rhs.retainedSize;
+    return lhs;
+}
+}
+
+bool HeapSnapshot::read(const AccumulatedTraceData& data, size_t& recordIndex)
+{
+    gcNum = data.objectTreeNodes[recordIndex].gcNum;
+    ObjectGraph graph;
+    const bool isComplete = readObjectGraph(data, recordIndex, &graph);
+
+    const auto numNodes = graph.size();
+    const auto dominators = immediateDominators(graph);
+
+    auto record = [&data, &graph](uint32_t node) -> const ObjectTreeNode& {
+        return data.objectTreeNodes[graph.records[node]];
+    };
+    vector<uint64_t> shallowSizes(numNodes, 0);
+    for (uint32_t node = 1; node < numNodes; ++node) {
+        shallowSizes[node] = data.allocationInfos[record(node).allocIndex.index].size;
+    }
+
+    vector<pair<uint32_t, uint32_t>> dominatorEdges;
+    dominatorEdges.reserve(numNodes);
+    for (uint32_t node = 1; node < numNodes; ++node) {
+        dominatorEdges.push_back({dominators[node], node});
+    }
+    vector<uint32_t> firstDominated;
+    vector<uint32_t> dominated;
+    toSparseRows(dominatorEdges, numNodes, &firstDominated, &dominated);
+
+    // an object retains itself and everything it dominates, the dominated objects are reached
+    // after their dominator in breadth-first order, so sum up in the reverse of it
+    vector<uint32_t> byDepth = {0};
+    byDepth.reserve(numNodes);
+    for (size_t i = 0; i < byDepth.size(); ++i) {
+        const auto node = byDepth[i];
+        byDepth.insert(byDepth.end(), dominated.begin() + firstDominated[node],
+                       dominated.begin() + firstDominated[node + 1]);
+    }
+    vector<uint64_t> retainedSizes = shallowSizes;
+    for (auto it = byDepth.rbegin(); it != byDepth.rend(); ++it) {
+        if (*it) {
+            retainedSizes[dominators[*it]] += retainedSizes[*it];
+        }
+    }
+
+    // group the dominated objects of the objects of a group by their class, breadth-first
+    // so the objects of a group are contiguous in groupObjects
+    groups = {{-1, record(0).classIndex, 1, shallowSizes[0], retainedSizes[0]}};
+    vector<pair<size_t, size_t>> groupRanges = {{0, 1}};
+    vector<uint32_t> groupObjects = {0};
+    vector<uint32_t> children;
+    auto classIndex = [&record](uint32_t node) { return record(node).classIndex.index; };
+    for (size_t i = 0; i < groups.size(); ++i) {
+        children.clear();
+        for (auto object = groupRanges[i].first; object < groupRanges[i].second; ++object) {
+            const auto node = groupObjects[object];
+            children.insert(children.end(), dominated.begin() + firstDominated[node],
+                            dominated.begin() + firstDominated[node + 1]);
+        }
+        stable_sort(children.begin(), children.end(),
+                    [&classIndex](uint32_t lhs, uint32_t rhs) { return classIndex(lhs) < classIndex(rhs); });
+        for (auto begin = children.begin(); begin != children.end();) {
+            const auto cls = classIndex(*begin);
+            auto end = find_if(begin, children.end(),
+                               [&classIndex, cls](uint32_t node) { return classIndex(node) != cls; });
+            Group group = {static_cast<int>(i), record(*begin).classIndex, static_cast<uint64_t>(end - begin), 0, 0};
+            for (auto it = begin; it != end; ++it) {
+                group.shallowSize += shallowSizes[*it];
+                group.retainedSize += retainedSizes[*it];
+            }
+            groups.push_back(group);
+            groupRanges.push_back({groupObjects.size(), groupObjects.size() + group.instances});
+            groupObjects.insert(groupObjects.end(), begin, end);
+            begin = end;
+        }
+    }
+
+    return isComplete;
+}
+
+void HeapGrowth::add(const HeapSnapshot& snapshot)
+{
+    if (m_paths.empty()) {
+        m_paths.push_back({0, {}});
+    }
+
+    auto& summary = m_summaries[snapshot.gcNum];
+    summary = {};
+    const auto& groups = snapshot.groups;
+    vector<uint64_t> pathIds(groups.size(), 0);
+    // number of groups with a class on the path to the current group, to find the outermost
+    // instances of a class, whose retained sizes don't overlap
+    unordered_map<uint64_t, int> classesOnPath;
+    vector<vector<uint32_t>> children(groups.size());
+    for (uint32_t i = 1; i < groups.size(); ++i) {
+        children[groups[i].parent].push_back(i);
+    }
+    // the groups whose children are being visited, with the next child to visit
+    vector<pair<uint32_t, size_t>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second == children[top.first].size()) {
+            if (top.first) {
+                --classesOnPath[groups[top.first].classIndex.index];
+            }
+            stack.pop_back();
+            continue;
+        }
+        const auto i = children[top.first][top.second++];
+        const auto& group = groups[i];
+        const auto cls = group.classIndex.index;
+
+        const auto key = make_pair(pathIds[group.parent], cls);
+        auto it = m_pathIds.find(key);
+        if (it == m_pathIds.end()) {
+            it = m_pathIds.insert({key, m_paths.size()}).first;
+            m_paths.push_back({key.first, group.classIndex});
+        }
+        pathIds[i] = it->second;
+
+        Stats stats;
+        stats.instances = group.instances;
+        stats.shallowSize = group.shallowSize;
+        stats.retainedSize = group.retainedSize;
+        summary.paths[pathIds[i]] += stats;
+
+        auto& onPath = classesOnPath[cls];
+        if (onPath) {
+            stats.retainedSize = 0;
+        }
+        summary.classes[cls] += stats;
+        ++onPath;
+        stack.push_back({i, 0});
+    }
+}
+
+vector<uint64_t> HeapGrowth::gcNums() const
+{
+    vector<uint64_t> ret;
+    ret.reserve(m_summaries.size());
+    for (const auto& summary : m_summaries) {
+        ret.push_back(summary.first);
+    }
+    return ret;
+}
+
+pair<const HeapGrowth::Summary*, const HeapGrowth::Summary*> HeapGrowth::range(uint64_t beginGc,
+                                                                               uint64_t endGc) const
+{
+    auto begin = m_summaries.lower_bound(beginGc);
+    auto end = m_summaries.upper_bound(endGc);
+    if (begin == m_summaries.end() || end == m_summaries.begin() || begin->first > prev(end)->first) {
+        return {nullptr, nullptr};
+    }
+    return {&begin->second, &prev(end)->second};
+}
+
+namespace {
+vector<HeapGrowth::Entry> compare(const unordered_map<uint64_t, HeapGrowth::Stats>& begin,
+                                  const unordered_map<uint64_t, HeapGrowth::Stats>& end)
+{
+    vector<HeapGrowth::Entry> ret;
+    ret.reserve(end.size());
+    for (const auto& stats : end) {
+        auto it = begin.find(stats.first);
+        ret.push_back({stats.first, it == begin.end() ? HeapGrowth::Stats() : it->second, stats.second});
+    }
+    for (const auto& stats : begin) {
+        if (!end.count(stats.first)) {
+            ret.push_back({stats.first, stats.second, {}});
+        }
+    }
+    return ret;
+}
+}
+
+vector<HeapGrowth::Entry> HeapGrowth::classGrowth(uint64_t beginGc, uint64_t endGc) const
+{
+    const auto summaries = range(beginGc, endGc);
+    if (!summaries.first) {
+        return {};
+    }
+    return compare(summaries.first->classes, summaries.second->classes);
+}
+
+vector<HeapGrowth::Entry> HeapGrowth::pathGrowth(uint64_t beginGc, uint64_t endGc) const
+{
+    const auto summaries = range(beginGc, endGc);
+    if (!summaries.first) {
+        return {};
+    }
+    return compare(summaries.first->paths, summaries.second->paths);
+}
+
+vector<ClassIndex> HeapGrowth::path(uint64_t pathId) const
+{
+    vector<ClassIndex> ret;
+    for (; pathId && pathId < m_paths.size(); pathId = m_paths[pathId].first) {
+        ret.push_back(m_paths[pathId].second);
+    }
+    reverse(ret.begin(), ret.end());
+    return ret;
+}
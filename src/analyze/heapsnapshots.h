@@ -0,0 +1,127 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HEAPSNAPSHOTS_H
+#define HEAPSNAPSHOTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util/indices.h"
+
+struct AccumulatedTraceData;
+
+/**
+ * A managed heap snapshot, i.e. the object graph that is written after a GC, reduced to
+ * the dominator tree of its objects grouped by class.
+ */
+struct HeapSnapshot
+{
+    /**
+     * The objects of one class that are immediately dominated by the objects of the parent
+     * group. Objects of one group never dominate each other, so their sizes add up.
+     */
+    struct Group
+    {
+        int parent;
+        ClassIndex classIndex;
+        uint64_t instances;
+        uint64_t shallowSize;
+        // the size of the objects and of everything that is only reachable through them
+        uint64_t retainedSize;
+    };
+
+    /**
+     * Read the snapshot whose records start at @p recordIndex in the object tree nodes of
+     * @p data and move @p recordIndex past them.
+     *
+     * @return false when the records end before the snapshot is complete, the snapshot then
+     *         holds the objects that were read until then
+     */
+    bool read(const AccumulatedTraceData& data, std::size_t& recordIndex);
+
+    uint64_t gcNum = 0;
+    // the groups in breadth-first order, the first one holds the root of the snapshot
+    std::vector<Group> groups;
+};
+
+/**
+ * Growth of the managed heap between snapshots, per class and per path of classes in
+ * the dominator tree. Each snapshot is summarized once when it is added, comparing a
+ * range of GCs only compares the summaries of its first and last snapshot.
+ */
+class HeapGrowth
+{
+public:
+    struct Stats
+    {
+        int64_t instances = 0;
+        int64_t shallowSize = 0;
+        // for the classes, only the instances that aren't dominated by an instance of the same class
+        int64_t retainedSize = 0;
+    };
+
+    struct Entry
+    {
+        // the class, or the path of a group, see path()
+        uint64_t id;
+        Stats begin;
+        Stats end;
+    };
+
+    void add(const HeapSnapshot& snapshot);
+
+    /// @return the numbers of the GCs of the added snapshots, in ascending order
+    std::vector<uint64_t> gcNums() const;
+
+    /**
+     * @return the growth per class from the first snapshot at or after GC @p beginGc
+     *         to the last one at or before GC @p endGc, the id of an entry is its class index
+     */
+    std::vector<Entry> classGrowth(uint64_t beginGc, uint64_t endGc) const;
+
+    /**
+     * @return the growth of the groups with the same path from the root of the dominator
+     *         tree, the id of an entry is the path, see path()
+     */
+    std::vector<Entry> pathGrowth(uint64_t beginGc, uint64_t endGc) const;
+
+    /// @return the classes of the groups along @p pathId, from the outermost dominator on
+    std::vector<ClassIndex> path(uint64_t pathId) const;
+
+private:
+    struct Summary
+    {
+        std::unordered_map<uint64_t, Stats> classes;
+        std::unordered_map<uint64_t, Stats> paths;
+    };
+
+    /// @return the summaries of the first and the last snapshot in the range, or null when it is empty
+    std::pair<const Summary*, const Summary*> range(uint64_t beginGc, uint64_t endGc) const;
+
+    std::map<uint64_t, Summary> m_summaries;
+    // the paths shared by all snapshots, as the path of the parent group and the class of the group
+    std::vector<std::pair<uint64_t, ClassIndex>> m_paths;
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> m_pathIds;
+};
+
+#endif // HEAPSNAPSHOTS_H
@@ -22,13 +22,21 @@
  * @brief Evaluate and print the collected heaptrack data.
  */
 
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/program_options.hpp>
 
 #include "analyze/accumulatedtracedata.h"
+#include "analyze/calltree.h"
+#include "analyze/heapsnapshots.h"
 
+#include <atomic>
+#include <csignal>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 
 #include "util/config.h"
 
@@ -37,6 +45,16 @@ namespace po = boost::program_options;
 
 namespace {
 
+// set on SIGINT to stop following the data file in live mode
+std::atomic<bool> stopLive(false);
+
+void handleInterrupt(int)
+{
+    stopLive = true;
+    // a second interrupt terminates right away
+    signal(SIGINT, SIG_DFL);
+}
+
 /**
  * Merged allocation information by instruction pointer outside of alloc funcs
  */
@@ -85,12 +103,123 @@ ostream& operator<<(ostream& out, const formatBytes data)
     return out << fixed << setprecision(2) << bytes << *unit;
 }
 
+/**
+ * Location of a call tree row. Like for merged allocations, frames are compared without
+ * taking the instruction pointer address into account, unless the function is unknown.
+ */
+struct CallTreeLocation
+{
+    Frame frame;
+    ModuleIndex moduleIndex;
+    uint64_t instructionPointer;
+
+    uint64_t unresolvedAddress() const
+    {
+        return frame.functionIndex ? 0 : instructionPointer;
+    }
+
+    bool operator<(const CallTreeLocation& rhs) const
+    {
+        return make_tuple(moduleIndex, frame, unresolvedAddress())
+            < make_tuple(rhs.moduleIndex, rhs.frame, rhs.unresolvedAddress());
+    }
+
+    bool operator==(const CallTreeLocation& rhs) const
+    {
+        return make_tuple(moduleIndex, frame, unresolvedAddress())
+            == make_tuple(rhs.moduleIndex, rhs.frame, rhs.unresolvedAddress());
+    }
+};
+
+struct CallTreeRow
+{
+    AllocationData::Stats cost;
+    CallTreeLocation location;
+    const CallTreeRow* parent;
+    vector<CallTreeRow> children;
+    AllocationData::CoreCLRType stackType;
+    vector<CallTree::Member> members;
+
+    bool operator<(const CallTreeLocation& rhs) const
+    {
+        return location < rhs;
+    }
+};
+
+using CallTreeRows = vector<CallTreeRow>;
+using LazyCallTree = CallTree::LazyTree<CallTreeLocation>;
+
+/**
+ * Minimal encoder for protocol buffer messages, enough to write the pprof
+ * format described in https://github.com/google/pprof/blob/master/proto/profile.proto
+ */
+class ProtobufMessage
+{
+public:
+    void addVarint(uint32_t field, uint64_t value)
+    {
+        addKey(field, 0);
+        addVarint(value);
+    }
+
+    void addBytes(uint32_t field, const string& value)
+    {
+        addKey(field, 2);
+        addVarint(value.size());
+        m_data += value;
+    }
+
+    void addMessage(uint32_t field, const ProtobufMessage& message)
+    {
+        addBytes(field, message.m_data);
+    }
+
+    template <typename Container>
+    void addPacked(uint32_t field, const Container& values)
+    {
+        ProtobufMessage packed;
+        for (auto value : values) {
+            packed.addVarint(static_cast<uint64_t>(value));
+        }
+        addMessage(field, packed);
+    }
+
+    const string& data() const
+    {
+        return m_data;
+    }
+
+    void clear()
+    {
+        m_data.clear();
+    }
+
+private:
+    void addKey(uint32_t field, uint32_t wireType)
+    {
+        addVarint((field << 3) | wireType);
+    }
+
+    void addVarint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            m_data += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        m_data += static_cast<char>(value);
+    }
+
+    string m_data;
+};
+
 struct Printer final : public AccumulatedTraceData
 {
     void finalize()
     {
+        // the printer sorts and filters complete allocations, so copy them out of the columnar storage
+        allocationRows = allocations.rows();
         filterAllocations();
-        mergedAllocations = mergeAllocations(allocations);
+        mergedAllocations = mergeAllocations(allocationRows);
     }
 
     void mergeAllocation(vector<MergedAllocation>* mergedAllocations, const Allocation& allocation) const
@@ -120,9 +249,9 @@ struct Printer final : public AccumulatedTraceData
     // called are combined
     vector<MergedAllocation> mergeAllocations(const vector<Allocation>& allocations) const
     {
-        // TODO: merge deeper traces, i.e. A,B,C,D and A,B,C,F
-        //       should be merged to A,B,C: D & F
-        //       currently the below will only merge it to: A: B,C,D & B,C,F
+        // NOTE: this only merges by the allocation site, i.e. A,B,C,D and A,B,C,F
+        //       are merged to A: B,C,D & B,C,F. buildBottomUp merges the complete
+        //       backtraces into a call tree instead
         vector<MergedAllocation> ret;
         ret.reserve(allocations.size());
         for (const Allocation& allocation : allocations) {
@@ -143,7 +272,7 @@ struct Printer final : public AccumulatedTraceData
         if (filterBtFunction.empty()) {
             return;
         }
-        allocations.erase(remove_if(allocations.begin(), allocations.end(),
+        allocationRows.erase(remove_if(allocationRows.begin(), allocationRows.end(),
                                     [&](const Allocation& allocation) -> bool {
                                         auto node = findTrace(allocation.traceIndex);
                                         while (node.ipIndex) {
@@ -166,7 +295,7 @@ struct Printer final : public AccumulatedTraceData
                                         };
                                         return true;
                                     }),
-                          allocations.end());
+                          allocationRows.end());
     }
 
     void printIndent(ostream& out, size_t indent, const char* indentString = "  ") const
@@ -279,6 +408,252 @@ struct Printer final : public AccumulatedTraceData
         printIp(ip, out, 0, true);
     }
 
+    /**
+     * Write the allocations as a pprof profile, one sample per backtrace.
+     *
+     * The fields of the profile are written as soon as they are known instead of
+     * building the whole message in memory. That is valid since protobuf allows
+     * repeated fields to be interleaved, the string table is referenced by the
+     * order of its entries. Locations, functions and mappings are deduplicated by
+     * their heaptrack indices.
+     */
+    void writePprof(ostream& out) const
+    {
+        enum ProfileField
+        {
+            SampleType = 1,
+            Sample = 2,
+            Mapping = 3,
+            Location = 4,
+            Function = 5,
+            StringTable = 6,
+            DurationNanos = 10,
+            Comment = 13,
+            DefaultSampleType = 14
+        };
+
+        ProtobufMessage profile;
+        auto flush = [&out, &profile]() {
+            out << profile.data();
+            profile.clear();
+        };
+
+        int64_t numStrings = 0;
+        auto addString = [&](const string& value) {
+            profile.addBytes(StringTable, value);
+            return numStrings++;
+        };
+        // the first entry of the string table has to be the empty string
+        addString({});
+
+        vector<int64_t> stringIds(strings.size() + 1, 0);
+        auto stringId = [&](StringIndex index) {
+            auto& id = stringIds[index.index];
+            if (index && !id) {
+                id = addString(stringify(index));
+            }
+            return id;
+        };
+
+        const auto count = addString("count");
+        const auto bytes = addString("bytes");
+        const pair<const char*, int64_t> sampleTypes[] = {
+            {"allocations", count}, {"allocated", bytes}, {"leaked", bytes}, {"peak", bytes}};
+        int64_t type = 0;
+        for (const auto& sampleType : sampleTypes) {
+            ProtobufMessage valueType;
+            type = addString(sampleType.first);
+            valueType.addVarint(1, type);
+            valueType.addVarint(2, sampleType.second);
+            profile.addMessage(SampleType, valueType);
+        }
+        // show the peak by default, which is the last sample type
+        profile.addVarint(DefaultSampleType, type);
+        profile.addVarint(DurationNanos, totalTime * 1000000);
+        if (!debuggee.empty()) {
+            profile.addVarint(Comment, addString(debuggee));
+        }
+        flush();
+
+        // modules are string indices, too
+        vector<bool> hasMapping(strings.size() + 1, false);
+        auto mappingId = [&](ModuleIndex module) {
+            if (module && !hasMapping[module.index]) {
+                hasMapping[module.index] = true;
+                ProtobufMessage mapping;
+                mapping.addVarint(1, module.index);
+                mapping.addVarint(5, stringId(module));
+                mapping.addVarint(7, true);
+                profile.addMessage(Mapping, mapping);
+            }
+            return module.index;
+        };
+
+        map<pair<uint32_t, uint32_t>, uint64_t> functionIds;
+        auto functionId = [&](const Frame& frame) -> uint64_t {
+            auto it = functionIds.find({frame.functionIndex.index, frame.fileIndex.index});
+            if (it != functionIds.end()) {
+                return it->second;
+            }
+            const auto id = functionIds.size() + 1;
+            functionIds[{frame.functionIndex.index, frame.fileIndex.index}] = id;
+            ProtobufMessage function;
+            function.addVarint(1, id);
+            function.addVarint(2, addString(prettyFunction(stringify(frame.functionIndex))));
+            function.addVarint(3, stringId(frame.functionIndex));
+            function.addVarint(4, stringId(frame.fileIndex));
+            profile.addMessage(Function, function);
+            return id;
+        };
+
+        // the location ids are the instruction pointer indices
+        vector<bool> hasLocation(instructionPointers.size() + 1, false);
+        auto addLocation = [&](IpIndex ipIndex, const InstructionPointer& ip) {
+            if (hasLocation[ipIndex.index]) {
+                return;
+            }
+            hasLocation[ipIndex.index] = true;
+            ProtobufMessage location;
+            location.addVarint(1, ipIndex.index);
+            location.addVarint(2, mappingId(ip.moduleIndex));
+            location.addVarint(3, ip.instructionPointer);
+            // the innermost frame comes first, followed by the frames it was inlined into.
+            // pprof rejects lines without a function, so unresolved frames only have the address
+            auto addLine = [&](const Frame& frame) {
+                if (!frame.functionIndex) {
+                    return;
+                }
+                ProtobufMessage line;
+                line.addVarint(1, functionId(frame));
+                line.addVarint(2, frame.line);
+                location.addMessage(4, line);
+            };
+            addLine(ip.frame);
+            for (const auto& inlined : ip.inlined) {
+                addLine(inlined);
+            }
+            profile.addMessage(Location, location);
+        };
+
+        vector<uint32_t> locationIds;
+        for (const auto& allocation : allocationRows) {
+            const auto& stats = *allocation.getDisplay(display);
+            if (stats.isEmpty()) {
+                continue;
+            }
+            locationIds.clear();
+            auto node = findTrace(allocation.traceIndex);
+            while (node.ipIndex) {
+                const auto ip = findIp(node.ipIndex);
+                addLocation(node.ipIndex, ip);
+                locationIds.push_back(node.ipIndex.index);
+                if (isStopIndex(ip.frame.functionIndex)) {
+                    break;
+                }
+                node = findTrace(node.parentIndex);
+            }
+            ProtobufMessage sample;
+            sample.addPacked(1, locationIds);
+            sample.addPacked(2, initializer_list<int64_t>{stats.allocations, stats.allocated, stats.leaked, stats.peak});
+            profile.addMessage(Sample, sample);
+            flush();
+        }
+    }
+
+    /**
+     * @return the call tree of the allocations, the same as shown in the GUI. Only the rows
+     *         that are printed get expanded.
+     */
+    LazyCallTree buildCallTree(LazyCallTree::Direction direction) const
+    {
+        auto ipLocation = [](IpIndex /*ipIndex*/, const InstructionPointer& ip, bool /*isUntrackedLocation*/) {
+            return CallTreeLocation{ip.frame, ip.moduleIndex, ip.instructionPointer};
+        };
+        auto frameLocation = [](const Frame& frame, const InstructionPointer& ip, bool /*isUntrackedLocation*/) {
+            return CallTreeLocation{frame, ip.moduleIndex, ip.instructionPointer};
+        };
+        LazyCallTree tree(*this, display, direction, ipLocation, frameLocation);
+        for (const auto& allocation : allocationRows) {
+            const auto& stats = *allocation.getDisplay(display);
+            if (!stats.isEmpty()) {
+                tree.addAllocation(allocation.traceIndex, stats);
+            }
+        }
+        return tree;
+    }
+
+    void printCost(int64_t AllocationData::Stats::*member, int64_t cost) const
+    {
+        if (member == &AllocationData::Stats::allocations || member == &AllocationData::Stats::temporary) {
+            cout << cost;
+        } else {
+            cout << formatBytes(cost);
+        }
+    }
+
+    void printLocation(const CallTreeLocation& location) const
+    {
+        if (location.frame.functionIndex) {
+            cout << prettyFunction(stringify(location.frame.functionIndex));
+        } else if (location.instructionPointer) {
+            cout << "0x" << hex << location.instructionPointer << dec;
+        } else {
+            cout << "??";
+        }
+        if (location.frame.fileIndex) {
+            cout << " at " << stringify(location.frame.fileIndex) << ':' << location.frame.line;
+        }
+        if (location.moduleIndex) {
+            cout << " in " << stringify(location.moduleIndex);
+        }
+    }
+
+    /**
+     * recursive call tree printer, rows whose cost is below @p threshold are
+     * summarized in a single line
+     */
+    void printCallTree(const LazyCallTree& tree, CallTreeRows* rows, int64_t AllocationData::Stats::*member,
+                       int64_t threshold, size_t indent = 0) const
+    {
+        vector<CallTreeRow*> sorted;
+        sorted.reserve(rows->size());
+        for (auto& row : *rows) {
+            sorted.push_back(&row);
+        }
+        // order rows of equal cost by location, so the output doesn't depend on how the tree was built
+        sort(sorted.begin(), sorted.end(), [member](const CallTreeRow* l, const CallTreeRow* r) {
+            const auto lhs = std::abs(l->cost.*member);
+            const auto rhs = std::abs(r->cost.*member);
+            return lhs != rhs ? lhs > rhs : l->location < r->location;
+        });
+
+        int64_t skipped = 0;
+        size_t numSkipped = 0;
+        for (const auto row : sorted) {
+            const auto cost = row->cost.*member;
+            if (!cost) {
+                break;
+            } else if (std::abs(cost) < threshold) {
+                skipped += cost;
+                ++numSkipped;
+                continue;
+            }
+            printIndent(cout, indent);
+            printCost(member, cost);
+            cout << ' ';
+            printLocation(row->location);
+            cout << '\n';
+            tree.expand(row);
+            printCallTree(tree, &row->children, member, threshold, indent + 1);
+        }
+        if (numSkipped) {
+            printIndent(cout, indent);
+            cout << "and ";
+            printCost(member, skipped);
+            cout << " from " << numSkipped << " other places below the threshold\n";
+        }
+    }
+
     template <typename T, typename LabelPrinter, typename SubLabelPrinter>
     void printAllocations(T AllocationData::Stats::*member, LabelPrinter label, SubLabelPrinter sublabel)
     {
@@ -292,13 +667,13 @@ struct Printer final : public AccumulatedTraceData
     template <typename T, typename LabelPrinter, typename SubLabelPrinter>
     void printMerged(T AllocationData::Stats::*member, LabelPrinter label, SubLabelPrinter sublabel)
     {
-        auto sortOrder = [member](const AllocationData& l, const AllocationData& r) {
-            return std::abs(l.getDisplay()->*member) > std::abs(r.getDisplay()->*member);
+        auto sortOrder = [this, member](const AllocationData& l, const AllocationData& r) {
+            return std::abs(l.getDisplay(display)->*member) > std::abs(r.getDisplay(display)->*member);
         };
         sort(mergedAllocations.begin(), mergedAllocations.end(), sortOrder);
         for (size_t i = 0; i < min(peakLimit, mergedAllocations.size()); ++i) {
             auto& allocation = mergedAllocations[i];
-            if (!(allocation.getDisplay()->*member)) {
+            if (!(allocation.getDisplay(display)->*member)) {
                 break;
             }
             label(allocation);
@@ -308,19 +683,19 @@ struct Printer final : public AccumulatedTraceData
             int64_t handled = 0;
             for (size_t j = 0; j < min(subPeakLimit, allocation.traces.size()); ++j) {
                 const auto& trace = allocation.traces[j];
-                if (!(trace.getDisplay()->*member)) {
+                if (!(trace.getDisplay(display)->*member)) {
                     break;
                 }
                 sublabel(trace);
-                handled += trace.getDisplay()->*member;
+                handled += trace.getDisplay(display)->*member;
                 printBacktrace(trace.traceIndex, cout, 2, true);
             }
             if (allocation.traces.size() > subPeakLimit) {
                 cout << "  and ";
                 if (member == &AllocationData::Stats::allocations) {
-                    cout << (allocation.getDisplay()->*member - handled);
+                    cout << (allocation.getDisplay(display)->*member - handled);
                 } else {
-                    cout << formatBytes(allocation.getDisplay()->*member - handled);
+                    cout << formatBytes(allocation.getDisplay(display)->*member - handled);
                 }
                 cout << " from " << (allocation.traces.size() - subPeakLimit) << " other places\n";
             }
@@ -331,11 +706,11 @@ struct Printer final : public AccumulatedTraceData
     template <typename T, typename LabelPrinter>
     void printUnmerged(T AllocationData::Stats::*member, LabelPrinter label)
     {
-        sort(allocations.begin(), allocations.end(),
-             [member](const Allocation& l, const Allocation& r) { return std::abs(l.getDisplay()->*member) > std::abs(r.getDisplay()->*member); });
-        for (size_t i = 0; i < min(peakLimit, allocations.size()); ++i) {
-            const auto& allocation = allocations[i];
-            if (!(allocation.getDisplay()->*member)) {
+        sort(allocationRows.begin(), allocationRows.end(),
+             [this, member](const Allocation& l, const Allocation& r) { return std::abs(l.getDisplay(display)->*member) > std::abs(r.getDisplay(display)->*member); });
+        for (size_t i = 0; i < min(peakLimit, allocationRows.size()); ++i) {
+            const auto& allocation = allocationRows[i];
+            if (!(allocation.getDisplay(display)->*member)) {
                 break;
             }
             label(allocation);
@@ -345,6 +720,155 @@ struct Printer final : public AccumulatedTraceData
         cout << endl;
     }
 
+    void printLifetimes() const
+    {
+        unordered_map<uint32_t, LifetimeHistogram> byTrace;
+        for (const auto& lifetime : lifetimes) {
+            byTrace[allocationInfos[lifetime.allocationIndex.index].traceIndex.index] += lifetime.histogram;
+        }
+        vector<pair<TraceIndex, LifetimeHistogram>> sites;
+        sites.reserve(byTrace.size());
+        for (const auto& site : byTrace) {
+            TraceIndex traceIndex;
+            traceIndex.index = site.first;
+            sites.push_back({traceIndex, site.second});
+        }
+        sort(sites.begin(), sites.end(),
+             [](const pair<TraceIndex, LifetimeHistogram>& l, const pair<TraceIndex, LifetimeHistogram>& r) {
+                 return l.second.shortLived() > r.second.shortLived();
+             });
+
+        static const char* timeLabels[LifetimeHistogram::NUM_BUCKETS] = {"<10ms", "<100ms", "<1s",
+                                                                         "<10s",  "<100s",  ">=100s"};
+        static const char* eventLabels[LifetimeHistogram::NUM_BUCKETS] = {"0",      "<10",    "<100",
+                                                                          "<1000",  "<10000", ">=10000"};
+        auto printHistogram = [](const char* title, const uint64_t* counts, const char** labels) {
+            cout << "  " << title;
+            for (int i = 0; i < LifetimeHistogram::NUM_BUCKETS; ++i) {
+                cout << ' ' << labels[i] << ": " << counts[i];
+            }
+            cout << '\n';
+        };
+        for (size_t i = 0; i < min(peakLimit, sites.size()); ++i) {
+            const auto& histogram = sites[i].second;
+            const auto shortLived = histogram.shortLived();
+            if (!shortLived) {
+                break;
+            }
+            uint64_t freed = 0;
+            for (const auto count : histogram.byEvents) {
+                freed += count;
+            }
+            cout << shortLived << " short-lived of " << freed << " freed allocations (" << fixed << setprecision(2)
+                 << (float(shortLived) * 100.f / freed) << "%) from\n";
+            printBacktrace(sites[i].first, cout, 1);
+            printHistogram("by time:  ", histogram.byTime, timeLabels);
+            printHistogram("by events:", histogram.byEvents, eventLabels);
+            cout << '\n';
+        }
+    }
+
+    void printSlackBySize() const
+    {
+        for (const auto& entry : slackBySize) {
+            const auto& bucket = entry.second;
+            if (!bucket.slack) {
+                continue;
+            }
+            cout << "  sizes up to " << formatBytes(entry.first) << ": " << formatBytes(bucket.slack)
+                 << " wasted on top of " << formatBytes(bucket.requested) << " requested (" << fixed
+                 << setprecision(2) << (float(bucket.slack) * 100.f / bucket.requested) << "%) over "
+                 << bucket.allocations << " calls\n";
+        }
+    }
+
+    void printThreads() const
+    {
+        vector<uint32_t> ids;
+        for (uint32_t thread = 0; thread < threads.size(); ++thread) {
+            if (threads[thread].cost.allocations) {
+                ids.push_back(thread);
+            }
+        }
+        sort(ids.begin(), ids.end(),
+             [this](uint32_t l, uint32_t r) { return threads[l].cost.peak > threads[r].cost.peak; });
+        for (const auto thread : ids) {
+            const auto& cost = threads[thread].cost;
+            cout << "  " << formatBytes(cost.peak) << " peak, " << formatBytes(cost.leaked) << " leaked over "
+                 << cost.allocations << " calls, " << cost.temporary << " temporary, from ";
+            if (thread) {
+                const auto& name = stringify(threads[thread].name);
+                cout << "thread " << thread << (name.empty() ? "" : " \"" + name + "\"") << '\n';
+            } else {
+                cout << "unknown threads\n";
+            }
+        }
+    }
+
+    void printHeapGrowth(uint64_t beginGc, uint64_t endGc) const
+    {
+        HeapGrowth growth;
+        size_t recordIndex = 0;
+        while (recordIndex < objectTreeNodes.size()) {
+            HeapSnapshot snapshot;
+            if (!snapshot.read(*this, recordIndex)) {
+                cerr << "heap snapshot of GC " << snapshot.gcNum << " is incomplete" << endl;
+            }
+            growth.add(snapshot);
+        }
+
+        const auto gcNums = growth.gcNums();
+        auto first = lower_bound(gcNums.begin(), gcNums.end(), beginGc);
+        auto last = upper_bound(gcNums.begin(), gcNums.end(), endGc);
+        if (first == gcNums.end() || last == gcNums.begin() || *first > *prev(last)) {
+            cout << "no heap snapshots in the range of GCs\n";
+            return;
+        }
+        cout << "from GC " << *first << " to GC " << *prev(last) << ", " << (last - first) << " snapshots\n\n";
+
+        auto byGrowth = [](const HeapGrowth::Entry& l, const HeapGrowth::Entry& r) {
+            return l.end.retainedSize - l.begin.retainedSize > r.end.retainedSize - r.begin.retainedSize;
+        };
+        auto printEntry = [](const HeapGrowth::Entry& entry) {
+            cout << formatBytes(entry.end.retainedSize - entry.begin.retainedSize) << " retained ("
+                 << formatBytes(entry.begin.retainedSize) << " -> " << formatBytes(entry.end.retainedSize) << "), "
+                 << (entry.end.instances - entry.begin.instances) << " instances (" << entry.begin.instances
+                 << " -> " << entry.end.instances << ")";
+        };
+
+        auto classes = growth.classGrowth(beginGc, endGc);
+        sort(classes.begin(), classes.end(), byGrowth);
+        cout << "CLASSES\n";
+        for (size_t i = 0; i < min(peakLimit, classes.size()); ++i) {
+            const auto& entry = classes[i];
+            if (entry.end.retainedSize <= entry.begin.retainedSize) {
+                break;
+            }
+            printEntry(entry);
+            ClassIndex classIndex;
+            classIndex.index = entry.id;
+            cout << " of " << stringify(classIndex) << '\n';
+        }
+
+        auto paths = growth.pathGrowth(beginGc, endGc);
+        sort(paths.begin(), paths.end(), byGrowth);
+        cout << "\nDOMINATOR PATHS\n";
+        for (size_t i = 0; i < min(peakLimit, paths.size()); ++i) {
+            const auto& entry = paths[i];
+            if (entry.end.retainedSize <= entry.begin.retainedSize) {
+                break;
+            }
+            printEntry(entry);
+            cout << " in\n";
+            const auto path = growth.path(entry.id);
+            printIndent(cout, 1);
+            for (size_t j = 0; j < path.size(); ++j) {
+                cout << (j ? " -> " : "") << stringify(path[j]);
+            }
+            cout << '\n';
+        }
+    }
+
     void writeMassifHeader(const char* command)
     {
         // write massif header
@@ -356,7 +880,7 @@ struct Printer final : public AccumulatedTraceData
     void writeMassifSnapshot(size_t timeStamp, bool isLast)
     {
         if (!lastMassifPeak) {
-            lastMassifPeak = totalCost.getDisplay()->leaked;
+            lastMassifPeak = totalCost.getDisplay(display)->leaked;
             massifAllocations = allocations;
         }
         massifOut << "#-----------\n"
@@ -370,7 +894,12 @@ struct Printer final : public AccumulatedTraceData
         if (massifDetailedFreq && (isLast || !(massifSnapshotId % massifDetailedFreq))) {
             massifOut << "heap_tree=detailed\n";
             const size_t threshold = double(lastMassifPeak) * massifThreshold * 0.01;
-            writeMassifBacktrace(massifAllocations, lastMassifPeak, threshold, IpIndex());
+            // while parsing, the allocations are ordered by their first occurrence,
+            // sort them to merge the backtraces in a stable order
+            auto snapshot = massifAllocations.rows();
+            sort(snapshot.begin(), snapshot.end(),
+                 [](const Allocation& l, const Allocation& r) { return l.traceIndex < r.traceIndex; });
+            writeMassifBacktrace(snapshot, lastMassifPeak, threshold, IpIndex());
         } else {
             massifOut << "heap_tree=empty\n";
         }
@@ -387,7 +916,7 @@ struct Printer final : public AccumulatedTraceData
         size_t skipped = 0;
         auto mergedAllocations = mergeAllocations(allocations);
         sort(mergedAllocations.begin(), mergedAllocations.end(),
-             [](const MergedAllocation& l, const MergedAllocation& r) { return l.getDisplay()->leaked > r.getDisplay()->leaked; });
+             [this](const MergedAllocation& l, const MergedAllocation& r) { return l.getDisplay(display)->leaked > r.getDisplay(display)->leaked; });
 
         const auto ip = findIp(location);
 
@@ -395,14 +924,14 @@ struct Printer final : public AccumulatedTraceData
         const bool shouldStop = isStopIndex(ip.frame.functionIndex);
         if (!shouldStop) {
             for (auto& merged : mergedAllocations) {
-                if (merged.getDisplay()->leaked < 0) {
+                if (merged.getDisplay(display)->leaked < 0) {
                     // list is sorted, so we can bail out now - these entries are
                     // uninteresting for massif
                     break;
                 }
 
                 // skip items below threshold
-                if (static_cast<size_t>(merged.getDisplay()->leaked) >= threshold) {
+                if (static_cast<size_t>(merged.getDisplay(display)->leaked) >= threshold) {
                     ++numAllocs;
                     // skip the first level of the backtrace, otherwise we'd endlessly
                     // recurse
@@ -411,7 +940,7 @@ struct Printer final : public AccumulatedTraceData
                     }
                 } else {
                     ++skipped;
-                    skippedLeaked += merged.getDisplay()->leaked;
+                    skippedLeaked += merged.getDisplay(display)->leaked;
                 }
             }
         }
@@ -452,12 +981,12 @@ struct Printer final : public AccumulatedTraceData
 
         if (!shouldStop) {
             for (const auto& merged : mergedAllocations) {
-                if (merged.getDisplay()->leaked > 0 && static_cast<size_t>(merged.getDisplay()->leaked) >= threshold) {
-                    if (skippedLeaked > merged.getDisplay()->leaked) {
+                if (merged.getDisplay(display)->leaked > 0 && static_cast<size_t>(merged.getDisplay(display)->leaked) >= threshold) {
+                    if (skippedLeaked > merged.getDisplay(display)->leaked) {
                         // manually inject this entry to keep the output sorted
                         writeSkipped();
                     }
-                    writeMassifBacktrace(merged.traces, merged.getDisplay()->leaked, threshold, merged.ipIndex, depth + 1);
+                    writeMassifBacktrace(merged.traces, merged.getDisplay(display)->leaked, threshold, merged.ipIndex, depth + 1);
                 }
             }
             writeSkipped();
@@ -473,10 +1002,21 @@ struct Printer final : public AccumulatedTraceData
         if (printHistogram) {
             ++sizeHistogram[info.size];
         }
+        if (printSlack) {
+            // the buckets are named by the power of two that bounds their requested sizes
+            uint64_t bound = 1;
+            while (bound < info.size) {
+                bound <<= 1;
+            }
+            auto& bucket = slackBySize[bound];
+            ++bucket.allocations;
+            bucket.requested += info.size;
+            bucket.slack += info.slack;
+        }
 
-        if (totalCost.getDisplay()->leaked > 0 && static_cast<size_t>(totalCost.getDisplay()->leaked) > lastMassifPeak && massifOut.is_open()) {
+        if (totalCost.getDisplay(display)->leaked > 0 && static_cast<size_t>(totalCost.getDisplay(display)->leaked) > lastMassifPeak && massifOut.is_open()) {
             massifAllocations = allocations;
-            lastMassifPeak = totalCost.getDisplay()->leaked;
+            lastMassifPeak = totalCost.getDisplay(display)->leaked;
         }
     }
 
@@ -485,11 +1025,24 @@ struct Printer final : public AccumulatedTraceData
         if (massifOut.is_open()) {
             writeMassifSnapshot(newStamp, newStamp == totalTime);
         }
+        if (liveInterval > 0 && newStamp >= nextLiveSummary) {
+            printLiveSummary(newStamp);
+            nextLiveSummary = newStamp + liveInterval;
+        }
+    }
+
+    void printLiveSummary(int64_t timeStamp) const
+    {
+        const auto* cost = totalCost.getDisplay(display);
+        cout << fixed << setprecision(2) << (timeStamp * 0.001) << "s: " << formatBytes(cost->leaked)
+             << " consumed, " << formatBytes(cost->peak) << " peak, " << cost->allocations
+             << " calls to allocation functions, " << cost->temporary << " temporary" << endl;
     }
 
     void handleDebuggee(const char* command) override
     {
         cout << "Debuggee command was: " << command << endl;
+        debuggee = command;
         if (massifOut.is_open()) {
             writeMassifHeader(command);
         }
@@ -497,14 +1050,29 @@ struct Printer final : public AccumulatedTraceData
 
     bool printHistogram = false;
     bool mergeBacktraces = true;
+    // time in ms between the summaries printed while reading live data, or zero
+    int64_t liveInterval = 0;
+    int64_t nextLiveSummary = 0;
+    AllocationData::DisplayId display = AllocationData::DisplayId::malloc;
+    string debuggee;
 
     vector<MergedAllocation> mergedAllocations;
+    vector<Allocation> allocationRows;
 
     std::map<uint64_t, uint64_t> sizeHistogram;
 
+    struct SlackBucket
+    {
+        uint64_t allocations = 0;
+        uint64_t requested = 0;
+        uint64_t slack = 0;
+    };
+    bool printSlack = false;
+    std::map<uint64_t, SlackBucket> slackBySize;
+
     uint64_t massifSnapshotId = 0;
     uint64_t lastMassifPeak = 0;
-    vector<Allocation> massifAllocations;
+    AllocationTable massifAllocations;
     ofstream massifOut;
     double massifThreshold = 1;
     uint64_t massifDetailedFreq = 1;
@@ -535,10 +1103,46 @@ int main(int argc, char** argv)
                                                  "Print backtraces to leaked memory allocations.")(
         "print-overall-allocated,o", po::value<bool>()->default_value(false)->implicit_value(true),
         "Print top overall allocators, ignoring memory frees.")(
+        "print-lifetimes", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print backtraces to the allocators with the most short-lived allocations, i.e. the ones that "
+        "are freed before 100 other allocation events happened, with histograms of the lifetimes "
+        "of their freed allocations by time and by the number of allocation events in between. They are "
+        "only known for traces interpreted with DUMP_HEAPTRACK_LIFETIMES.")(
+        "print-heap-growth", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print the classes and the paths in the dominator tree of the managed heap whose retained "
+        "size grew the most between the heap snapshots of --gc-begin and --gc-end.")(
+        "print-slack", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print backtraces to the allocators with the most allocator slack at the peak, i.e. the bytes "
+        "that malloc reserved beyond the requested sizes, and the slack by requested size. It is only "
+        "known for traces recorded with DUMP_HEAPTRACK_USABLE_SIZE or interpreted with "
+        "DUMP_HEAPTRACK_MALLOC_ALIGNMENT.")(
+        "print-fragmentation", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print backtraces to the allocators whose allocations pinned the most sparse heap pages, i.e. "
+        "pages that are less than a quarter used, at the largest gap between the pages spanned by "
+        "the heap and its live bytes. It is only known for traces interpreted with "
+        "DUMP_HEAPTRACK_FRAGMENTATION.")(
+        "gc-begin", po::value<uint64_t>()->default_value(0),
+        "Number of the first GC whose heap snapshot is compared with --print-heap-growth.")(
+        "gc-end", po::value<uint64_t>()->default_value(numeric_limits<uint64_t>::max()),
+        "Number of the last GC whose heap snapshot is compared with --print-heap-growth.")(
+        "thread", po::value<vector<string>>()->composing(),
+        "Only account for the malloc allocations of the threads with the given name or id, "
+        "can be given several times. The threads are listed in the summary.")(
         "peak-limit,n", po::value<size_t>()->default_value(10)->implicit_value(10),
         "Limit the number of reported peaks.")("sub-peak-limit,s",
                                                po::value<size_t>()->default_value(5)->implicit_value(5),
                                                "Limit the number of reported backtraces of merged peak locations.")(
+        "print-top-down", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print the top-down call tree of the allocations, starting at main.")(
+        "print-bottom-up", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Print the bottom-up call tree of the allocations, starting at the allocation sites.")(
+        "call-tree-cost", po::value<string>()->default_value("peak"),
+        "Cost that the call trees are sorted by, one of peak, leaked, allocations, temporary, "
+        "allocated, slack, i.e. the allocator slack at the peak, or pinned, i.e. the free bytes of "
+        "the sparse pages pinned at the largest heap fragmentation.")(
+        "call-tree-threshold", po::value<double>()->default_value(1.),
+        "Percentage of the total cost, below which the rows of the call trees are aggregated "
+        "into a single entry.")(
         "print-histogram,H", po::value<string>()->default_value(string()),
         "Path to output file where an allocation size histogram will be written "
         "to.")("print-flamegraph,F", po::value<string>()->default_value(string()),
@@ -551,6 +1155,11 @@ int main(int argc, char** argv)
                "  flamegraph.pl --title \"heaptrack: allocations\" --colors mem \\\n"
                "    --countname allocations < stacks.txt > heaptrack.someapp.PID.svg\n"
                "  [firefox|chromium] heaptrack.someapp.PID.svg\n")(
+        "print-pprof", po::value<string>()->default_value(string()),
+        "Path to output file where a gzip compressed pprof profile will be written to. "
+        "It has the sample types allocations, allocated, leaked and peak with one sample "
+        "per backtrace, e.g.:\n"
+        "  pprof -sample_index=peak -top heaptrack_print_output.pb.gz\n")(
         "print-massif,M", po::value<string>()->default_value(string()),
         "Path to output file where a massif compatible data file will be written "
         "to.")("massif-threshold", po::value<double>()->default_value(1.),
@@ -563,7 +1172,24 @@ int main(int argc, char** argv)
         "You can set the value to zero to disable detailed snapshots.\n")(
         "filter-bt-function", po::value<string>()->default_value(string()),
         "Only print allocations where the backtrace contains the given "
-        "function.")("help,h", "Show this help message.")("version,v", "Displays version information.");
+        "function.")("write-index", po::value<string>()->default_value(string()),
+                     "Path to output file where an index of the data file will be written to. "
+                     "It allows to quickly analyze time windows of the data with --index later on.")(
+        "checkpoint-interval", po::value<int64_t>()->default_value(10000),
+        "Time in ms between the checkpoints of the accumulated state in the index.")(
+        "index", po::value<string>()->default_value(string()),
+        "Path to an index written with --write-index. It is used to start reading the data "
+        "file at the last checkpoint before the time window.")(
+        "begin", po::value<int64_t>()->default_value(0),
+        "Only analyze the peaks and allocation callbacks from the given time in ms on.")(
+        "end", po::value<int64_t>()->default_value(numeric_limits<int64_t>::max()),
+        "Stop analyzing the data after the given time in ms.")(
+        "live", po::value<bool>()->default_value(false)->implicit_value(true),
+        "Follow the data file while it is still being written, e.g. a growing file or a FIFO "
+        "that heaptrack_interpret writes to, and print a short summary periodically. The "
+        "full report is printed once the FIFO is closed or on SIGINT.")(
+        "live-interval", po::value<int64_t>()->default_value(1000),
+        "Time in ms of the trace between the summaries that are printed with --live.")("help,h", "Show this help message.")("version,v", "Displays version information.");
     po::positional_options_description p;
     p.add("file", -1);
 
@@ -607,10 +1233,14 @@ int main(int argc, char** argv)
     data.filterBtFunction = vm["filter-bt-function"].as<string>();
     data.peakLimit = vm["peak-limit"].as<size_t>();
     data.subPeakLimit = vm["sub-peak-limit"].as<size_t>();
+    if (vm.count("thread")) {
+        data.threadFilter = vm["thread"].as<vector<string>>();
+    }
     const string printHistogram = vm["print-histogram"].as<string>();
     data.printHistogram = !printHistogram.empty();
     const string printFlamegraph = vm["print-flamegraph"].as<string>();
     const string printMassif = vm["print-massif"].as<string>();
+    const string printPprof = vm["print-pprof"].as<string>();
     if (!printMassif.empty()) {
         data.massifOut.open(printMassif, ios_base::out);
         if (!data.massifOut.is_open()) {
@@ -622,40 +1252,96 @@ int main(int argc, char** argv)
     }
     const bool printLeaks = vm["print-leaks"].as<bool>();
     const bool printOverallAlloc = vm["print-overall-allocated"].as<bool>();
+    const bool printLifetimes = vm["print-lifetimes"].as<bool>();
+    const bool printHeapGrowth = vm["print-heap-growth"].as<bool>();
+    const bool printSlack = vm["print-slack"].as<bool>();
+    data.printSlack = printSlack;
+    const bool printFragmentation = vm["print-fragmentation"].as<bool>();
     const bool printPeaks = vm["print-peaks"].as<bool>();
     const bool printAllocs = vm["print-allocators"].as<bool>();
     const bool printTemporary = vm["print-temporary"].as<bool>();
+    const bool printTopDown = vm["print-top-down"].as<bool>();
+    const bool printBottomUp = vm["print-bottom-up"].as<bool>();
+    const auto callTreeCost = vm["call-tree-cost"].as<string>();
+    const map<string, int64_t AllocationData::Stats::*> callTreeMembers = {
+        {"peak", &AllocationData::Stats::peak},
+        {"leaked", &AllocationData::Stats::leaked},
+        {"allocations", &AllocationData::Stats::allocations},
+        {"temporary", &AllocationData::Stats::temporary},
+        {"allocated", &AllocationData::Stats::allocated},
+        {"slack", &AllocationData::Stats::peakSlack},
+        {"pinned", &AllocationData::Stats::pinned}};
+    if (!callTreeMembers.count(callTreeCost)) {
+        cerr << "ERROR: unknown call tree cost \"" << callTreeCost << "\"\n\n" << desc << endl;
+        return 1;
+    }
+    const auto writeIndex = vm["write-index"].as<string>();
+    const auto indexFile = vm["index"].as<string>();
+    const auto windowBegin = vm["begin"].as<int64_t>();
+    const auto windowEnd = vm["end"].as<int64_t>();
+    const bool readWindow = !indexFile.empty() || windowBegin != 0 || windowEnd != numeric_limits<int64_t>::max();
+    if (!writeIndex.empty() && readWindow) {
+        cerr << "ERROR: --write-index can't be combined with a time window\n\n" << desc << endl;
+        return 1;
+    }
+    if (vm.count("thread") && (!writeIndex.empty() || !indexFile.empty())) {
+        // the checkpoints of an index hold the cost of all threads
+        cerr << "ERROR: --thread can't be combined with an index\n\n" << desc << endl;
+        return 1;
+    }
+    const bool live = vm["live"].as<bool>();
+    if (live && (!writeIndex.empty() || readWindow || !diffFile.empty())) {
+        cerr << "ERROR: --live can't be combined with an index, a time window or a diff\n\n" << desc << endl;
+        return 1;
+    }
+    if (live) {
+        data.liveInterval = max(vm["live-interval"].as<int64_t>(), int64_t(1));
+        signal(SIGINT, handleInterrupt);
+    }
+    auto readInput = [&]() {
+        if (live) {
+            return data.readLive(inputFile, stopLive);
+        } else if (!writeIndex.empty()) {
+            return data.readAndIndex(inputFile, writeIndex, vm["checkpoint-interval"].as<int64_t>());
+        } else if (readWindow) {
+            return data.readWindow(inputFile, indexFile, windowBegin, windowEnd);
+        }
+        return data.read(inputFile);
+    };
 
     cout << "reading file \"" << inputFile << "\" - please wait, this might take some time..." << endl;
 
     if (!diffFile.empty()) {
         cout << "reading diff file \"" << diffFile << "\" - please wait, this might take some time..." << endl;
         Printer diffData;
+        diffData.threadFilter = data.threadFilter;
         auto diffRead = async(launch::async, [&diffData, diffFile]() { return diffData.read(diffFile); });
 
-        if (!data.read(inputFile) || !diffRead.get()) {
+        if (!readInput() || !diffRead.get()) {
             return 1;
         }
 
         data.diff(diffData);
-    } else if (!data.read(inputFile)) {
+    } else if (!readInput()) {
         return 1;
     }
 
     data.finalize();
 
+    const auto display = data.display;
+
     cout << "finished reading file, now analyzing data:\n" << endl;
 
     if (printAllocs) {
         // sort by amount of allocations
         cout << "MOST CALLS TO ALLOCATION FUNCTIONS\n";
         data.printAllocations(&AllocationData::Stats::allocations,
-                              [](const AllocationData& data) {
-                                  cout << data.getDisplay()->allocations << " calls to allocation functions with "
-                                       << formatBytes(data.getDisplay()->peak) << " peak consumption from\n";
+                              [display](const AllocationData& data) {
+                                  cout << data.getDisplay(display)->allocations << " calls to allocation functions with "
+                                       << formatBytes(data.getDisplay(display)->peak) << " peak consumption from\n";
                               },
-                              [](const AllocationData& data) {
-                                  cout << data.getDisplay()->allocations << " calls with " << formatBytes(data.getDisplay()->peak)
+                              [display](const AllocationData& data) {
+                                  cout << data.getDisplay(display)->allocations << " calls with " << formatBytes(data.getDisplay(display)->peak)
                                        << " peak consumption from:\n";
                               });
         cout << endl;
@@ -664,12 +1350,12 @@ int main(int argc, char** argv)
     if (printOverallAlloc) {
         cout << "MOST BYTES ALLOCATED OVER TIME (ignoring deallocations)\n";
         data.printAllocations(&AllocationData::Stats::allocated,
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->allocated) << " allocated over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->allocated) << " allocated over " << data.getDisplay(display)->allocations
                                        << " calls from\n";
                               },
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->allocated) << " allocated over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->allocated) << " allocated over " << data.getDisplay(display)->allocations
                                        << " calls from:\n";
                               });
         cout << endl;
@@ -678,12 +1364,12 @@ int main(int argc, char** argv)
     if (printPeaks) {
         cout << "PEAK MEMORY CONSUMERS\n";
         data.printAllocations(&AllocationData::Stats::peak,
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->peak) << " peak memory consumed over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->peak) << " peak memory consumed over " << data.getDisplay(display)->allocations
                                        << " calls from\n";
                               },
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->peak) << " consumed over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->peak) << " consumed over " << data.getDisplay(display)->allocations
                                        << " calls from:\n";
                               });
         cout << endl;
@@ -693,12 +1379,12 @@ int main(int argc, char** argv)
         // sort by amount of leaks
         cout << "MEMORY LEAKS\n";
         data.printAllocations(&AllocationData::Stats::leaked,
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->leaked) << " leaked over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->leaked) << " leaked over " << data.getDisplay(display)->allocations
                                        << " calls from\n";
                               },
-                              [](const AllocationData& data) {
-                                  cout << formatBytes(data.getDisplay()->leaked) << " leaked over " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->leaked) << " leaked over " << data.getDisplay(display)->allocations
                                        << " calls from:\n";
                               });
         cout << endl;
@@ -708,30 +1394,123 @@ int main(int argc, char** argv)
         // sort by amount of temporary allocations
         cout << "MOST TEMPORARY ALLOCATIONS\n";
         data.printAllocations(&AllocationData::Stats::temporary,
-                              [](const AllocationData& data) {
-                                  cout << data.getDisplay()->temporary << " temporary allocations of " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << data.getDisplay(display)->temporary << " temporary allocations of " << data.getDisplay(display)->allocations
                                        << " allocations in total (" << fixed << setprecision(2)
-                                       << (float(data.getDisplay()->temporary) * 100.f / data.getDisplay()->allocations) << "%) from\n";
+                                       << (float(data.getDisplay(display)->temporary) * 100.f / data.getDisplay(display)->allocations) << "%) from\n";
                               },
-                              [](const AllocationData& data) {
-                                  cout << data.getDisplay()->temporary << " temporary allocations of " << data.getDisplay()->allocations
+                              [display](const AllocationData& data) {
+                                  cout << data.getDisplay(display)->temporary << " temporary allocations of " << data.getDisplay(display)->allocations
                                        << " allocations in total (" << fixed << setprecision(2)
-                                       << (float(data.getDisplay()->temporary) * 100.f / data.getDisplay()->allocations) << "%) from:\n";
+                                       << (float(data.getDisplay(display)->temporary) * 100.f / data.getDisplay(display)->allocations) << "%) from:\n";
                               });
         cout << endl;
     }
 
+    if (printLifetimes) {
+        cout << "MOST SHORT-LIVED ALLOCATIONS\n";
+        data.printLifetimes();
+        cout << endl;
+    }
+
+    if (printSlack) {
+        cout << "MOST ALLOCATOR SLACK AT PEAK\n";
+        data.printAllocations(&AllocationData::Stats::peakSlack,
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->peakSlack) << " wasted on top of "
+                                       << formatBytes(data.getDisplay(display)->peak) << " peak memory consumed over "
+                                       << data.getDisplay(display)->allocations << " calls from\n";
+                              },
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->peakSlack) << " wasted on top of "
+                                       << formatBytes(data.getDisplay(display)->peak) << " consumed over "
+                                       << data.getDisplay(display)->allocations << " calls from:\n";
+                              });
+        cout << endl;
+        cout << "ALLOCATOR SLACK BY REQUESTED SIZE\n";
+        data.printSlackBySize();
+        cout << endl;
+    }
+
+    if (printFragmentation) {
+        cout << "MOST SPARSE PAGES PINNED\n";
+        data.printAllocations(&AllocationData::Stats::pinned,
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->pinned)
+                                       << " of sparse pages pinned, allocated over "
+                                       << data.getDisplay(display)->allocations << " calls from\n";
+                              },
+                              [display](const AllocationData& data) {
+                                  cout << formatBytes(data.getDisplay(display)->pinned)
+                                       << " of sparse pages pinned, allocated over "
+                                       << data.getDisplay(display)->allocations << " calls from:\n";
+                              });
+        cout << endl;
+    }
+
+    if (printHeapGrowth) {
+        cout << "MANAGED HEAP GROWTH\n";
+        data.printHeapGrowth(vm["gc-begin"].as<uint64_t>(), vm["gc-end"].as<uint64_t>());
+        cout << endl;
+    }
+
+    if (printTopDown || printBottomUp) {
+        const auto member = callTreeMembers.at(callTreeCost);
+        const int64_t threshold =
+            std::abs(data.totalCost.getDisplay(display)->*member) * vm["call-tree-threshold"].as<double>() * 0.01;
+        auto printTree = [&](LazyCallTree::Direction direction) {
+            const auto tree = data.buildCallTree(direction);
+            auto rows = tree.topRows<CallTreeRows>();
+            data.printCallTree(tree, &rows, member, threshold);
+        };
+        if (printBottomUp) {
+            cout << "BOTTOM-UP CALL TREE (" << callTreeCost << ")\n";
+            printTree(LazyCallTree::BottomUp);
+            cout << endl;
+        }
+        if (printTopDown) {
+            cout << "TOP-DOWN CALL TREE (" << callTreeCost << ")\n";
+            printTree(LazyCallTree::TopDown);
+            cout << endl;
+        }
+    }
+
     const double totalTimeS = 0.001 * data.totalTime;
     cout << "total runtime: " << fixed << totalTimeS << "s.\n"
-         << "bytes allocated in total (ignoring deallocations): " << formatBytes(data.totalCost.getDisplay()->allocated) << " ("
-         << formatBytes(data.totalCost.getDisplay()->allocated / totalTimeS) << "/s)" << '\n'
-         << "calls to allocation functions: " << data.totalCost.getDisplay()->allocations << " ("
-         << int64_t(data.totalCost.getDisplay()->allocations / totalTimeS) << "/s)\n"
-         << "temporary memory allocations: " << data.totalCost.getDisplay()->temporary << " ("
-         << int64_t(data.totalCost.getDisplay()->temporary / totalTimeS) << "/s)\n"
-         << "peak heap memory consumption: " << formatBytes(data.totalCost.getDisplay()->peak) << '\n'
+         << "bytes allocated in total (ignoring deallocations): " << formatBytes(data.totalCost.getDisplay(display)->allocated) << " ("
+         << formatBytes(data.totalCost.getDisplay(display)->allocated / totalTimeS) << "/s)" << '\n'
+         << "calls to allocation functions: " << data.totalCost.getDisplay(display)->allocations << " ("
+         << int64_t(data.totalCost.getDisplay(display)->allocations / totalTimeS) << "/s)\n"
+         << "temporary memory allocations: " << data.totalCost.getDisplay(display)->temporary << " ("
+         << int64_t(data.totalCost.getDisplay(display)->temporary / totalTimeS) << "/s)\n"
+         << "peak heap memory consumption: " << formatBytes(data.totalCost.getDisplay(display)->peak) << '\n'
          << "peak RSS (including heaptrack overhead): " << formatBytes(data.peakRSS * 1024) << '\n'
-         << "total memory leaked: " << formatBytes(data.totalCost.getDisplay()->leaked) << '\n';
+         << "total memory leaked: " << formatBytes(data.totalCost.getDisplay(display)->leaked) << '\n';
+    if (data.totalCost.getDisplay(display)->shortLived) {
+        // only traces that were interpreted with lifetime tracking have them
+        cout << "short-lived memory allocations: " << data.totalCost.getDisplay(display)->shortLived << '\n';
+    }
+    if (data.totalCost.getDisplay(display)->peakSlack) {
+        // only traces with the usable sizes or a modeled allocator have it
+        cout << "allocator slack at peak: " << formatBytes(data.totalCost.getDisplay(display)->peakSlack) << " ("
+             << fixed << setprecision(2)
+             << (float(data.totalCost.getDisplay(display)->peakSlack) * 100.f
+                 / data.totalCost.getDisplay(display)->peak)
+             << "% of the peak heap memory consumption)\n";
+    }
+    if (display == AllocationData::DisplayId::malloc && data.peakFragmentation.spanned) {
+        // only traces that were interpreted with fragmentation tracking have it
+        const auto& fragmentation = data.peakFragmentation;
+        cout << "peak heap fragmentation: " << formatBytes(fragmentation.spanned) << " of pages spanned by "
+             << formatBytes(fragmentation.live) << " live bytes, " << formatBytes(fragmentation.sparse)
+             << " of them in sparse pages, after " << fixed << setprecision(3)
+             << (0.001 * data.peakFragmentationTime) << "s\n";
+    }
+    if (display == AllocationData::DisplayId::malloc && data.threads.size() > 1) {
+        // only traces of trackers that attribute the allocations to threads have them
+        cout << "malloc allocations per thread:\n";
+        data.printThreads();
+    }
 
     if (!printHistogram.empty()) {
         ofstream histogram(printHistogram, ios_base::out);
@@ -749,16 +1528,28 @@ int main(int argc, char** argv)
         if (!flamegraph.is_open()) {
             cerr << "Failed to open flamegraph output file \"" << printFlamegraph << "\"." << endl;
         } else {
-            for (const auto& allocation : data.allocations) {
+            for (const auto& allocation : data.allocationRows) {
                 if (!allocation.traceIndex) {
                     flamegraph << "??";
                 } else {
                     data.printFlamegraph(data.findTrace(allocation.traceIndex), flamegraph);
                 }
-                flamegraph << ' ' << allocation.getDisplay()->allocations << '\n';
+                flamegraph << ' ' << allocation.getDisplay(display)->allocations << '\n';
             }
         }
     }
 
+    if (!printPprof.empty()) {
+        boost::iostreams::file_sink file(printPprof, ios_base::out | ios_base::binary);
+        if (!file.is_open()) {
+            cerr << "Failed to open pprof output file \"" << printPprof << "\"." << endl;
+        } else {
+            boost::iostreams::filtering_ostream pprof;
+            pprof.push(boost::iostreams::gzip_compressor());
+            pprof.push(file);
+            data.writePprof(pprof);
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "traceanalysis.h"
+
+#include <algorithm>
+#include <map>
+
+#include "calltree.h"
+
+using namespace std;
+
+bool TraceAnalysis::Filter::matches(const Location& location) const
+{
+    return (function.empty() || location.function.find(function) != string::npos)
+        && (module.empty() || location.module.find(module) != string::npos);
+}
+
+bool TraceAnalysis::load(const std::string& inputFile)
+{
+    m_inputFile = inputFile;
+    return read(inputFile);
+}
+
+TraceAnalysis::Location TraceAnalysis::location(const Frame& frame, const InstructionPointer& ip) const
+{
+    Location location;
+    location.function = prettyFunction(stringify(frame.functionIndex));
+    location.file = stringify(frame.fileIndex);
+    location.line = frame.line;
+    location.module = stringify(ip.moduleIndex);
+    return location;
+}
+
+void TraceAnalysis::backtrace(TraceIndex traceIndex, std::vector<Location>* frames) const
+{
+    frames->clear();
+    if (!traceIndex) {
+        return;
+    }
+    CallTree::forEachFrame(*this, traceIndex,
+                           [this, frames](const TraceNode&, const InstructionPointer& ip, const Frame* inlined, bool) {
+                               frames->push_back(location(inlined ? *inlined : ip.frame, ip));
+                               return true;
+                           });
+}
+
+bool TraceAnalysis::matches(TraceIndex traceIndex, const Filter& filter) const
+{
+    if (filter.isEmpty()) {
+        return true;
+    }
+    vector<Location> frames;
+    backtrace(traceIndex, &frames);
+    return any_of(frames.begin(), frames.end(), [&filter](const Location& frame) { return filter.matches(frame); });
+}
+
+std::vector<TraceAnalysis::LocationCost> TraceAnalysis::top(AllocationData::DisplayId display, Metric metric,
+                                                            std::size_t count, const Filter& filter) const
+{
+    map<Location, AllocationData::Stats> sites;
+    for (size_t slot = 0; allocations.hasData(display) && slot < allocations.size(); ++slot) {
+        const auto traceIndex = allocations.traceIndex(slot);
+        const auto stats = allocations.stats(slot, display);
+        if (!traceIndex || stats.isEmpty() || !matches(traceIndex, filter)) {
+            continue;
+        }
+        const auto ip = findIp(findTrace(traceIndex).ipIndex);
+        sites[location(ip.frame, ip)] += stats;
+    }
+
+    vector<LocationCost> ret;
+    ret.reserve(sites.size());
+    for (const auto& site : sites) {
+        ret.push_back({site.first, site.second});
+    }
+    auto compare = [metric](const LocationCost& lhs, const LocationCost& rhs) {
+        return lhs.cost.*metric > rhs.cost.*metric;
+    };
+    count = min(count, ret.size());
+    partial_sort(ret.begin(), ret.begin() + count, ret.end(), compare);
+    ret.resize(count);
+    return ret;
+}
+
+TraceAnalysis::CallTreeNode TraceAnalysis::subtree(AllocationData::DisplayId display, const Filter& filter) const
+{
+    CallTreeNode root = {};
+    struct StackFrame
+    {
+        Location location;
+        AllocationData::CoreCLRType stackType;
+    };
+    vector<StackFrame> frames;
+    for (size_t slot = 0; allocations.hasData(display) && slot < allocations.size(); ++slot) {
+        const auto traceIndex = allocations.traceIndex(slot);
+        const auto stats = allocations.stats(slot, display);
+        if (!traceIndex || stats.isEmpty()) {
+            continue;
+        }
+        frames.clear();
+        CallTree::forEachFrame(*this, traceIndex, [&](const TraceNode& trace, const InstructionPointer& ip,
+                                                      const Frame* inlined, bool) {
+            const auto stackType = isShowCoreCLRPartOption ? trace.getNodeType(display)
+                                                           : AllocationData::CoreCLRType::nonCoreCLR;
+            frames.push_back({location(inlined ? *inlined : ip.frame, ip), stackType});
+            return true;
+        });
+        // the frames go from the allocation site to main, so the outermost match is the last one
+        auto match = find_if(frames.rbegin(), frames.rend(),
+                             [&filter](const StackFrame& frame) { return filter.matches(frame.location); });
+        if (match == frames.rend()) {
+            continue;
+        }
+
+        root.cost += stats;
+        auto rows = &root.children;
+        for (auto frame = match; frame != frames.rend(); ++frame) {
+            rows = CallTree::addRow(rows, frame->location, stats, frame->stackType);
+        }
+    }
+    CallTree::setParents(root.children, nullptr);
+    return root;
+}
+
+bool TraceAnalysis::windowPeak(AllocationData::DisplayId display, int64_t begin, int64_t end, Peak* peak,
+                               const std::string& indexFile, const Filter& filter) const
+{
+    TraceAnalysis window;
+    window.shortenTemplates = shortenTemplates;
+    window.threadFilter = threadFilter;
+    if (!filter.isEmpty()) {
+        window.m_filteredPeak.reset(new FilteredPeak);
+        window.m_filteredPeak->display = display;
+        window.m_filteredPeak->filter = filter;
+        window.m_filteredPeak->begin = begin;
+        // reading starts at a checkpoint before the window, or at the start of the data when it is in the window
+        window.m_filteredPeak->timeStamp = max(begin, int64_t(0));
+    }
+    if (!window.readWindow(m_inputFile, indexFile, begin, end)) {
+        return false;
+    }
+    if (window.m_filteredPeak) {
+        *peak = window.m_filteredPeak->peak;
+        return true;
+    }
+    const auto total = window.totalCost.getDisplay(display);
+    peak->time = window.getPeakTime(display);
+    peak->consumed = total->peak;
+    peak->instances = total->peak_instances;
+    return true;
+}
+
+bool TraceAnalysis::matchesFilteredPeak(TraceIndex traceIndex)
+{
+    auto& traceMatches = m_filteredPeak->traceMatches;
+    if (traceIndex.index >= traceMatches.size()) {
+        traceMatches.resize(traceIndex.index + 1, 0);
+    }
+    auto& match = traceMatches[traceIndex.index];
+    if (!match) {
+        match = traceIndex && matches(traceIndex, m_filteredPeak->filter) ? 1 : 2;
+    }
+    return match == 1;
+}
+
+void TraceAnalysis::startFilteredPeak()
+{
+    auto& filtered = *m_filteredPeak;
+    filtered.isStarted = true;
+    filtered.leaked = 0;
+    filtered.instances = 0;
+    for (size_t slot = 0; allocations.hasData(filtered.display) && slot < allocations.size(); ++slot) {
+        if (!matchesFilteredPeak(allocations.traceIndex(slot))) {
+            continue;
+        }
+        const auto stats = allocations.stats(slot, filtered.display);
+        filtered.leaked += stats.leaked;
+        filtered.instances += stats.allocations - stats.deallocations;
+    }
+    if (!filtered.isHeap()) {
+        // like the total peak, the peak of the address ranges has no instances
+        filtered.instances = 0;
+    }
+    filtered.updatePeak();
+}
+
+void TraceAnalysis::updateFilteredPeak(const AllocationInfo& info, int64_t sign)
+{
+    auto& filtered = *m_filteredPeak;
+    if (!filtered.isStarted) {
+        // the allocations already hold this event
+        startFilteredPeak();
+        return;
+    }
+    const auto display = info.isManaged ? AllocationData::DisplayId::managed : AllocationData::DisplayId::malloc;
+    if (display != filtered.display || !matchesFilteredPeak(info.traceIndex)) {
+        return;
+    }
+    filtered.leaked += sign * static_cast<int64_t>(info.size);
+    filtered.instances += sign;
+    filtered.updatePeak();
+}
+
+void TraceAnalysis::handleTimeStamp(int64_t /*oldStamp*/, int64_t newStamp)
+{
+    if (!m_filteredPeak) {
+        return;
+    }
+    m_filteredPeak->timeStamp = newStamp;
+    if (!m_filteredPeak->isStarted && newStamp >= m_filteredPeak->begin) {
+        startFilteredPeak();
+    }
+}
+
+void TraceAnalysis::handleTotalCostUpdate()
+{
+}
+
+void TraceAnalysis::handleAllocation(const AllocationInfo& info, const AllocationIndex /*index*/)
+{
+    if (m_filteredPeak) {
+        updateFilteredPeak(info, 1);
+    }
+}
+
+void TraceAnalysis::handleDeallocation(const AllocationInfo& info, const AllocationIndex /*index*/)
+{
+    if (m_filteredPeak) {
+        updateFilteredPeak(info, -1);
+    }
+}
+
+void TraceAnalysis::handleAddressRangesUpdate()
+{
+    // the smaps chunks replace the costs of all address ranges at once
+    if (m_filteredPeak && (!m_filteredPeak->isStarted || !m_filteredPeak->isHeap())) {
+        startFilteredPeak();
+    }
+}
+
+void TraceAnalysis::handleDebuggee(const char* command)
+{
+    debuggee = command;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TRACEANALYSIS_H
+#define TRACEANALYSIS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "accumulatedtracedata.h"
+
+/**
+ * A heaptrack data file loaded for analysis, with queries over its allocations.
+ *
+ * This only depends on the standard library and boost, so it can be used by
+ * command line tools and tests that don't link against Qt.
+ */
+class TraceAnalysis final : public AccumulatedTraceData
+{
+public:
+    using Metric = int64_t AllocationData::Stats::*;
+
+    struct Location
+    {
+        std::string function;
+        std::string file;
+        int line = 0;
+        std::string module;
+
+        bool operator<(const Location& rhs) const
+        {
+            return std::tie(function, file, line, module) < std::tie(rhs.function, rhs.file, rhs.line, rhs.module);
+        }
+
+        bool operator==(const Location& rhs) const
+        {
+            return std::tie(function, file, line, module) == std::tie(rhs.function, rhs.file, rhs.line, rhs.module);
+        }
+    };
+
+    /**
+     * Restricts queries to the allocations with a frame in their backtrace that matches
+     * both the function and the module. An empty string matches everything.
+     */
+    struct Filter
+    {
+        std::string function;
+        std::string module;
+
+        bool isEmpty() const
+        {
+            return function.empty() && module.empty();
+        }
+
+        bool matches(const Location& location) const;
+    };
+
+    struct LocationCost
+    {
+        Location location;
+        AllocationData::Stats cost;
+    };
+
+    // a row of the call trees built by CallTree
+    struct CallTreeNode
+    {
+        AllocationData::Stats cost;
+        Location location;
+        const CallTreeNode* parent;
+        std::vector<CallTreeNode> children;
+        AllocationData::CoreCLRType stackType;
+
+        bool operator<(const Location& rhs) const
+        {
+            return location < rhs;
+        }
+    };
+
+    struct Peak
+    {
+        // time of the peak in ms
+        int64_t time = 0;
+        // total memory consumption and number of instances at the peak
+        int64_t consumed = 0;
+        int64_t instances = 0;
+    };
+
+    bool load(const std::string& inputFile);
+
+    /**
+     * @return the @p count allocation sites with the highest @p metric, i.e. the locations
+     *         where the allocation functions are called from, merged over all backtraces
+     */
+    std::vector<LocationCost> top(AllocationData::DisplayId display, Metric metric, std::size_t count,
+                                  const Filter& filter = {}) const;
+
+    /**
+     * @return the top-down call tree below the frames that match @p filter. The root
+     *         has no location and holds the total cost, its children are the matched frames
+     *         and have no parent.
+     */
+    CallTreeNode subtree(AllocationData::DisplayId display, const Filter& filter) const;
+
+    /**
+     * Read the loaded file again to find the peak within the time window [@p begin, @p end] in ms,
+     * optionally using an index written by AccumulatedTraceData::readAndIndex. With a @p filter,
+     * it is the peak of the allocations whose backtraces match it, taken over the same events.
+     */
+    bool windowPeak(AllocationData::DisplayId display, int64_t begin, int64_t end, Peak* peak,
+                    const std::string& indexFile = {}, const Filter& filter = {}) const;
+
+    /**
+     * @return the location of the frame, the inlined frames of an instruction pointer
+     *         share its module
+     */
+    Location location(const Frame& frame, const InstructionPointer& ip) const;
+
+    void handleTimeStamp(int64_t oldStamp, int64_t newStamp) override;
+    void handleTotalCostUpdate() override;
+    void handleAllocation(const AllocationInfo& info, const AllocationIndex index) override;
+    void handleDebuggee(const char* command) override;
+    void handleDeallocation(const AllocationInfo& info, const AllocationIndex index) override;
+    void handleAddressRangesUpdate() override;
+
+    std::string debuggee;
+
+private:
+    // collects the frames of the backtrace, from the allocation site up to the first stop frame
+    void backtrace(TraceIndex traceIndex, std::vector<Location>* frames) const;
+    bool matches(TraceIndex traceIndex, const Filter& filter) const;
+
+    // The cost of the allocations that match the filter of windowPeak, tracked while the window is read.
+    // It starts out with the state at the begin of the window and then follows the events in it.
+    struct FilteredPeak
+    {
+        AllocationData::DisplayId display;
+        Filter filter;
+        int64_t begin = 0;
+        int64_t timeStamp = 0;
+        bool isStarted = false;
+        int64_t leaked = 0;
+        int64_t instances = 0;
+        Peak peak;
+        // whether the traces match the filter, by trace index: 0 when not known yet, 1 or 2 otherwise
+        std::vector<char> traceMatches;
+
+        bool isHeap() const
+        {
+            return display == AllocationData::DisplayId::malloc || display == AllocationData::DisplayId::managed;
+        }
+
+        void updatePeak()
+        {
+            if (leaked > peak.consumed) {
+                peak.time = timeStamp;
+                peak.consumed = leaked;
+                peak.instances = instances;
+            }
+        }
+    };
+    bool matchesFilteredPeak(TraceIndex traceIndex);
+    // sums up the matching allocations from scratch
+    void startFilteredPeak();
+    void updateFilteredPeak(const AllocationInfo& info, int64_t sign);
+
+    std::string m_inputFile;
+    std::unique_ptr<FilteredPeak> m_filteredPeak;
+};
+
+#endif // TRACEANALYSIS_H
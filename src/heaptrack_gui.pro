@@ -109,6 +109,7 @@ THREAD_WEAVER {
 
 SOURCES += \
     analyze/accumulatedtracedata.cpp \
+    analyze/heapsnapshots.cpp \
     analyze/gui/aboutdata.cpp \
     analyze/gui/aboutdialog.cpp \
     analyze/gui/gui.cpp \
@@ -119,6 +120,7 @@ SOURCES += \
     analyze/gui/objecttreemodel.cpp \
     analyze/gui/objecttreeproxy.cpp \
     analyze/gui/parser.cpp \
+    analyze/gui/searchindex.cpp \
     analyze/gui/stacksmodel.cpp \
     analyze/gui/topproxy.cpp \
     analyze/gui/treemodel.cpp \
@@ -127,6 +129,9 @@ SOURCES += \
 
 HEADERS += \
     analyze/accumulatedtracedata.h \
+    analyze/allocationtable.h \
+    analyze/calltree.h \
+    analyze/heapsnapshots.h \
     analyze/gui/aboutdata.h \
     analyze/gui/aboutdialog.h \
     analyze/gui/callercalleemodel.h \
@@ -138,13 +143,16 @@ HEADERS += \
     analyze/gui/objecttreemodel.h \
     analyze/gui/objecttreeproxy.h \
     analyze/gui/parser.h \
+    analyze/gui/searchindex.h \
     analyze/gui/stacksmodel.h \
     analyze/gui/summarydata.h \
     analyze/gui/topproxy.h \
     analyze/gui/treemodel.h \
     analyze/gui/treeproxy.h \
     analyze/gui/util.h \
-    util/config.h
+    util/blockmap.h \
+    util/config.h \
+    util/lifetimehistogram.h
 
 QWT_CHART {
     SOURCES += \
@@ -9,8 +9,11 @@ LIBS += -lboost_program_options -lboost_iostreams -lpthread
 
 SOURCES += \
     analyze/print/heaptrack_print.cpp \
-    analyze/accumulatedtracedata.cpp
+    analyze/accumulatedtracedata.cpp \
+    analyze/heapsnapshots.cpp
 
 HEADERS += \
-    analyze/accumulatedtracedata.h
+    analyze/accumulatedtracedata.h \
+    analyze/calltree.h \
+    analyze/heapsnapshots.h \
     util/config.h
@@ -24,7 +24,10 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdio_ext.h>
 #include <tuple>
@@ -38,6 +41,7 @@
 
 #include "libbacktrace/backtrace.h"
 #include "libbacktrace/internal.h"
+#include "util/lifetimehistogram.h"
 #include "util/linereader.h"
 #include "util/pointermap.h"
 
@@ -440,6 +444,184 @@ private:
     unordered_map<uintptr_t, size_t> m_encounteredIps;
     unordered_map<uintptr_t, size_t> m_encounteredClasses;
 };
+
+/**
+ * Read the optional limit in the environment variable @p name into @p limit.
+ */
+template <typename T>
+void readLimit(const char* name, T* limit)
+{
+    const char* env = getenv(name);
+    if (!env) {
+        return;
+    }
+    try {
+        *limit = static_cast<T>(std::stoull(std::string(env)));
+    } catch (...) {
+        fprintf(stderr, "WARNING: %s should be a non-negative number, ignoring it.\n", name);
+    }
+}
+
+/**
+ * Model of the glibc malloc chunks: a chunk holds the requested size plus one size field,
+ * rounded up to the malloc alignment and at least two alignments large. Requests above the
+ * default mmap threshold get their own pages, with two size fields in front.
+ *
+ * @return the bytes that glibc reserves beyond the requested @p size
+ */
+uint64_t modelSlack(uint64_t size, uint64_t alignment)
+{
+    const uint64_t sizeField = alignment / 2;
+    const uint64_t mmapThreshold = 128 * 1024;
+    const uint64_t pageSize = 4096;
+    if (size >= mmapThreshold) {
+        const auto chunk = (size + 2 * sizeField + pageSize - 1) & ~(pageSize - 1);
+        return chunk - 2 * sizeField - size;
+    }
+    const auto chunk = max(2 * alignment, (size + sizeField + alignment - 1) & ~(alignment - 1));
+    return chunk - sizeField - size;
+}
+
+/**
+ * Occupancy of the pages of the malloc'd address space by the live allocations.
+ *
+ * A page is spanned as long as one byte of a live allocation is on it. Spanned pages that
+ * are less than a quarter used are sparse: they stay resident while mostly holding freed
+ * memory, which keeps the RSS up after the heap shrank.
+ *
+ * Only the first and the last page of an allocation can be shared with other allocations, the
+ * pages in between are fully covered by it and never sparse, so they are only counted.
+ */
+class PageOccupancy
+{
+public:
+    void setPageSize(uint64_t pageSize)
+    {
+        if (pageSize && m_pages.empty() && !m_fullPages) {
+            m_pageSize = pageSize;
+        }
+    }
+
+    void add(uint64_t ptr, uint64_t size)
+    {
+        m_fullPages += forEachPartialPage(ptr, size, [this](uint64_t number, uint64_t bytes) {
+            auto& page = m_pages[number];
+            if (page.allocations && isSparse(page)) {
+                --m_sparsePages;
+            }
+            ++page.allocations;
+            page.bytes += bytes;
+            if (isSparse(page)) {
+                ++m_sparsePages;
+            }
+        });
+        m_liveBytes += size;
+    }
+
+    void remove(uint64_t ptr, uint64_t size)
+    {
+        m_fullPages -= forEachPartialPage(ptr, size, [this](uint64_t number, uint64_t bytes) {
+            auto it = m_pages.find(number);
+            if (it == m_pages.end()) {
+                return;
+            }
+            auto& page = it->second;
+            if (isSparse(page)) {
+                --m_sparsePages;
+            }
+            --page.allocations;
+            page.bytes -= bytes;
+            if (!page.allocations) {
+                m_pages.erase(it);
+            } else if (isSparse(page)) {
+                ++m_sparsePages;
+            }
+        });
+        m_liveBytes -= size;
+    }
+
+    uint64_t liveBytes() const
+    {
+        return m_liveBytes;
+    }
+
+    uint64_t spannedBytes() const
+    {
+        return (m_pages.size() + m_fullPages) * m_pageSize;
+    }
+
+    uint64_t sparseBytes() const
+    {
+        return m_sparsePages * m_pageSize;
+    }
+
+    /**
+     * @return the free bytes of the sparse pages that the allocation keeps resident,
+     *         shared evenly with the other live allocations on these pages
+     */
+    uint64_t pinnedBytes(uint64_t ptr, uint64_t size) const
+    {
+        uint64_t pinned = 0;
+        forEachPartialPage(ptr, size, [this, &pinned](uint64_t number, uint64_t /*bytes*/) {
+            auto it = m_pages.find(number);
+            if (it != m_pages.end() && isSparse(it->second)) {
+                pinned += (m_pageSize - it->second.bytes) / it->second.allocations;
+            }
+        });
+        return pinned;
+    }
+
+private:
+    struct Page
+    {
+        uint32_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    bool isSparse(const Page& page) const
+    {
+        return page.bytes * 4 < m_pageSize;
+    }
+
+    // calls @p callback with the number of the first and the last page of the allocation and its bytes
+    // on that page when it covers the page partially, empty allocations still span the page of their
+    // address. @return the number of pages the allocation covers fully
+    template <typename Callback>
+    uint64_t forEachPartialPage(uint64_t ptr, uint64_t size, Callback callback) const
+    {
+        const auto end = ptr + size;
+        const auto first = ptr / m_pageSize;
+        const auto last = (max(end, ptr + 1) - 1) / m_pageSize;
+        if (first == last) {
+            if (size == m_pageSize) {
+                return 1;
+            }
+            callback(first, size);
+            return 0;
+        }
+        uint64_t fullPages = last - first - 1;
+        const auto firstBytes = (first + 1) * m_pageSize - ptr;
+        if (firstBytes == m_pageSize) {
+            ++fullPages;
+        } else {
+            callback(first, firstBytes);
+        }
+        const auto lastBytes = end - last * m_pageSize;
+        if (lastBytes == m_pageSize) {
+            ++fullPages;
+        } else {
+            callback(last, lastBytes);
+        }
+        return fullPages;
+    }
+
+    uint64_t m_pageSize = 4096;
+    uint64_t m_liveBytes = 0;
+    uint64_t m_sparsePages = 0;
+    uint64_t m_fullPages = 0;
+    // the partially covered pages
+    unordered_map<uint64_t, Page> m_pages;
+};
 }
 
 // Should be close to createFile() (src/track/libheaptrack.cpp) code,
@@ -541,7 +723,72 @@ int main(int /*argc*/, char** /*argv*/)
     string exe;
 
     PointerMap ptrToIndex;
-    uint64_t lastPtr = 0;
+    // the lifetimes are only computed on request, they cost the time stamp and the event number of every live
+    // malloc allocation
+    const char* lifetimesEnv = getenv("DUMP_HEAPTRACK_LIFETIMES");
+    const bool trackLifetimes = lifetimesEnv && strcmp(lifetimesEnv, "0") != 0;
+    struct Birth
+    {
+        int64_t timeStamp;
+        uint64_t event;
+    };
+    BasicPointerMap<Birth> births;
+    // an allocation is temporary when the thread that allocated it frees it with at most this
+    // many of its other allocation events in between and within this many milliseconds
+    uint64_t maxTemporaryEvents = 0;
+    int64_t maxTemporaryTime = numeric_limits<int64_t>::max();
+    readLimit("DUMP_HEAPTRACK_TEMPORARY_EVENTS", &maxTemporaryEvents);
+    readLimit("DUMP_HEAPTRACK_TEMPORARY_TIME", &maxTemporaryTime);
+    // the allocation events of a thread and its latest mallocs that can still become temporary, i.e. at most
+    // maxTemporaryEvents + 1 of them. Older trackers don't write the thread, it is 0 then
+    struct RecentMalloc
+    {
+        uint64_t ptr;
+        uint64_t threadEvent;
+        int64_t timeStamp;
+    };
+    struct ThreadEvents
+    {
+        uint64_t events = 0;
+        deque<RecentMalloc> recentMallocs;
+    };
+    unordered_map<uint32_t, ThreadEvents> threadEvents;
+    // the managed allocations don't carry a thread, they are counted for the thread of the latest malloc or free
+    uint32_t lastThread = 0;
+    // the malloc allocations by their allocation index, the managed ones are left out
+    struct MallocInfo
+    {
+        bool isMalloc = false;
+        uint32_t thread = 0;
+        uint64_t size = 0;
+    };
+    vector<MallocInfo> mallocInfos;
+    // the allocator slack is taken from the usable sizes, when the tracker records them, or
+    // modeled after glibc with this malloc alignment, i.e. 16 on 64bit and 8 on 32bit systems
+    uint64_t mallocAlignment = 0;
+    readLimit("DUMP_HEAPTRACK_MALLOC_ALIGNMENT", &mallocAlignment);
+    if (mallocAlignment && (mallocAlignment < 8 || (mallocAlignment & (mallocAlignment - 1)))) {
+        fprintf(stderr, "WARNING: DUMP_HEAPTRACK_MALLOC_ALIGNMENT should be a power of two of at least 8, "
+                        "ignoring it.\n");
+        mallocAlignment = 0;
+    }
+    // the occupancy of the heap pages is only tracked on request, it costs a map update per page
+    // of every allocation and free
+    const char* fragmentationEnv = getenv("DUMP_HEAPTRACK_FRAGMENTATION");
+    const bool trackFragmentation = fragmentationEnv && strcmp(fragmentationEnv, "0") != 0;
+    PageOccupancy pages;
+    // the bytes of the last fragmentation record, it is only written when they changed
+    uint64_t lastLiveBytes = 0;
+    uint64_t lastSpannedBytes = 0;
+    uint64_t lastSparseBytes = 0;
+    // the free bytes of sparse pages pinned by the live allocations, indexed by the allocation index, at the
+    // largest gap between the spanned and the live bytes, written after all other data
+    vector<uint64_t> pinned;
+    uint64_t pinnedGap = 0;
+    // indexed by the allocation index, written after all other data
+    vector<LifetimeHistogram> lifetimes;
+    int64_t timeStamp = 0;
+    uint64_t events = 0;
     AllocationInfoSet allocationInfos;
     std::set<uint64_t> managedPointersSet;
     std::set<uint64_t> gcManagedPointersSet;
@@ -619,7 +866,8 @@ int main(int /*argc*/, char** /*argv*/)
             }
             ptrToIndex.addPointer(ptr, index);
             managedPointersSet.insert(ptr);
-            lastPtr = ptr;
+            ++events;
+            ++threadEvents[lastThread].events;
             fprintf(outStream, "^ %x\n", index.index);
         } else if (reader.mode() == 'G') {
             int isStart;
@@ -752,13 +1000,52 @@ int main(int /*argc*/, char** /*argv*/)
                 cerr << "[W] failed to parse line: " << reader.line() << endl;
                 continue;
             }
+            uint32_t thread = 0;
+            uint64_t usableSize = 0;
+            if (reader >> thread) {
+                reader >> usableSize;
+            }
+            uint64_t slack = 0;
+            if (usableSize > size) {
+                slack = usableSize - size;
+            } else if (!usableSize && mallocAlignment) {
+                slack = modelSlack(size, mallocAlignment);
+            }
 
             AllocationIndex index;
-            if (allocationInfos.add(size, traceId, &index, 0)) {
-                fprintf(outStream, "a %" PRIx64 " %x 0\n", size, traceId.index);
+            // the allocations are attributed to threads and get their slack through their allocation infos
+            if (allocationInfos.add(size, traceId, &index, 0, thread, slack)) {
+                if (slack) {
+                    fprintf(outStream, "a %" PRIx64 " %x 0 %x %" PRIx64 "\n", size, traceId.index, thread, slack);
+                } else if (thread) {
+                    fprintf(outStream, "a %" PRIx64 " %x 0 %x\n", size, traceId.index, thread);
+                } else {
+                    fprintf(outStream, "a %" PRIx64 " %x 0\n", size, traceId.index);
+                }
             }
             ptrToIndex.addPointer(ptr, index);
-            lastPtr = ptr;
+            if (trackLifetimes) {
+                births.addPointer(ptr, {timeStamp, events});
+            }
+            ++events;
+            if (mallocInfos.size() <= index.index) {
+                mallocInfos.resize(index.index + 1);
+            }
+            auto& mallocInfo = mallocInfos[index.index];
+            mallocInfo.isMalloc = true;
+            mallocInfo.thread = thread;
+            mallocInfo.size = size;
+            lastThread = thread;
+            auto& mallocThread = threadEvents[thread];
+            auto& recentMallocs = mallocThread.recentMallocs;
+            while (!recentMallocs.empty()
+                   && mallocThread.events - recentMallocs.front().threadEvent - 1 > maxTemporaryEvents) {
+                recentMallocs.pop_front();
+            }
+            recentMallocs.push_back({ptr, mallocThread.events++, timeStamp});
+            if (trackFragmentation) {
+                pages.add(ptr, size);
+            }
             fprintf(outStream, "+ %x\n", index.index);
         } else if (reader.mode() == '-') {
             uint64_t ptr = 0;
@@ -766,17 +1053,60 @@ int main(int /*argc*/, char** /*argv*/)
                 cerr << "[W] failed to parse line: " << reader.line() << endl;
                 continue;
             }
-            bool temporary = lastPtr == ptr;
-            lastPtr = 0;
+            uint32_t thread = 0;
+            reader >> thread;
+            lastThread = thread;
+            auto& freeThread = threadEvents[thread];
             auto allocation = ptrToIndex.takePointer(ptr);
             if (!allocation.second) {
+                ++freeThread.events;
                 continue;
             }
-            fprintf(outStream, "- %x\n", allocation.first.index);
+            bool temporary = false;
+            const auto mallocInfo =
+                allocation.first.index < mallocInfos.size() ? mallocInfos[allocation.first.index] : MallocInfo();
+            if (mallocInfo.isMalloc) {
+                // the newest entry is the live allocation, in case the pointer got allocated twice
+                const auto allocationThread = mallocInfo.thread;
+                auto& recentMallocs = threadEvents[allocationThread].recentMallocs;
+                auto recent = find_if(recentMallocs.rbegin(), recentMallocs.rend(),
+                                      [ptr](const RecentMalloc& recent) { return recent.ptr == ptr; });
+                if (recent != recentMallocs.rend()) {
+                    temporary = allocationThread == thread
+                        && freeThread.events - recent->threadEvent - 1 <= maxTemporaryEvents
+                        && timeStamp - recent->timeStamp <= maxTemporaryTime;
+                    recentMallocs.erase(next(recent).base());
+                }
+            }
+            const auto birth = trackLifetimes ? births.takePointer(ptr) : make_pair(Birth(), false);
+            if (birth.second) {
+                if (lifetimes.size() <= allocation.first.index) {
+                    lifetimes.resize(allocation.first.index + 1);
+                }
+                lifetimes[allocation.first.index].add(timeStamp - birth.first.timeStamp,
+                                                      events - birth.first.event - 1);
+            }
+            if (trackFragmentation && mallocInfo.isMalloc) {
+                pages.remove(ptr, mallocInfo.size);
+            }
+            ++events;
+            ++freeThread.events;
+            // the analysis can't tell the temporary allocations of interleaving threads apart
+            fprintf(outStream, temporary ? "- %x 1\n" : "- %x\n", allocation.first.index);
             if (temporary) {
                 ++temporaryAllocations;
             }
             --leakedAllocations;
+        } else if (reader.mode() == 'h') {
+            uint32_t thread = 0;
+            string name;
+            if (!(reader >> thread) || !(reader >> name)) {
+                cerr << "[W] failed to parse line: " << reader.line() << endl;
+                continue;
+            }
+            // thread names can contain spaces
+            name = reader.line().substr(reader.line().find(' ', 2) + 1);
+            fprintf(outStream, "h %x %zx\n", thread, data.intern(name));
         } else if (reader.mode() == 'n') {
             uint64_t ip;
             string methodOrClassName;
@@ -820,6 +1150,50 @@ int main(int /*argc*/, char** /*argv*/)
                 cerr << "[W] unknown object id (" << objectPointer << ") here: " << reader.line() << endl;
             // trace point, map current output index to parent index
             fprintf(outStream, "e %zx %zx %zx %zx %zx\n", gcCounter, numChildren, objectPointer, classId, objectId.first.index);
+        } else if (reader.mode() == 'c') {
+            if (!(reader >> timeStamp)) {
+                cerr << "[W] failed to parse line: " << reader.line() << endl;
+            }
+            // the fragmentation is written in front of the time stamp, like the events it results from
+            if (trackFragmentation) {
+                if (pages.liveBytes() != lastLiveBytes || pages.spannedBytes() != lastSpannedBytes
+                    || pages.sparseBytes() != lastSparseBytes) {
+                    lastLiveBytes = pages.liveBytes();
+                    lastSpannedBytes = pages.spannedBytes();
+                    lastSparseBytes = pages.sparseBytes();
+                    fprintf(outStream, "f %" PRIx64 " %" PRIx64 " %" PRIx64 "\n", lastLiveBytes, lastSpannedBytes,
+                            lastSparseBytes);
+                }
+                // walking all live allocations is expensive, so the gap has to grow by a sixteenth
+                // to take a new snapshot of the pinned pages
+                const auto gap = pages.spannedBytes() - pages.liveBytes();
+                if (gap > pinnedGap + pinnedGap / 16) {
+                    pinnedGap = gap;
+                    pinned.assign(pinned.size(), 0);
+                    ptrToIndex.forEachPointer([&](uint64_t ptr, AllocationIndex index) {
+                        if (index.index >= mallocInfos.size() || !mallocInfos[index.index].isMalloc) {
+                            return;
+                        }
+                        const auto bytes = pages.pinnedBytes(ptr, mallocInfos[index.index].size);
+                        if (!bytes) {
+                            return;
+                        }
+                        if (pinned.size() <= index.index) {
+                            pinned.resize(index.index + 1);
+                        }
+                        pinned[index.index] += bytes;
+                    });
+                }
+            }
+            fputs(reader.line().c_str(), outStream);
+            fputc('\n', outStream);
+        } else if (reader.mode() == 'I') {
+            uint64_t pageSize = 0;
+            if (reader >> pageSize) {
+                pages.setPageSize(pageSize);
+            }
+            fputs(reader.line().c_str(), outStream);
+            fputc('\n', outStream);
         } else if (reader.mode() == 'C') {
             uintptr_t classPointer = 0;
             if (!(reader >> classPointer)) {
@@ -833,6 +1207,33 @@ int main(int /*argc*/, char** /*argv*/)
         }
     }
 
+    // one line per allocation index that got freed, with the counts by time and then by events
+    for (size_t index = 0; index < lifetimes.size(); ++index) {
+        const auto& lifetime = lifetimes[index];
+        uint64_t freed = 0;
+        for (const auto count : lifetime.byEvents) {
+            freed += count;
+        }
+        if (!freed) {
+            continue;
+        }
+        fprintf(outStream, "l %zx", index);
+        for (const auto count : lifetime.byTime) {
+            fprintf(outStream, " %" PRIx64, count);
+        }
+        for (const auto count : lifetime.byEvents) {
+            fprintf(outStream, " %" PRIx64, count);
+        }
+        fputc('\n', outStream);
+    }
+
+    // one line per allocation index that pinned sparse pages at the largest fragmentation
+    for (size_t index = 0; index < pinned.size(); ++index) {
+        if (pinned[index]) {
+            fprintf(outStream, "p %zx %" PRIx64 "\n", index, pinned[index]);
+        }
+    }
+
     fprintf(stderr, "heaptrack stats:\n"
                     "\tallocations:          \t%" PRIu64 "\n"
                     "\tleaked allocations:   \t%" PRIu64 "\n"
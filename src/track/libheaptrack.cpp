@@ -31,12 +31,14 @@
 #include <cstdlib>
 #include <fcntl.h>
 #include <link.h>
+#include <malloc.h>
 #include <stdio_ext.h>
 #include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 
 #include <sys/mman.h>
+#include <sys/prctl.h>
 
 #include <atomic>
 #include <cinttypes>
@@ -75,6 +77,14 @@ __thread StackEntry* g_shadowStack = nullptr;
 
 namespace {
 
+/**
+ * Compact id of the calling thread, the threads are numbered from 1 on in the order
+ * of their first allocation event, see HeapTrack::threadId. It allows to attribute
+ * the allocations to threads and to find temporary allocations per thread.
+ */
+__thread uint32_t t_threadId = 0;
+atomic<uint32_t> s_nextThreadId{0};
+
 /**
  * Set to true in an atexit handler. In such conditions, the stop callback
  * will not be called.
@@ -486,7 +496,16 @@ public:
         s_data->known.insert(ptr);
 #endif
 
-        if (fprintf(s_data->out, "+ %zx %x %" PRIxPTR "\n", size, index, reinterpret_cast<uintptr_t>(ptr)) < 0) {
+        const auto thread = threadId();
+        int ret = 0;
+        if (s_data->writeUsableSize) {
+            ret = fprintf(s_data->out, "+ %zx %x %" PRIxPTR " %x %zx\n", size, index, reinterpret_cast<uintptr_t>(ptr),
+                          thread, malloc_usable_size(ptr));
+        } else {
+            ret = fprintf(s_data->out, "+ %zx %x %" PRIxPTR " %x\n", size, index, reinterpret_cast<uintptr_t>(ptr),
+                          thread);
+        }
+        if (ret < 0) {
             writeError();
             return;
         }
@@ -504,12 +523,35 @@ public:
         s_data->known.erase(it);
 #endif
 
-        if (fprintf(s_data->out, "- %" PRIxPTR "\n", reinterpret_cast<uintptr_t>(ptr)) < 0) {
+        const auto thread = threadId();
+        if (fprintf(s_data->out, "- %" PRIxPTR " %x\n", reinterpret_cast<uintptr_t>(ptr), thread) < 0) {
             writeError();
             return;
         }
     }
 
+    /**
+     * @return the compact id of the calling thread. On the first event of a thread, its id
+     *         is written together with its name, i.e. the one in /proc/self/task/<tid>/comm.
+     */
+    uint32_t threadId()
+    {
+        if (t_threadId) {
+            return t_threadId;
+        }
+        t_threadId = ++s_nextThreadId;
+
+        // reading the name from procfs could allocate, prctl gives the same for the calling thread
+        char name[17] = {};
+        if (prctl(PR_GET_NAME, name) != 0 || !name[0]) {
+            return t_threadId;
+        }
+        if (fprintf(s_data->out, "h %x %s\n", t_threadId, name) < 0) {
+            writeError();
+        }
+        return t_threadId;
+    }
+
     void handleMmap(void* ptr,
                     size_t length,
                     int prot,
@@ -769,6 +811,9 @@ private:
         {
             debugLog<MinimalOutput>("%s", "constructing LockedData");
 
+            const char* usableSize = getenv("DUMP_HEAPTRACK_USABLE_SIZE");
+            writeUsableSize = usableSize && strcmp(usableSize, "0") != 0;
+
             procSmaps = fopen("/proc/self/smaps", "r");
             if (!procSmaps) {
                 fprintf(stderr, "WARNING: Failed to open /proc/self/smaps for reading.\n");
@@ -853,6 +898,9 @@ private:
         /// /proc/self/smaps file stream to read address range data from
         FILE* procSmaps = nullptr;
 
+        /// write the malloc_usable_size of each allocation, to find the allocator slack
+        bool writeUsableSize = false;
+
         /**
          * Calls to dlopen/dlclose mark the cache as dirty.
          * When this happened, all modules and their section addresses
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef BLOCKMAP_H
+#define BLOCKMAP_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * An ordered map with a subset of the std::map API, optimized for maps with
+ * many small entries that are frequently looked up and modified around a
+ * known position.
+ *
+ * Instead of allocating one tree node per entry, the sorted entries are kept
+ * in contiguous blocks of at most MaxBlockSize entries, i.e. the map is a
+ * two-level B-tree. A block is split when it grows beyond its maximum size and
+ * removed when it gets empty.
+ *
+ * NOTE: unlike with std::map, any insertion or removal invalidates all
+ *       iterators, except for erase() which returns the iterator following
+ *       the erased entry and keeps iterators before the erased entry valid.
+ */
+template <typename Key, typename Value, std::size_t MaxBlockSize = 64>
+class BlockMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+
+private:
+    using Block = std::vector<value_type>;
+
+    template <bool IsConst>
+    class Iterator
+    {
+        using Map = typename std::conditional<IsConst, const BlockMap, BlockMap>::type;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = typename BlockMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<IsConst, const value_type*, value_type*>::type;
+        using reference = typename std::conditional<IsConst, const value_type&, value_type&>::type;
+
+        Iterator() = default;
+
+        Iterator(Map* map, std::size_t block, std::size_t pos)
+            : m_map(map)
+            , m_block(block)
+            , m_pos(pos)
+        {
+        }
+
+        // allow conversion from iterator to const_iterator
+        template <bool OtherIsConst, typename = typename std::enable_if<IsConst && !OtherIsConst>::type>
+        Iterator(const Iterator<OtherIsConst>& other)
+            : m_map(other.m_map)
+            , m_block(other.m_block)
+            , m_pos(other.m_pos)
+        {
+        }
+
+        reference operator*() const
+        {
+            return m_map->m_blocks[m_block][m_pos];
+        }
+
+        pointer operator->() const
+        {
+            return &m_map->m_blocks[m_block][m_pos];
+        }
+
+        Iterator& operator++()
+        {
+            if (++m_pos == m_map->m_blocks[m_block].size()) {
+                ++m_block;
+                m_pos = 0;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        Iterator& operator--()
+        {
+            if (m_pos == 0) {
+                --m_block;
+                m_pos = m_map->m_blocks[m_block].size() - 1;
+            } else {
+                --m_pos;
+            }
+            return *this;
+        }
+
+        Iterator operator--(int)
+        {
+            auto ret = *this;
+            --*this;
+            return ret;
+        }
+
+        bool operator==(const Iterator& rhs) const
+        {
+            return m_block == rhs.m_block && m_pos == rhs.m_pos;
+        }
+
+        bool operator!=(const Iterator& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class BlockMap;
+        template <bool>
+        friend class Iterator;
+
+        Map* m_map = nullptr;
+        std::size_t m_block = 0;
+        std::size_t m_pos = 0;
+    };
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    iterator begin()
+    {
+        return {this, 0, 0};
+    }
+
+    iterator end()
+    {
+        return {this, m_blocks.size(), 0};
+    }
+
+    const_iterator begin() const
+    {
+        return {this, 0, 0};
+    }
+
+    const_iterator end() const
+    {
+        return {this, m_blocks.size(), 0};
+    }
+
+    reverse_iterator rbegin()
+    {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend()
+    {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    bool empty() const
+    {
+        return m_blocks.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    void clear()
+    {
+        m_blocks.clear();
+        m_size = 0;
+    }
+
+    iterator lower_bound(const Key& key)
+    {
+        return bound<iterator>(this, key, false);
+    }
+
+    const_iterator lower_bound(const Key& key) const
+    {
+        return bound<const_iterator>(this, key, false);
+    }
+
+    iterator upper_bound(const Key& key)
+    {
+        return bound<iterator>(this, key, true);
+    }
+
+    const_iterator upper_bound(const Key& key) const
+    {
+        return bound<const_iterator>(this, key, true);
+    }
+
+    iterator find(const Key& key)
+    {
+        auto it = lower_bound(key);
+        if (it != end() && it->first == key) {
+            return it;
+        }
+        return end();
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        if (m_blocks.empty()) {
+            // findBlock needs the last key of each block, so never keep an empty one
+            m_blocks.emplace_back();
+            m_blocks.back().reserve(MaxBlockSize + 1);
+            m_blocks.back().push_back(value);
+            ++m_size;
+            return {iterator(this, 0, 0), true};
+        }
+
+        // insert into the first block that contains larger keys, or append to the last one
+        auto blockIt = findBlock(this, value.first, false);
+        if (blockIt == m_blocks.end()) {
+            --blockIt;
+        }
+        auto& block = *blockIt;
+        auto pos = std::lower_bound(block.begin(), block.end(), value.first, compareKey);
+        if (pos != block.end() && pos->first == value.first) {
+            return {iterator(this, blockIt - m_blocks.begin(), pos - block.begin()), false};
+        }
+
+        std::size_t blockIndex = blockIt - m_blocks.begin();
+        std::size_t posIndex = pos - block.begin();
+        block.insert(pos, value);
+        ++m_size;
+
+        if (block.size() > MaxBlockSize) {
+            // split the block in halves
+            const std::size_t half = block.size() / 2;
+            Block tail;
+            tail.reserve(MaxBlockSize + 1);
+            tail.insert(tail.end(), std::make_move_iterator(block.begin() + half),
+                        std::make_move_iterator(block.end()));
+            block.erase(block.begin() + half, block.end());
+            m_blocks.insert(m_blocks.begin() + blockIndex + 1, std::move(tail));
+            if (posIndex >= half) {
+                ++blockIndex;
+                posIndex -= half;
+            }
+        }
+
+        return {iterator(this, blockIndex, posIndex), true};
+    }
+
+    iterator erase(const_iterator it)
+    {
+        assert(it != end());
+
+        auto& block = m_blocks[it.m_block];
+        block.erase(block.begin() + it.m_pos);
+        --m_size;
+
+        if (block.empty()) {
+            m_blocks.erase(m_blocks.begin() + it.m_block);
+            return {this, it.m_block, 0};
+        } else if (it.m_pos == block.size()) {
+            return {this, it.m_block + 1, 0};
+        }
+        return {this, it.m_block, it.m_pos};
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        auto count = std::distance(first, last);
+        iterator it(this, first.m_block, first.m_pos);
+        while (count--) {
+            it = erase(it);
+        }
+        return it;
+    }
+
+private:
+    static bool compareKey(const value_type& value, const Key& key)
+    {
+        return value.first < key;
+    }
+
+    template <typename Map>
+    static auto findBlock(Map* map, const Key& key, bool upper) -> decltype(map->m_blocks.begin())
+    {
+        // the blocks are sorted, so search for the first block whose last key is not smaller,
+        // or for upper_bound, larger than the key
+        return std::partition_point(map->m_blocks.begin(), map->m_blocks.end(), [&key, upper](const Block& block) {
+            return upper ? !(key < block.back().first) : block.back().first < key;
+        });
+    }
+
+    template <typename It, typename Map>
+    static It bound(Map* map, const Key& key, bool upper)
+    {
+        auto blockIt = findBlock(map, key, upper);
+        if (blockIt == map->m_blocks.end()) {
+            return It(map, map->m_blocks.size(), 0);
+        }
+        auto pos = upper ? std::upper_bound(blockIt->begin(), blockIt->end(), key,
+                                            [](const Key& key, const value_type& value) { return key < value.first; })
+                         : std::lower_bound(blockIt->begin(), blockIt->end(), key, compareKey);
+        assert(pos != blockIt->end());
+        return It(map, blockIt - map->m_blocks.begin(), pos - blockIt->begin());
+    }
+
+    std::vector<Block> m_blocks;
+    std::size_t m_size = 0;
+};
+
+#endif // BLOCKMAP_H
@@ -25,7 +25,7 @@
 #define HEAPTRACK_VERSION_PATCH 0
 #define HEAPTRACK_VERSION ((HEAPTRACK_VERSION_MAJOR<<16)|(HEAPTRACK_VERSION_MINOR<<8)|(HEAPTRACK_VERSION_PATCH))
 
-#define HEAPTRACK_FILE_FORMAT_VERSION 2
+#define HEAPTRACK_FILE_FORMAT_VERSION 3
 
 #define HEAPTRACK_DEBUG_BUILD 1
 
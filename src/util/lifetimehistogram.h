@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef LIFETIMEHISTOGRAM_H
+#define LIFETIMEHISTOGRAM_H
+
+#include <cstdint>
+
+/**
+ * Lifetimes of the freed allocations of one allocation index, once by the time between
+ * the allocation and the deallocation and once by the number of allocation events in
+ * between. The buckets grow by a factor of ten, the first one holds the lifetimes below
+ * its bound and the last one all the lifetimes that don't fit into the others.
+ */
+struct LifetimeHistogram
+{
+    enum
+    {
+        NUM_BUCKETS = 6,
+        // the time stamps are written every 10ms, shorter lifetimes can't be told apart
+        FIRST_TIME_BOUND = 10,
+        // allocations that are freed right away, i.e. the temporary ones, get a bucket of their own
+        FIRST_EVENTS_BOUND = 1,
+        // freed before 100 other allocation events happened
+        SHORT_LIVED_BUCKETS = 3
+    };
+
+    static int bucket(uint64_t value, uint64_t bound)
+    {
+        int bucket = 0;
+        while (bucket < NUM_BUCKETS - 1 && value >= bound) {
+            bound *= 10;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    void add(uint64_t milliseconds, uint64_t events)
+    {
+        ++byTime[bucket(milliseconds, FIRST_TIME_BOUND)];
+        ++byEvents[bucket(events, FIRST_EVENTS_BOUND)];
+    }
+
+    uint64_t shortLived() const
+    {
+        uint64_t ret = 0;
+        for (int i = 0; i < SHORT_LIVED_BUCKETS; ++i) {
+            ret += byEvents[i];
+        }
+        return ret;
+    }
+
+    LifetimeHistogram& operator+=(const LifetimeHistogram& rhs)
+    {
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            byTime[i] += rhs.byTime[i];
+            byEvents[i] += rhs.byEvents[i];
+        }
+        return *this;
+    }
+
+    uint64_t byTime[NUM_BUCKETS] = {};
+    uint64_t byEvents[NUM_BUCKETS] = {};
+};
+
+#endif // LIFETIMEHISTOGRAM_H
@@ -19,7 +19,10 @@
 #ifndef LINEREADER_H
 #define LINEREADER_H
 
+#include <bitset>
+#include <cstdint>
 #include <istream>
+#include <limits>
 #include <string>
 
 /**
@@ -43,6 +46,7 @@ public:
             return false;
         }
         std::getline(in, m_line);
+        m_size = m_line.size() + 1;
         m_it = m_line.cbegin();
         if (m_line.length() > 2) {
             m_it += 2;
@@ -52,6 +56,37 @@ public:
         return true;
     }
 
+    using Modes = std::bitset<256>;
+
+    /**
+     * Like getLine, but lines whose mode is set in @p skipModes are consumed after
+     * peeking at their first character, without copying them. They are returned
+     * as empty lines, i.e. with the comment mode.
+     */
+    bool getLine(std::istream& in, const Modes& skipModes)
+    {
+        if (!in.good()) {
+            return false;
+        }
+        const auto mode = in.peek();
+        if (mode == std::istream::traits_type::eof() || !skipModes[static_cast<unsigned char>(mode)]) {
+            return getLine(in);
+        }
+        in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        m_size = in.gcount();
+        m_line.clear();
+        m_it = m_line.cend();
+        return true;
+    }
+
+    /**
+     * @return the size of the last line in bytes, including the newline
+     */
+    uint64_t size() const
+    {
+        return m_size;
+    }
+
     char mode() const
     {
         return m_line.empty() ? '#' : m_line[0];
@@ -150,6 +185,7 @@ public:
 private:
     std::string m_line;
     std::string::const_iterator m_it;
+    uint64_t m_size = 0;
 };
 
 #endif // LINEREADER_H
@@ -40,9 +40,14 @@ struct IndexedAllocationInfo
     TraceIndex traceIndex;
     AllocationIndex allocationIndex;
     int isManaged;
+    // the compact id of the thread that made the allocation, 0 when unknown
+    uint32_t thread;
+    // the bytes that the allocator reserved beyond the requested size
+    uint64_t slack;
     bool operator==(const IndexedAllocationInfo& rhs) const
     {
-        return rhs.traceIndex == traceIndex && rhs.size == size && rhs.isManaged == isManaged;
+        return rhs.traceIndex == traceIndex && rhs.size == size && rhs.isManaged == isManaged
+            && rhs.thread == thread && rhs.slack == slack;
         // allocationInfoIndex not compared to allow to look it up
     }
 };
@@ -57,6 +62,8 @@ struct hash<IndexedAllocationInfo>
         boost::hash_combine(seed, info.size);
         boost::hash_combine(seed, info.traceIndex.index);
         boost::hash_combine(seed, info.isManaged);
+        boost::hash_combine(seed, info.thread);
+        boost::hash_combine(seed, info.slack);
         // allocationInfoIndex not hashed to allow to look it up
         return seed;
     }
@@ -70,10 +77,11 @@ struct AllocationInfoSet
         set.reserve(625000);
     }
 
-    bool add(uint64_t size, TraceIndex traceIndex, AllocationIndex* allocationIndex, int isManaged)
+    bool add(uint64_t size, TraceIndex traceIndex, AllocationIndex* allocationIndex, int isManaged,
+             uint32_t thread = 0, uint64_t slack = 0)
     {
         allocationIndex->index = set.size();
-        IndexedAllocationInfo info = {size, traceIndex, *allocationIndex, isManaged};
+        IndexedAllocationInfo info = {size, traceIndex, *allocationIndex, isManaged, thread, slack};
         auto it = set.find(info);
         if (it != set.end()) {
             *allocationIndex = it->allocationIndex;
@@ -87,8 +95,8 @@ struct AllocationInfoSet
 };
 
 /**
- * A low-memory-overhead map of 64bit pointer addresses to 32bit allocation
- * indices.
+ * A low-memory-overhead map of 64bit pointer addresses to small values, usually
+ * 32bit allocation indices.
  *
  * We leverage the fact that pointers are allocated in pages, i.e. close to each
  * other. We split the 64bit address into a common large part and an individual
@@ -97,10 +105,10 @@ struct AllocationInfoSet
  *
  * The big part of the address is used for a hash map to lookup the Indices
  * structure where we aggregate common pointers in two memory-efficient vectors,
- * one for the 16bit small pointer pairs, and one for the 32bit allocation
- * indices.
+ * one for the 16bit small pointer pairs, and one for the values.
  */
-class PointerMap
+template <typename Value>
+class BasicPointerMap
 {
     struct SplitPointer
     {
@@ -118,12 +126,12 @@ class PointerMap
     };
 
 public:
-    PointerMap()
+    BasicPointerMap()
     {
         map.reserve(1024);
     }
 
-    void addPointer(const uint64_t ptr, const AllocationIndex allocationIndex)
+    void addPointer(const uint64_t ptr, const Value value)
     {
         const SplitPointer pointer(ptr);
 
@@ -133,16 +141,16 @@ public:
         }
         auto& indices = mapIt->second;
         auto pageIt = std::lower_bound(indices.smallPtrParts.begin(), indices.smallPtrParts.end(), pointer.small);
-        auto allocationIt = indices.allocationIndices.begin() + distance(indices.smallPtrParts.begin(), pageIt);
+        auto valueIt = indices.values.begin() + distance(indices.smallPtrParts.begin(), pageIt);
         if (pageIt == indices.smallPtrParts.end() || *pageIt != pointer.small) {
             indices.smallPtrParts.insert(pageIt, pointer.small);
-            indices.allocationIndices.insert(allocationIt, allocationIndex);
+            indices.values.insert(valueIt, value);
         } else {
-            *allocationIt = allocationIndex;
+            *valueIt = value;
         }
     }
 
-    std::pair<AllocationIndex, bool> takePointer(const uint64_t ptr)
+    std::pair<Value, bool> takePointer(const uint64_t ptr)
     {
         const SplitPointer pointer(ptr);
 
@@ -155,18 +163,18 @@ public:
         if (pageIt == indices.smallPtrParts.end() || *pageIt != pointer.small) {
             return {{}, false};
         }
-        auto allocationIt = indices.allocationIndices.begin() + distance(indices.smallPtrParts.begin(), pageIt);
-        auto index = *allocationIt;
-        indices.allocationIndices.erase(allocationIt);
+        auto valueIt = indices.values.begin() + distance(indices.smallPtrParts.begin(), pageIt);
+        auto value = *valueIt;
+        indices.values.erase(valueIt);
         indices.smallPtrParts.erase(pageIt);
-        if (indices.allocationIndices.empty()) {
+        if (indices.values.empty()) {
             map.erase(mapIt);
         }
-        return {index, true};
+        return {value, true};
     }
 
-    // Get AllocationIndex for a pointer without removing it from the map
-    std::pair<AllocationIndex, bool> peekPointer(const uint64_t ptr)
+    // Get the value for a pointer without removing it from the map
+    std::pair<Value, bool> peekPointer(const uint64_t ptr)
     {
         const SplitPointer pointer(ptr);
 
@@ -179,18 +187,31 @@ public:
         if (pageIt == indices.smallPtrParts.end() || *pageIt != pointer.small) {
             return {{}, false};
         }
-        auto allocationIt = indices.allocationIndices.begin() + distance(indices.smallPtrParts.begin(), pageIt);
-        auto index = *allocationIt;
-        return {index, true};
+        auto valueIt = indices.values.begin() + distance(indices.smallPtrParts.begin(), pageIt);
+        return {*valueIt, true};
+    }
+
+    // Call @p visitor with each pointer and its value, in no particular order
+    template <typename Visitor>
+    void forEachPointer(Visitor visitor) const
+    {
+        for (const auto& page : map) {
+            const auto& indices = page.second;
+            for (size_t i = 0; i < indices.smallPtrParts.size(); ++i) {
+                visitor(page.first * SplitPointer::PageSize + indices.smallPtrParts[i], indices.values[i]);
+            }
+        }
     }
 
 private:
     struct Indices
     {
         std::vector<uint16_t> smallPtrParts;
-        std::vector<AllocationIndex> allocationIndices;
+        std::vector<Value> values;
     };
     std::unordered_map<uint64_t, Indices> map;
 };
 
+using PointerMap = BasicPointerMap<AllocationIndex>;
+
 #endif // POINTERMAP_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "3rdparty/catch.hpp"
+#include "src/util/blockmap.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// small blocks, so that a few entries already split and remove blocks
+using Map = BlockMap<int, int, 4>;
+using Reference = map<int, int>;
+using Entries = vector<pair<int, int>>;
+
+Entries entries(const Map& map)
+{
+    return {map.begin(), map.end()};
+}
+
+Entries entries(const Reference& map)
+{
+    return {map.begin(), map.end()};
+}
+
+void validate(const Map& map, const Reference& reference)
+{
+    REQUIRE(map.size() == reference.size());
+    REQUIRE(map.empty() == reference.empty());
+    REQUIRE(entries(map) == entries(reference));
+    REQUIRE(Entries(map.rbegin(), map.rend()) == Entries(reference.rbegin(), reference.rend()));
+}
+
+void validateBounds(const Map& map, const Reference& reference, int key)
+{
+    REQUIRE(distance(map.begin(), map.lower_bound(key)) == distance(reference.begin(), reference.lower_bound(key)));
+    REQUIRE(distance(map.begin(), map.upper_bound(key)) == distance(reference.begin(), reference.upper_bound(key)));
+}
+}
+
+TEST_CASE ("an empty block map", "[blockmap]") {
+    Map map;
+    validate(map, {});
+    REQUIRE(map.lower_bound(0) == map.end());
+    REQUIRE(map.upper_bound(0) == map.end());
+    REQUIRE(map.find(0) == map.end());
+
+    SECTION ("insert the first entry") {
+        auto ret = map.insert({1, 10});
+        REQUIRE(ret.second);
+        REQUIRE(ret.first == map.begin());
+        REQUIRE(map.find(1)->second == 10);
+        REQUIRE(map.lower_bound(2) == map.end());
+        REQUIRE(map.upper_bound(0) == map.begin());
+        validate(map, {{1, 10}});
+    }
+}
+
+TEST_CASE ("a block map behaves like std::map", "[blockmap]") {
+    mt19937 random(42);
+    uniform_int_distribution<int> keys(0, 200);
+    uniform_int_distribution<int> operations(0, 9);
+
+    Map map;
+    Reference reference;
+    for (int i = 0; i < 20000; ++i) {
+        const auto key = keys(random);
+        const auto operation = operations(random);
+        if (operation < 5) {
+            auto ret = map.insert({key, i});
+            auto expected = reference.insert({key, i});
+            REQUIRE(ret.second == expected.second);
+            REQUIRE(ret.first->first == key);
+            REQUIRE(ret.first->second == expected.first->second);
+        } else if (operation < 8) {
+            auto it = map.find(key);
+            auto expected = reference.find(key);
+            REQUIRE((it == map.end()) == (expected == reference.end()));
+            if (it != map.end()) {
+                auto next = map.erase(it);
+                auto expectedNext = reference.erase(expected);
+                REQUIRE(distance(map.begin(), next) == distance(reference.begin(), expectedNext));
+            }
+        } else if (operation < 9) {
+            const auto lastKey = key + keys(random) / 20;
+            auto next = map.erase(map.lower_bound(key), map.upper_bound(lastKey));
+            auto expectedNext = reference.erase(reference.lower_bound(key), reference.upper_bound(lastKey));
+            REQUIRE(distance(map.begin(), next) == distance(reference.begin(), expectedNext));
+        } else {
+            map.clear();
+            reference.clear();
+        }
+        validateBounds(map, reference, key);
+        validateBounds(map, reference, keys(random));
+        if (i % 100 == 0) {
+            validate(map, reference);
+        }
+    }
+    validate(map, reference);
+}
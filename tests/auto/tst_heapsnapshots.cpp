@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "3rdparty/catch.hpp"
+#include "src/analyze/heapsnapshots.h"
+#include "src/analyze/traceanalysis.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace {
+/**
+ * A heap of objects that reference each other, node 0 is the root of the snapshot.
+ * Every object has a class of its own, so each group of a snapshot holds one object.
+ */
+struct Graph
+{
+    explicit Graph(uint32_t numNodes)
+        : references(numNodes)
+        , sizes(numNodes, 0)
+    {
+    }
+
+    // the records of the snapshot as the runtime writes them, see HeapSnapshot::read
+    void write(TraceAnalysis* data) const
+    {
+        data->allocationInfos.resize(sizes.size());
+        for (uint32_t node = 0; node < sizes.size(); ++node) {
+            data->allocationInfos[node].size = sizes[node];
+        }
+        vector<bool> visited(sizes.size(), false);
+        writeNode(data, 0, &visited);
+    }
+
+    void writeNode(TraceAnalysis* data, uint32_t node, vector<bool>* visited) const
+    {
+        const bool isVisited = (*visited)[node];
+        (*visited)[node] = true;
+        ObjectTreeNode record;
+        record.gcNum = 1;
+        record.numChildren = isVisited ? 0 : references[node].size();
+        record.objectPtr = 0x1000 + node * 0x10;
+        record.classIndex.index = node;
+        record.allocIndex.index = node;
+        data->objectTreeNodes.push_back(record);
+        if (!isVisited) {
+            for (const auto target : references[node]) {
+                writeNode(data, target, visited);
+            }
+        }
+    }
+
+    // @return for each node whether it can be reached from the root without passing @p removed
+    vector<bool> reachable(uint32_t removed) const
+    {
+        vector<bool> ret(sizes.size(), false);
+        vector<uint32_t> stack = {0};
+        ret[0] = true;
+        while (!stack.empty()) {
+            const auto node = stack.back();
+            stack.pop_back();
+            for (const auto target : references[node]) {
+                if (target != removed && !ret[target]) {
+                    ret[target] = true;
+                    stack.push_back(target);
+                }
+            }
+        }
+        return ret;
+    }
+
+    vector<vector<uint32_t>> references;
+    vector<uint64_t> sizes;
+};
+
+/**
+ * Compare the snapshot of @p graph to the dominator tree found by brute force: a node
+ * dominates the nodes that can't be reached anymore without it.
+ */
+void validate(const Graph& graph)
+{
+    TraceAnalysis data;
+    graph.write(&data);
+    HeapSnapshot snapshot;
+    size_t recordIndex = 0;
+    REQUIRE(snapshot.read(data, recordIndex));
+    REQUIRE(recordIndex == data.objectTreeNodes.size());
+
+    const auto numNodes = graph.sizes.size();
+    vector<vector<bool>> dominated(numNodes, vector<bool>(numNodes, true));
+    for (uint32_t node = 1; node < numNodes; ++node) {
+        const auto reachable = graph.reachable(node);
+        for (uint32_t other = 0; other < numNodes; ++other) {
+            dominated[node][other] = !reachable[other];
+        }
+    }
+
+    REQUIRE(snapshot.groups.size() == numNodes);
+    for (const auto& group : snapshot.groups) {
+        const auto node = group.classIndex.index;
+        REQUIRE(group.instances == 1);
+        REQUIRE(group.shallowSize == graph.sizes[node]);
+
+        uint64_t retainedSize = 0;
+        for (uint32_t other = 0; other < numNodes; ++other) {
+            if (dominated[node][other]) {
+                retainedSize += graph.sizes[other];
+            }
+        }
+        REQUIRE(group.retainedSize == retainedSize);
+
+        if (!node) {
+            REQUIRE(group.parent == -1);
+            continue;
+        }
+        // the immediate dominator is the one that dominates the fewest nodes
+        uint32_t dominator = 0;
+        size_t dominatorSize = numNodes;
+        for (uint32_t other = 1; other < numNodes; ++other) {
+            const size_t size = count(dominated[other].begin(), dominated[other].end(), true);
+            if (other != node && dominated[other][node] && size < dominatorSize) {
+                dominator = other;
+                dominatorSize = size;
+            }
+        }
+        REQUIRE(group.parent >= 0);
+        REQUIRE(snapshot.groups[group.parent].classIndex.index == dominator);
+    }
+}
+}
+
+TEST_CASE ("dominators of a small heap", "[heapsnapshots]") {
+    // 0 -> 1 -> 2 -> 4 -> 5
+    //   \> 3 -/        \-> 2
+    Graph graph(6);
+    graph.references = {{1, 3}, {2}, {4}, {2}, {5, 2}, {}};
+    graph.sizes = {0, 10, 20, 30, 40, 50};
+    validate(graph);
+}
+
+TEST_CASE ("dominators of random heaps", "[heapsnapshots]") {
+    mt19937 random(42);
+    for (int i = 0; i < 500; ++i) {
+        const auto numNodes = uniform_int_distribution<uint32_t>(1, 30)(random);
+        Graph graph(numNodes);
+        for (uint32_t node = 1; node < numNodes; ++node) {
+            // a spanning tree keeps all objects reachable, the other references add joins and cycles
+            graph.references[uniform_int_distribution<uint32_t>(0, node - 1)(random)].push_back(node);
+            graph.sizes[node] = uniform_int_distribution<uint64_t>(1, 1000)(random);
+        }
+        const auto numReferences = uniform_int_distribution<uint32_t>(0, numNodes * 2)(random);
+        for (uint32_t reference = 0; numNodes > 1 && reference < numReferences; ++reference) {
+            const auto source = uniform_int_distribution<uint32_t>(0, numNodes - 1)(random);
+            const auto target = uniform_int_distribution<uint32_t>(1, numNodes - 1)(random);
+            graph.references[source].push_back(target);
+        }
+        for (auto& references : graph.references) {
+            shuffle(references.begin(), references.end(), random);
+        }
+        validate(graph);
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "3rdparty/catch.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+// two call sites, the peak of 180 bytes is reached with 3 of the 4 allocations
+const string DEFINITIONS = "v 10100 2\n"
+                           "X ./test\n"
+                           "s libtest.so\n"
+                           "s alloc\n"
+                           "s main\n"
+                           "i 1000 1 2\n"
+                           "i 2000 1 3\n"
+                           "t 1 0\n"
+                           "t 2 1\n";
+const string TRACE = DEFINITIONS + "a 64 1 0\n"
+                                   "a 28 2 0\n"
+                                   "+ 0\n"
+                                   "c a\n"
+                                   "+ 1\n"
+                                   "+ 1\n"
+                                   "c 14\n"
+                                   "- 0\n"
+                                   "- 1\n"
+                                   "c 1e\n"
+                                   "+ 1\n"
+                                   "c 28\n";
+
+struct TemporaryFile
+{
+    TemporaryFile(const string& contents)
+    {
+        char name[] = "/tmp/tst_heaptrack_check.XXXXXX";
+        close(mkstemp(name));
+        path = name;
+        ofstream(path) << contents;
+    }
+
+    ~TemporaryFile()
+    {
+        unlink(path.c_str());
+    }
+
+    string path;
+};
+
+int check(const string& arguments)
+{
+    const auto status = system((string(HEAPTRACK_CHECK) + ' ' + arguments + " > /dev/null 2>&1").c_str());
+    REQUIRE(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+}
+
+TEST_CASE ("heaptrack_check exit codes", "[check]") {
+    TemporaryFile base(TRACE);
+
+    SECTION ("identical runs pass") {
+        REQUIRE(check(base.path + " -b " + base.path) == 0);
+    }
+
+    SECTION ("identical runs pass against a written baseline") {
+        TemporaryFile baseline("");
+        REQUIRE(check(base.path + " -w " + baseline.path) == 0);
+        REQUIRE(check(base.path + " -b " + baseline.path) == 0);
+    }
+
+    SECTION ("a larger peak fails") {
+        // 40 more bytes at the peak, i.e. an increase of 22%
+        TemporaryFile run(DEFINITIONS + "a 64 1 0\n"
+                                        "a 3c 2 0\n"
+                                        "+ 0\n"
+                                        "c a\n"
+                                        "+ 1\n"
+                                        "+ 1\n"
+                                        "c 14\n"
+                                        "- 0\n"
+                                        "- 1\n"
+                                        "c 1e\n"
+                                        "+ 1\n"
+                                        "c 28\n");
+        REQUIRE(check(run.path + " -b " + base.path) == 1);
+        REQUIRE(check(run.path + " -b " + base.path + " --max-peak-increase 25") == 0);
+    }
+
+    SECTION ("more allocations fail") {
+        // the same peak, but 6 instead of 4 allocations
+        TemporaryFile run(TRACE + "+ 1\n"
+                                  "- 1\n"
+                                  "+ 1\n"
+                                  "- 1\n"
+                                  "c 32\n");
+        REQUIRE(check(run.path + " -b " + base.path) == 1);
+        REQUIRE(check(run.path + " -b " + base.path + " --max-allocations-increase 50") == 0);
+    }
+
+    SECTION ("unreadable input is an error") {
+        REQUIRE(check(base.path + ".missing -b " + base.path) == 2);
+        REQUIRE(check(base.path + " -b " + base.path + ".missing") == 2);
+        TemporaryFile baseline("# heaptrack_check baseline\nno baseline\n");
+        REQUIRE(check(base.path + " -b " + baseline.path) == 2);
+        REQUIRE(check(base.path) == 2);
+    }
+}
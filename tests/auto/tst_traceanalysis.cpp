@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "3rdparty/catch.hpp"
+#include "src/analyze/traceanalysis.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+// two call sites, the peak of 180 bytes is reached at 20ms
+const char TRACE[] = "v 10100 2\n"
+                     "X ./test\n"
+                     "s libtest.so\n"
+                     "s alloc\n"
+                     "s main\n"
+                     "i 1000 1 2\n"
+                     "i 2000 1 3\n"
+                     "t 1 0\n"
+                     "t 2 1\n"
+                     "a 64 1 0\n"
+                     "a 28 2 0\n"
+                     "+ 0\n"
+                     "c a\n"
+                     "+ 1\n"
+                     "+ 1\n"
+                     "c 14\n"
+                     "- 0\n"
+                     "- 1\n"
+                     "c 1e\n"
+                     "+ 1\n"
+                     "c 28\n";
+
+struct TemporaryFile
+{
+    TemporaryFile(const char* contents)
+    {
+        char name[] = "/tmp/tst_traceanalysis.XXXXXX";
+        close(mkstemp(name));
+        path = name;
+        ofstream(path) << contents;
+    }
+
+    ~TemporaryFile()
+    {
+        unlink(path.c_str());
+    }
+
+    string path;
+};
+
+vector<AllocationData::Stats> allStats(const TraceAnalysis& data)
+{
+    vector<AllocationData::Stats> ret;
+    for (size_t slot = 0; slot < data.allocations.size(); ++slot) {
+        for (int display = 0; display < AllocationTable::NumDisplays; ++display) {
+            ret.push_back(data.allocations.stats(slot, static_cast<AllocationData::DisplayId>(display)));
+        }
+    }
+    return ret;
+}
+}
+
+TEST_CASE ("the chart pass keeps the peaks", "[traceanalysis]") {
+    TemporaryFile file(TRACE);
+    AccumulatedTraceData::isShowCoreCLRPartOption = true;
+
+    TraceAnalysis data;
+    REQUIRE(data.load(file.path));
+    REQUIRE(data.totalCost.malloc.peak == 180);
+    REQUIRE(data.allocations.size() == 2);
+    REQUIRE(data.allocations.stats(0, AllocationData::DisplayId::malloc).peak == 100);
+    REQUIRE(data.allocations.stats(1, AllocationData::DisplayId::malloc).peak == 80);
+    REQUIRE(data.partUnknown.malloc.peak == 100);
+    REQUIRE(data.partNonCoreclr.malloc.peak == 80);
+
+    const auto stats = allStats(data);
+    const auto totalCost = data.totalCost;
+    const auto parts = vector<AllocationData>{data.partCoreclr, data.partNonCoreclr, data.partUnknown,
+                                              data.partUntracked};
+
+    // heaptrack_gui reads the data a third time to build the charts and keeps it afterwards
+    REQUIRE(data.read(file.path));
+    REQUIRE(allStats(data) == stats);
+    REQUIRE(data.totalCost == totalCost);
+    REQUIRE((vector<AllocationData>{data.partCoreclr, data.partNonCoreclr, data.partUnknown, data.partUntracked}
+             == parts));
+
+    AccumulatedTraceData::isShowCoreCLRPartOption = false;
+}
+
+TEST_CASE ("the thread filter is kept per instance", "[traceanalysis]") {
+    // the same trace, but the two call sites are used by the threads 1 and 2
+    string trace = TRACE;
+    trace.replace(trace.find("a 64 1 0\n"), 9, "a 64 1 0 1\n");
+    trace.replace(trace.find("a 28 2 0\n"), 9, "a 28 2 0 2\n");
+    TemporaryFile file(trace.c_str());
+
+    TraceAnalysis filtered;
+    filtered.threadFilter = {"2"};
+    TraceAnalysis unfiltered;
+    REQUIRE(filtered.load(file.path));
+    REQUIRE(unfiltered.load(file.path));
+    REQUIRE(filtered.totalCost.malloc.peak == 80);
+    REQUIRE(unfiltered.totalCost.malloc.peak == 180);
+}
+
+TEST_CASE ("the peak of a time window", "[traceanalysis]") {
+    TemporaryFile file(TRACE);
+    TraceAnalysis data;
+    REQUIRE(data.load(file.path));
+
+    auto windowPeak = [&](int64_t begin, int64_t end, const TraceAnalysis::Filter& filter,
+                          const string& indexFile) {
+        TraceAnalysis::Peak peak;
+        REQUIRE(data.windowPeak(AllocationData::DisplayId::malloc, begin, end, &peak, indexFile, filter));
+        return vector<int64_t>{peak.time, peak.consumed, peak.instances};
+    };
+
+    TemporaryFile index("");
+    TraceAnalysis indexed;
+    REQUIRE(indexed.readAndIndex(file.path, index.path, 10));
+
+    for (const auto& indexFile : {string(), index.path}) {
+        REQUIRE(windowPeak(0, 100, {}, indexFile) == (vector<int64_t>{10, 180, 3}));
+        REQUIRE(windowPeak(20, 100, {}, indexFile) == (vector<int64_t>{20, 180, 3}));
+        // the frames are unresolved, all backtraces go through the module alloc, the second call site
+        // also through the module main
+        REQUIRE(windowPeak(20, 100, {"", "alloc"}, indexFile) == (vector<int64_t>{20, 180, 3}));
+        REQUIRE(windowPeak(0, 100, {"", "main"}, indexFile) == (vector<int64_t>{10, 80, 2}));
+        REQUIRE(windowPeak(25, 100, {"", "main"}, indexFile) == (vector<int64_t>{30, 80, 2}));
+        REQUIRE(windowPeak(0, 100, {"main", "main"}, indexFile) == (vector<int64_t>{0, 0, 0}));
+    }
+}
+
+TEST_CASE ("the call tree below a filter", "[traceanalysis]") {
+    TemporaryFile file(TRACE);
+    TraceAnalysis data;
+    REQUIRE(data.load(file.path));
+
+    const auto all = data.subtree(AllocationData::DisplayId::malloc, {"", "alloc"});
+    REQUIRE(all.cost.allocations == 4);
+    REQUIRE(all.children.size() == 1);
+    const auto& alloc = all.children[0];
+    REQUIRE(alloc.location.module == "alloc");
+    REQUIRE(alloc.cost.allocations == 4);
+    REQUIRE(alloc.parent == nullptr);
+    REQUIRE(alloc.children.size() == 1);
+    REQUIRE(alloc.children[0].location.module == "main");
+    REQUIRE(alloc.children[0].cost.allocations == 3);
+    REQUIRE(alloc.children[0].parent == &alloc);
+
+    const auto caller = data.subtree(AllocationData::DisplayId::malloc, {"", "main"});
+    REQUIRE(caller.cost.allocations == 3);
+    REQUIRE(caller.children.size() == 1);
+    REQUIRE(caller.children[0].location.module == "main");
+    REQUIRE(caller.children[0].children.empty());
+
+    REQUIRE(data.subtree(AllocationData::DisplayId::malloc, {"main", "main"}).children.empty());
+}